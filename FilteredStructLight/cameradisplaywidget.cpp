@@ -13,9 +13,16 @@ GLWidget::GLWidget(const int no_of_cams, const QGLFormat& format, QWidget* paren
 	: no_of_cams_(no_of_cams), QGLWidget(format, parent),
 	m_vertexBuffer(QGLBuffer::VertexBuffer), threshold_(0.075), is_thresholding_on_(0)
 {
+	preview_ = new CameraPreview(no_of_cams_, this);
+	preview_frames_.resize(no_of_cams_);
+	// queued, the preview thread only asks for a repaint
+	connect(preview_, &CameraPreview::frame_ready, this, [this](int) { update(); });
+	preview_->start();
 }
 
 GLWidget::~GLWidget() {
+	preview_->shutdown();
+	preview_->wait();
 	if (tex) {
 		delete[] tex;
 	}
@@ -80,6 +87,7 @@ void GLWidget::initializeGL()
 	// gen texture
 	tex = new GLuint[no_of_cams_];
 	glGenTextures(no_of_cams_, tex);
+	texture_sizes_.assign(no_of_cams_, cv::Size(0, 0));
 
 	for (int i = 0; i < no_of_cams_; ++i) {
 		glBindTexture(GL_TEXTURE_2D, tex[i]);
@@ -143,6 +151,8 @@ void GLWidget::resizeGL(int w, int h)
 {
 	// Set the viewport to window dimensions
 	glViewport(0, 0, w, qMax(h, 1));
+	// each camera gets a quarter of the widget
+	preview_->set_max_size(w / 2, qMax(h, 1) / 2);
 }
 
 void GLWidget::paintGL()
@@ -150,6 +160,8 @@ void GLWidget::paintGL()
 	// Clear the buffer with the current clearing color
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+	upload_previews();
+
 	if (!m_shader.bind())
 	{
 		qWarning() << "Could not bind shader program to context";
@@ -199,34 +211,30 @@ void GLWidget::set_no_of_cams(int no_of_cams) {
 	no_of_cams_ = no_of_cams;
 }
 
-void GLWidget::display_image(const Image& image, int cam_no) {
-
-	makeCurrent();
-	cv::Mat test2(image.GetRows(), image.GetCols(), CV_8UC1, image.GetData(), image.GetStride());
-	cv::Mat test;
-	//cv::cvtColor(test, colored, CV_BayerBG2BGR);
-	cv::cvtColor(test2, test, CV_BayerBG2GRAY);
-	// Set stride for unpacking pixels
-	glPixelStorei(GL_UNPACK_ROW_LENGTH, image.GetStride());
-	// Replace current texture with new image
-	glBindTexture(GL_TEXTURE_2D, tex[cam_no]);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, image.GetCols(), image.GetRows(), 0,
-		GL_RED, GL_UNSIGNED_BYTE, test.ptr());
-	FlyCapture2::PixelFormat format = image.GetPixelFormat();
-	glBindTexture(GL_TEXTURE_2D, NULL);
-
-	//cv::Mat test(image.GetRows(), image.GetCols(), CV_8UC1, image.GetData(), image.GetStride());
-
-	//std::string img_filename = std::string("test_") + std::to_string(cam_no) + std::string(".png");
-	//cv::imwrite(img_filename, test);
-	
-
-	update();
-	//if (cam_no == no_of_cams_ - 1) {
-	//	//glViewport(0, 0, width(), qMax(height(), 1));
-	//	updateGL();
-	//}
+CameraPreview* GLWidget::get_preview() {
+	return preview_;
+}
 
+// only the newest preview of each camera is uploaded, into the texture it already has unless its size changed
+void GLWidget::upload_previews() {
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	for (int i = 0; i < no_of_cams_ && i < texture_sizes_.size(); ++i) {
+		if (!preview_->take_frame(i, preview_frames_[i])) {
+			continue;
+		}
+		auto& frame = preview_frames_[i];
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, frame.step[0]);
+		glBindTexture(GL_TEXTURE_2D, tex[i]);
+		if (frame.size() != texture_sizes_[i]) {
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, frame.cols, frame.rows, 0, GL_RED, GL_UNSIGNED_BYTE, frame.ptr());
+			texture_sizes_[i] = frame.size();
+		} else {
+			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, frame.cols, frame.rows, GL_RED, GL_UNSIGNED_BYTE, frame.ptr());
+		}
+	}
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glBindTexture(GL_TEXTURE_2D, NULL);
 }
 
 void GLWidget::set_threshold(int value) {
@@ -7,6 +7,7 @@
 #include <QGLBuffer>
 #include <QGLShaderProgram>
 #include "FlyCapture2.h"
+#include "camerapreview.h"
 
 using namespace FlyCapture2;
 
@@ -37,8 +38,14 @@ private:
 	float threshold_;
 	int is_thresholding_on_;
 
+	CameraPreview* preview_;
+	// the frames last uploaded, their buffers go back to the preview on the next take
+	std::vector<cv::Mat> preview_frames_;
+	std::vector<cv::Size> texture_sizes_;
+
+	void upload_previews();
+
 public slots:
-void display_image(const FlyCapture2::Image& img, int cam_no);
 void set_threshold(int value);
 void toggle_thresholding(int value);
 
@@ -47,4 +54,6 @@ public:
 	virtual ~GLWidget();
 	QSize sizeHint() const;
 	void set_no_of_cams(int no_of_cams);
+	// frames go in here from the capture thread, see CameraPreview::submit
+	CameraPreview* get_preview();
 };
\ No newline at end of file
@@ -0,0 +1,109 @@
+#include "camerapreview.h"
+#include <algorithm>
+
+CameraPreview::CameraPreview(int no_of_cams, QObject* parent) : QThread(parent), slots_(no_of_cams),
+	max_width_(0), max_height_(0), is_shutting_down_(false) {
+}
+
+CameraPreview::~CameraPreview() {
+	shutdown();
+	wait();
+}
+
+void CameraPreview::submit(const FlyCapture2::Image& image, int cam_no) {
+	// capture doesn't wait for the preview, the frame is dropped while the worker or the gui hold the lock
+	if (!lock_.tryLock()) {
+		return;
+	}
+	if (cam_no >= 0 && cam_no < slots_.size()) {
+		cv::Mat raw(image.GetRows(), image.GetCols(), CV_8UC1, image.GetData(), image.GetStride());
+		// same size every frame, so the slot's buffer is reused
+		raw.copyTo(slots_[cam_no].raw);
+		slots_[cam_no].has_raw = true;
+		has_raw_.wakeOne();
+	}
+	lock_.unlock();
+}
+
+bool CameraPreview::take_frame(int cam_no, cv::Mat& frame) {
+	QMutexLocker locker(&lock_);
+	if (cam_no < 0 || cam_no >= slots_.size() || !slots_[cam_no].has_frame) {
+		return false;
+	}
+	cv::swap(slots_[cam_no].frame, frame);
+	slots_[cam_no].has_frame = false;
+	return true;
+}
+
+void CameraPreview::set_max_size(int max_width, int max_height) {
+	QMutexLocker locker(&lock_);
+	max_width_ = max_width;
+	max_height_ = max_height;
+}
+
+void CameraPreview::shutdown() {
+	QMutexLocker locker(&lock_);
+	is_shutting_down_ = true;
+	has_raw_.wakeAll();
+}
+
+void CameraPreview::run() {
+	std::vector<cv::Mat> raw(slots_.size());
+	std::vector<bool> has_raw(slots_.size());
+	cv::Mat gray;
+	cv::Mat frame;
+
+	while (true) {
+		int max_width = 0;
+		int max_height = 0;
+		{
+			QMutexLocker locker(&lock_);
+			while (!is_shutting_down_ && std::none_of(slots_.begin(), slots_.end(),
+				[](const PreviewSlot& slot) { return slot.has_raw; })) {
+				has_raw_.wait(&lock_);
+			}
+			if (is_shutting_down_) {
+				break;
+			}
+			// swapped, not copied, the capture thread writes the next frame into the buffer this one came from
+			for (int i = 0; i < slots_.size(); ++i) {
+				has_raw[i] = slots_[i].has_raw;
+				if (has_raw[i]) {
+					cv::swap(slots_[i].raw, raw[i]);
+					slots_[i].has_raw = false;
+				}
+			}
+			max_width = max_width_;
+			max_height = max_height_;
+		}
+
+		for (int i = 0; i < raw.size(); ++i) {
+			if (!has_raw[i]) {
+				continue;
+			}
+			cv::cvtColor(raw[i], gray, CV_BayerBG2GRAY);
+
+			// a whole factor keeps the preview size, and the texture, the same while the widget is resized
+			int factor = 1;
+			if (max_width > 0 && max_height > 0) {
+				factor = std::max(1, std::min(gray.cols / max_width, gray.rows / max_height));
+			}
+			if (factor > 1) {
+				cv::resize(gray, frame, cv::Size(gray.cols / factor, gray.rows / factor), 0, 0, cv::INTER_AREA);
+			} else {
+				cv::swap(gray, frame);
+			}
+
+			bool notify = false;
+			{
+				QMutexLocker locker(&lock_);
+				cv::swap(slots_[i].frame, frame);
+				notify = !slots_[i].has_frame;
+				slots_[i].has_frame = true;
+			}
+			if (notify) {
+				emit frame_ready(i);
+			}
+		}
+	}
+}
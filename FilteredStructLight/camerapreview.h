@@ -0,0 +1,46 @@
+#pragma once
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+#include <opencv2/opencv.hpp>
+#include <vector>
+#include "FlyCapture2.h"
+
+// one raw frame and one preview frame per camera, each a single slot where the latest frame replaces whatever
+// wasn't taken yet. the capture thread fills the raw slot, this thread turns it into a grey preview no bigger
+// than it needs to be for the widget, and the gui takes the preview when it paints. nothing waits on the
+// preview, a frame that comes in while the slot is busy is dropped
+class CameraPreview : public QThread {
+	Q_OBJECT
+
+	struct PreviewSlot {
+		cv::Mat raw;
+		bool has_raw;
+		cv::Mat frame;
+		bool has_frame;
+		PreviewSlot() : has_raw(false), has_frame(false) {}
+	};
+
+	QMutex lock_;
+	QWaitCondition has_raw_;
+	std::vector<PreviewSlot> slots_;
+	// previews are decimated by whole factors until they fit in this, 0 keeps the camera resolution
+	int max_width_;
+	int max_height_;
+	bool is_shutting_down_;
+
+public:
+	CameraPreview(int no_of_cams, QObject* parent = NULL);
+	~CameraPreview();
+	// called from the capture thread. copies the frame, so image can be reused right after
+	void submit(const FlyCapture2::Image& image, int cam_no);
+	// the newest preview of cam_no if there's one that wasn't taken. frame's buffer goes back to the slot
+	bool take_frame(int cam_no, cv::Mat& frame);
+	void set_max_size(int max_width, int max_height);
+	void shutdown();
+	void run();
+
+signals:
+	// only when the slot was empty, so there's at most one of these waiting per camera
+	void frame_ready(int cam_no);
+};
@@ -2,9 +2,6 @@
 
 
 
-const string CamThread::csDestinationDirectory = "";
-
-
 CamThread::CamThread(QObject* parent)
 {
 	init();
@@ -40,31 +37,6 @@ void CamThread::cleanup() {
 	delete[] ppCameras;
 }
 
-int CamThread::createFiles(FILE** arhFile, unsigned int g_uiNumCameras)
-{
-	for (unsigned int uiCamera = 0; uiCamera < g_uiNumCameras; uiCamera++)
-	{
-		stringstream sstream;
-		string tmpfilename;
-
-		sstream << csDestinationDirectory << "camera" << uiCamera << ".tmp";
-		sstream >> tmpfilename;
-		filenames.push_back(tmpfilename);
-
-		std::cout << "Creating " << tmpfilename << "..." << endl;
-
-		// Create temporary files to do writing to
-		arhFile[uiCamera] = fopen(tmpfilename.c_str(), "w+");
-		if (arhFile[uiCamera] == NULL)
-		{
-			assert(false);
-			return -1;
-		}
-	}
-	return 0;
-}
-
-
 void CamThread::PrintBuildInfo()
 {
 	FC2Version fc2Version;
@@ -110,9 +82,6 @@ std::vector<unsigned> CamThread::get_serial_nos() {
 int CamThread::init()
 {
 
-	iCountMissedIm = 0;
-	iImageSize = 0;
-
 	PrintBuildInfo();
 
 
@@ -133,14 +102,6 @@ int CamThread::init()
 		return -1;
 	}
 
-	// Create files to write to
-	if (createFiles(arhFile, no_of_cams_) != 0)
-	{
-		std::cout << "There was error creating the files... press Enter to exit.";
-		cin.ignore();
-		return -1;
-	}
-
 	ppCameras = new Camera*[no_of_cams_];
 
 	// Connect to all detected cameras and attempt to set them to
@@ -334,6 +295,14 @@ void CamThread::shutdown() {
 	is_shutting_down_ = true;
 }
 
+bool CamThread::start_recording(const std::string& directory) {
+	return recorder_.start_recording(directory, no_of_cams_);
+}
+
+void CamThread::stop_recording() {
+	recorder_.stop_recording();
+}
+
 void CamThread::run() {
 	std::cout << "Grabbing ...";
 
@@ -355,48 +324,10 @@ void CamThread::run() {
 						//return -1;
 					}
 
-					emit image_ready(image, uiCamera);
-
-					////Get the size of the buffer associated with the image, in bytes. Returns the size of the buffer in bytes.
-					//iImageSize = image.GetDataSize();
-
-					//// Write to the file
-					//ardwBytesWritten[uiCamera] = fwrite(image.GetData(), 1, image.GetCols()*image.GetRows(), arhFile[uiCamera]);
-
-					//// Ensure that the write was successful
-					//if (ardwBytesWritten[uiCamera] != (unsigned)iImageSize)
-					//{
-					//	std::cout << "Error writing to file for camera " << uiCamera << " !" << endl;
-					//	continue;
-					//	//return -1;
-					//}
+					// before anything else sees the frame, the recorder only copies it
+					recorder_.submit(image, uiCamera);
 
-					//imFrameCount[uiCamera] = image.GetMetadata();
-
-					//// Keep track of the difference in image sequence numbers (iFrameCount)
-					//// in order to determine if any images have been missed.  A difference
-					//// greater than 1 indicates that an image has been missed.
-
-					//if (iImages == 0)
-					//{
-					//	// This is the first image, set up the variables
-					//	iFrameNumberPrev[uiCamera] = imFrameCount[uiCamera].embeddedFrameCounter;
-
-					//	iFrameNumberDelta[uiCamera] = 1;
-					//}
-					//else
-					//{
-					//	// Get the difference in sequence numbers between the current
-					//	// image and the last image we received
-					//	iFrameNumberDelta[uiCamera] = imFrameCount[uiCamera].embeddedFrameCounter - iFrameNumberPrev[uiCamera];
-					//}
-
-					//if (iFrameNumberDelta[uiCamera] != 1)
-					//{
-					//	iCountMissedIm += iFrameNumberDelta[uiCamera] - 1;
-					//}
-
-					//iFrameNumberPrev[uiCamera] = imFrameCount[uiCamera].embeddedFrameCounter;
+					emit image_ready(image, uiCamera);
 				}
 					if (is_shutting_down_) {
 						break;
@@ -411,6 +342,7 @@ void CamThread::run() {
 
 		//std::cout << "We missed " << iCountMissedIm << " images!" << endl << endl;
 	}
+	recorder_.stop_recording();
 	cleanup();
 
 }
\ No newline at end of file
@@ -9,6 +9,7 @@
 #include <sstream>
 #include <iostream>
 #include "FlyCapture2.h"
+#include "rawrecording.h"
 
 using namespace FlyCapture2;
 using namespace std;
@@ -29,18 +30,12 @@ private:
 	// Maximum size of expected (raw) image.
 	const static int ciMaxImageSize = 2000 * 2000;
 
-	// Directory to save data to.
-	const static string csDestinationDirectory;
-
 	// Number of grabbed images
 	const static int numberOfImages = 20;
 
 	// Buffers used for color-processing (BGR pixel format)
 	//unsigned char g_srcBuffer[ciMaxImageSize];
 
-	vector<string> filenames;
-	FILE*	     arhFile[ciMaxCameras];
-	size_t		 ardwBytesWritten[ciMaxCameras];
 	Error		 error;
 
 	BusManager	 busMgr;
@@ -50,16 +45,8 @@ private:
 
 	unsigned int no_of_cams_;
 
-	int iCountMissedIm;
-	int iImageSize;
-	int iFrameNumberPrev[ciMaxCameras];
-	int iFrameNumberDelta[ciMaxCameras];
-
-	ImageMetadata imFrameCount[ciMaxCameras];
-
-	FILE* rawFile;
+	RawRecorder recorder_;
 
-	int createFiles(FILE** arhFile, unsigned int g_uiNumCameras);
 	void PrintBuildInfo();
 	void PrintCameraInfo(CameraInfo* pCamInfo);
 	void PrintError(Error error);
@@ -75,6 +62,9 @@ public:
 	void run();
 	void cleanup();
 	void shutdown();
+	// raw frames of every camera to camera<n>.raw and camera<n>.idx in directory, see RawRecorder
+	bool start_recording(const std::string& directory);
+	void stop_recording();
 	CamThread(QObject* parent = NULL);
 	~CamThread();
 
@@ -0,0 +1,99 @@
+#pragma once
+#include <cstdint>
+#include <cmath>
+
+// counter based random numbers (philox 4x32-10). a generator is only its key and counter, so every
+// draw is a function of (seed, stream, step, domain) and a run can be replayed exactly, no matter
+// how threads are scheduled. the distributions are done here instead of using <random> so the
+// numbers are the same on every compiler
+class CounterRng {
+public:
+	// keeps the different users of the same (stream, step) apart
+	enum Domain {
+		ROBOT_VELOCITY = 1,
+		STARTING_FORMATION = 2,
+		DEATH_MAP = 3,
+		MCMC_INIT = 4,
+		MCMC_PERTURB = 5,
+		MCMC_ACCEPT = 6,
+		MCMC_SEED_ORIGINAL = 7
+	};
+
+	CounterRng(std::uint64_t seed, std::uint32_t stream, std::uint32_t step, std::uint32_t domain) : next_(4) {
+		key_[0] = static_cast<std::uint32_t>(seed);
+		key_[1] = static_cast<std::uint32_t>(seed >> 32);
+		counter_[0] = 0;
+		counter_[1] = step;
+		counter_[2] = stream;
+		counter_[3] = domain;
+	}
+
+	std::uint32_t next_uint() {
+		if (next_ == 4) {
+			for (int i = 0; i < 4; ++i) {
+				block_[i] = counter_[i];
+			}
+			philox(block_, key_);
+			counter_[0]++;
+			next_ = 0;
+		}
+		return block_[next_++];
+	}
+
+	// [0, 1) with 53 bits
+	double uniform() {
+		std::uint64_t a = next_uint() >> 5;
+		std::uint64_t b = next_uint() >> 6;
+		return (a * 67108864.0 + b) * (1.0 / 9007199254740992.0);
+	}
+
+	double uniform(double min, double max) {
+		return min + (max - min) * uniform();
+	}
+
+	// [min, max], same as std::uniform_int_distribution
+	int uniform_int(int min, int max) {
+		std::uint64_t range = static_cast<std::uint64_t>(static_cast<std::int64_t>(max) - min) + 1;
+		return min + static_cast<int>((next_uint() * range) >> 32);
+	}
+
+	// box muller, the second value is dropped to keep the generator stateless between calls
+	double normal(double mean, double stddev) {
+		double u1 = uniform();
+		double u2 = uniform();
+		if (u1 < 1e-300) {
+			u1 = 1e-300;
+		}
+		return mean + stddev * std::sqrt(-2.0 * std::log(u1)) * std::cos(6.283185307179586 * u2);
+	}
+
+	static void philox(std::uint32_t counter[4], const std::uint32_t key[2]) {
+		const std::uint32_t M0 = 0xD2511F53;
+		const std::uint32_t M1 = 0xCD9E8D57;
+		const std::uint32_t W0 = 0x9E3779B9;
+		const std::uint32_t W1 = 0xBB67AE85;
+
+		std::uint32_t k0 = key[0];
+		std::uint32_t k1 = key[1];
+		for (int round = 0; round < 10; ++round) {
+			std::uint64_t p0 = static_cast<std::uint64_t>(M0) * counter[0];
+			std::uint64_t p1 = static_cast<std::uint64_t>(M1) * counter[2];
+			std::uint32_t c0 = static_cast<std::uint32_t>(p1 >> 32) ^ counter[1] ^ k0;
+			std::uint32_t c1 = static_cast<std::uint32_t>(p1);
+			std::uint32_t c2 = static_cast<std::uint32_t>(p0 >> 32) ^ counter[3] ^ k1;
+			std::uint32_t c3 = static_cast<std::uint32_t>(p0);
+			counter[0] = c0;
+			counter[1] = c1;
+			counter[2] = c2;
+			counter[3] = c3;
+			k0 += W0;
+			k1 += W1;
+		}
+	}
+
+private:
+	std::uint32_t key_[2];
+	std::uint32_t counter_[4];
+	std::uint32_t block_[4];
+	int next_;
+};
@@ -7,6 +7,7 @@
 #include <glm/detail/type_mat.hpp>
 #include <glm/detail/type_mat.hpp>
 #include "jps.h"
+#include "counterrng.h"
 
 #define PI 3.14159265359	
 
@@ -94,12 +95,6 @@ ExperimentalRobot::ExperimentalRobot(UniformLocations& locations, unsigned id, i
 	local_explore_state_ = EXPLORE;
 
 	max_no_of_cells_ = occupancy_grid_->get_grid_width() * occupancy_grid_->get_grid_height();
-	if (render_) {
-		explored_cell_count_ = 0;
-		vis_explored_cells_.resize(max_no_of_cells_);
-		interior_explored_cell_count_ = 0;
-		vis_interior_explored_cells_.resize(max_no_of_cells_);
-	}
 
 	max_adjacent_cells_ = std::pow(sensor_range_ * 2 + 1, 2);
 	adjacent_cells_.resize(max_adjacent_cells_);
@@ -124,6 +119,19 @@ ExperimentalRobot::ExperimentalRobot(UniformLocations& locations, unsigned id, i
 	previous_explore_cell = glm::vec3(-1, 0, -1);
 
 
+	init_local_map();
+
+	// maximum path can be only no of grid cells, conservative but an upper bound
+	path_.resize(max_no_of_cells_);
+	total_no_of_path_steps_ = 0;
+	current_path_step_ = 0;
+
+	normalizing_multiplier_constant_ = 1000.f;
+}
+
+void ExperimentalRobot::init_local_map() {
+	local_map_.fill(0);
+
 	// mark interior interiors as already explored
 	for (int y = 0; y < occupancy_grid_->get_grid_height(); ++y) {
 		for (int x = 0; x < occupancy_grid_->get_grid_width(); ++x) {
@@ -134,29 +142,80 @@ ExperimentalRobot::ExperimentalRobot(UniformLocations& locations, unsigned id, i
 			}
 		}
 	}
+}
+
+void ExperimentalRobot::reset(int cluster_id, double separation_constant, double alignment_constant,
+	double cluster_constant, double explore_constant, int discovery_range, double separation_distance, glm::vec3 position,
+	double square_radius, double bounce_function_power, double bounce_function_multiplier, int max_time,
+	const SwarmParams& swarm_params) {
+
+	Robot::reset(position, separation_constant, alignment_constant, cluster_constant, explore_constant,
+		discovery_range, separation_distance);
+
+	square_radius_ = square_radius;
+	bounce_function_power_ = bounce_function_power;
+	bounce_function_multiplier_ = bounce_function_multiplier;
+	max_time_ = max_time;
+	swarm_params_ = swarm_params;
+
+	// the rest mirrors the constructor
+	measurement_time_step_ = 100;
+	random_direction_ = glm::vec3(1.f, 0.f, 0.f);
+	max_velocity_ = 4.f;
+	robot_radius_ = 11.85f;
+	previous_no_of_explored_cells_ = -1;
+	death_time_ = -1;
+	dead_ = false;
+	dead_color_changed_ = false;
+	cluster_id_ = cluster_id;
+	populate_occlusion_map();
+	populate_clustering_map();
+	random_constant_ = 10.f;
+
+	explore_range_ = Range(0, diagonal_grid_length_);
+	local_no_of_unexplored_cells_ = occupancy_grid_->get_grid_width() * occupancy_grid_->get_grid_height();
+	previous_no_of_local_explored_cells_ = 0;
+	figure_mode_ = false;
+	local_explore_state_ = EXPLORE;
+
+	current_adjacent_cells_ = 0;
+	current_interior_cells_ = 0;
+	current_no_of_robots_ = 0;
+	same_cell_count_ = 0;
+	current_timestamp_ = 0;
+
+	previous_local_explore_cell = glm::vec3(-1, 0, -1);
+	previous_explore_cell = glm::vec3(-1, 0, -1);
+	previous_nminus2_position_ = glm::vec3(0.f);
+	goal_cell_ = glm::ivec3(0);
+
+	reconstructed_positions_.clear();
+	past_reconstructed_positions_.clear();
+	incremental_interior_list_.clear();
+	vis_goal_cells_.clear();
+	vis_astar_cells_.clear();
+	vis_poo_cells_.clear();
+	prev_vis_astar_cells_.clear();
+
+	init_local_map();
 
-	// maximum path can be only no of grid cells, conservative but an upper bound
-	path_.resize(max_no_of_cells_);
 	total_no_of_path_steps_ = 0;
 	current_path_step_ = 0;
-
-	normalizing_multiplier_constant_ = 1000.f;
 }
 
 void ExperimentalRobot::populate_occlusion_map() {
-	int no_of_divisions = max_time_ / measurement_time_step_;
-
-	for (int i = 0; i < no_of_divisions; ++i) {
-		occlusions_per_timestamp_map_[i * measurement_time_step_] = 0.0;
+	occlusion_stats_ = RunningStats();
+	// timestamp 0 is never measured, but it counts as a zero sample
+	if (max_time_ >= measurement_time_step_) {
+		occlusion_stats_.add(0.0);
 	}
 }
 
 void ExperimentalRobot::populate_clustering_map() {
 	//measurement_time_step_ = 100;
-	int no_of_divisions = max_time_ / measurement_time_step_;
-
-	for (int i = 0; i < no_of_divisions; ++i) {
-		clustered_neighbors_per_timestamp_map_[i * measurement_time_step_] = 0;
+	clustered_neighbors_stats_ = RunningStats();
+	if (max_time_ >= measurement_time_step_) {
+		clustered_neighbors_stats_.add(0.0);
 	}
 }
 
@@ -529,20 +588,7 @@ void ExperimentalRobot::update_visualization_structs() {
 	//for (auto& adjacent_sensor_cell : interior_explored_cells_) {
 	//	overlay_->update_grid_position(adjacent_sensor_cell, color_ );
 	//}
-	cv::Vec4f cyan = cv::Vec4f(0.f, 255.f, 204.f, 255.f) / 255.f;
-	for (int i = 0; i < explored_cell_count_; ++i) {
-		overlay_->update_grid_position(vis_explored_cells_[i], cyan/ 1.3f);
-		//overlay_->update_grid_position(vis_explored_cells_[i], cv::Vec4f(25.f, 188.f, 157.f, 255.f)/255.f);
-	}
-	for (int i = 0; i < interior_explored_cell_count_; ++i) {
-		//overlay_->update_grid_position(vis_interior_explored_cells_[i], color_);
-		//overlay_->update_grid_position(vis_interior_explored_cells_[i], cv::Vec4f(50.f, 151.f, 219.f, 255.f)/255.f);
-		overlay_->update_grid_position(vis_interior_explored_cells_[i], cyan / 2.f);
-	}
-
-	// reset counters
-	explored_cell_count_ = 0;
-	interior_explored_cell_count_ = 0;
+	// explored cells are colored by update_overlay_cells as they're explored
 
 
 	// undo prev color
@@ -656,6 +702,16 @@ void ExperimentalRobot::set_colors_buffer(std::vector<cv::Vec4f>& colors) {
 	colors_ = colors;
 }
 
+void ExperimentalRobot::set_replay_state(const glm::vec3& position, bool dead, cv::Vec4f& alive_color) {
+	previous_position_ = position_;
+	position_ = position;
+	if (dead_color_changed_ && !dead) {
+		change_color(alive_color);
+		dead_color_changed_ = false;
+	}
+	dead_ = dead;
+}
+
 void ExperimentalRobot::set_death_time(int death_time) {
 	death_time_ = death_time;
 }
@@ -832,7 +888,7 @@ glm::vec3 ExperimentalRobot::calculate_clustering_velocity() {
 	}
 
 	if (current_timestamp_ > 0 && ((current_timestamp_ % measurement_time_step_) == 0)) {
-		clustered_neighbors_per_timestamp_map_[current_timestamp_] = count ;
+		clustered_neighbors_stats_.add(count);
 	}
 
 	glm::vec3 move_towards_vector = pc - position_;
@@ -1223,6 +1279,7 @@ void ExperimentalRobot::calculate_path(Grid* grid, const glm::ivec3& current_cel
 		// or any other higher value to output every Nth position.
 		JPS::PathVector path; // The resulting path will go here.
 		// Single-call interface:
+		PROFILE_COUNT(profile_, ASTAR_SEARCHES);
 		obstacle_found = !JPS::findPath(path, *this, current_cell.x, current_cell.z, goal_cell.x, goal_cell.z, 1);
 
 		if (!obstacle_found) {
@@ -1406,6 +1463,7 @@ glm::vec3 ExperimentalRobot::calculate_astar_explore_velocity() {
 
 				if (!something_to_explore) {
 					// go left
+					PROFILE_COUNT(profile_, FRONTIER_QUERIES);
 					something_to_explore = local_perimeter_search_for_astar(goal_cell);
 					//local_explore_state_ = PERIMETER;
 				}
@@ -1492,6 +1550,7 @@ glm::vec3 ExperimentalRobot::calculate_explore_velocity() {
 		explore_cell = previous_explore_cell;
 	}
 	else {
+		PROFILE_COUNT(profile_, FRONTIER_QUERIES);
 		something_to_explore = occupancy_grid_->next_cell_to_explore(current_cell, explore_cell, explore_range_.min_, explore_range_.max_);
 	}
 	//something_to_explore = occupancy_grid_->next_cell_to_explore(current_cell, explore_cell, explore_range_.min_, explore_range_.max_);
@@ -1623,37 +1682,11 @@ std::vector<glm::vec3> ExperimentalRobot::get_corners(const glm::vec3& interior_
 }
 
 double ExperimentalRobot::calculate_occulsion() {
-	double occlusion = 0.0;
-	double entry_count = 0;
-
-	for (auto& occlusion_per_timestamp: occlusions_per_timestamp_map_) {
-		if (occlusion_per_timestamp.first <= current_timestamp_) {
-			occlusion += occlusion_per_timestamp.second;
-			entry_count++;
-		}
-	}
-	if (entry_count > 0) {
-		occlusion /= entry_count;
-	}
-	return occlusion;
-	
+	return occlusion_stats_.mean;
 }
 
 double ExperimentalRobot::calculate_clustering() {
-	double clustering = 0.0;
-	double entry_count = 0;
-
-	for (auto& clustering_per_timestamp: clustered_neighbors_per_timestamp_map_) {
-		if (clustering_per_timestamp.first <= current_timestamp_) {
-			clustering += clustering_per_timestamp.second;
-			entry_count++;
-		}
-	}
-	if (entry_count > 0) {
-		clustering /= entry_count;
-	}
-	return clustering;
-	
+	return clustered_neighbors_stats_.mean;
 }
 
 bool ExperimentalRobot::is_colliding_precisely(const glm::vec3& interior_cell) {
@@ -1800,11 +1833,11 @@ glm::vec3 ExperimentalRobot::calculate_obstacle_avoidance_velocity() {
 }
 
 glm::vec3 ExperimentalRobot::get_random_velocity() {
-	std::random_device rd;
-	std::mt19937 eng(rd());
-	std::uniform_real_distribution<float> dist(-max_velocity_, max_velocity_);
+	CounterRng rng(swarm_params_.seed_, id_, current_timestamp_, CounterRng::ROBOT_VELOCITY);
 
-	glm::vec3 random_velocity(dist(eng), 0.f, dist(eng));
+	float x = rng.uniform(-max_velocity_, max_velocity_);
+	float z = rng.uniform(-max_velocity_, max_velocity_);
+	glm::vec3 random_velocity(x, 0.f, z);
 
 	return random_velocity * random_constant_;
 }
@@ -1819,22 +1852,16 @@ bool ExperimentalRobot::not_locally_visited(const glm::ivec3& grid_position) {
 
 void ExperimentalRobot::update_overlay_cells(const bool is_interior, const glm::ivec3& grid_position) {
 	if (render_) {
+		// straight into the overlay's cpu side colors, it uploads them once per frame
+		cv::Vec4f cyan = cv::Vec4f(0.f, 255.f, 204.f, 255.f) / 255.f;
 		if (is_interior) {
-			explored_mutex_.lock();
 			//interior_explored_cells_.push_back(sensored_cell);
-			if (interior_explored_cell_count_ < max_no_of_cells_ - 1) {
-				vis_interior_explored_cells_[interior_explored_cell_count_++] = (grid_position);
-			}
-			explored_mutex_.unlock();
+			overlay_->update_grid_position(grid_position, cyan / 2.f);
 		}
 		else {
 			// additional check because even interior can be marked as non-interior;
 			if (swarm_params_.display_local_map_ || !occupancy_grid_->is_interior(grid_position)) {
-				explored_mutex_.lock();
-				if (explored_cell_count_ < max_no_of_cells_ - 1) {
-					vis_explored_cells_[explored_cell_count_++] = (grid_position);
-				}
-				explored_mutex_.unlock();
+				overlay_->update_grid_position(grid_position, cyan / 1.3f);
 			}
 		}
 	}
@@ -2134,7 +2161,11 @@ void ExperimentalRobot::update_adjacent_and_interior_memory_save(const glm::ivec
 	for (auto i = 0; i < current_interior_cells_; ++i) {
 		for (auto k = 0; k < current_adjacent_cells_; ++k) {
 			auto& curr_adj_cell = adjacent_cells_[k];
-			if (curr_adj_cell.is_visible() && !VisibilityQuadrant::visbility_quadrant(sensor_range_)->
+			if (!curr_adj_cell.is_visible()) {
+				continue;
+			}
+			PROFILE_COUNT(profile_, VISIBILITY_TESTS);
+			if (!VisibilityQuadrant::visbility_quadrant(sensor_range_)->
 				is_sensor_cell_visible(current_position,
 				occupancy_grid_->map_to_grid(interior_cells_[i]), curr_adj_cell.cell)) {
 				curr_adj_cell.visible = false;
@@ -2200,10 +2231,14 @@ void ExperimentalRobot::update(int timestamp) {
 	}
 
 	current_timestamp_ = timestamp;
+	PROFILE_TICK_BEGIN(profile_);
 
+	PROFILE_BEGIN(profile_, NEIGHBOURS);
 	//robot_ids_ = get_other_robots(adjacent_cells_);
 	get_other_robots_memory_wise();
+	PROFILE_END(profile_, NEIGHBOURS);
 
+	PROFILE_BEGIN(profile_, INTERIOR_STATS);
 	if (timestamp > 0 && ((timestamp % measurement_time_step_) == 0)) {
 		double avg_inverse_distance = 0.0;
 		for (int i = 0; i < current_no_of_robots_; ++i) {
@@ -2223,7 +2258,7 @@ void ExperimentalRobot::update(int timestamp) {
 		//if (robot_ids_.size() > 0) {
 		//	avg_inverse_distance /= robot_ids_.size();
 		//}
-		occlusions_per_timestamp_map_[timestamp] = avg_inverse_distance;
+		occlusion_stats_.add(avg_inverse_distance);
 
 		for (int k = 0; k < current_interior_cells_; ++k) {
 			auto& interior = interior_cells_[k];
@@ -2231,18 +2266,25 @@ void ExperimentalRobot::update(int timestamp) {
 			occupancy_grid_->update_interior_stats(occupancy_grid_->map_to_grid(interior), timestamp, id_, timestamp);
 		}
 	}
+	PROFILE_END(profile_, INTERIOR_STATS);
 
+	PROFILE_BEGIN(profile_, VELOCITY);
 	glm::vec3 separation_velocity = calculate_separation_velocity();
 	glm::vec3 alignment_velocity = calculate_alignment_velocity();
 	glm::vec3 clustering_velocity = calculate_clustering_velocity();
+	PROFILE_END(profile_, VELOCITY);
+	PROFILE_BEGIN(profile_, EXPLORE);
 #ifdef LOCAL
 	//glm::vec3 explore_velocity = calculate_local_explore_velocity();
 	glm::vec3 explore_velocity = calculate_astar_explore_velocity();
 #else
 	glm::vec3 explore_velocity = calculate_explore_velocity();
 #endif
+	PROFILE_END(profile_, EXPLORE);
+	PROFILE_BEGIN(profile_, VELOCITY);
 	glm::vec3  random_velocity = get_random_velocity();
 	glm::vec3 obstacle_avoidance_velocity = calculate_obstacle_avoidance_velocity();
+	PROFILE_END(profile_, VELOCITY);
 
 	velocity_ += separation_velocity;
 	velocity_ += alignment_velocity;
@@ -2266,6 +2308,7 @@ void ExperimentalRobot::update(int timestamp) {
 	position_ += velocity_ * delta_time / 1000.f / 10.f;
 
 #ifdef LOCAL
+	PROFILE_BEGIN(profile_, GRID_MARKING);
 	auto current_cell = occupancy_grid_->map_to_grid(previous_position_);
 	auto previous_cell = occupancy_grid_->map_to_grid(previous_nminus2_position_);
 
@@ -2274,6 +2317,7 @@ void ExperimentalRobot::update(int timestamp) {
 			mark_othere_robots_ranges();
 		}
 	}
+	PROFILE_END(profile_, GRID_MARKING);
 #endif
 	//bool is_colliding = false;
 	//is_colliding |= is_colliding_precisely(interior_cells_);
@@ -2291,12 +2335,14 @@ void ExperimentalRobot::update(int timestamp) {
 
 
 	// update grid data structure
+	PROFILE_BEGIN(profile_, SENSOR_WINDOW);
 	int explored = id_;
 	glm::ivec3 grid_position = occupancy_grid_->map_to_grid(position_);
 	glm::ivec3 previous_grid_position = occupancy_grid_->map_to_grid(previous_position_);
 	collision_grid_->update(id_, previous_grid_position, grid_position);
 
 	update_adjacent_and_interior_memory_save(previous_grid_position, grid_position);
+	PROFILE_END(profile_, SENSOR_WINDOW);
 
 
 	if (figure_mode_) {
@@ -2309,6 +2355,7 @@ void ExperimentalRobot::update(int timestamp) {
 		}
 	}
 
+	PROFILE_BEGIN(profile_, PATH);
 	if (is_path_not_empty()) {
 		for (int k = 0; k < total_no_of_path_steps_; ++k) {
 			auto& cell = path_[k];
@@ -2327,7 +2374,9 @@ void ExperimentalRobot::update(int timestamp) {
 			increment_path_step();
 		}
 	}
+	PROFILE_END(profile_, PATH);
 
+	PROFILE_BEGIN(profile_, GRID_MARKING);
 	if (interior_updated_) {
 		for (int i = 0; i < current_adjacent_cells_; ++i) {
 		//for (auto sensored_cell : adjacent_cells_) {
@@ -2368,7 +2417,7 @@ void ExperimentalRobot::update(int timestamp) {
 			//}
 #endif
 			if (!occupancy_grid_->is_interior(sensored_cell)) {
-				occupancy_grid_->set(sensored_cell.x, sensored_cell.z, explored);
+				occupancy_grid_->mark_explored(sensored_cell, explored);
 
 				// We need to go one extra grid to cover interior, so make sure it's always less than 1
 				//if (distance < (sensor_range_ - 2)) {
@@ -2402,9 +2451,11 @@ void ExperimentalRobot::update(int timestamp) {
 		}
 		//reconstruct_points();
 	}
+	PROFILE_END(profile_, GRID_MARKING);
 
 	previous_nminus2_position_ = previous_position_;
 	previous_position_ = position_;
+	PROFILE_TICK_END(profile_);
 	//	accumulator_ -= delta_time;
 	//}
 }
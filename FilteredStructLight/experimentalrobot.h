@@ -55,8 +55,8 @@ private:
 	int death_time_;
 	bool dead_color_changed_;
 	std::set<glm::ivec3, IVec3Comparator> past_reconstructed_positions_;
-	std::unordered_map<int, double> occlusions_per_timestamp_map_;
-	std::unordered_map<int, int> clustered_neighbors_per_timestamp_map_;
+	RunningStats occlusion_stats_;
+	RunningStats clustered_neighbors_stats_;
 	int max_time_;
 	int measurement_time_step_;
 	int current_timestamp_;
@@ -98,8 +98,6 @@ private:
 
 	//render
 	int max_no_of_cells_;
-	int explored_cell_count_;
-	int interior_explored_cell_count_;
 
 	// adjacent cells
 	int max_adjacent_cells_;
@@ -114,8 +112,6 @@ private:
 
 
 	// visualization structs;
-	std::vector<glm::ivec3> vis_explored_cells_;
-	std::vector<glm::ivec3> vis_interior_explored_cells_;
 	std::vector<glm::ivec3> vis_goal_cells_;
 	std::vector<glm::ivec3> vis_astar_cells_;
 	std::vector<glm::vec3> vis_poo_cells_;
@@ -162,6 +158,7 @@ private:
 	bool is_path_not_empty() const;
 	void increment_path_step();
 	void update_overlay_cells(const bool is_interior, const glm::ivec3& grid_position);
+	void init_local_map();
 	SwarmParams swarm_params_;
 public:
 	//ExperimentalRobot(UniformLocations& locations, unsigned int id, SwarmOccupancyTree* octree, SwarmCollisionTree* collision_tree, Swarm3DReconTree* recon_tree,
@@ -178,6 +175,12 @@ public:
 		int discovery_range, double separation_distance, glm::vec3 position,
 		double square_radius, double bounce_function_power, double bounce_function_multiplier, int max_time,
 		bool collide_with_robots, bool render, QGLShaderProgram* shader, SwarmParams swarm_params);
+	// reinitialises the robot for another simulation on the same grids. the id, no of robots and sensor range
+	// size its buffers, so they have to match what it was constructed with
+	void reset(int cluster_id, double separation_constant, double alignment_constant,
+		double cluster_constant, double explore_constant, int discovery_range, double separation_distance, glm::vec3 position,
+		double square_radius, double bounce_function_power, double bounce_function_multiplier, int max_time,
+		const SwarmParams& swarm_params);
 	void populate_occlusion_map();
 	void populate_clustering_map();
 	void init_sensor_range();
@@ -186,6 +189,9 @@ public:
 	virtual void update_visualization_structs() override;
 	void change_color(cv::Vec4f& color);
 	void set_colors_buffer(std::vector<cv::Vec4f>& colors);
+	// puts the robot where a trace has it, update_visualization_structs then draws it there. a dead robot
+	// brought back by seeking backwards gets alive_color again
+	void set_replay_state(const glm::vec3& position, bool dead, cv::Vec4f& alive_color);
 
 
 	void set_death_time(int death_time);
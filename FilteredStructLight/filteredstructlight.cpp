@@ -150,6 +150,7 @@ SwarmParams FilteredStructLight::get_swarm_params_from_ui() {
 	swarm_params.death_time_taken_ = death_time_taken_->value();
 
 	swarm_params.desired_sampling = desired_sampling_->value();
+	swarm_params.seed_ = seed_spinbox_->value();
 
 	swarm_params.coverage_needed_ = coverage_needed_->value();
 
@@ -302,6 +303,9 @@ void FilteredStructLight::set_swarm_params_to_ui(const SwarmParams& swarm_params
 	desired_sampling_->setValue(swarm_params.desired_sampling);
 	emit desired_sampling_->valueChanged(desired_sampling_->value());
 
+	seed_spinbox_->setValue(swarm_params.seed_);
+	emit seed_spinbox_->valueChanged(seed_spinbox_->value());
+
 	
 }
 
@@ -323,6 +327,11 @@ OptimizationParams FilteredStructLight::get_opt_params_from_ui() {
 	opt_params.no_of_iterations = no_of_iterations_spin_box_->value();
 	opt_params.no_of_threads = no_of_threads_spin_box_->value();
 	opt_params.culling_nth_iteration = culling_nth_iteration_spin_box_->value();
+	opt_params.distributed_port = distributed_port_spin_box_->value();
+	opt_params.no_of_local_workers = no_of_local_workers_spin_box_->value();
+	opt_params.use_result_cache = use_result_cache_check_box_->isChecked();
+	opt_params.surrogate_candidates = surrogate_candidates_spin_box_->value();
+	opt_params.record_traces = record_traces_check_box_->isChecked();
 
 	opt_params.coefficients.time_taken = time_step_count_score_textbox_->value();
 	opt_params.coefficients.density = coverage_score_textbox_->value();
@@ -344,6 +353,11 @@ void FilteredStructLight::set_opt_params_to_ui(const OptimizationParams& opt_par
 	no_of_iterations_spin_box_->setValue(opt_params.no_of_iterations);
 	no_of_threads_spin_box_->setValue(opt_params.no_of_threads);
 	culling_nth_iteration_spin_box_->setValue(opt_params.culling_nth_iteration);
+	distributed_port_spin_box_->setValue(opt_params.distributed_port);
+	no_of_local_workers_spin_box_->setValue(opt_params.no_of_local_workers);
+	use_result_cache_check_box_->setChecked(opt_params.use_result_cache);
+	surrogate_candidates_spin_box_->setValue(opt_params.surrogate_candidates);
+	record_traces_check_box_->setChecked(opt_params.record_traces);
 
 	emit no_of_iterations_spin_box_->valueChanged(opt_params.no_of_iterations);
 	emit no_of_threads_spin_box_->valueChanged(opt_params.no_of_threads);
@@ -455,6 +469,7 @@ void FilteredStructLight::add_reconstruction_tab(CameraPairs& camera_pairs, QTab
 
 	QGroupBox* misc_controls_group_box = new QGroupBox("Misc. Controls", reconstruction_tab_);
 	reset_orientation_button_ = new QPushButton("Reset Controls", misc_controls_group_box);
+	QPushButton* open_point_lod_button = new QPushButton("Open Point LOD", misc_controls_group_box);
 	QLabel* scale_label = new QLabel("Scale", misc_controls_group_box);
 	QSlider* scale_slider = new QSlider(Qt::Orientation::Horizontal, misc_controls_group_box);
 	scale_slider->setMaximum(100);
@@ -466,6 +481,7 @@ void FilteredStructLight::add_reconstruction_tab(CameraPairs& camera_pairs, QTab
 
 	QVBoxLayout* misc_control_box_layout = new QVBoxLayout(misc_controls_group_box);
 	misc_control_box_layout->addWidget(reset_orientation_button_);
+	misc_control_box_layout->addWidget(open_point_lod_button);
 	misc_control_box_layout->addWidget(scale_label);
 	misc_control_box_layout->addWidget(scale_slider);
 	misc_controls_group_box->setLayout(misc_control_box_layout);
@@ -493,6 +509,14 @@ void FilteredStructLight::add_reconstruction_tab(CameraPairs& camera_pairs, QTab
 	connect(color_solid_color_radio_button, &QRadioButton::clicked, model_viewer_, &ModelViewer::draw_colors);
 	connect(reset_orientation_button_, &QPushButton::clicked, model_viewer_, &ModelViewer::reset_view);
 	connect(scale_slider, &QSlider::valueChanged, model_viewer_, &ModelViewer::set_scale);
+	connect(open_point_lod_button, &QPushButton::clicked, this, 
+		[&] {
+		QString selected_directory = QFileDialog::getExistingDirectory(this, QString("Open Point LOD"),
+			QDir::currentPath());
+		if (!selected_directory.isEmpty()) {
+			model_viewer_->load_point_lod(selected_directory);
+		}
+	});
 
 	color_solid_color_radio_button->click();
 	draw_points_radio_button->click();
@@ -1431,6 +1455,43 @@ void FilteredStructLight::add_swarm_optimization_options(QGroupBox* group_box) {
 
 	group_box_layout->addLayout(culling_nth_iteration_layout);
 
+	QLabel* distributed_port_label = new QLabel("distributed_port (0 = local)");
+	distributed_port_spin_box_ = new QSpinBox(group_box);
+	distributed_port_spin_box_->setRange(0, 65535);
+
+	QHBoxLayout* distributed_port_layout = new QHBoxLayout();
+	distributed_port_layout->addWidget(distributed_port_label);
+	distributed_port_layout->addWidget(distributed_port_spin_box_);
+
+	group_box_layout->addLayout(distributed_port_layout);
+
+	QLabel* no_of_local_workers_label = new QLabel("no_of_local_workers");
+	no_of_local_workers_spin_box_ = new QSpinBox(group_box);
+	no_of_local_workers_spin_box_->setRange(0, 256);
+
+	QHBoxLayout* no_of_local_workers_layout = new QHBoxLayout();
+	no_of_local_workers_layout->addWidget(no_of_local_workers_label);
+	no_of_local_workers_layout->addWidget(no_of_local_workers_spin_box_);
+
+	group_box_layout->addLayout(no_of_local_workers_layout);
+
+	use_result_cache_check_box_ = new QCheckBox("use_result_cache", group_box);
+	use_result_cache_check_box_->setChecked(true);
+	group_box_layout->addWidget(use_result_cache_check_box_);
+
+	QLabel* surrogate_candidates_label = new QLabel("surrogate_candidates");
+	surrogate_candidates_spin_box_ = new QSpinBox(group_box);
+	surrogate_candidates_spin_box_->setRange(1, 64);
+
+	QHBoxLayout* surrogate_candidates_layout = new QHBoxLayout();
+	surrogate_candidates_layout->addWidget(surrogate_candidates_label);
+	surrogate_candidates_layout->addWidget(surrogate_candidates_spin_box_);
+
+	group_box_layout->addLayout(surrogate_candidates_layout);
+
+	record_traces_check_box_ = new QCheckBox("record_traces", group_box);
+	group_box_layout->addWidget(record_traces_check_box_);
+
 	//run_brute_force_optimization_button_ = new QPushButton("Run Brute Force Optimization", group_box);
 	//group_box_layout->addWidget(run_brute_force_optimization_button_);
 
@@ -1632,6 +1693,41 @@ void FilteredStructLight::add_swarm_sim_flow_control_options(QGroupBox* group_bo
 	swarm_reset_button_ = new QPushButton("Reset Sim.", group_box);
 	group_box_layout->addWidget(swarm_reset_button_);
 
+	QHBoxLayout* replay_layout = new QHBoxLayout();
+	load_trace_button_ = new QPushButton("Load Trace", group_box);
+	QLabel* replay_speed_label = new QLabel("Ticks/s");
+	replay_speed_spin_box_ = new QDoubleSpinBox(group_box);
+	replay_speed_spin_box_->setRange(-10000.0, 10000.0);
+	replay_speed_spin_box_->setValue(30.0);
+
+	replay_layout->addWidget(load_trace_button_);
+	replay_layout->addWidget(replay_speed_label);
+	replay_layout->addWidget(replay_speed_spin_box_);
+
+	group_box_layout->addLayout(replay_layout);
+
+	replay_slider_ = new QSlider(Qt::Orientation::Horizontal, group_box);
+	replay_slider_->setRange(0, 0);
+	group_box_layout->addWidget(replay_slider_);
+
+	connect(load_trace_button_, &QPushButton::clicked, this, [&] {
+		QString filename = QFileDialog::getOpenFileName(this, QString("Open Swarm Trace"), QDir::currentPath(),
+			"Swarm Traces(*.swtr)");
+		QFile file(filename);
+		if (file.exists()) {
+			swarm_viewer_->load_trace(filename);
+		}
+	});
+	connect(replay_speed_spin_box_, static_cast<void (QDoubleSpinBox::*)(double)>(&QDoubleSpinBox::valueChanged),
+		swarm_viewer_, &SwarmViewer::set_replay_speed);
+	// sliderMoved only fires for the user, so following the replay below doesn't seek
+	connect(replay_slider_, &QSlider::sliderMoved, swarm_viewer_, &SwarmViewer::seek_replay);
+	connect(swarm_viewer_, &SwarmViewer::replay_loaded, this, [&](int no_of_ticks) {
+		replay_slider_->setRange(0, no_of_ticks - 1);
+		swarm_viewer_->set_replay_speed(replay_speed_spin_box_->value());
+	});
+	connect(swarm_viewer_, &SwarmViewer::replay_tick_changed, replay_slider_, &QSlider::setValue);
+
 	QHBoxLayout* movement_constant_layout = new QHBoxLayout();
 	QLabel* magic_k_label = new QLabel("Magic K");
 	magic_k_spin_box_ = new QDoubleSpinBox(group_box);
@@ -1675,6 +1771,18 @@ void FilteredStructLight::add_swarm_sim_flow_control_options(QGroupBox* group_bo
 
 	group_box_layout->addLayout(desired_sampling_layout);
 
+	QHBoxLayout* seed_layout = new QHBoxLayout();
+	QLabel* seed_label = new QLabel("Seed");
+	seed_spinbox_ = new QSpinBox(group_box);
+	seed_spinbox_->setMinimum(0);
+	seed_spinbox_->setMaximum(std::numeric_limits<int>::max());
+	seed_spinbox_->setValue(1);
+
+	seed_layout->addWidget(seed_label);
+	seed_layout->addWidget(seed_spinbox_);
+
+	group_box_layout->addLayout(seed_layout);
+
 
 	// should render
 	should_render_check_box_ = new QCheckBox("Should Render?", group_box);
@@ -2402,9 +2510,52 @@ void FilteredStructLight::add_camera_calibration_tab(QTabWidget* tab_widget) {
 
 	vbox_layout->addWidget(reconstruction_group_);
 
+	// raw recording
+	recording_group_ = new QGroupBox("Recording", left_panel_);
+
+	start_recording_ = new QPushButton("Start recording", recording_group_);
+	connect(start_recording_, &QPushButton::clicked, this, 
+		[&]()
+	{
+		QString directory = QString("recordings/") + QDateTime::currentDateTime().toString("yyyyMMdd-hhmmss");
+		cam_thread_->start_recording(directory.toStdString());
+	});
+
+	stop_recording_ = new QPushButton("Stop recording", recording_group_);
+	connect(stop_recording_, &QPushButton::clicked, this, 
+		[&]()
+	{
+		cam_thread_->stop_recording();
+	});
+
+	// plays into the preview, alongside the live cameras
+	recording_replay_ = new RawRecordingReplay(this);
+	connect(recording_replay_, &RawRecordingReplay::image_ready, opengl_widget_->get_preview(), &CameraPreview::submit,
+		Qt::DirectConnection);
+
+	replay_recording_ = new QPushButton("Replay recording", recording_group_);
+	connect(replay_recording_, &QPushButton::clicked, this, 
+		[&]()
+	{
+		QString selected_directory = QFileDialog::getExistingDirectory(this, QString("Replay Recording"),
+			QDir::currentPath());
+		if (!selected_directory.isEmpty() && !recording_replay_->isRunning()
+			&& recording_replay_->open(selected_directory.toStdString())) {
+			recording_replay_->start();
+		}
+	});
+
+	QVBoxLayout* recording_group_layout = new QVBoxLayout(left_panel_);
+	recording_group_layout->addWidget(start_recording_);
+	recording_group_layout->addWidget(stop_recording_);
+	recording_group_layout->addWidget(replay_recording_);
+	recording_group_->setLayout(recording_group_layout);
 
+	vbox_layout->addWidget(recording_group_);
 
-	connect(cam_thread_, &CamThread::image_ready, opengl_widget_, &GLWidget::display_image);
+	// straight from the capture thread, the preview copies the frame and never blocks it
+	connect(cam_thread_, &CamThread::image_ready, opengl_widget_->get_preview(), &CameraPreview::submit,
+		Qt::DirectConnection);
 	connect(threshold_slider_, &QSlider::valueChanged, opengl_widget_, &GLWidget::set_threshold);
 	connect(threshold_toggle_checkbox_, &QCheckBox::stateChanged, opengl_widget_, &GLWidget::toggle_thresholding);
 
@@ -103,6 +103,12 @@ private:
 	QPushButton* load_camera_calibration_;
 	QPushButton* start_reconstruction_video_;
 	QPushButton* end_reconstruction_video_;
+
+	QGroupBox* recording_group_;
+	QPushButton* start_recording_;
+	QPushButton* stop_recording_;
+	QPushButton* replay_recording_;
+	RawRecordingReplay* recording_replay_;
 	QPushButton* recalibrate_button;
 	QWidget* reconstruction_tab_;
 	ModelViewer* model_viewer_;
@@ -193,6 +199,9 @@ private:
 	QPushButton* swarm_pause_button_;
 	QPushButton* swarm_step_button_;
 	QPushButton* swarm_resume_button_;
+	QPushButton* load_trace_button_;
+	QDoubleSpinBox* replay_speed_spin_box_;
+	QSlider* replay_slider_;
 	QLabel* time_step_count_label_;
 	QSpinBox* discovery_range_;
 	//QPushButton* run_least_squared_optimization_button_;
@@ -227,6 +236,11 @@ private:
 	QSpinBox* no_of_threads_spin_box_;
 	QSpinBox* no_of_iterations_spin_box_;
 	QSpinBox* culling_nth_iteration_spin_box_;
+	QSpinBox* distributed_port_spin_box_;
+	QSpinBox* no_of_local_workers_spin_box_;
+	QCheckBox* use_result_cache_check_box_;
+	QSpinBox* surrogate_candidates_spin_box_;
+	QCheckBox* record_traces_check_box_;
 	QLineEdit* optimization_config_filename_;
 	QPushButton* optimization_config_filename_browse_;
 	QPushButton* load_optimization_config_button_;
@@ -259,6 +273,7 @@ private:
 	QCheckBox* display_astar_path_mode_;
 	QSpinBox* local_map_robot_id_spinbox_;
 	QDoubleSpinBox* desired_sampling_;
+	QSpinBox* seed_spinbox_;
 	QCheckBox* record_video_mode_;
 	void load_recon_settings();
 
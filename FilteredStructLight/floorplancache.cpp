@@ -0,0 +1,299 @@
+#include "floorplancache.h"
+#include <QSaveFile>
+#include <QFileInfo>
+#include <iostream>
+#include <cstring>
+
+const int FloorPlanCache::MAX_RESOLUTION = 12;
+const int FloorPlanCache::INTERIOR_THRESHOLD = 220;
+
+QMutex FloorPlanCache::lock_;
+std::unordered_map<std::uint64_t, std::shared_ptr<FloorPlanCache>> FloorPlanCache::loaded_;
+
+static const char CACHE_MAGIC[4] = { 'F', 'P', 'C', '1' };
+static const std::uint32_t CACHE_VERSION = 1;
+
+FloorPlanCache::FloorPlanCache() : source_cols_(0), source_rows_(0) {
+}
+
+FloorPlanCache::~FloorPlanCache() {
+	file_.close();
+}
+
+bool FloorPlanCache::read_model_matrix(const std::string& model_filename, cv::Mat& model_matrix) {
+	std::size_t last_period_pos = model_filename.find_last_of('.');
+	if (last_period_pos == std::string::npos) {
+		std::cout << "Unknown file type :  " << model_filename << "\n";
+		return false;
+	}
+	std::string file_ext = model_filename.substr(last_period_pos, model_filename.length() - last_period_pos);
+
+	if (file_ext == ".yml") {
+		cv::FileStorage fs2(model_filename, cv::FileStorage::READ);
+		fs2["model"] >> model_matrix;
+	} else if (file_ext == ".bmp" || file_ext == ".jpg") {
+		model_matrix = cv::imread(model_filename, CV_LOAD_IMAGE_GRAYSCALE);
+	} else {
+		std::cout << "Unknown file type :  " << file_ext << "\n";
+	}
+
+	return !model_matrix.empty();
+}
+
+// fnv-1a
+std::uint64_t FloorPlanCache::hash_file(const std::string& filename, bool& ok) {
+	ok = false;
+	QFile file(QString::fromStdString(filename));
+	if (!file.open(QIODevice::ReadOnly)) {
+		return 0;
+	}
+
+	std::uint64_t hash = 14695981039346656037ULL;
+	qint64 size = file.size();
+	const uchar* data = size > 0 ? file.map(0, size) : nullptr;
+	if (data) {
+		for (qint64 i = 0; i < size; ++i) {
+			hash = (hash ^ data[i]) * 1099511628211ULL;
+		}
+		file.unmap(const_cast<uchar*>(data));
+	} else {
+		QByteArray bytes = file.readAll();
+		for (int i = 0; i < bytes.size(); ++i) {
+			hash = (hash ^ static_cast<unsigned char>(bytes[i])) * 1099511628211ULL;
+		}
+	}
+	ok = true;
+	return hash;
+}
+
+std::shared_ptr<FloorPlanCache> FloorPlanCache::get(const std::string& model_filename) {
+	bool ok;
+	std::uint64_t content_hash = hash_file(model_filename, ok);
+	if (!ok) {
+		return nullptr;
+	}
+
+	// simulator threads load the same floor plan at the same time, only one of them compiles it
+	QMutexLocker locker(&lock_);
+	auto loaded = loaded_.find(content_hash);
+	if (loaded != loaded_.end()) {
+		return loaded->second;
+	}
+
+	QString cache_filename = QString::fromStdString(model_filename) + "." +
+		QString::number(content_hash, 16).rightJustified(16, '0') + ".fpc";
+
+	std::shared_ptr<FloorPlanCache> cache(new FloorPlanCache());
+	if (!cache->map(cache_filename, content_hash)) {
+		if (!cache->build(model_filename, cache_filename, content_hash)) {
+			return nullptr;
+		}
+	}
+
+	loaded_[content_hash] = cache;
+	return cache;
+}
+
+bool FloorPlanCache::map(const QString& cache_filename, std::uint64_t content_hash) {
+	if (!QFileInfo(cache_filename).exists()) {
+		return false;
+	}
+
+	file_.setFileName(cache_filename);
+	if (!file_.open(QIODevice::ReadOnly)) {
+		return false;
+	}
+
+	qint64 size = file_.size();
+	const uchar* data = file_.map(0, size);
+	if (!data || !attach(reinterpret_cast<const char*>(data), size, content_hash)) {
+		std::cout << "Ignoring floor plan cache : " << cache_filename.toStdString() << "\n";
+		file_.close();
+		levels_.clear();
+		return false;
+	}
+	return true;
+}
+
+bool FloorPlanCache::attach(const char* data, std::uint64_t size, std::uint64_t content_hash) {
+	if (size < sizeof(Header)) {
+		return false;
+	}
+
+	const Header* header = reinterpret_cast<const Header*>(data);
+	if (std::memcmp(header->magic, CACHE_MAGIC, 4) != 0 || header->version != CACHE_VERSION
+		|| header->content_hash != content_hash || header->no_of_levels < 0) {
+		return false;
+	}
+
+	std::uint64_t table_end = sizeof(Header) + header->no_of_levels * sizeof(LevelEntry);
+	if (table_end > size) {
+		return false;
+	}
+
+	source_cols_ = header->source_cols;
+	source_rows_ = header->source_rows;
+
+	const LevelEntry* entries = reinterpret_cast<const LevelEntry*>(data + sizeof(Header));
+	levels_.clear();
+	for (int i = 0; i < header->no_of_levels; ++i) {
+		const LevelEntry& entry = entries[i];
+		FloorPlanLevel level;
+		level.resolution = entry.resolution;
+		level.grid_width = entry.grid_width;
+		level.grid_height = entry.grid_height;
+		level.words_per_row = (entry.grid_width + 63) / 64;
+		level.no_of_perimeter_cells = entry.no_of_perimeter_cells;
+
+		std::uint64_t mask_size = std::uint64_t(level.words_per_row) * level.grid_height * sizeof(std::uint64_t);
+		std::uint64_t perimeter_size = std::uint64_t(level.no_of_perimeter_cells) * 2 * sizeof(std::int32_t);
+		if (entry.mask_offset + mask_size > size || entry.perimeter_offset + perimeter_size > size) {
+			levels_.clear();
+			return false;
+		}
+
+		level.interior_mask = reinterpret_cast<const std::uint64_t*>(data + entry.mask_offset);
+		level.perimeter_cells = reinterpret_cast<const std::int32_t*>(data + entry.perimeter_offset);
+		levels_.push_back(level);
+	}
+	return true;
+}
+
+bool FloorPlanCache::build(const std::string& model_filename, const QString& cache_filename, std::uint64_t content_hash) {
+	cv::Mat model_matrix;
+	if (!read_model_matrix(model_filename, model_matrix)) {
+		return false;
+	}
+
+	std::vector<LevelEntry> entries;
+	std::vector<std::vector<std::uint64_t>> masks;
+	std::vector<std::vector<std::int32_t>> perimeters;
+
+	// same sizes as load_interior_model_from_matrix
+	float aspect_ratio = model_matrix.cols / (float)(model_matrix.rows);
+	for (int resolution = 1; resolution <= MAX_RESOLUTION; ++resolution) {
+		int grid_width = std::pow(2, resolution);
+		int grid_height = grid_width / aspect_ratio;
+		if (grid_height < 1) {
+			continue;
+		}
+
+		cv::Mat level_matrix = model_matrix;
+		if (grid_width != model_matrix.cols) {
+			cv::resize(model_matrix, level_matrix, cv::Size(grid_width, grid_height));
+		}
+
+		int words_per_row = (grid_width + 63) / 64;
+		std::vector<std::uint64_t> mask(words_per_row * grid_height, 0);
+		int rows = std::min(level_matrix.rows, grid_height);
+		int cols = std::min(level_matrix.cols, grid_width);
+		for (int z = 0; z < rows; ++z) {
+			const unsigned char* row = level_matrix.ptr<unsigned char>(z);
+			for (int x = 0; x < cols; ++x) {
+				if (row[x] < INTERIOR_THRESHOLD) {
+					mask[z * words_per_row + (x >> 6)] |= std::uint64_t(1) << (x & 63);
+				}
+			}
+		}
+
+		// the occupancy grid marks its border as interior before the image is applied
+		int edge_x = grid_width - 1;
+		int edge_z = grid_height - 1;
+		auto is_interior = [&](int x, int z) {
+			return x == 0 || x == edge_x || z == 0 || z == edge_z ||
+				((mask[z * words_per_row + (x >> 6)] >> (x & 63)) & 1);
+		};
+
+		std::vector<std::int32_t> perimeter;
+		for (int x = 0; x < grid_width; ++x) {
+			for (int z = 0; z < grid_height; ++z) {
+				if (!is_interior(x, z)) {
+					continue;
+				}
+				bool perimeter_found = false;
+				for (int nx = std::max(x - 1, 0); nx <= std::min(x + 1, edge_x) && !perimeter_found; ++nx) {
+					for (int nz = std::max(z - 1, 0); nz <= std::min(z + 1, edge_z); ++nz) {
+						if (!is_interior(nx, nz)) {
+							perimeter_found = true;
+							break;
+						}
+					}
+				}
+				if (perimeter_found) {
+					perimeter.push_back(x);
+					perimeter.push_back(z);
+				}
+			}
+		}
+
+		LevelEntry entry;
+		entry.resolution = resolution;
+		entry.grid_width = grid_width;
+		entry.grid_height = grid_height;
+		entry.no_of_perimeter_cells = perimeter.size() / 2;
+		entries.push_back(entry);
+		masks.push_back(std::move(mask));
+		perimeters.push_back(std::move(perimeter));
+	}
+
+	// header, level table, then the masks and perimeter lists. every block is a multiple of 8 bytes
+	std::uint64_t offset = sizeof(Header) + entries.size() * sizeof(LevelEntry);
+	for (int i = 0; i < entries.size(); ++i) {
+		entries[i].mask_offset = offset;
+		offset += masks[i].size() * sizeof(std::uint64_t);
+		entries[i].perimeter_offset = offset;
+		offset += perimeters[i].size() * sizeof(std::int32_t);
+	}
+
+	std::vector<char> buffer(offset, 0);
+	Header header;
+	std::memcpy(header.magic, CACHE_MAGIC, 4);
+	header.version = CACHE_VERSION;
+	header.content_hash = content_hash;
+	header.source_cols = model_matrix.cols;
+	header.source_rows = model_matrix.rows;
+	header.no_of_levels = entries.size();
+	header.reserved = 0;
+	std::memcpy(buffer.data(), &header, sizeof(Header));
+	if (!entries.empty()) {
+		std::memcpy(buffer.data() + sizeof(Header), entries.data(), entries.size() * sizeof(LevelEntry));
+	}
+	for (int i = 0; i < entries.size(); ++i) {
+		std::memcpy(buffer.data() + entries[i].mask_offset, masks[i].data(), masks[i].size() * sizeof(std::uint64_t));
+		if (!perimeters[i].empty()) {
+			std::memcpy(buffer.data() + entries[i].perimeter_offset, perimeters[i].data(),
+				perimeters[i].size() * sizeof(std::int32_t));
+		}
+	}
+
+	// QSaveFile writes to a temporary and renames on commit, so a reader never maps half a file
+	QSaveFile save_file(cache_filename);
+	if (save_file.open(QIODevice::WriteOnly) &&
+		save_file.write(buffer.data(), buffer.size()) == qint64(buffer.size()) && save_file.commit()) {
+		if (map(cache_filename, content_hash)) {
+			return true;
+		}
+	} else {
+		std::cout << "Couldn't write floor plan cache : " << cache_filename.toStdString() << "\n";
+	}
+
+	owned_data_ = std::move(buffer);
+	return attach(owned_data_.data(), owned_data_.size(), content_hash);
+}
+
+const FloorPlanLevel* FloorPlanCache::level(int resolution) const {
+	for (auto& level : levels_) {
+		if (level.resolution == resolution) {
+			return &level;
+		}
+	}
+	return nullptr;
+}
+
+int FloorPlanCache::get_source_cols() const {
+	return source_cols_;
+}
+
+int FloorPlanCache::get_source_rows() const {
+	return source_rows_;
+}
@@ -0,0 +1,95 @@
+#pragma once
+#include "fsl_common.h"
+#include <QFile>
+#include <QMutex>
+#include <memory>
+#include <string>
+#include <cstdint>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// one power of two resolution of a compiled floor plan. everything points into the cache file
+struct FloorPlanLevel {
+	int resolution;
+	int grid_width;
+	int grid_height;
+	// words per row of the interior bitmask, bit x of row z is set where the resized image is < 220
+	int words_per_row;
+	const std::uint64_t* interior_mask;
+	// x, z pairs of the interior cells with a non interior neighbour, the border of the grid
+	// counted as interior. this is what SwarmOccupancyTree::create_interior_list finds
+	const std::int32_t* perimeter_cells;
+	int no_of_perimeter_cells;
+
+	bool is_interior(int x, int z) const {
+		return (interior_mask[z * words_per_row + (x >> 6)] >> (x & 63)) & 1;
+	}
+
+	static int lowest_bit(std::uint64_t word) {
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward64(&index, word);
+		return index;
+#else
+		return __builtin_ctzll(word);
+#endif
+	}
+};
+
+// floor plan images are compiled once into a binary pyramid (one level per grid resolution) which is
+// written next to the model as <model>.<content hash>.fpc and memory mapped on the next load. a change
+// in grid_resolution_ during a sweep is then a lookup instead of a decode, resize and scan
+class FloorPlanCache {
+public:
+	static const int MAX_RESOLUTION;
+	static const int INTERIOR_THRESHOLD;
+
+	// returns nullptr if the model can't be read
+	static std::shared_ptr<FloorPlanCache> get(const std::string& model_filename);
+	static bool read_model_matrix(const std::string& model_filename, cv::Mat& model_matrix);
+	// fnv-1a of the file contents
+	static std::uint64_t hash_file(const std::string& filename, bool& ok);
+
+	// nullptr if the resolution is not in the pyramid
+	const FloorPlanLevel* level(int resolution) const;
+	int get_source_cols() const;
+	int get_source_rows() const;
+
+	~FloorPlanCache();
+
+private:
+	struct Header {
+		char magic[4];
+		std::uint32_t version;
+		std::uint64_t content_hash;
+		std::int32_t source_cols;
+		std::int32_t source_rows;
+		std::int32_t no_of_levels;
+		std::int32_t reserved;
+	};
+
+	struct LevelEntry {
+		std::int32_t resolution;
+		std::int32_t grid_width;
+		std::int32_t grid_height;
+		std::int32_t no_of_perimeter_cells;
+		std::uint64_t mask_offset;
+		std::uint64_t perimeter_offset;
+	};
+
+	FloorPlanCache();
+	bool map(const QString& cache_filename, std::uint64_t content_hash);
+	bool build(const std::string& model_filename, const QString& cache_filename, std::uint64_t content_hash);
+	bool attach(const char* data, std::uint64_t size, std::uint64_t content_hash);
+
+	QFile file_;
+	// used when the cache file couldn't be written
+	std::vector<char> owned_data_;
+	int source_cols_;
+	int source_rows_;
+	std::vector<FloorPlanLevel> levels_;
+
+	static QMutex lock_;
+	static std::unordered_map<std::uint64_t, std::shared_ptr<FloorPlanCache>> loaded_;
+};
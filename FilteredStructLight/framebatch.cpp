@@ -0,0 +1,92 @@
+#include "framebatch.h"
+#include <algorithm>
+#include <cassert>
+
+const int FrameBatch::MIN_CAPACITY = 1024;
+
+FrameBatch::FrameBatch() : uploaded_count_(0), capacity_(0) {
+}
+
+int FrameBatch::append_frame(const std::vector<cv::Vec3f>& positions, const std::vector<cv::Vec4f>& colors) {
+	assert(positions.size() == colors.size());
+
+	frame_firsts_.push_back(static_cast<int>(positions_.size()));
+	frame_counts_.push_back(static_cast<int>(positions.size()));
+	positions_.insert(positions_.end(), positions.begin(), positions.end());
+	colors_.insert(colors_.end(), colors.begin(), colors.end());
+
+	return static_cast<int>(frame_firsts_.size()) - 1;
+}
+
+int FrameBatch::append_frame(const std::vector<cv::Vec3f>& positions, const cv::Vec4f& color) {
+	std::vector<cv::Vec4f> colors(positions.size(), color);
+	return append_frame(positions, colors);
+}
+
+void FrameBatch::clear() {
+	positions_.clear();
+	colors_.clear();
+	frame_firsts_.clear();
+	frame_counts_.clear();
+	uploaded_count_ = 0;
+}
+
+int FrameBatch::get_no_of_frames() const {
+	return static_cast<int>(frame_firsts_.size());
+}
+
+int FrameBatch::get_no_of_vertices() const {
+	return static_cast<int>(positions_.size());
+}
+
+void FrameBatch::get_frame_range(int frame, int& first, int& count) const {
+	if (frame < 0 || frame >= get_no_of_frames()) {
+		first = 0;
+		count = 0;
+		return;
+	}
+	first = frame_firsts_[frame];
+	count = frame_counts_[frame];
+}
+
+const std::vector<int>& FrameBatch::get_frame_firsts() const {
+	return frame_firsts_;
+}
+
+const std::vector<int>& FrameBatch::get_frame_counts() const {
+	return frame_counts_;
+}
+
+const cv::Vec3f* FrameBatch::get_positions() const {
+	return positions_.empty() ? nullptr : &positions_[0];
+}
+
+const cv::Vec4f* FrameBatch::get_colors() const {
+	return colors_.empty() ? nullptr : &colors_[0];
+}
+
+bool FrameBatch::has_pending() const {
+	return uploaded_count_ < get_no_of_vertices();
+}
+
+int FrameBatch::get_uploaded_count() const {
+	return uploaded_count_;
+}
+
+int FrameBatch::get_capacity() const {
+	return capacity_;
+}
+
+int FrameBatch::get_required_capacity() const {
+	int no_of_vertices = get_no_of_vertices();
+	if (no_of_vertices <= capacity_) {
+		return capacity_;
+	}
+	return std::max(std::max(no_of_vertices, 2 * capacity_), MIN_CAPACITY);
+}
+
+void FrameBatch::mark_uploaded(int capacity) {
+	assert(capacity >= get_no_of_vertices());
+	capacity_ = capacity;
+	uploaded_count_ = get_no_of_vertices();
+}
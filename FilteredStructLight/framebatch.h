@@ -0,0 +1,43 @@
+#pragma once
+#include "opencv2/core/core.hpp"
+#include <vector>
+
+// the geometry of a stream of frames in one array that only grows. a new frame only appends, so what's on the gpu
+// never changes and an upload is the vertices since the last one. storage doubles when it runs out, so a long
+// run reallocates a handful of times. no gl in here, StreamedEntity uploads and draws it
+class FrameBatch {
+	std::vector<cv::Vec3f> positions_;
+	std::vector<cv::Vec4f> colors_;
+	// first vertex and vertex count of every frame, the way glMultiDrawArrays takes them
+	std::vector<int> frame_firsts_;
+	std::vector<int> frame_counts_;
+	int uploaded_count_;
+	int capacity_;
+
+public:
+	static const int MIN_CAPACITY;
+
+	FrameBatch();
+	// returns the frame number. frames can be empty, so frame numbers line up across batches
+	int append_frame(const std::vector<cv::Vec3f>& positions, const std::vector<cv::Vec4f>& colors);
+	int append_frame(const std::vector<cv::Vec3f>& positions, const cv::Vec4f& color);
+	// keeps the capacity, the gpu storage is written over instead of freed
+	void clear();
+
+	int get_no_of_frames() const;
+	int get_no_of_vertices() const;
+	// count is 0 for a frame that doesn't exist
+	void get_frame_range(int frame, int& first, int& count) const;
+	const std::vector<int>& get_frame_firsts() const;
+	const std::vector<int>& get_frame_counts() const;
+	const cv::Vec3f* get_positions() const;
+	const cv::Vec4f* get_colors() const;
+
+	bool has_pending() const;
+	int get_uploaded_count() const;
+	int get_capacity() const;
+	// get_capacity() while everything still fits, else the capacity to reallocate to
+	int get_required_capacity() const;
+	// everything is on the gpu in storage of capacity vertices
+	void mark_uploaded(int capacity);
+};
@@ -1,8 +1,15 @@
 //#define QT_QML_DEBUG
 #include "filteredstructlight.h"
 #include "projectorwindow.h"
+#include "swarmbenchmark.h"
+#include "swarmdistributed.h"
+#include "swarmopt.h"
+#include "swarmvoxelsim.h"
+#include "pointlod.h"
 #include <QtWidgets/QApplication>
 #include <QQuickView>
+#include <QEventLoop>
+#include <fstream>
 #define _CRTDBG_MAP_ALLOC
 #include <stdlib.h>
 #include <crtdbg.h>
@@ -45,8 +52,160 @@ void run_program(int argc, char *argv[]) {
 	a.exec();
 }
 
+// FilteredStructLight --benchmark [output.json] [config.ini ...]
+int run_benchmark(int argc, char *argv[], int benchmark_arg) {
+	QCoreApplication a(argc, argv);
+	qRegisterMetaType<SwarmParams>("SwarmParams");
+	qRegisterMetaType<OptimizationResults>("OptimizationResults");
+
+	std::string output_filename = "benchmark_results.json";
+	QStringList configs;
+	for (int i = benchmark_arg + 1; i < argc; ++i) {
+		QString arg(argv[i]);
+		if (arg.endsWith(".json")) {
+			output_filename = arg.toStdString();
+		} else {
+			configs.push_back(arg);
+		}
+	}
+	return SwarmBenchmark::run(output_filename, configs);
+}
+
+// FilteredStructLight --worker <coordinator host> <port> [no_of_threads]
+int run_worker(int argc, char *argv[], int worker_arg) {
+	QCoreApplication a(argc, argv);
+	qRegisterMetaType<SwarmParams>("SwarmParams");
+	qRegisterMetaType<OptimizationResults>("OptimizationResults");
+
+	if (worker_arg + 2 >= argc) {
+		std::cout << "usage : FilteredStructLight --worker <host> <port> [no_of_threads]\n";
+		return 1;
+	}
+	QString host(argv[worker_arg + 1]);
+	quint16 port = QString(argv[worker_arg + 2]).toUShort();
+	int no_of_threads = worker_arg + 3 < argc ? QString(argv[worker_arg + 3]).toInt() : 0;
+
+	SwarmWorker worker(host, port, no_of_threads);
+	worker.start();
+	return a.exec();
+}
+
+// FilteredStructLight --optimize <optimization config.ini>, batch optimizes its swarm configs without the gui
+int run_optimization(int argc, char *argv[], int optimize_arg) {
+	QCoreApplication a(argc, argv);
+	qRegisterMetaType<SwarmParams>("SwarmParams");
+	qRegisterMetaType<OptimizationResults>("OptimizationResults");
+
+	if (optimize_arg + 1 >= argc) {
+		std::cout << "usage : FilteredStructLight --optimize <optimization config.ini>\n";
+		return 1;
+	}
+	auto opt_params = SwarmUtils::load_optimization_params(argv[optimize_arg + 1]);
+
+	std::string optimizer_filename = SwarmUtils::get_optimizer_results_filename("batch_optimizer.csv", "mcmc_results");
+	std::ofstream file(optimizer_filename);
+	SwarmUtils::print_result_header(file);
+	file.close();
+
+	for (auto& config : opt_params.swarm_configs) {
+		auto swarm_params = SwarmUtils::load_swarm_params(config);
+		swarm_params.config_name_ = config;
+
+		ParallelMCMCOptimizer optimizer(swarm_params, opt_params, optimizer_filename);
+		QEventLoop loop;
+		QObject::connect(&optimizer, SIGNAL(finished()), &loop, SLOT(quit()));
+		optimizer.run_optimizer();
+		loop.exec();
+	}
+	return 0;
+}
+
+// FilteredStructLight --video <swarm config.ini> [output directory], simulates the config once without the gui
+// and writes a top down frame of every tick
+int run_video(int argc, char *argv[], int video_arg) {
+	QCoreApplication a(argc, argv);
+	qRegisterMetaType<SwarmParams>("SwarmParams");
+	qRegisterMetaType<OptimizationResults>("OptimizationResults");
+
+	if (video_arg + 1 >= argc) {
+		std::cout << "usage : FilteredStructLight --video <swarm config.ini> [output directory]\n";
+		return 1;
+	}
+	QString config(argv[video_arg + 1]);
+	auto swarm_params = SwarmUtils::load_swarm_params(config);
+	swarm_params.config_name_ = config;
+	std::string video_directory = video_arg + 2 < argc ? std::string(argv[video_arg + 2])
+		: SwarmUtils::get_video_directory(config.toStdString());
+
+	SimulatorThread simulator_thread(0, 0, 0, swarm_params);
+	simulator_thread.setAutoDelete(false);
+	simulator_thread.set_video_directory(video_directory);
+	simulator_thread.reset_sim();
+	simulator_thread.run();
+	return 0;
+}
+
+// FilteredStructLight --voxel-explore <swarm config.ini> [output.csv], explores the config's model in 3d without
+// the gui, see SwarmVoxelSimulator
+int run_voxel_explore(int argc, char *argv[], int voxel_arg) {
+	if (voxel_arg + 1 >= argc) {
+		std::cout << "usage : FilteredStructLight --voxel-explore <swarm config.ini> [output.csv]\n";
+		return 1;
+	}
+	QCoreApplication a(argc, argv);
+	auto swarm_params = SwarmUtils::load_swarm_params(argv[voxel_arg + 1]);
+	SwarmVoxelSimulator simulator(swarm_params);
+	if (!simulator.load_model()) {
+		return 1;
+	}
+	simulator.create_robots();
+
+	std::ofstream results_file;
+	if (voxel_arg + 2 < argc) {
+		results_file.open(argv[voxel_arg + 2]);
+	}
+	simulator.run(results_file.is_open() ? &results_file : nullptr);
+	return 0;
+}
+
+// FilteredStructLight --build-lod <points file> <output directory>, the points file is raw float x, y, z triples.
+// the directory opens in the reconstruction tab with Open Point LOD
+int run_build_lod(int argc, char *argv[], int build_lod_arg) {
+	if (build_lod_arg + 2 >= argc) {
+		std::cout << "usage : FilteredStructLight --build-lod <points file> <output directory>\n";
+		return 1;
+	}
+	RawPointStream stream(argv[build_lod_arg + 1]);
+	if (!stream.is_open()) {
+		std::cout << "Couldn't open " << argv[build_lod_arg + 1] << std::endl;
+		return 1;
+	}
+	return PointLODBuilder::build(stream, argv[build_lod_arg + 2]) ? 0 : 1;
+}
+
 int main(int argc, char *argv[])
 {
+	for (int i = 1; i < argc; ++i) {
+		if (std::string(argv[i]) == "--benchmark") {
+			return run_benchmark(argc, argv, i);
+		}
+		if (std::string(argv[i]) == "--worker") {
+			return run_worker(argc, argv, i);
+		}
+		if (std::string(argv[i]) == "--optimize") {
+			return run_optimization(argc, argv, i);
+		}
+		if (std::string(argv[i]) == "--video") {
+			return run_video(argc, argv, i);
+		}
+		if (std::string(argv[i]) == "--build-lod") {
+			return run_build_lod(argc, argv, i);
+		}
+		if (std::string(argv[i]) == "--voxel-explore") {
+			return run_voxel_explore(argc, argv, i);
+		}
+	}
+
 	//_CrtSetDbgFlag(_CRTDBG_ALLOC_MEM_DF | _CRTDBG_LEAK_CHECK_DF);
 
 	//_CrtSetBreakAlloc(1144150);
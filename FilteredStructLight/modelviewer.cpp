@@ -12,7 +12,7 @@
 ModelViewer::ModelViewer(const QGLFormat& format, QWidget* parent)
 	:  QGLWidget(format, parent),
 	m_vertexBuffer(QGLBuffer::VertexBuffer), no_of_pts_(0), angle_(0), is_draw_triangles_(true), is_texture_on_(true),
-	m_xRot(0), m_yRot(0), m_zRot(0), mouse_down_(false)
+	m_xRot(0), m_yRot(0), m_zRot(0), mouse_down_(false), lod_point_budget_(2 * 1024 * 1024)
 {
 
 	setFocusPolicy(Qt::StrongFocus);
@@ -221,6 +221,10 @@ void ModelViewer::paintGL()
 	//glm::mat4 rotateZ = glm::rotate(rotateY, (float)1.f, glm::vec3(0.f, 0.f, 1.f));
 	
 	glm::mat4 model = rotateZ;
+	if (point_lod_.is_open()) {
+		// the octree isn't centered like update_model centers its points
+		model = glm::translate(model, -point_lod_.get_center());
+	}
 
 	glUniformMatrix4fv(model_loc, 1, GL_FALSE, glm::value_ptr(model));
 
@@ -235,6 +239,12 @@ void ModelViewer::paintGL()
 	GLint camera_location = m_shader.uniformLocation("camera");
 	glUniformMatrix4fv(camera_location, 1, GL_FALSE, glm::value_ptr(camera));
 
+	if (point_lod_.is_open()) {
+		glm::mat4 model_view = camera * model;
+		glm::vec3 eye = glm::vec3(glm::inverse(model_view) * glm::vec4(0.f, 0.f, 0.f, 1.f));
+		update_lod_points(projection * model_view, eye);
+	}
+
 
 	GLint texture_used_loc = m_shader.uniformLocation("is_texture_used");
 	glUniform1i(texture_used_loc, is_texture_on_);
@@ -282,6 +292,7 @@ void ModelViewer::change_world_pts(WPt& world_pts) {
 
 void ModelViewer::update_model(WPts world_pnts) {
 	makeCurrent();
+	point_lod_.close();
 
 	if (world_pnts.size() < 1) {
 		std::cout << "No points to display" << std::endl;
@@ -340,6 +351,54 @@ void ModelViewer::update_model(WPts world_pnts) {
 }
 
 
+void ModelViewer::load_point_lod(QString directory) {
+	if (!point_lod_.open(directory.toStdString())) {
+		return;
+	}
+	std::cout << "Opened " << point_lod_.get_no_of_points() << " points in " << point_lod_.get_nodes().size()
+		<< " nodes" << std::endl;
+
+	lod_selection_.clear();
+	is_draw_triangles_ = false;
+	update();
+}
+
+void ModelViewer::update_lod_points(const glm::mat4& mvp, const glm::vec3& eye) {
+	std::vector<int> selection;
+	point_lod_.select_nodes(mvp, eye, lod_point_budget_, selection);
+	if (selection == lod_selection_) {
+		return;
+	}
+	lod_selection_.swap(selection);
+
+	std::vector<cv::Vec3f> points;
+	for (auto node : lod_selection_) {
+		auto& node_points = point_lod_.get_node_points(node);
+		points.insert(points.end(), node_points.begin(), node_points.end());
+	}
+	no_of_pts_ = static_cast<int>(points.size());
+	if (points.empty()) {
+		return;
+	}
+	std::vector<cv::Vec3f> colors(points.size(), cv::Vec3f(1.f, 1.f, 1.f));
+
+	glBindVertexArray(vao_pts_);
+
+	GLuint vert_pos_attr = m_shader.attributeLocation("vertex");
+	glBindBuffer(GL_ARRAY_BUFFER, vbo_pts_[0]);
+	glBufferData(GL_ARRAY_BUFFER, points.size() * sizeof(cv::Vec3f), &points[0], GL_STREAM_DRAW);
+	glEnableVertexAttribArray(vert_pos_attr);
+	glVertexAttribPointer(vert_pos_attr, 3, GL_FLOAT, GL_FALSE, sizeof(cv::Vec3f), NULL);
+
+	GLuint vert_color_attr = m_shader.attributeLocation("vertColor");
+	glBindBuffer(GL_ARRAY_BUFFER, vbo_pts_[1]);
+	glBufferData(GL_ARRAY_BUFFER, colors.size() * sizeof(cv::Vec3f), &colors[0], GL_STREAM_DRAW);
+	glEnableVertexAttribArray(vert_color_attr);
+	glVertexAttribPointer(vert_color_attr, 3, GL_FLOAT, GL_FALSE, sizeof(cv::Vec3f), NULL);
+
+	glBindVertexArray(NULL);
+}
+
 void ModelViewer::gen_texture(GLuint& texture_id, cv::Mat& remapped_img_gray) {
 
 	makeCurrent();
@@ -397,6 +456,7 @@ void ModelViewer::set_scale(int value) {
 void ModelViewer::update_model_with_triangles(WPts world_pnts, WPts world_pt_colrs, WPt triangles, IPt texture_coords,
 											  cv::Mat texture_img) {
 	makeCurrent();
+	point_lod_.close();
 
 	if (triangles.size() < 1) {
 		std::cout << "No triangles to display" << std::endl;
@@ -5,6 +5,7 @@
 #include <QGLBuffer>
 #include <QGLShaderProgram>
 #include "fsl_common.h"
+#include "pointlod.h"
 #include <QTimer>
 #include <QWheelEvent>
 #include <opencv2/video/background_segm.hpp>
@@ -60,6 +61,12 @@ private:
 	void setYRotation(float angle);
 	void setZRotation(float angle);
 
+	// a cloud too big to upload whole, only the nodes the camera sees are in vao_pts_
+	PointLOD point_lod_;
+	std::vector<int> lod_selection_;
+	int lod_point_budget_;
+	void update_lod_points(const glm::mat4& mvp, const glm::vec3& eye);
+
 
 public:
 	ModelViewer(const QGLFormat& format, QWidget* parent = 0);
@@ -69,6 +76,8 @@ public:
 
 	public slots:
 	void update_model(WPts world_pts);
+	// draws the octree PointLODBuilder wrote to directory instead of the current model
+	void load_point_lod(QString directory);
 	void update_model_with_triangles(WPts world_pts, WPts world_pt_colors, WPt triangles, IPt texture_coords, cv::Mat texture_img);
 	void draw_triangles();
 	void draw_points();
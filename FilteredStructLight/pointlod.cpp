@@ -0,0 +1,566 @@
+#include "pointlod.h"
+#include <QDir>
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <limits>
+#include <queue>
+#include <sstream>
+
+const int PointLODBuilder::GRID_RESOLUTION = 32;
+const int PointLODBuilder::LEAF_CAPACITY = 8192;
+const int PointLODBuilder::MAX_LEVEL = 20;
+const int PointLODBuilder::MAX_POINTS_IN_MEMORY = 16 * 1024 * 1024;
+const int PointLODBuilder::MAX_TOP_LEVELS = 3;
+const int PointLODBuilder::SPILL_BUFFER_SIZE = 8192;
+const int PointLODBuilder::READ_SIZE = 1024 * 1024;
+
+const char PointLOD::MAGIC[4] = { 'P', 'L', 'O', 'D' };
+const int PointLOD::VERSION = 1;
+const long long PointLOD::MAX_CACHED_POINTS = 32 * 1024 * 1024;
+
+RawPointStream::RawPointStream(const std::string& filename) : file_(filename, std::ios::binary), filename_(filename) {
+}
+
+bool RawPointStream::is_open() const {
+	return file_.is_open();
+}
+
+void RawPointStream::rewind() {
+	file_.clear();
+	file_.seekg(0);
+}
+
+int RawPointStream::read(cv::Vec3f* points, int max_no_of_points) {
+	file_.read(reinterpret_cast<char*>(points), max_no_of_points * sizeof(cv::Vec3f));
+	return static_cast<int>(file_.gcount() / sizeof(cv::Vec3f));
+}
+
+int PointLODBuilder::grid_index(const cv::Vec3f& point, const cv::Vec3f& origin, float size) {
+	int cell[3];
+	for (int i = 0; i < 3; ++i) {
+		int c = static_cast<int>((point[i] - origin[i]) / size * GRID_RESOLUTION);
+		cell[i] = std::max(0, std::min(c, GRID_RESOLUTION - 1));
+	}
+	return (cell[2] * GRID_RESOLUTION + cell[1]) * GRID_RESOLUTION + cell[0];
+}
+
+int PointLODBuilder::octant(const cv::Vec3f& point, const cv::Vec3f& origin, float size) {
+	float half = size / 2.f;
+	int result = 0;
+	for (int i = 0; i < 3; ++i) {
+		if (point[i] - origin[i] >= half) {
+			result |= 1 << i;
+		}
+	}
+	return result;
+}
+
+static cv::Vec3f child_origin(const cv::Vec3f& origin, float size, int octant) {
+	float half = size / 2.f;
+	return cv::Vec3f(origin[0] + ((octant & 1) ? half : 0.f), origin[1] + ((octant & 2) ? half : 0.f),
+		origin[2] + ((octant & 4) ? half : 0.f));
+}
+
+static PointLODNode make_node(const cv::Vec3f& origin, float size, int level) {
+	PointLODNode node;
+	node.origin = origin;
+	node.size = size;
+	node.level = level;
+	std::fill(node.children, node.children + 8, -1);
+	node.offset = 0;
+	node.no_of_points = 0;
+	return node;
+}
+
+static void write_points(const std::vector<cv::Vec3f>& points, PointLODNode& node, std::ofstream& points_file,
+	long long& no_of_written_points) {
+	node.offset = no_of_written_points;
+	node.no_of_points = static_cast<int>(points.size());
+	if (!points.empty()) {
+		points_file.write(reinterpret_cast<const char*>(&points[0]), points.size() * sizeof(cv::Vec3f));
+	}
+	no_of_written_points += points.size();
+}
+
+int PointLODBuilder::build_subtree(std::vector<cv::Vec3f>& points, cv::Vec3f origin, float size, int level,
+	std::vector<PointLODNode>& nodes, std::ofstream& points_file, long long& no_of_written_points) {
+	int id = static_cast<int>(nodes.size());
+	nodes.push_back(make_node(origin, size, level));
+
+	std::vector<cv::Vec3f> kept_points;
+	std::vector<cv::Vec3f> child_points[8];
+	if (points.size() <= LEAF_CAPACITY || level >= MAX_LEVEL) {
+		kept_points.swap(points);
+	} else {
+		std::vector<unsigned char> grid(GRID_RESOLUTION * GRID_RESOLUTION * GRID_RESOLUTION, 0);
+		for (auto& point : points) {
+			int cell = grid_index(point, origin, size);
+			if (!grid[cell]) {
+				grid[cell] = 1;
+				kept_points.push_back(point);
+			} else {
+				child_points[octant(point, origin, size)].push_back(point);
+			}
+		}
+		// the children hold them now, don't keep two copies down the recursion
+		std::vector<cv::Vec3f>().swap(points);
+	}
+
+	write_points(kept_points, nodes[id], points_file, no_of_written_points);
+
+	for (int c = 0; c < 8; ++c) {
+		if (!child_points[c].empty()) {
+			int child = build_subtree(child_points[c], child_origin(origin, size, c), size / 2.f, level + 1, nodes,
+				points_file, no_of_written_points);
+			nodes[id].children[c] = child;
+		}
+	}
+	return id;
+}
+
+int PointLODBuilder::build_spilled_subtree(const std::string& filename, long long no_of_points, cv::Vec3f origin,
+	float size, int level, std::vector<PointLODNode>& nodes, std::ofstream& points_file, long long& no_of_written_points) {
+	if (no_of_points <= MAX_POINTS_IN_MEMORY || level >= MAX_LEVEL) {
+		if (no_of_points > MAX_POINTS_IN_MEMORY) {
+			std::cout << filename << " holds " << no_of_points << " points at the deepest level, more than the in memory limit"
+				<< std::endl;
+		}
+		std::vector<cv::Vec3f> points(no_of_points);
+		std::ifstream spill_file(filename, std::ios::binary);
+		spill_file.read(reinterpret_cast<char*>(&points[0]), no_of_points * sizeof(cv::Vec3f));
+		// short, the subtree would be built from points that were never read. build checks points_file at the end
+		if (!spill_file) {
+			points_file.setstate(std::ios::failbit);
+		}
+		spill_file.close();
+		std::remove(filename.c_str());
+		return build_subtree(points, origin, size, level, nodes, points_file, no_of_written_points);
+	}
+
+	// the same split as build_subtree, streamed from the spill file into one per child
+	int id = static_cast<int>(nodes.size());
+	nodes.push_back(make_node(origin, size, level));
+
+	std::vector<cv::Vec3f> kept_points;
+	long long child_counts[8] = { 0 };
+	{
+		std::vector<unsigned char> grid(GRID_RESOLUTION * GRID_RESOLUTION * GRID_RESOLUTION, 0);
+		std::vector<cv::Vec3f> child_points[8];
+		std::ofstream child_files[8];
+		for (int c = 0; c < 8; ++c) {
+			std::stringstream ss;
+			ss << filename << "_" << c;
+			child_files[c].open(ss.str(), std::ios::binary | std::ios::trunc);
+		}
+		auto spill = [&] (int c) {
+			if (!child_points[c].empty()) {
+				child_files[c].write(reinterpret_cast<const char*>(&child_points[c][0]),
+					child_points[c].size() * sizeof(cv::Vec3f));
+				child_points[c].clear();
+			}
+		};
+
+		std::vector<cv::Vec3f> read_buffer(READ_SIZE);
+		std::ifstream spill_file(filename, std::ios::binary);
+		while (spill_file) {
+			spill_file.read(reinterpret_cast<char*>(&read_buffer[0]), READ_SIZE * sizeof(cv::Vec3f));
+			int no_of_read = static_cast<int>(spill_file.gcount() / sizeof(cv::Vec3f));
+			for (int i = 0; i < no_of_read; ++i) {
+				const cv::Vec3f& point = read_buffer[i];
+				int cell = grid_index(point, origin, size);
+				if (!grid[cell]) {
+					grid[cell] = 1;
+					kept_points.push_back(point);
+					continue;
+				}
+				int c = octant(point, origin, size);
+				child_points[c].push_back(point);
+				++child_counts[c];
+				if (child_points[c].size() >= SPILL_BUFFER_SIZE) {
+					spill(c);
+				}
+			}
+		}
+		spill_file.close();
+		std::remove(filename.c_str());
+		for (int c = 0; c < 8; ++c) {
+			spill(c);
+			child_files[c].close();
+			if (child_files[c].fail()) {
+				points_file.setstate(std::ios::failbit);
+			}
+		}
+	}
+
+	write_points(kept_points, nodes[id], points_file, no_of_written_points);
+	std::vector<cv::Vec3f>().swap(kept_points);
+
+	for (int c = 0; c < 8; ++c) {
+		std::stringstream ss;
+		ss << filename << "_" << c;
+		if (child_counts[c] == 0) {
+			std::remove(ss.str().c_str());
+			continue;
+		}
+		int child = build_spilled_subtree(ss.str(), child_counts[c], child_origin(origin, size, c), size / 2.f, level + 1,
+			nodes, points_file, no_of_written_points);
+		nodes[id].children[c] = child;
+	}
+	return id;
+}
+
+bool PointLODBuilder::build(PointStream& stream, const std::string& directory) {
+	if (!QDir().mkpath(directory.c_str())) {
+		std::cout << "Unable to create " << directory << std::endl;
+		return false;
+	}
+	std::vector<cv::Vec3f> read_buffer(READ_SIZE);
+
+	// bounds
+	cv::Vec3f min_point(std::numeric_limits<float>::max(), std::numeric_limits<float>::max(),
+		std::numeric_limits<float>::max());
+	cv::Vec3f max_point = -min_point;
+	long long no_of_points = 0;
+	stream.rewind();
+	int no_of_read;
+	while ((no_of_read = stream.read(&read_buffer[0], READ_SIZE)) > 0) {
+		for (int i = 0; i < no_of_read; ++i) {
+			for (int k = 0; k < 3; ++k) {
+				min_point[k] = std::min(min_point[k], read_buffer[i][k]);
+				max_point[k] = std::max(max_point[k], read_buffer[i][k]);
+			}
+		}
+		no_of_points += no_of_read;
+	}
+	if (no_of_points == 0) {
+		std::cout << "No points to build a level of detail octree from" << std::endl;
+		return false;
+	}
+
+	// a cube, a little bigger so the max corner still lands inside
+	float size = std::max(std::max(max_point[0] - min_point[0], max_point[1] - min_point[1]), max_point[2] - min_point[2]);
+	size = std::max(size * 1.001f, 1e-3f);
+	cv::Vec3f origin = min_point;
+
+	// the levels above the spill files, enough that a spill file fits in memory if the cloud is spread out
+	int top_levels = 0;
+	while (top_levels < MAX_TOP_LEVELS && (no_of_points >> (3 * top_levels)) > MAX_POINTS_IN_MEMORY) {
+		++top_levels;
+	}
+
+	std::vector<PointLODNode> nodes;
+	std::ofstream points_file(directory + "/points.bin", std::ios::binary);
+	if (!points_file.is_open()) {
+		std::cout << "Unable to create " << directory << "/points.bin" << std::endl;
+		return false;
+	}
+	long long no_of_written_points = 0;
+
+	// top nodes by level and cell, with their grids and the points they keep
+	std::vector<std::vector<int>> top_node_ids(top_levels);
+	std::vector<std::vector<unsigned char>> top_grids;
+	std::vector<std::vector<cv::Vec3f>> top_points;
+	for (int level = 0; level < top_levels; ++level) {
+		top_node_ids[level].assign(1 << (3 * level), -1);
+	}
+
+	int no_of_buckets = 1 << (3 * top_levels);
+	int cells_per_side = 1 << top_levels;
+	float bucket_size = size / cells_per_side;
+	std::vector<std::vector<cv::Vec3f>> buckets(no_of_buckets);
+	std::vector<long long> bucket_counts(no_of_buckets, 0);
+	auto bucket_filename = [&] (int bucket) {
+		std::stringstream ss;
+		ss << directory << "/bucket_" << bucket << ".tmp";
+		return ss.str();
+	};
+	auto spill = [&] (int bucket) {
+		if (buckets[bucket].empty()) {
+			return;
+		}
+		std::ofstream spill_file(bucket_filename(bucket), std::ios::binary | std::ios::app);
+		spill_file.write(reinterpret_cast<const char*>(&buckets[bucket][0]), buckets[bucket].size() * sizeof(cv::Vec3f));
+		if (!spill_file.good()) {
+			points_file.setstate(std::ios::failbit);
+		}
+		buckets[bucket].clear();
+	};
+	// spill files are appended to, anything left over from a build that didn't finish would end up in this one
+	if (top_levels > 0) {
+		for (int bucket = 0; bucket < no_of_buckets; ++bucket) {
+			std::remove(bucket_filename(bucket).c_str());
+		}
+	}
+
+	stream.rewind();
+	while ((no_of_read = stream.read(&read_buffer[0], READ_SIZE)) > 0) {
+		for (int i = 0; i < no_of_read; ++i) {
+			const cv::Vec3f& point = read_buffer[i];
+			int cell[3];
+			for (int k = 0; k < 3; ++k) {
+				int c = static_cast<int>((point[k] - origin[k]) / bucket_size);
+				cell[k] = std::max(0, std::min(c, cells_per_side - 1));
+			}
+
+			bool kept = false;
+			int parent = -1;
+			for (int level = 0; level < top_levels && !kept; ++level) {
+				int shift = top_levels - level;
+				int x = cell[0] >> shift, y = cell[1] >> shift, z = cell[2] >> shift;
+				int side = 1 << level;
+				int index = (z * side + y) * side + x;
+				int& id = top_node_ids[level][index];
+				if (id < 0) {
+					float node_size = size / (1 << level);
+					id = static_cast<int>(nodes.size());
+					nodes.push_back(make_node(origin + cv::Vec3f(x * node_size, y * node_size, z * node_size),
+						node_size, level));
+					top_grids.push_back(std::vector<unsigned char>(GRID_RESOLUTION * GRID_RESOLUTION * GRID_RESOLUTION, 0));
+					top_points.push_back(std::vector<cv::Vec3f>());
+					if (parent >= 0) {
+						nodes[parent].children[(x & 1) | ((y & 1) << 1) | ((z & 1) << 2)] = id;
+					}
+				}
+				// top nodes are the first nodes, so their ids index the grids too
+				int grid_cell = grid_index(point, nodes[id].origin, nodes[id].size);
+				if (!top_grids[id][grid_cell]) {
+					top_grids[id][grid_cell] = 1;
+					top_points[id].push_back(point);
+					kept = true;
+				}
+				parent = id;
+			}
+			if (kept) {
+				continue;
+			}
+
+			int bucket = (cell[2] * cells_per_side + cell[1]) * cells_per_side + cell[0];
+			buckets[bucket].push_back(point);
+			++bucket_counts[bucket];
+			if (top_levels > 0 && buckets[bucket].size() >= SPILL_BUFFER_SIZE) {
+				spill(bucket);
+			}
+		}
+	}
+	std::vector<std::vector<unsigned char>>().swap(top_grids);
+
+	int no_of_top_nodes = static_cast<int>(nodes.size());
+	for (int bucket = 0; bucket < no_of_buckets; ++bucket) {
+		if (bucket_counts[bucket] == 0) {
+			continue;
+		}
+
+		int x = bucket % cells_per_side;
+		int y = (bucket / cells_per_side) % cells_per_side;
+		int z = bucket / (cells_per_side * cells_per_side);
+		cv::Vec3f bucket_origin = origin + cv::Vec3f(x * bucket_size, y * bucket_size, z * bucket_size);
+		int root;
+		if (top_levels > 0) {
+			spill(bucket);
+			std::vector<cv::Vec3f>().swap(buckets[bucket]);
+			root = build_spilled_subtree(bucket_filename(bucket), bucket_counts[bucket], bucket_origin, bucket_size,
+				top_levels, nodes, points_file, no_of_written_points);
+		} else {
+			root = build_subtree(buckets[bucket], bucket_origin, bucket_size, top_levels, nodes, points_file,
+				no_of_written_points);
+		}
+		if (top_levels > 0) {
+			int parent_side = cells_per_side / 2;
+			int parent = top_node_ids[top_levels - 1][((z / 2) * parent_side + y / 2) * parent_side + x / 2];
+			nodes[parent].children[(x & 1) | ((y & 1) << 1) | ((z & 1) << 2)] = root;
+		}
+	}
+
+	for (int id = 0; id < no_of_top_nodes; ++id) {
+		write_points(top_points[id], nodes[id], points_file, no_of_written_points);
+	}
+	points_file.close();
+	// spill files that failed fail points_file too
+	if (points_file.fail()) {
+		std::cout << "Error writing the points to " << directory << ", disk full?" << std::endl;
+		return false;
+	}
+
+	// raw structs, the index is only ever read back on the machine that built it
+	std::ofstream index_file(directory + "/index.lod", std::ios::binary);
+	index_file.write(PointLOD::MAGIC, sizeof(PointLOD::MAGIC));
+	index_file.write(reinterpret_cast<const char*>(&PointLOD::VERSION), sizeof(PointLOD::VERSION));
+	int no_of_nodes = static_cast<int>(nodes.size());
+	index_file.write(reinterpret_cast<const char*>(&no_of_nodes), sizeof(no_of_nodes));
+	index_file.write(reinterpret_cast<const char*>(&no_of_written_points), sizeof(no_of_written_points));
+	index_file.write(reinterpret_cast<const char*>(&nodes[0]), nodes.size() * sizeof(PointLODNode));
+
+	index_file.close();
+	if (index_file.fail()) {
+		std::cout << "Error writing " << directory << "/index.lod" << std::endl;
+		return false;
+	}
+
+	std::cout << "Built a level of detail octree of " << no_of_written_points << " points in " << no_of_nodes
+		<< " nodes, " << top_levels << " levels above the spill files" << std::endl;
+	return true;
+}
+
+PointLOD::PointLOD() : no_of_points_(0), no_of_cached_points_(0) {
+}
+
+bool PointLOD::open(const std::string& directory) {
+	close();
+
+	std::ifstream index_file(directory + "/index.lod", std::ios::binary);
+	char magic[4];
+	int version = 0;
+	int no_of_nodes = 0;
+	index_file.read(magic, sizeof(magic));
+	index_file.read(reinterpret_cast<char*>(&version), sizeof(version));
+	index_file.read(reinterpret_cast<char*>(&no_of_nodes), sizeof(no_of_nodes));
+	index_file.read(reinterpret_cast<char*>(&no_of_points_), sizeof(no_of_points_));
+	if (!index_file || !std::equal(magic, magic + 4, MAGIC) || version != VERSION || no_of_nodes <= 0) {
+		std::cout << "Not a level of detail octree : " << directory << std::endl;
+		no_of_points_ = 0;
+		return false;
+	}
+
+	nodes_.resize(no_of_nodes);
+	index_file.read(reinterpret_cast<char*>(&nodes_[0]), no_of_nodes * sizeof(PointLODNode));
+	points_file_.open(directory + "/points.bin", std::ios::binary);
+	if (!index_file || !points_file_.is_open()) {
+		std::cout << "Couldn't read the level of detail octree in " << directory << std::endl;
+		nodes_.clear();
+		no_of_points_ = 0;
+		return false;
+	}
+	directory_ = directory;
+	return true;
+}
+
+void PointLOD::close() {
+	nodes_.clear();
+	cache_.clear();
+	cache_order_.clear();
+	no_of_cached_points_ = 0;
+	no_of_points_ = 0;
+	points_file_.close();
+	points_file_.clear();
+}
+
+bool PointLOD::is_open() const {
+	return !nodes_.empty();
+}
+
+const std::vector<PointLODNode>& PointLOD::get_nodes() const {
+	return nodes_;
+}
+
+long long PointLOD::get_no_of_points() const {
+	return no_of_points_;
+}
+
+glm::vec3 PointLOD::get_center() const {
+	if (nodes_.empty()) {
+		return glm::vec3(0.f);
+	}
+	// the root is node 0
+	float half = nodes_[0].size / 2.f;
+	return glm::vec3(nodes_[0].origin[0] + half, nodes_[0].origin[1] + half, nodes_[0].origin[2] + half);
+}
+
+void PointLOD::select_nodes(const glm::mat4& mvp, const glm::vec3& eye, int point_budget, std::vector<int>& selected,
+	float min_projected_size) const {
+	selected.clear();
+	if (nodes_.empty()) {
+		return;
+	}
+
+	// frustum planes straight from the rows of mvp, they face inwards
+	glm::vec4 planes[6];
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; ++i) {
+		rows[i] = glm::vec4(mvp[0][i], mvp[1][i], mvp[2][i], mvp[3][i]);
+	}
+	for (int i = 0; i < 3; ++i) {
+		planes[2 * i] = rows[3] + rows[i];
+		planes[2 * i + 1] = rows[3] - rows[i];
+	}
+
+	auto is_visible = [&] (const PointLODNode& node) {
+		for (auto& plane : planes) {
+			// the corner furthest along the plane normal
+			glm::vec3 corner(node.origin[0] + (plane.x >= 0.f ? node.size : 0.f),
+				node.origin[1] + (plane.y >= 0.f ? node.size : 0.f),
+				node.origin[2] + (plane.z >= 0.f ? node.size : 0.f));
+			if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.f) {
+				return false;
+			}
+		}
+		return true;
+	};
+
+	auto projected_size = [&] (const PointLODNode& node) {
+		float half = node.size / 2.f;
+		glm::vec3 center(node.origin[0] + half, node.origin[1] + half, node.origin[2] + half);
+		float distance = glm::length(center - eye) - half * 1.7320508f;
+		if (distance <= 0.f) {
+			return std::numeric_limits<float>::max();
+		}
+		return node.size / distance;
+	};
+
+	std::priority_queue<std::pair<float, int>> queue;
+	queue.push(std::make_pair(projected_size(nodes_[0]), 0));
+	long long no_of_selected_points = 0;
+	while (!queue.empty()) {
+		float size = queue.top().first;
+		int id = queue.top().second;
+		queue.pop();
+
+		const PointLODNode& node = nodes_[id];
+		if (size < min_projected_size || !is_visible(node)) {
+			continue;
+		}
+		if (no_of_selected_points + node.no_of_points > point_budget) {
+			// something smaller further down the queue may still fit
+			continue;
+		}
+		selected.push_back(id);
+		no_of_selected_points += node.no_of_points;
+
+		for (int c = 0; c < 8; ++c) {
+			if (node.children[c] >= 0) {
+				queue.push(std::make_pair(projected_size(nodes_[node.children[c]]), node.children[c]));
+			}
+		}
+	}
+}
+
+const std::vector<cv::Vec3f>& PointLOD::get_node_points(int node) {
+	auto cached = cache_.find(node);
+	if (cached != cache_.end()) {
+		cache_order_.splice(cache_order_.begin(), cache_order_, cached->second.second);
+		return cached->second.first;
+	}
+
+	const PointLODNode& lod_node = nodes_[node];
+	std::vector<cv::Vec3f> points(lod_node.no_of_points);
+	if (lod_node.no_of_points > 0) {
+		points_file_.clear();
+		points_file_.seekg(lod_node.offset * sizeof(cv::Vec3f));
+		points_file_.read(reinterpret_cast<char*>(&points[0]), points.size() * sizeof(cv::Vec3f));
+	}
+
+	// make room, but never drop what's being asked for
+	no_of_cached_points_ += lod_node.no_of_points;
+	while (no_of_cached_points_ > MAX_CACHED_POINTS && !cache_order_.empty()) {
+		int evicted = cache_order_.back();
+		cache_order_.pop_back();
+		no_of_cached_points_ -= cache_[evicted].first.size();
+		cache_.erase(evicted);
+	}
+
+	cache_order_.push_front(node);
+	auto& entry = cache_[node];
+	entry.first.swap(points);
+	entry.second = cache_order_.begin();
+	return entry.first;
+}
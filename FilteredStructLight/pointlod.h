@@ -0,0 +1,103 @@
+#pragma once
+#include "fsl_common.h"
+#include <fstream>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// where the builder reads a cloud from. read is called again after rewind, the builder goes over the cloud twice
+class PointStream {
+public:
+	virtual ~PointStream() {}
+	virtual void rewind() = 0;
+	// 0 at the end
+	virtual int read(cv::Vec3f* points, int max_no_of_points) = 0;
+};
+
+// raw little endian float x, y, z triples, no header
+class RawPointStream : public PointStream {
+	std::ifstream file_;
+	std::string filename_;
+
+public:
+	explicit RawPointStream(const std::string& filename);
+	bool is_open() const;
+	void rewind() override;
+	int read(cv::Vec3f* points, int max_no_of_points) override;
+};
+
+// a cube of the octree. its points are a subsample of everything under it and aren't repeated in its children, so
+// drawing a node means drawing its ancestors as well and each level down adds detail
+struct PointLODNode {
+	cv::Vec3f origin;
+	float size;
+	int level;
+	// -1 where there's no child. octant bit 0 is x, bit 1 y, bit 2 z
+	int children[8];
+	// into points.bin, in points
+	long long offset;
+	int no_of_points;
+};
+
+// builds the octree of a cloud too big for memory into a directory, index.lod and points.bin. the points are
+// binned once into spill files of at most MAX_POINTS_IN_MEMORY (for evenly spread clouds), and each spill file is
+// built in memory on its own. a spill file that's still too big, where the cloud is dense, is split a level further
+// on disk first. a node keeps the first point in each of its GRID_RESOLUTION^3 cells and passes the
+// rest down, a node with LEAF_CAPACITY points or fewer keeps them all
+class PointLODBuilder {
+public:
+	static const int GRID_RESOLUTION;
+	static const int LEAF_CAPACITY;
+	static const int MAX_LEVEL;
+	static const int MAX_POINTS_IN_MEMORY;
+	static const int MAX_TOP_LEVELS;
+	static const int SPILL_BUFFER_SIZE;
+	static const int READ_SIZE;
+
+	static bool build(PointStream& stream, const std::string& directory);
+
+private:
+	static int build_subtree(std::vector<cv::Vec3f>& points, cv::Vec3f origin, float size, int level,
+		std::vector<PointLODNode>& nodes, std::ofstream& points_file, long long& no_of_written_points);
+	// the same as build_subtree for the no_of_points points in a spill file, which is removed after
+	static int build_spilled_subtree(const std::string& filename, long long no_of_points, cv::Vec3f origin, float size,
+		int level, std::vector<PointLODNode>& nodes, std::ofstream& points_file, long long& no_of_written_points);
+	static int grid_index(const cv::Vec3f& point, const cv::Vec3f& origin, float size);
+	static int octant(const cv::Vec3f& point, const cv::Vec3f& origin, float size);
+};
+
+// an octree built by PointLODBuilder. only the index is read on open, points are read a node at a time and the
+// last MAX_CACHED_POINTS read are kept
+class PointLOD {
+	std::string directory_;
+	std::vector<PointLODNode> nodes_;
+	long long no_of_points_;
+	std::ifstream points_file_;
+
+	// most recently used first
+	std::list<int> cache_order_;
+	std::unordered_map<int, std::pair<std::vector<cv::Vec3f>, std::list<int>::iterator>> cache_;
+	long long no_of_cached_points_;
+
+public:
+	static const char MAGIC[4];
+	static const int VERSION;
+	static const long long MAX_CACHED_POINTS;
+
+	PointLOD();
+	bool open(const std::string& directory);
+	void close();
+	bool is_open() const;
+	const std::vector<PointLODNode>& get_nodes() const;
+	long long get_no_of_points() const;
+	glm::vec3 get_center() const;
+
+	// the nodes to draw from eye with the model view projection mvp, biggest on screen first, up to point_budget
+	// points. nodes outside the frustum and their subtrees are left out, and so are nodes whose size over distance
+	// is under min_projected_size. parents always come before their children
+	void select_nodes(const glm::mat4& mvp, const glm::vec3& eye, int point_budget, std::vector<int>& selected,
+		float min_projected_size = 0.f) const;
+	// reads the node unless it's cached. the reference is good until the next call
+	const std::vector<cv::Vec3f>& get_node_points(int node);
+};
@@ -1,4 +1,5 @@
 #pragma once
+#include <algorithm>
 #include <stdexcept>
 #include <glm/detail/type_vec3.hpp>
 
@@ -21,6 +22,7 @@ namespace mm {
 		int get_grid_height() const;
 		float get_grid_square_length() const;
 		bool create_grid(int width, int height);
+		void fill(T value);
 		bool map_to_grid(const float x, const float y, int& grid_x, int& grid_y) const;
 		bool is_out_of_bounds(const unsigned x, const unsigned y) const;
 	protected:
@@ -166,6 +168,11 @@ bool mm::Quadtree<T>::create_grid(int width, int height) {
 	return true;
 }
 
+template <class T>
+void mm::Quadtree<T>::fill(T value) {
+	std::fill(grid_, grid_ + grid_width_ * grid_height_, value);
+}
+
 template <class T>
 bool mm::Quadtree<T>::map_to_grid(const float x, const float y, int& grid_x, int& grid_y) const  {
 //	glm::vec3 grid_pos_float =  (position / static_cast<float>(grid_cube_length_));
@@ -0,0 +1,453 @@
+#include "rawrecording.h"
+#include <QDir>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <sstream>
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#else
+#include <sys/types.h>
+#include <unistd.h>
+#endif
+
+const char RawRecorder::MAGIC[4] = { 'F', 'S', 'L', 'R' };
+const int RawRecorder::VERSION = 1;
+const int RawRecorder::PREALLOCATED_FRAMES = 4096;
+const int RawRecorder::POOL_BYTES = 256 * 1024 * 1024;
+
+static std::string camera_filename(const std::string& directory, int cam_no, const char* extension) {
+	std::stringstream ss;
+	ss << directory << "/camera" << cam_no << extension;
+	return ss.str();
+}
+
+RawRecorder::RawRecorder(QObject* parent) : QThread(parent), slot_bytes_(0), recording_no_(0), is_recording_(false),
+	is_stopping_(false), no_of_overflowed_frames_(0), no_of_oversized_frames_(0) {
+}
+
+RawRecorder::~RawRecorder() {
+	stop_recording();
+}
+
+bool RawRecorder::resize_file(FILE* file, long long size) {
+	fflush(file);
+#ifdef _WIN32
+	// sets the end of file without writing zeros, unlike _chsize_s
+	HANDLE handle = reinterpret_cast<HANDLE>(_get_osfhandle(_fileno(file)));
+	LARGE_INTEGER position;
+	position.QuadPart = size;
+	return SetFilePointerEx(handle, position, NULL, FILE_BEGIN) && SetEndOfFile(handle);
+#else
+	return ftruncate(fileno(file), size) == 0;
+#endif
+}
+
+bool RawRecorder::seek_file(FILE* file, long long offset) {
+#ifdef _WIN32
+	return _fseeki64(file, offset, SEEK_SET) == 0;
+#else
+	return fseeko(file, offset, SEEK_SET) == 0;
+#endif
+}
+
+bool RawRecorder::start_recording(const std::string& directory, int no_of_cams) {
+	if (isRunning()) {
+		std::cout << "Already recording to " << directory_ << std::endl;
+		return false;
+	}
+
+	// kept between recordings, a 32 bit process may not find the address space a second time
+	if (pool_.size() != (size_t)POOL_BYTES) {
+		try {
+			pool_.resize(POOL_BYTES);
+		} catch (std::bad_alloc&) {
+			std::cout << "Unable to allocate " << POOL_BYTES / (1024 * 1024) << " MB for the recording" << std::endl;
+			return false;
+		}
+	}
+
+	QDir().mkpath(directory.c_str());
+	directory_ = directory;
+	cameras_.clear();
+	cameras_.resize(no_of_cams);
+	for (int i = 0; i < no_of_cams; ++i) {
+		auto& camera = cameras_[i];
+		camera.data_file = fopen(camera_filename(directory, i, ".raw").c_str(), "wb");
+		camera.index_file = fopen(camera_filename(directory, i, ".idx").c_str(), "wb");
+		if (!camera.data_file || !camera.index_file) {
+			std::cout << "Unable to create the recording files in " << directory << std::endl;
+			close_files();
+			return false;
+		}
+		// frames are written straight from the pool, stdio buffering would only add a copy
+		setvbuf(camera.data_file, NULL, _IONBF, 0);
+
+		// a camera that never delivers a frame still leaves a valid, empty recording. the size is filled in on
+		// the first frame
+		std::memset(&camera.header, 0, sizeof(RecordingHeader));
+		std::memcpy(camera.header.magic, MAGIC, sizeof(MAGIC));
+		camera.header.version = VERSION;
+		fwrite(&camera.header, sizeof(RecordingHeader), 1, camera.index_file);
+		fflush(camera.index_file);
+	}
+
+	{
+		QMutexLocker locker(&lock_);
+		is_recording_ = true;
+		is_stopping_ = false;
+		no_of_overflowed_frames_ = 0;
+		no_of_oversized_frames_ = 0;
+		recording_no_++;
+		slot_bytes_ = 0;
+		free_buffers_.clear();
+		queue_.clear();
+	}
+	start();
+	std::cout << "Recording " << no_of_cams << " cameras to " << directory << std::endl;
+	return true;
+}
+
+void RawRecorder::stop_recording() {
+	{
+		QMutexLocker locker(&lock_);
+		if (!is_recording_) {
+			return;
+		}
+		is_recording_ = false;
+		is_stopping_ = true;
+		has_frames_.wakeAll();
+	}
+	wait();
+
+	for (int i = 0; i < cameras_.size(); ++i) {
+		std::cout << "camera " << i << " : " << cameras_[i].no_of_frames << " frames, "
+			<< cameras_[i].no_of_missed_frames << " missed" << std::endl;
+	}
+	std::cout << no_of_overflowed_frames_ << " frames dropped waiting on the disk" << std::endl;
+	if (no_of_oversized_frames_ > 0) {
+		std::cout << no_of_oversized_frames_ << " frames dropped, bigger than the first frame" << std::endl;
+	}
+}
+
+bool RawRecorder::is_recording() {
+	QMutexLocker locker(&lock_);
+	return is_recording_;
+}
+
+void RawRecorder::submit(const FlyCapture2::Image& image, int cam_no) {
+	int frame_bytes = image.GetRows() * image.GetStride();
+	unsigned char* buffer = nullptr;
+	int recording_no = 0;
+	{
+		QMutexLocker locker(&lock_);
+		if (!is_recording_ || cam_no < 0 || cam_no >= cameras_.size() || frame_bytes <= 0) {
+			return;
+		}
+		if (slot_bytes_ == 0) {
+			slot_bytes_ = frame_bytes;
+			for (long long offset = 0; offset + slot_bytes_ <= POOL_BYTES; offset += slot_bytes_) {
+				free_buffers_.push_back(&pool_[offset]);
+			}
+		}
+		if (frame_bytes > slot_bytes_) {
+			no_of_oversized_frames_++;
+			return;
+		}
+		if (free_buffers_.empty()) {
+			no_of_overflowed_frames_++;
+			return;
+		}
+		buffer = free_buffers_.back();
+		free_buffers_.pop_back();
+		recording_no = recording_no_;
+	}
+
+	// copied outside the lock, the writer only takes it to swap the queue
+	QueuedFrame frame;
+	frame.cam_no = cam_no;
+	frame.data = buffer;
+	std::memcpy(frame.header.magic, MAGIC, sizeof(MAGIC));
+	frame.header.version = VERSION;
+	frame.header.rows = image.GetRows();
+	frame.header.cols = image.GetCols();
+	frame.header.stride = image.GetStride();
+	frame.header.pixel_format = image.GetPixelFormat();
+	frame.header.bayer_format = image.GetBayerTileFormat();
+	frame.header.frame_bytes = frame_bytes;
+	std::memcpy(buffer, image.GetData(), frame_bytes);
+
+	auto time_stamp = image.GetTimeStamp();
+	frame.entry.offset = 0;
+	frame.entry.timestamp = (long long)time_stamp.seconds * 1000000 + time_stamp.microSeconds;
+	frame.entry.frame_counter = image.GetMetadata().embeddedFrameCounter;
+	frame.entry.no_of_missed_frames = 0;
+
+	QMutexLocker locker(&lock_);
+	// stopped while the frame was copied, the writer may be gone already. if another recording started since,
+	// the pool has been cut up again and the slot isn't one of its
+	if (!is_recording_ || recording_no != recording_no_) {
+		if (recording_no == recording_no_) {
+			free_buffers_.push_back(buffer);
+		}
+		return;
+	}
+	queue_.push_back(frame);
+	has_frames_.wakeOne();
+}
+
+void RawRecorder::run() {
+	std::vector<QueuedFrame> batch;
+	while (true) {
+		{
+			QMutexLocker locker(&lock_);
+			while (queue_.empty() && !is_stopping_) {
+				has_frames_.wait(&lock_);
+			}
+			if (queue_.empty()) {
+				break;
+			}
+			batch.swap(queue_);
+		}
+
+		for (auto& frame : batch) {
+			write_frame(cameras_[frame.cam_no], frame);
+		}
+		for (auto& camera : cameras_) {
+			flush(camera);
+		}
+
+		QMutexLocker locker(&lock_);
+		for (auto& frame : batch) {
+			free_buffers_.push_back(frame.data);
+		}
+		batch.clear();
+	}
+	close_files();
+}
+
+bool RawRecorder::write_frame(CameraFile& camera, const QueuedFrame& frame) {
+	if (!camera.has_header) {
+		camera.header = frame.header;
+		camera.has_header = true;
+		// nothing follows the placeholder yet, so the index carries on right after it
+		seek_file(camera.index_file, 0);
+		fwrite(&camera.header, sizeof(RecordingHeader), 1, camera.index_file);
+		fflush(camera.index_file);
+	} else if (frame.header.frame_bytes != camera.header.frame_bytes) {
+		std::cout << "Camera " << frame.cam_no << " changed its image size while recording, frame dropped" << std::endl;
+		return false;
+	}
+
+	long long size = camera.no_of_written_bytes + frame.header.frame_bytes;
+	if (size > camera.no_of_allocated_bytes) {
+		camera.no_of_allocated_bytes = std::max(size,
+			camera.no_of_allocated_bytes + (long long)PREALLOCATED_FRAMES * camera.header.frame_bytes);
+		resize_file(camera.data_file, camera.no_of_allocated_bytes);
+		// resizing moves the file position on windows
+		seek_file(camera.data_file, camera.no_of_written_bytes);
+	}
+
+	// straight from the pool slot
+	size_t no_of_bytes = fwrite(frame.data, 1, frame.header.frame_bytes, camera.data_file);
+	if (no_of_bytes != (size_t)frame.header.frame_bytes) {
+		std::cout << "Error writing to " << directory_ << ", frame dropped" << std::endl;
+		seek_file(camera.data_file, camera.no_of_written_bytes);
+		return false;
+	}
+
+	RecordedFrame entry = frame.entry;
+	if (camera.no_of_frames > 0) {
+		// unsigned, so the counter wrapping around still gives the gap
+		unsigned int delta = entry.frame_counter - camera.last_frame_counter;
+		entry.no_of_missed_frames = (delta > 1) ? delta - 1 : 0;
+		camera.no_of_missed_frames += entry.no_of_missed_frames;
+	}
+	camera.last_frame_counter = entry.frame_counter;
+	entry.offset = camera.no_of_written_bytes;
+	camera.no_of_written_bytes += no_of_bytes;
+	camera.pending_entries.push_back(entry);
+	camera.no_of_frames++;
+	return true;
+}
+
+// the index is written after the frames it points at, so a recording cut short is still consistent
+bool RawRecorder::flush(CameraFile& camera) {
+	if (camera.pending_entries.empty()) {
+		return true;
+	}
+	size_t no_of_pending_entries = camera.pending_entries.size();
+	size_t no_of_entries = fwrite(&camera.pending_entries[0], sizeof(RecordedFrame), no_of_pending_entries,
+		camera.index_file);
+	fflush(camera.index_file);
+	camera.pending_entries.clear();
+	return no_of_entries == no_of_pending_entries;
+}
+
+void RawRecorder::close_files() {
+	for (auto& camera : cameras_) {
+		if (camera.data_file) {
+			flush(camera);
+			// the rest of the last preallocation
+			resize_file(camera.data_file, camera.no_of_written_bytes);
+			fclose(camera.data_file);
+			camera.data_file = NULL;
+		}
+		if (camera.index_file) {
+			fclose(camera.index_file);
+			camera.index_file = NULL;
+		}
+	}
+}
+
+bool RawRecordingReader::open(const std::string& directory) {
+	close();
+	for (int i = 0; ; ++i) {
+		std::ifstream index_file(camera_filename(directory, i, ".idx"), std::ios::binary);
+		if (!index_file) {
+			break;
+		}
+
+		// a camera that can't be read stays in as one without frames, so the ones after it keep their numbers
+		std::unique_ptr<CameraRecording> camera(new CameraRecording());
+		std::memset(&camera->header, 0, sizeof(RecordingHeader));
+		RecordingHeader header;
+		index_file.read(reinterpret_cast<char*>(&header), sizeof(RecordingHeader));
+		if (!index_file || !std::equal(header.magic, header.magic + 4, RawRecorder::MAGIC)
+			|| header.version != RawRecorder::VERSION) {
+			std::cout << "Not a recording : " << camera_filename(directory, i, ".idx") << std::endl;
+			cameras_.push_back(std::move(camera));
+			continue;
+		}
+
+		camera->data_file.open(camera_filename(directory, i, ".raw"), std::ios::binary);
+		if (!camera->data_file) {
+			std::cout << "Missing frames : " << camera_filename(directory, i, ".raw") << std::endl;
+			cameras_.push_back(std::move(camera));
+			continue;
+		}
+
+		camera->header = header;
+		RecordedFrame entry;
+		// a header without a size is a camera that recorded nothing
+		while (header.frame_bytes > 0 && index_file.read(reinterpret_cast<char*>(&entry), sizeof(RecordedFrame))) {
+			camera->index.push_back(entry);
+		}
+		cameras_.push_back(std::move(camera));
+	}
+	return std::any_of(cameras_.begin(), cameras_.end(),
+		[](const std::unique_ptr<CameraRecording>& camera) { return !camera->index.empty(); });
+}
+
+void RawRecordingReader::close() {
+	cameras_.clear();
+}
+
+int RawRecordingReader::get_no_of_cams() const {
+	return cameras_.size();
+}
+
+int RawRecordingReader::get_no_of_frames(int cam_no) const {
+	return cameras_[cam_no]->index.size();
+}
+
+const RecordingHeader& RawRecordingReader::get_header(int cam_no) const {
+	return cameras_[cam_no]->header;
+}
+
+const std::vector<RecordedFrame>& RawRecordingReader::get_index(int cam_no) const {
+	return cameras_[cam_no]->index;
+}
+
+bool RawRecordingReader::read_frame(int cam_no, int frame, cv::Mat& raw) {
+	if (cam_no < 0 || cam_no >= cameras_.size() || frame < 0 || frame >= cameras_[cam_no]->index.size()) {
+		return false;
+	}
+	auto& camera = *cameras_[cam_no];
+	auto& header = camera.header;
+	raw.create(header.rows, header.stride, CV_8UC1);
+	camera.data_file.clear();
+	camera.data_file.seekg(camera.index[frame].offset);
+	camera.data_file.read(reinterpret_cast<char*>(raw.data), header.frame_bytes);
+	if (header.stride != header.cols) {
+		raw = raw.colRange(0, header.cols).clone();
+	}
+	return bool(camera.data_file);
+}
+
+bool RawRecordingReader::read_image(int cam_no, int frame, FlyCapture2::Image& image) {
+	if (cam_no < 0 || cam_no >= cameras_.size() || frame < 0 || frame >= cameras_[cam_no]->index.size()) {
+		return false;
+	}
+	auto& camera = *cameras_[cam_no];
+	auto& header = camera.header;
+	buffer_.resize(header.frame_bytes);
+	camera.data_file.clear();
+	camera.data_file.seekg(camera.index[frame].offset);
+	camera.data_file.read(reinterpret_cast<char*>(&buffer_[0]), header.frame_bytes);
+	if (!camera.data_file) {
+		return false;
+	}
+	image.SetDimensions(header.rows, header.cols, header.stride, FlyCapture2::PixelFormat(header.pixel_format),
+		FlyCapture2::BayerTileFormat(header.bayer_format));
+	image.SetData(&buffer_[0], header.frame_bytes);
+	return true;
+}
+
+RawRecordingReplay::RawRecordingReplay(QObject* parent) : QThread(parent), is_realtime_(true),
+	is_shutting_down_(false) {
+}
+
+RawRecordingReplay::~RawRecordingReplay() {
+	shutdown();
+	wait();
+}
+
+bool RawRecordingReplay::open(const std::string& directory, bool realtime) {
+	if (isRunning()) {
+		return false;
+	}
+	is_realtime_ = realtime;
+	return reader_.open(directory);
+}
+
+int RawRecordingReplay::get_no_of_cams() const {
+	return reader_.get_no_of_cams();
+}
+
+void RawRecordingReplay::shutdown() {
+	is_shutting_down_ = true;
+}
+
+void RawRecordingReplay::run() {
+	is_shutting_down_ = false;
+	// cameras that recorded nothing are left out, they'd stop the replay before it started
+	int no_of_frames = 0;
+	int timing_cam = -1;
+	for (int i = 0; i < reader_.get_no_of_cams(); ++i) {
+		if (reader_.get_no_of_frames(i) == 0) {
+			continue;
+		}
+		no_of_frames = (timing_cam < 0) ? reader_.get_no_of_frames(i) : std::min(no_of_frames, reader_.get_no_of_frames(i));
+		if (timing_cam < 0) {
+			timing_cam = i;
+		}
+	}
+
+	FlyCapture2::Image image;
+	for (int frame = 0; frame < no_of_frames && !is_shutting_down_; ++frame) {
+		if (is_realtime_ && frame > 0) {
+			auto& index = reader_.get_index(timing_cam);
+			long long delay = index[frame].timestamp - index[frame - 1].timestamp;
+			// a second at most, in case the clock jumped
+			QThread::usleep(std::max(0LL, std::min(delay, 1000000LL)));
+		}
+		for (int cam_no = 0; cam_no < reader_.get_no_of_cams(); ++cam_no) {
+			if (reader_.read_image(cam_no, frame, image)) {
+				emit image_ready(image, cam_no);
+			}
+		}
+	}
+}
@@ -0,0 +1,150 @@
+#pragma once
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+#include <opencv2/opencv.hpp>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "FlyCapture2.h"
+
+// start of camera<n>.idx, followed by one RecordedFrame per frame in camera<n>.raw
+struct RecordingHeader {
+	char magic[4];
+	int version;
+	int rows;
+	int cols;
+	int stride;
+	int pixel_format;
+	int bayer_format;
+	int frame_bytes;
+};
+
+struct RecordedFrame {
+	// into camera<n>.raw, in bytes
+	long long offset;
+	// microseconds
+	long long timestamp;
+	unsigned int frame_counter;
+	// frames between this one and the one before it that aren't in the recording, dropped by the camera, the
+	// bus or the recorder
+	unsigned int no_of_missed_frames;
+};
+
+// raw frames of every camera to one large file per camera, with an index next to it. the capture thread only
+// copies a frame into a slot of a pool of POOL_BYTES allocated when recording starts, this thread writes the
+// slots that have queued up since its last pass straight to the files, and the index entries in one write per
+// camera. data files grow PREALLOCATED_FRAMES at a time and are trimmed on stop. when every slot is waiting on
+// the disk, frames are dropped rather than stalling capture, capture never allocates
+class RawRecorder : public QThread {
+	struct QueuedFrame {
+		int cam_no;
+		unsigned char* data;
+		RecordingHeader header;
+		RecordedFrame entry;
+	};
+
+	struct CameraFile {
+		FILE* data_file;
+		FILE* index_file;
+		RecordingHeader header;
+		bool has_header;
+		long long no_of_written_bytes;
+		long long no_of_allocated_bytes;
+		long long no_of_frames;
+		long long no_of_missed_frames;
+		unsigned int last_frame_counter;
+		std::vector<RecordedFrame> pending_entries;
+
+		CameraFile() : data_file(NULL), index_file(NULL), has_header(false), no_of_written_bytes(0),
+			no_of_allocated_bytes(0), no_of_frames(0), no_of_missed_frames(0), last_frame_counter(0) {}
+	};
+
+	QMutex lock_;
+	QWaitCondition has_frames_;
+	std::vector<QueuedFrame> queue_;
+	std::vector<unsigned char> pool_;
+	// the pool is cut into slots the size of the first frame of a recording
+	int slot_bytes_;
+	std::vector<unsigned char*> free_buffers_;
+	// a slot taken in one recording isn't handed back into the next one
+	int recording_no_;
+	bool is_recording_;
+	bool is_stopping_;
+	long long no_of_overflowed_frames_;
+	long long no_of_oversized_frames_;
+
+	std::string directory_;
+	std::vector<CameraFile> cameras_;
+
+	bool write_frame(CameraFile& camera, const QueuedFrame& frame);
+	bool flush(CameraFile& camera);
+	void close_files();
+
+public:
+	static const char MAGIC[4];
+	static const int VERSION;
+	static const int PREALLOCATED_FRAMES;
+	static const int POOL_BYTES;
+
+	RawRecorder(QObject* parent = NULL);
+	~RawRecorder();
+	bool start_recording(const std::string& directory, int no_of_cams);
+	// returns once everything queued is on disk
+	void stop_recording();
+	bool is_recording();
+	// called from the capture thread, image can be reused right after
+	void submit(const FlyCapture2::Image& image, int cam_no);
+	void run();
+
+	static bool resize_file(FILE* file, long long size);
+	static bool seek_file(FILE* file, long long offset);
+};
+
+// reads what RawRecorder wrote, a frame at a time
+class RawRecordingReader {
+	struct CameraRecording {
+		RecordingHeader header;
+		std::vector<RecordedFrame> index;
+		std::ifstream data_file;
+	};
+
+	std::vector<std::unique_ptr<CameraRecording>> cameras_;
+	std::vector<unsigned char> buffer_;
+
+public:
+	// camera0 onwards until one is missing. cameras without frames are kept, with an empty index
+	bool open(const std::string& directory);
+	void close();
+	int get_no_of_cams() const;
+	int get_no_of_frames(int cam_no) const;
+	const RecordingHeader& get_header(int cam_no) const;
+	const std::vector<RecordedFrame>& get_index(int cam_no) const;
+	// the raw bayer frame, rows x cols
+	bool read_frame(int cam_no, int frame, cv::Mat& raw);
+	// the frame as the camera handed it over, without the embedded metadata
+	bool read_image(int cam_no, int frame, FlyCapture2::Image& image);
+};
+
+// plays a recording back through the same signal as CamThread, frame by frame across the cameras. with
+// realtime on, frames are spaced by the timestamps of the first camera that has any
+class RawRecordingReplay : public QThread {
+	Q_OBJECT
+
+	RawRecordingReader reader_;
+	bool is_realtime_;
+	bool is_shutting_down_;
+
+public:
+	RawRecordingReplay(QObject* parent = NULL);
+	~RawRecordingReplay();
+	bool open(const std::string& directory, bool realtime = true);
+	int get_no_of_cams() const;
+	void shutdown();
+	void run();
+
+signals:
+	void image_ready(const FlyCapture2::Image& img, int cam_no);
+};
@@ -32,6 +32,17 @@ typedef std::chrono::milliseconds milliseconds;
 std::string Reconstruct3D::calib_dirname_ = "calibration";
 std::string Reconstruct3D::camera_subdir_prefix_ = "camera_";
 std::string Reconstruct3D::recon_dirname_ = "reconstruction";
+// pixels at or below this are background, before rectifying
+const int Reconstruct3D::STRIPE_THRESHOLD = 50;
+
+cv::Mat StripeRows::lit_pixels_in_row(int row) {
+	int begin = row_offsets[row];
+	int end = row_offsets[row + 1];
+	if (begin == end) {
+		return cv::Mat();
+	}
+	return cv::Mat(end - begin, 1, CV_32SC2, &lit_pixels[begin]);
+}
 
 Reconstruct3D::Reconstruct3D(int no_of_cams, QObject* parent) 
 	: no_of_cams_(no_of_cams), QObject(parent), started_capture_(false)
@@ -682,28 +693,97 @@ void convert_2_left_camera_color(const cv::Mat& img, const cv::Mat& inter_camera
 
 void Reconstruct3D::pre_process_img(cv::Mat& input, cv::Mat& output, bool is_right) {
 	cv::Mat thresholded;
-	cv::threshold(input, thresholded, 50, 255, CV_THRESH_TOZERO);
+	cv::threshold(input, thresholded, STRIPE_THRESHOLD, 255, CV_THRESH_TOZERO);
 	remap(thresholded, output, rmap[is_right][0], rmap[is_right][1], CV_INTER_CUBIC);
 }
 
-void Reconstruct3D::init_imgs(CameraImgMap& camera_img_map, int cam, bool is_right) {
+void Reconstruct3D::rectify_stripe_img(const cv::Mat& input, bool is_right, cv::Mat& output, StripeRows& stripe_rows) const {
+	assert(input.type() == CV_8UC1);
+
+	// create_rectification_map makes CV_16SC2 maps, integer source pixel in the first and the 5 bit x and y
+	// fractions as fy * 32 + fx in the second, so the weights are integers summing to 32 * 32
+	const cv::Mat& map_xy = rmap[is_right][0];
+	const cv::Mat& map_fraction = rmap[is_right][1];
+	const int fraction_bits = 5;
+	const int fraction_size = 1 << fraction_bits;
+	const int fraction_mask = fraction_size - 1;
+
+	output.create(map_xy.rows, map_xy.cols, CV_8UC1);
+	stripe_rows.row_sums.assign(output.rows, 0);
+	stripe_rows.row_offsets.resize(output.rows + 1);
+	stripe_rows.lit_pixels.clear();
+
+	const int max_x = input.cols - 1;
+	const int max_y = input.rows - 1;
+
+	for (int y = 0; y < output.rows; ++y) {
+		const cv::Vec2s* xy_row = map_xy.ptr<cv::Vec2s>(y);
+		const unsigned short* fraction_row = map_fraction.ptr<unsigned short>(y);
+		unsigned char* output_row = output.ptr<unsigned char>(y);
+		int row_sum = 0;
+		stripe_rows.row_offsets[y] = stripe_rows.lit_pixels.size();
+
+		for (int x = 0; x < output.cols; ++x) {
+			int source_x = xy_row[x][0];
+			int source_y = xy_row[x][1];
+			int fx = fraction_row[x] & fraction_mask;
+			int fy = fraction_row[x] >> fraction_bits;
+
+			// taps outside the image are 0 like remap's constant border, and each tap is thresholded first
+			// like cv::threshold before remap
+			int taps[4] = { 0, 0, 0, 0 };
+			for (int k = 0; k < 4; ++k) {
+				int tap_x = source_x + (k & 1);
+				int tap_y = source_y + (k >> 1);
+				if (tap_x >= 0 && tap_x <= max_x && tap_y >= 0 && tap_y <= max_y) {
+					int tap = input.ptr<unsigned char>(tap_y)[tap_x];
+					taps[k] = (tap > STRIPE_THRESHOLD) ? tap : 0;
+				}
+			}
+
+			int value = ((fraction_size - fx) * (fraction_size - fy) * taps[0] + fx * (fraction_size - fy) * taps[1]
+				+ (fraction_size - fx) * fy * taps[2] + fx * fy * taps[3] + (fraction_size * fraction_size / 2))
+				>> (2 * fraction_bits);
+
+			output_row[x] = static_cast<unsigned char>(value);
+			if (value != 0) {
+				row_sum += value;
+				stripe_rows.lit_pixels.push_back(cv::Vec2i(x, y));
+			}
+		}
+		stripe_rows.row_sums[y] = row_sum;
+	}
+	stripe_rows.row_offsets[output.rows] = stripe_rows.lit_pixels.size();
+}
+
+void Reconstruct3D::init_imgs(CameraImgMap& camera_img_map, int cam, bool is_right, std::vector<StripeRows>* stripe_rows) {
 
 	assert(cam < no_of_cams_);
 	//assert(camera_img_map.size() == no_of_cams_);
 	assert(camera_img_map.find(cam) != camera_img_map.end());
 
 	auto& camera_imgs = camera_img_map[cam];
+	if (stripe_rows) {
+		stripe_rows->resize(camera_imgs.size());
+	}
 	std::string img_name = "remap_" + std::to_string(cam) + ".png";
 	for (int i = 0; i < camera_imgs.size(); i++) {
 		cv::Mat& img = camera_imgs[i];
 		cv::Mat rImg;
-		pre_process_img(img, rImg, is_right);
+		if (stripe_rows) {
+			rectify_stripe_img(img, is_right, rImg, (*stripe_rows)[i]);
+		} else {
+			pre_process_img(img, rImg, is_right);
+		}
 		camera_imgs[i] = rImg;
 
+#ifdef DEBUG
 		imwrite(img_name, rImg);
-		cv::cvtColor(rImg, rImg, CV_GRAY2BGR);
-		cv::rectangle(rImg, validRoi[is_right], cv::Scalar(0, 0, 255));
-		imshow(img_name, rImg);
+		cv::Mat debug_img;
+		cv::cvtColor(rImg, debug_img, CV_GRAY2BGR);
+		cv::rectangle(debug_img, validRoi[is_right], cv::Scalar(0, 0, 255));
+		imshow(img_name, debug_img);
+#endif
 	}
 }
 
@@ -829,12 +909,15 @@ void Reconstruct3D::compute_correlation_using_gaussian(IPts& img_pts1, IPts& img
 													   CameraImgMap& camera_img_map, std::vector<std::pair<int, int>> camera_pairs,
 													   Intensities& left_intensities, Intensities& right_intensities) {
 
-    init_imgs(camera_img_map, camera_pairs[0].first, false);
-    init_imgs(camera_img_map, camera_pairs[0].second, true);
+	std::vector<StripeRows> left_stripe_rows;
+	std::vector<StripeRows> right_stripe_rows;
+    init_imgs(camera_img_map, camera_pairs[0].first, false, &left_stripe_rows);
+    init_imgs(camera_img_map, camera_pairs[0].second, true, &right_stripe_rows);
 
 	typedef std::unordered_map<int, int> GaussMidPoints;
 
-	correpond_with_gaussians(camera_img_map, camera_pairs[0].first, camera_pairs[0].second, img_pts1, img_pts2, left_intensities, right_intensities);
+	correpond_with_gaussians(camera_img_map, camera_pairs[0].first, camera_pairs[0].second, left_stripe_rows, right_stripe_rows,
+		img_pts1, img_pts2, left_intensities, right_intensities);
     write_file("recon.cp", img_pts1, img_pts2);
 }
 
@@ -1069,6 +1152,100 @@ void Reconstruct3D::remesh_with_smoothing(WPts& world_pts) {
 	
 }
 
+const int Reconstruct3D::STRIPE_SMOOTHING_RADIUS = 2;
+
+void Reconstruct3D::stripe_smooth(WPts& world_pts, const std::vector<std::vector<int>>& rows, WPts* normals) const {
+	assert(world_pts.size() == rows.size());
+	const int no_of_imgs = world_pts.size();
+	const int radius = STRIPE_SMOOTHING_RADIUS;
+
+	// index of the point on each row of each image, -1 where the stripe has no point
+	int max_row = 0;
+	for (auto& img_rows : rows) {
+		for (auto row : img_rows) {
+			max_row = std::max(max_row, row);
+		}
+	}
+	std::vector<std::vector<int>> row_index(no_of_imgs, std::vector<int>(max_row + 1, -1));
+	for (int img = 0; img < no_of_imgs; ++img) {
+		for (int i = 0; i < rows[img].size(); ++i) {
+			row_index[img][rows[img][i]] = i;
+		}
+	}
+
+	// smoothed from the original points, not the ones already moved
+	WPts smoothed_pts = world_pts;
+	if (normals) {
+		normals->resize(no_of_imgs);
+	}
+
+#pragma omp parallel for schedule(dynamic)
+	for (int img = 0; img < no_of_imgs; ++img) {
+		if (normals) {
+			(*normals)[img].assign(world_pts[img].size(), cv::Vec3d(0.0, 0.0, 0.0));
+		}
+		for (int i = 0; i < world_pts[img].size(); ++i) {
+			int row = rows[img][i];
+			cv::Vec3d centroid(0.0, 0.0, 0.0);
+			int no_of_neighbours = 0;
+			for (int neighbour_img = std::max(img - radius, 0); neighbour_img <= std::min(img + radius, no_of_imgs - 1); ++neighbour_img) {
+				for (int neighbour_row = std::max(row - radius, 0); neighbour_row <= std::min(row + radius, max_row); ++neighbour_row) {
+					int index = row_index[neighbour_img][neighbour_row];
+					if (index >= 0) {
+						centroid += world_pts[neighbour_img][index];
+						++no_of_neighbours;
+					}
+				}
+			}
+			centroid /= static_cast<double>(no_of_neighbours);
+
+			// tangents along the stripe and across stripes, between the furthest neighbours either side, or the
+			// point itself on a side without any
+			const cv::Vec3d& point = world_pts[img][i];
+			cv::Vec3d along_ends[2] = { point, point };
+			cv::Vec3d across_ends[2] = { point, point };
+			bool along_found = false;
+			bool across_found = false;
+			for (int side = 0; side < 2; ++side) {
+				int direction = side ? 1 : -1;
+				for (int k = radius; k > 0; --k) {
+					int neighbour_row = row + direction * k;
+					if (neighbour_row >= 0 && neighbour_row <= max_row && row_index[img][neighbour_row] >= 0) {
+						along_ends[side] = world_pts[img][row_index[img][neighbour_row]];
+						along_found = true;
+						break;
+					}
+				}
+				for (int k = radius; k > 0; --k) {
+					int neighbour_img = img + direction * k;
+					if (neighbour_img >= 0 && neighbour_img < no_of_imgs && row_index[neighbour_img][row] >= 0) {
+						across_ends[side] = world_pts[neighbour_img][row_index[neighbour_img][row]];
+						across_found = true;
+						break;
+					}
+				}
+			}
+			if (!along_found || !across_found) {
+				continue;
+			}
+
+			cv::Vec3d normal = (along_ends[1] - along_ends[0]).cross(across_ends[1] - across_ends[0]);
+			double length = cv::norm(normal);
+			if (length < 1e-12) {
+				continue;
+			}
+			normal /= length;
+
+			smoothed_pts[img][i] = point - (point - centroid).dot(normal) * normal;
+			if (normals) {
+				(*normals)[img][i] = normal;
+			}
+		}
+	}
+
+	world_pts.swap(smoothed_pts);
+}
+
 void Reconstruct3D::bilateral_smooth(WPts& world_pts, const Intensities& left_intensities) {
 		
 	pcl::PointCloud<pcl::PointXYZI>::Ptr cloud (new pcl::PointCloud<pcl::PointXYZI> ());
@@ -1169,6 +1346,7 @@ void estimate_plane(const cv::Vec3d& p, const cv::Vec3d& q, const cv::Vec3d& r,
 }
 
 void Reconstruct3D::correpond_with_gaussians(CameraImgMap& camera_img_map, int left_cam_no, int right_cam_no, 
+											 std::vector<StripeRows>& left_stripe_rows, std::vector<StripeRows>& right_stripe_rows,
 											 IPts& img_pts1, IPts& img_pts2, Intensities& left_intensities, Intensities& right_intensities) {
 
 	auto& left_imgs = camera_img_map[left_cam_no];
@@ -1186,19 +1364,20 @@ void Reconstruct3D::correpond_with_gaussians(CameraImgMap& camera_img_map, int l
 
 	for (auto img = 0u; img < left_imgs.size(); ++img) {
 		cv::Mat& left_img = left_imgs[img];
-		cv::Mat left_row_sum;
-		cv::reduce(left_img, left_row_sum, 1, CV_REDUCE_SUM, CV_32S);
+		// row sums and lit pixels came out of rectifying
+		auto& left_rows = left_stripe_rows[img];
 
 		cv::Mat& right_img = right_imgs[img];
-		cv::Mat right_row_sum;
-		cv::reduce(right_img, right_row_sum, 1, CV_REDUCE_SUM, CV_32S);
+		auto& right_rows = right_stripe_rows[img];
 
+#ifdef DEBUG
 		// debug data
 		cv::Mat left_corr_img;
 		cv::cvtColor(left_img, left_corr_img, CV_GRAY2BGR);
 
 		cv::Mat right_corr_img;
 		cv::cvtColor(right_img, right_corr_img, CV_GRAY2BGR);
+#endif
 
 		const int image_width = left_img.cols;
 		const int width_threshold_percentage = 10;
@@ -1213,17 +1392,15 @@ void Reconstruct3D::correpond_with_gaussians(CameraImgMap& camera_img_map, int l
 		std::vector<cv::Point2d> temp_left_points;
 		std::vector<cv::Point2d> temp_right_points;
 
-		for (auto row = 1u; row < left_row_sum.rows - 1; ++row) {
-			if ((left_row_sum.at<int>(row, 0) >= threshold)
-				&& (right_row_sum.at<int>(row, 0) >= threshold)) {
+		for (auto row = 1u; row < left_rows.row_sums.size() - 1; ++row) {
+			if ((left_rows.row_sums[row] >= threshold)
+				&& (right_rows.row_sums[row] >= threshold)) {
 
 					double left_mid_point;
-					cv::Mat left_non_zero_points;
-					cv::findNonZero(left_img.row(row), left_non_zero_points);
+					cv::Mat left_non_zero_points = left_rows.lit_pixels_in_row(row);
 
 					double right_mid_point;
-					cv::Mat right_non_zero_points;
-					cv::findNonZero(right_img.row(row), right_non_zero_points);
+					cv::Mat right_non_zero_points = right_rows.lit_pixels_in_row(row);
 
 					// let's do some basic noise filtering
 					bool found_anomaly = false;
@@ -1411,20 +1588,24 @@ void Reconstruct3D::correpond_with_gaussians(CameraImgMap& camera_img_map, int l
 			left_intensities[img].push_back(left_intensity);
 			right_intensities[img].push_back(right_intensity);
 
+#ifdef DEBUG
 			left_corr_img.at<cv::Vec3b>(row, left_mid_point) = cv::Vec3b(0, 0, 255);
 			right_corr_img.at<cv::Vec3b>(row, right_mid_point) = cv::Vec3b(0, 0, 255);
+#endif
 		}
 		}
 
+#ifdef DEBUG
 		cv::imshow("left_gauss_fit", left_corr_img);
 		cv::imshow("right_gauss_fit", right_corr_img);
 		cv::imwrite("left_gauss_fit.png", left_corr_img);
 		cv::imwrite("right_gauss_fit.png", right_corr_img);
+#endif
 	}
 }
 
 void Reconstruct3D::triangulate_pts(const WPts& world_pnts, WPt& triangles, 
-	IPt& texture_coords, cv::Mat& remapped_img) {
+	IPt& texture_coords, cv::Mat& remapped_img, const IPts* left_projections) {
 
 
 	const cv::Mat proj = P1;
@@ -1442,19 +1623,20 @@ void Reconstruct3D::triangulate_pts(const WPts& world_pnts, WPt& triangles,
 		}
 	}
 
-	std::vector<cv::Point2f> projected_pts;
-	for (auto i = 0u; i < world_pt_single_array.size(); ++i) {
-			// project point
-			cv::Mat world_pnt(4, 1, CV_64F);
-			for (int x = 0; x < 3; ++x) {
-				world_pnt.at<double>(x, 0) = (double)world_pt_single_array[i][x];
-			}
-			world_pnt.at<double>(3, 0) = 1.0;
-			cv::Mat projected_pt = proj * world_pnt;
-			double z = projected_pt.at<double>(2, 0);
-			projected_pts.push_back(cv::Point2f(projected_pt.at<double>(0, 0) / z, projected_pt.at<double>(1, 0) / z));
+	IPt projected_pts_single_array;
+	if (left_projections) {
+		for (auto img = 0u; img < left_projections->size(); ++img) {
+			projected_pts_single_array.insert(projected_pts_single_array.end(), (*left_projections)[img].begin(),
+				(*left_projections)[img].end());
+		}
+	} else if (!world_pt_single_array.empty()) {
+		projected_pts_single_array.resize(world_pt_single_array.size());
+		project_points(&world_pt_single_array[0], static_cast<int>(world_pt_single_array.size()), proj,
+			&projected_pts_single_array[0]);
 	}
 
+	std::vector<cv::Point2f> projected_pts(projected_pts_single_array.begin(), projected_pts_single_array.end());
+
 	assert(world_pt_single_array.size() == projected_pts.size());
 
 
@@ -1569,42 +1751,44 @@ void Reconstruct3D::alter_img_for_projection(const cv::Mat& img, cv::Mat& remapp
 
 void Reconstruct3D::smooth_points(WPts& world_pts, const Intensities& left_intensities, const Intensities& right_intensities) {
 
-//	for (auto img = 0u; img < world_pts.size(); ++img) {
-//		optimize_smoothness(world_pts[img], left_intensities[img], right_intensities[img]);
-//	}
-
-	// simple laplacian
-
-	for (auto iter = 0u; iter < 1000000; ++iter ) {
-		for (auto img = 0u; img < world_pts.size(); ++img) {
-			//		optimize_smoothness(world_pts[img], left_intensities[img], right_intensities[img]);
-			double lambda = 0.1;
-			if (world_pts[img].size() >= 3) {
-				for (auto i = 1; i < world_pts[img].size() - 1; ++i) {
-					double old_z = world_pts[img][i][2];
-					double top_z = world_pts[img][i-1][2];
-					double bottom_z = world_pts[img][i+1][2];
-					double length_top_old_z = std::abs(top_z - old_z);
-					double length_bottom_old_z = std::abs(bottom_z - old_z);
+	// stripes don't share points, so each one is its own tridiagonal solve
+#pragma omp parallel for schedule(dynamic)
+	for (int img = 0; img < static_cast<int>(world_pts.size()); ++img) {
+		optimize_smoothness(world_pts[img], left_intensities[img], right_intensities[img]);
+	}
 
-					if (length_top_old_z < 1e-6 || length_bottom_old_z < 1e-6) {
-						// skip this point, nothing to smooth
-						continue;
-					}
+//	// simple laplacian
+
+//	for (auto iter = 0u; iter < 1000000; ++iter ) {
+//		for (auto img = 0u; img < world_pts.size(); ++img) {
+//			//		optimize_smoothness(world_pts[img], left_intensities[img], right_intensities[img]);
+//			double lambda = 0.1;
+//			if (world_pts[img].size() >= 3) {
+//				for (auto i = 1; i < world_pts[img].size() - 1; ++i) {
+//					double old_z = world_pts[img][i][2];
+//					double top_z = world_pts[img][i-1][2];
+//					double bottom_z = world_pts[img][i+1][2];
+//					double length_top_old_z = std::abs(top_z - old_z);
+//					double length_bottom_old_z = std::abs(bottom_z - old_z);
+
+//					if (length_top_old_z < 1e-6 || length_bottom_old_z < 1e-6) {
+//						// skip this point, nothing to smooth
+//						continue;
+//					}
 
-					double weights_top = 1.0 / length_top_old_z;
-					double weights_bottom = 1.0 / length_bottom_old_z;
-					double total_weights = weights_top + weights_bottom;
-					double laplacian = ((weights_top * top_z + weights_bottom * bottom_z) / total_weights) - old_z;
-					double new_z = old_z + lambda * (laplacian);
-					if (new_z > 1e5 || new_z < -1e5) {
-						std::cout << new_z << std::endl;
-					}
-					world_pts[img][i][2] = new_z;
-				}
-			}
-		}
-	}
+//					double weights_top = 1.0 / length_top_old_z;
+//					double weights_bottom = 1.0 / length_bottom_old_z;
+//					double total_weights = weights_top + weights_bottom;
+//					double laplacian = ((weights_top * top_z + weights_bottom * bottom_z) / total_weights) - old_z;
+//					double new_z = old_z + lambda * (laplacian);
+//					if (new_z > 1e5 || new_z < -1e5) {
+//						std::cout << new_z << std::endl;
+//					}
+//					world_pts[img][i][2] = new_z;
+//				}
+//			}
+//		}
+//	}
 #ifdef DEBUG
 		for (auto img = 0u; img < world_pts.size(); ++img) {
 			double z_diff_avg = 0.0;
@@ -1660,15 +1844,44 @@ cv::Vec3d Reconstruct3D::calculate_3D_point(const cv::Vec2d& left_image_point, c
 }
 
 
-void  Reconstruct3D::correct_img_coordinates(IPts& img_pts1, IPts& img_pts2) {
-	// read file
-	cv::Mat proj1 = P1;
-	cv::Mat proj2 = P2;
+cv::Mat Reconstruct3D::fundamental_from_projections(const cv::Mat& proj1, const cv::Mat& proj2) const {
+	cv::Mat center;
+	cv::SVD::solveZ(proj1, center);
 
-	for (auto img = 0u; img < img_pts1.size(); ++img) {
-		for (auto i = 0u; i < img_pts1[img].size(); ++i) {
-			optimize_image_coordinates(img_pts1[img][i], img_pts2[img][i], this, proj1, proj2);
+	cv::Mat epipole = proj2 * center;
+	cv::Mat epipole_cross = (cv::Mat_<double>(3, 3) <<
+		0., -epipole.at<double>(2), epipole.at<double>(1),
+		epipole.at<double>(2), 0., -epipole.at<double>(0),
+		-epipole.at<double>(1), epipole.at<double>(0), 0.);
+
+	cv::Mat proj1_inv;
+	cv::invert(proj1, proj1_inv, cv::DECOMP_SVD);
+
+	cv::Mat fundamental = epipole_cross * proj2 * proj1_inv;
+	return fundamental / cv::norm(fundamental);
+}
+
+void  Reconstruct3D::correct_img_coordinates(IPts& img_pts1, IPts& img_pts2) const {
+	// the old per point lm (optimize_image_coordinates) only moved a shared row and went through globals.
+	// for the rectified P1, P2 F is [0 0 0; 0 0 -1; 0 1 0] and this comes out the same as meeting at the mean row,
+	// but closed form
+	cv::Mat fundamental = fundamental_from_projections(P1, P2);
+
+#pragma omp parallel for schedule(dynamic)
+	for (int img = 0; img < static_cast<int>(img_pts1.size()); ++img) {
+		int no_of_pts = std::min(img_pts1[img].size(), img_pts2[img].size());
+		if (no_of_pts == 0) {
+			continue;
 		}
+
+		cv::Mat left(1, no_of_pts, CV_64FC2, &img_pts1[img][0]);
+		cv::Mat right(1, no_of_pts, CV_64FC2, &img_pts2[img][0]);
+		cv::Mat corrected_left, corrected_right;
+		cv::correctMatches(fundamental, left, right, corrected_left, corrected_right);
+
+		// written back through the headers, so straight into the vectors
+		corrected_left.convertTo(left, CV_64FC2);
+		corrected_right.convertTo(right, CV_64FC2);
 	}
 }
 
@@ -1727,93 +1940,137 @@ void Reconstruct3D::recon_obj(const IPts& img_pts1, const IPts& img_pts2, WPts&
 }
 
 cv::Point2d Reconstruct3D::project_point(const cv::Vec3d& world_pt, const cv::Mat& projection_matrix) const {
-	cv::Mat world_pnt_mtx(4, 1, CV_64F);
-	for (int x = 0; x < 3; ++x) {
-		world_pnt_mtx.at<double>(x, 0) = (double)world_pt[x];
+	cv::Vec2d projected_point;
+	project_points(&world_pt, 1, projection_matrix, &projected_point);
+
+	return cv::Point2d(projected_point[0], projected_point[1]);
+}
+
+void Reconstruct3D::project_points(const cv::Vec3d* world_pts, int no_of_pts, const cv::Mat& projection_matrix,
+	cv::Vec2d* projected_pts) {
+	// plain doubles, the 4x1 mat per point cost more than the multiply
+	double p[12];
+	for (int row = 0; row < 3; ++row) {
+		for (int col = 0; col < 4; ++col) {
+			p[row * 4 + col] = projection_matrix.at<double>(row, col);
+		}
 	}
-	world_pnt_mtx.at<double>(3, 0) = 1.0;
 
-	cv::Mat projected_matrix = projection_matrix * world_pnt_mtx;
-	double z = projected_matrix.at<double>(2, 0);
+	// only worth the threads on a whole scan, inside a per image loop the region isn't nested
+#pragma omp parallel for if (no_of_pts > 4096)
+	for (int i = 0; i < no_of_pts; ++i) {
+		const cv::Vec3d& pt = world_pts[i];
+		double x = p[0] * pt[0] + p[1] * pt[1] + p[2] * pt[2] + p[3];
+		double y = p[4] * pt[0] + p[5] * pt[1] + p[6] * pt[2] + p[7];
+		double z = p[8] * pt[0] + p[9] * pt[1] + p[10] * pt[2] + p[11];
+		projected_pts[i] = cv::Vec2d(x / z, y / z);
+	}
+}
 
-	cv::Point2d projected_point(projected_matrix.at<double>(0, 0) / z, projected_matrix.at<double>(1, 0) / z);
+bool Reconstruct3D::sample_bilinear(const cv::Mat& img, const cv::Vec2d& img_pt, double& value) {
+	double x = img_pt[0];
+	double y = img_pt[1];
+	if (!(x >= 0 && x < img.cols && y >= 0 && y < img.rows)) {
+		return false;
+	}
 
-	return projected_point;
+	int x0 = static_cast<int>(x);
+	int y0 = static_cast<int>(y);
+	int x1 = std::min(x0 + 1, img.cols - 1);
+	int y1 = std::min(y0 + 1, img.rows - 1);
+	double fx = x - x0;
+	double fy = y - y0;
+
+	const unsigned char* top = img.ptr<unsigned char>(y0);
+	const unsigned char* bottom = img.ptr<unsigned char>(y1);
+	value = (1. - fy) * ((1. - fx) * top[x0] + fx * top[x1]) + fy * ((1. - fx) * bottom[x0] + fx * bottom[x1]);
+	return true;
 }
 
 cv::RNG rng(255);
 
 void Reconstruct3D::project_points_on_to_img(WPts& world_pts, WPts& world_point_colors_all,
-                                             cv::Mat& left_img, cv::Mat& right_img, IPts& img_pts1, IPts& img_pts2) {
-
-	cv::Mat proj1 = P1;
-	cv::Mat proj2 = P2;
+                                             cv::Mat& left_img, cv::Mat& right_img, IPts& img_pts1, IPts& img_pts2,
+                                             IPts* left_projections) {
+	assert(left_img.type() == CV_8UC1);
 
-	cv::Mat left_projected_img = left_img.clone();
-	cv::cvtColor(left_projected_img, left_projected_img, CV_GRAY2BGR);
-
-	cv::Mat right_projected_img = right_img.clone();
-	cv::cvtColor(right_projected_img, right_projected_img, CV_GRAY2BGR);
-
-
-	world_point_colors_all.clear();
+	world_point_colors_all.assign(world_pts.size(), WPt());
+	if (left_projections) {
+		left_projections->assign(world_pts.size(), IPt());
+	}
 
-	for (auto img = 0u; img < world_pts.size(); ++img) {
+	// both projections of an image in one pass, the colors and the points seen by both cameras come out of it
+#pragma omp parallel for schedule(dynamic)
+	for (int img = 0; img < static_cast<int>(world_pts.size()); ++img) {
+		int no_of_pts = static_cast<int>(world_pts[img].size());
 		img_pts1[img].clear();
 		img_pts2[img].clear();
 
-		WPt world_pt_colors_per_img;
-		for (auto i = 0u; i < world_pts[img].size(); ++i) {
-			cv::Vec3b common_color(rng.next(), rng.next(), rng.next());
-			// project point
+		IPt left_projected_pts(no_of_pts);
+		IPt right_projected_pts(no_of_pts);
+		if (no_of_pts > 0) {
+			project_points(&world_pts[img][0], no_of_pts, P1, &left_projected_pts[0]);
+			project_points(&world_pts[img][0], no_of_pts, P2, &right_projected_pts[0]);
+		}
 
-			cv::Point2d left_projected_point = project_point(world_pts[img][i], P1);
+		WPt& world_pt_colors_per_img = world_point_colors_all[img];
+		world_pt_colors_per_img.assign(no_of_pts, cv::Vec3d(0, 0, 0));
+		img_pts1[img].reserve(no_of_pts);
+		img_pts2[img].reserve(no_of_pts);
 
-			// unique color for each stripe for better recognition, common color 
-			if (i < 5 && img == 0) {
-				std::cout  << std::setprecision(15) << " left projected points : "<< left_projected_point.x << ", " << left_projected_point.y << std::endl;
+		for (int i = 0; i < no_of_pts; ++i) {
+			double grayscale;
+			if (!sample_bilinear(left_img, left_projected_pts[i], grayscale)) {
+				continue;
 			}
+			world_pt_colors_per_img[i] = cv::Vec3d(grayscale, grayscale, grayscale) / 255.;
 
-			cv::Vec3d world_pt_color(0, 0, 0);
+			const cv::Vec2d& right_projected_pt = right_projected_pts[i];
+			if ((right_projected_pt[0] >= 0 && right_projected_pt[0] < right_img.cols)
+				&& (right_projected_pt[1] >= 0 && right_projected_pt[1] < right_img.rows)) {
+				img_pts1[img].push_back(left_projected_pts[i]);
+				img_pts2[img].push_back(right_projected_pt);
+			}
+		}
 
-			bool left_point_exists = false;
-			if ((left_projected_point.x >= 0 && left_projected_point.x < left_projected_img.cols)
-				&& ((left_projected_point.y >= 0 && left_projected_point.y < left_projected_img.rows))) {
-					left_projected_img.at<cv::Vec3b>(left_projected_point.y, left_projected_point.x) = common_color;
-					unsigned char red = left_img.at<unsigned char>(left_projected_point.y, left_projected_point.x);
-					float grayscale_float = red;
+		if (left_projections) {
+			(*left_projections)[img].swap(left_projected_pts);
+		}
+	}
 
-					world_pt_color = cv::Vec3d(grayscale_float, grayscale_float, grayscale_float);
-					//world_pt_color = cv::Vec3d(common_color[2], common_color[1], common_color[0]);
-					world_pt_color /= 255.f;
-					left_point_exists = true;
-			} 
-			world_pt_colors_per_img.push_back(world_pt_color);
+#ifdef DEBUG
+	// unique color for each point for better recognition, common to both images
+	cv::Mat left_projected_img;
+	cv::cvtColor(left_img, left_projected_img, CV_GRAY2BGR);
 
-			cv::Point2d right_projected_point = project_point(world_pts[img][i], P2);
+	cv::Mat right_projected_img;
+	cv::cvtColor(right_img, right_projected_img, CV_GRAY2BGR);
 
-			if ((right_projected_point.x >= 0 && right_projected_point.x < right_projected_img.cols)
-				&& ((right_projected_point.y >= 0 && right_projected_point.y < right_projected_img.rows))) {
-					right_projected_img.at<cv::Vec3b>(right_projected_point.y, right_projected_point.x) = common_color;
-					//left_projected_img.at<cv::Vec3b>(right_projected_point.y, right_projected_point.x) = common_color;
-					if (left_point_exists) {
-						img_pts1[img].push_back(cv::Vec2d(left_projected_point.x, left_projected_point.y));
-						img_pts2[img].push_back(cv::Vec2d(right_projected_point.x, right_projected_point.y));
-					}
-			}
+	for (auto img = 0u; img < world_pts.size(); ++img) {
+		for (auto i = 0u; i < world_pts[img].size(); ++i) {
+			cv::Vec3b common_color(rng.next(), rng.next(), rng.next());
+			cv::Point2d left_projected_point = project_point(world_pts[img][i], P1);
+			cv::Point2d right_projected_point = project_point(world_pts[img][i], P2);
 
 			if (i < 5 && img == 0) {
+				std::cout  << std::setprecision(15) << " left projected points : "<< left_projected_point.x << ", " << left_projected_point.y << std::endl;
 				std::cout  << " right projected points : "<< right_projected_point.x << ", " << right_projected_point.y << std::endl;
 			}
+
+			if (left_projected_point.inside(cv::Rect(0, 0, left_projected_img.cols, left_projected_img.rows))) {
+				left_projected_img.at<cv::Vec3b>(left_projected_point.y, left_projected_point.x) = common_color;
+			}
+			if (right_projected_point.inside(cv::Rect(0, 0, right_projected_img.cols, right_projected_img.rows))) {
+				right_projected_img.at<cv::Vec3b>(right_projected_point.y, right_projected_point.x) = common_color;
+			}
 		}
-		world_point_colors_all.push_back(world_pt_colors_per_img);
 	}
 
 	cv::imshow("left projected image", left_projected_img);
 	cv::imwrite("left_projected_image.png", left_projected_img);
 	cv::imshow("right projected image", right_projected_img);
 	cv::imwrite("right_projected_image.png", right_projected_img);
-	
+#endif
 }
 
 void Reconstruct3D::reconstruct(CameraPairs& camera_pairs, int no_of_images) {
@@ -1881,7 +2138,7 @@ void Reconstruct3D::reconstruct(CameraPairs& camera_pairs, int no_of_images) {
 //		std::cout << std::endl;
 
 	
-		//correct_img_coordinates(img_pts1, img_pts2);
+		correct_img_coordinates(img_pts1, img_pts2);
 
 //		for (auto i = 0; i < 15; ++i) {
 //			std::cout << "corrected points : " << img_pts1[0][i][0] << ", " << img_pts1[0][i][1] << std::endl;
@@ -1894,12 +2151,23 @@ void Reconstruct3D::reconstruct(CameraPairs& camera_pairs, int no_of_images) {
 //		std::cout << std::endl;
 
 		recon_obj(img_pts1, img_pts2, world_pts);
-		project_points_on_to_img(world_pts, world_point_colors, left_texture_img, right_texture_img, img_pts1, img_pts2);
+		// the stripe grid, before project_points_on_to_img replaces the image points
+		std::vector<std::vector<int>> stripe_rows(img_pts1.size());
+		for (auto img = 0u; img < img_pts1.size(); ++img) {
+			for (auto& img_pt : img_pts1[img]) {
+				stripe_rows[img].push_back(static_cast<int>(img_pt[1] + 0.5));
+			}
+		}
+		// the left projections double as the texture coordinates, no second pass over the points
+		IPts left_projections;
+		project_points_on_to_img(world_pts, world_point_colors, left_texture_img, right_texture_img, img_pts1, img_pts2,
+			&left_projections);
 
-		triangulate_pts(world_pts, triangles, texture_coordinates, left_img);
+		triangulate_pts(world_pts, triangles, texture_coordinates, left_img, &left_projections);
 //		for (auto i = 0; i < 15; ++i) {
 //		smooth_points(world_pts, left_intensities, right_intensities);
-		remesh_with_smoothing(world_pts);
+		//remesh_with_smoothing(world_pts);
+		stripe_smooth(world_pts, stripe_rows);
 //		bilateral_smooth(world_pts, left_intensities);
 		
 //		}
@@ -25,6 +25,18 @@ typedef std::vector<cv::Vec6f> TriangleList;
 typedef std::pair<int, std::pair<cv::Vec3i, cv::Vec3i> > UniqueColorPair;
 typedef std::unordered_map<int, std::vector<int>> UniqueEdges;
 
+// the lit pixels of a rectified stripe image row by row, filled by Reconstruct3D::rectify_stripe_img in the same
+// pass that rectifies the image, so finding the stripe doesn't go over the image again
+struct StripeRows {
+	std::vector<int> row_sums;
+	// lit pixels of row r are [row_offsets[r], row_offsets[r + 1]) of lit_pixels
+	std::vector<int> row_offsets;
+	// (x, row) like findNonZero
+	std::vector<cv::Vec2i> lit_pixels;
+
+	// n x 1 CV_32SC2 header over the lit pixels of row, what findNonZero returns for it
+	cv::Mat lit_pixels_in_row(int row);
+};
 
 
 class Reconstruct3D : public QObject
@@ -84,6 +96,7 @@ public:
 	bool non_consecutive_points_exists(unsigned img, unsigned row, const cv::Mat& left_non_zero_points, const cv::Mat& right_non_zero_points);
 	bool anomaly_exists_in_vertical_points(std::vector<cv::Point2d>& points);
 	void correpond_with_gaussians(CameraImgMap& camera_img_map, int left_cam_no, int right_cam_no,
+		std::vector<StripeRows>& left_stripe_rows, std::vector<StripeRows>& right_stripe_rows,
 		IPts& img_pts1, IPts& img_pts2, Intensities& left_intensities, Intensities& right_intensities);
 
 	void compute_correlation_using_gaussian(IPts& img_pts1, IPts& img_pts2,
@@ -95,8 +108,13 @@ public:
 	void compute_correlation(IPts& img_pts1, IPts& img_pts2,
 		CameraImgMap& camera_img_map, std::vector<std::pair<int, int>> camera_pairs);
 
+	static const int STRIPE_THRESHOLD;
 	void pre_process_img(cv::Mat& img, cv::Mat& rImg, bool is_right);
-	void init_imgs(CameraImgMap& camera_img_map, int cam, bool is_right);
+	// pre_process_img with bilinear instead of bicubic interpolation, straight off the fixed point maps, plus
+	// the lit pixels and sum of every row. one pass over the image
+	void rectify_stripe_img(const cv::Mat& input, bool is_right, cv::Mat& output, StripeRows& stripe_rows) const;
+	// stripe_rows gets the StripeRows of every image if it isn't null
+	void init_imgs(CameraImgMap& camera_img_map, int cam, bool is_right, std::vector<StripeRows>* stripe_rows = nullptr);
 	
 
 	void read_file(const std::string& file_name, IPts& img_pts1, IPts& img_pts2);
@@ -105,8 +123,9 @@ public:
 	void convert(const WPts& world_pts, pcl::PointCloud<pcl::PointXYZ>::Ptr& cloud);
 	void convert(const WPts& world_pts, const Intensities& intensities, pcl::PointCloud<pcl::PointXYZI>::Ptr& cloud);
 
+	// left_projections are the P1 projections of pnts if project_points_on_to_img already made them
 	void triangulate_pts(const WPts& pnts, WPt& triangles, 
-		IPt& texture_coords, cv::Mat& remapped_img);
+		IPt& texture_coords, cv::Mat& remapped_img, const IPts* left_projections = nullptr);
 	void gen_texture(GLuint& texture_id, cv::Mat& remapped_img_for_texture) const;
 	
 	
@@ -115,18 +134,35 @@ public:
 	std::string generate_extrinsics_filename(int left_num, int right_num);
 
 	void remesh_with_smoothing(WPts& world_pts);
+	static const int STRIPE_SMOOTHING_RADIUS;
+	// moves every point onto the plane through its stripe neighbourhood, the points within STRIPE_SMOOTHING_RADIUS
+	// rows in its own image and the same rows in the images either side. rows[img][i] is the rectified row of
+	// world_pts[img][i]. the neighbours come from the rows, so there's no search, and images run in parallel.
+	// normals gets the plane normal of every point, 0 where a point has no neighbours one way or the other
+	void stripe_smooth(WPts& world_pts, const std::vector<std::vector<int>>& rows, WPts* normals = nullptr) const;
 
 	cv::Vec3d Reconstruct3D::calculate_3D_point(const cv::Vec2d& left_image_point, const cv::Vec2d& right_image_point, 
 		const cv::Mat& proj1, const cv::Mat& proj2) const;
 	void recon_obj(const IPts& img_pts1, const IPts& img_pts2, WPts& world_pts);
 
-	void correct_img_coordinates(IPts& img_pts1, IPts& img_pts2);
+	// F of the pair straight from P1 and P2, F = [P2 C1]x P2 P1+ with C1 the left camera center
+	cv::Mat fundamental_from_projections(const cv::Mat& proj1, const cv::Mat& proj2) const;
+	// moves each pair to the closest one that satisfies the epipolar constraint exactly (hartley-sturm), all points
+	// of an image in one call and the images in parallel
+	void correct_img_coordinates(IPts& img_pts1, IPts& img_pts2) const;
 
 
 	cv::Point2d Reconstruct3D::project_point(const cv::Vec3d& world_pt, const cv::Mat& projection_matrix) const;
-
+	// projected_pts must hold no_of_pts
+	static void project_points(const cv::Vec3d* world_pts, int no_of_pts, const cv::Mat& projection_matrix,
+		cv::Vec2d* projected_pts);
+	// false outside the 8 bit single channel img
+	static bool sample_bilinear(const cv::Mat& img, const cv::Vec2d& img_pt, double& value);
+
+	// colors are sampled bilinearly from left_img. left_projections gets the P1 projection of every world point
+	// if it isn't null, for triangulate_pts
 	void project_points_on_to_img(WPts& world_pts, WPts& world_point_colors, cv::Mat& left_img, cv::Mat& right_img,
-		IPts& img_pts1, IPts& img_pts2);
+		IPts& img_pts1, IPts& img_pts2, IPts* left_projections = nullptr);
 	void reconstruct(CameraPairs& camera_pairs, int no_of_images);
 	//void gen_texture(GLuint& texture_id_, cv::Mat& remapped_img_for_texture) const;
 	void re_reconstruct(CameraPairs& camera_pairs, int no_of_images);
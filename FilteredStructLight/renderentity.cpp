@@ -152,6 +152,92 @@ void RenderEntity::draw() {
 RenderEntity::~RenderEntity() {
 }
 
+StreamedEntity::StreamedEntity(GLenum primitive, QGLShaderProgram* shader) : primitive_(primitive), shader_(shader), vao_(0) {
+}
+
+void StreamedEntity::upload() {
+	if (!batch_.has_pending()) {
+		return;
+	}
+
+	shader_->bind();
+
+	if (vao_ == 0) {
+		glGenVertexArrays(1, &vao_);
+		glBindVertexArray(vao_);
+		glGenBuffers(2, vbo_);
+
+		GLuint vert_pos_attr = shader_->attributeLocation("vertex");
+		glBindBuffer(GL_ARRAY_BUFFER, vbo_[0]);
+		glEnableVertexAttribArray(vert_pos_attr);
+		glVertexAttribPointer(vert_pos_attr, 3, GL_FLOAT, GL_FALSE, sizeof(cv::Vec3f), NULL);
+
+		GLuint vert_color_attr = shader_->attributeLocation("vertColor");
+		glBindBuffer(GL_ARRAY_BUFFER, vbo_[1]);
+		glEnableVertexAttribArray(vert_color_attr);
+		glVertexAttribPointer(vert_color_attr, 4, GL_FLOAT, GL_FALSE, sizeof(cv::Vec4f), NULL);
+	} else {
+		glBindVertexArray(vao_);
+	}
+
+	int capacity = batch_.get_required_capacity();
+	int first = batch_.get_uploaded_count();
+	if (capacity != batch_.get_capacity()) {
+		// the cpu side still has everything, so growing is allocating and uploading it all again
+		glBindBuffer(GL_ARRAY_BUFFER, vbo_[0]);
+		glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(cv::Vec3f), NULL, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, vbo_[1]);
+		glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(cv::Vec4f), NULL, GL_DYNAMIC_DRAW);
+		first = 0;
+	}
+
+	int count = batch_.get_no_of_vertices() - first;
+	glBindBuffer(GL_ARRAY_BUFFER, vbo_[0]);
+	glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(cv::Vec3f), count * sizeof(cv::Vec3f), batch_.get_positions() + first);
+	glBindBuffer(GL_ARRAY_BUFFER, vbo_[1]);
+	glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(cv::Vec4f), count * sizeof(cv::Vec4f), batch_.get_colors() + first);
+
+	batch_.mark_uploaded(capacity);
+
+	glBindVertexArray(NULL);
+}
+
+void StreamedEntity::draw(int frame) {
+	upload();
+	if (batch_.get_no_of_vertices() == 0) {
+		return;
+	}
+
+	shader_->bind();
+	glBindVertexArray(vao_);
+	if (frame >= 0) {
+		int first, count;
+		batch_.get_frame_range(frame, first, count);
+		if (count > 0) {
+			glDrawArrays(primitive_, first, count);
+		}
+	} else if (primitive_ == GL_POINTS || primitive_ == GL_LINES) {
+		// frames are back to back and these don't join up, so it's all one draw
+		glDrawArrays(primitive_, 0, batch_.get_no_of_vertices());
+	} else {
+		glMultiDrawArrays(primitive_, &batch_.get_frame_firsts()[0], &batch_.get_frame_counts()[0],
+			batch_.get_no_of_frames());
+	}
+	glBindVertexArray(NULL);
+}
+
+void StreamedEntity::clear_gpu_structs() {
+	if (vao_ != 0) {
+		glBindVertexArray(vao_);
+		glDeleteBuffers(2, vbo_);
+		glBindVertexArray(NULL);
+		glDeleteVertexArrays(1, &vao_);
+		vao_ = 0;
+	}
+	batch_.clear();
+	batch_.mark_uploaded(0);
+}
+
 void VisObject::clear_gpu_structs() {
 	for (auto& entity : mesh_) {
 		glBindVertexArray(entity.vao_);
@@ -7,6 +7,7 @@
 #include <QGLBuffer>
 #include <QGLShaderProgram>
 #include "octree/octree.h"
+#include "framebatch.h"
 
 
 struct VertexBufferData {
@@ -78,6 +79,24 @@ private:
 	RenderEntity::Type type_;
 };
 
+// one vao over a FrameBatch, for geometry streamed in a frame at a time. uploads whatever was appended since the
+// last draw, so appending doesn't need the context
+class StreamedEntity {
+public:
+	GLenum primitive_;
+	QGLShaderProgram* shader_;
+	GLuint vao_;
+	GLuint vbo_[2];
+	FrameBatch batch_;
+
+	StreamedEntity(GLenum primitive, QGLShaderProgram* shader);
+
+	void upload();
+	// every frame if frame is negative. points and lines are one draw call, strips are one multi draw
+	void draw(int frame = -1);
+	void clear_gpu_structs();
+};
+
 typedef std::vector<RenderEntity> RenderMesh;
 typedef std::unordered_map<std::string, RenderMesh> Assets;
 typedef std::vector<RenderMesh> Scene;
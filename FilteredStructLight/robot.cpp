@@ -111,6 +111,7 @@ void Robot::init() {
 	
 
 	tick_tock_age_ = 0;
+	coverage_map_.resize(occupancy_grid_->get_grid_width(), occupancy_grid_->get_grid_height());
 	//init_coverage_map();
 
 	cv::Vec4f green(0.f, 1.f, 0.f, 1.f);
@@ -223,6 +224,38 @@ Robot::Robot(UniformLocations& locations, unsigned id, SwarmOccupancyTree* octre
 	heap_pool_ = new std::vector<std::vector<glm::ivec3>>();
 }
 
+void Robot::reset(glm::vec3 position, double separation_constant, double alignment_constant, double cluster_constant,
+	double explore_constant, int discovery_range, double separation_distance) {
+	position_ = position;
+	velocity_ = glm::vec3(0.f);
+	explore_constant_ = explore_constant;
+	separation_constant_ = separation_constant;
+	alignment_constant_ = alignment_constant;
+	cluster_constant_ = cluster_constant;
+	discovery_range_ = discovery_range;
+	separation_distance_ = separation_distance;
+
+	all_goals_explored_ = false;
+	accumulator_ = 0.f;
+	timeout_ = 5000;
+	last_timeout_ = 0;
+	last_updated_time_ = -1;
+
+	explore_force_ = glm::vec3(0.f);
+	separation_force_ = glm::vec3(0.f);
+	perimeter_force_ = glm::vec3(0.f);
+	cluster_force_ = glm::vec3(0.f);
+	alignment_force_ = glm::vec3(0.f);
+	work_force_ = glm::vec3(0.f);
+	resultant_force_ = glm::vec3(0.f);
+
+	last_resultant_directions_.clear();
+	robots_.clear();
+	profile_.reset();
+
+	init();
+}
+
 Robot& Robot::operator=(const Robot& other) {
 	if (this != &other) {
 		id_ = other.id_;
@@ -233,9 +266,6 @@ Robot& Robot::operator=(const Robot& other) {
 		timeout_ = other.timeout_;
 		last_timeout_ = other.last_timeout_;
 		last_updated_time_ = other.last_updated_time_;
-		rng_ = other.rng_;
-		velocity_generator_ = other.velocity_generator_;
-		position_generator_ = other.position_generator_;
 
 		explore_constant_ = other.explore_constant_;
 		separation_constant_ = other.separation_constant_;
@@ -259,6 +289,10 @@ Robot& Robot::operator=(const Robot& other) {
 	return *this;
 }
 
+const SimProfile& Robot::get_profile() const {
+	return profile_;
+}
+
 Robot::~Robot() {
 	//heap_pool_->clear();
 	delete heap_pool_;
@@ -818,8 +852,8 @@ void Robot::calculate_sampling_factor() {
 
 double Robot::calculate_coverage() {
 	double avg_covered_cells = 0;
-	for (auto& cell : coverage_map_) {
-		if (cell.second > 0) {
+	for (auto index : coverage_map_.cells()) {
+		if (coverage_map_.value(index) > 0) {
 			avg_covered_cells += 1;
 		}
 	}
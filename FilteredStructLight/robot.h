@@ -6,8 +6,10 @@
 #include <stdexcept>
 //#include "octree.h"
 #include "swarmtree.h"
+#include "simprofile.h"
 #include <memory>
 #include <qspinbox.h>
+#include <QMutex>
 
 
 struct SwarmParams {
@@ -52,8 +54,9 @@ struct SwarmParams {
 	double sensor_range_;
 	double discovery_range_;
 	//int grid_resolution_per_side_;
-	int grid_width_;
-	int grid_height_;
+	// set from the floor plan when the grids are created
+	int grid_width_ = 0;
+	int grid_height_ = 0;
 
 	int no_of_clusters_;
 	int max_time_taken_;
@@ -61,7 +64,8 @@ struct SwarmParams {
 	int death_time_taken_;
 	QString config_name_;
 	QString model_matrix_filename_;
-	int robots_in_a_cluster_;
+	// set when the robots are created
+	int robots_in_a_cluster_ = 0;
 	double coverage_needed_;
 	bool display_local_map_;
 	int local_map_robot_id_;
@@ -69,6 +73,8 @@ struct SwarmParams {
 	double desired_sampling;
 
 	bool video_mode_;
+	// every random draw of a run is keyed off this, see CounterRng
+	unsigned int seed_;
 };
 
 struct Recon3DPoints : public VisObject {
@@ -106,13 +112,34 @@ struct GridOverlay : public VisObject {
 			QGLShaderProgram* shader, int no_of_robots_in_a_cluster, bool display_local_map);
 	int desired_sampling_;
 	mm::Quadtree<SamplingTime> simult_sampling_grid_;
+
+	// cell colors are kept here and only reach the gpu in flush, once per frame, so the simulation thread can
+	// color cells without a gl context and a tick that explores thousands of cells costs a few uploads.
+	// both vectors use the x * grid_height + z layout of the color buffer
+	static const int MAX_SPAN_GAP;
+	QMutex cell_lock_;
+	std::vector<cv::Vec4f> cell_colors_;
+	std::vector<char> dirty_cells_;
+	// dirty cells all lie in [dirty_begin_, dirty_end_)
+	int dirty_begin_;
+	int dirty_end_;
+	// 6 vertex colors per cell of every span of a flush, and the spans as [begin, end) cell indices
+	std::vector<cv::Vec4f> upload_colors_;
+	std::vector<std::pair<int, int>> upload_spans_;
+	// caller holds cell_lock_
+	void set_cell_color(int index, const cv::Vec4f& color);
+	// uploads the cells colored since the last flush, needs the gl context
+	void flush();
+
+	// safe from any thread
 	void update_grid_position(const glm::ivec3& position, const cv::Vec4f& color);
 	void update_grid_position(const glm::ivec3& position);
 	void create_mesh(bool initialize);
+	// flushes
 	void update(glm::mat4 global_model) override;
 	void update_poo_position(const glm::vec3& position, const cv::Vec4f& color);
 	cv::Vec4f calculate_heatmap_color_grid_cell(double minimum, double maximum, double unclamped_value);
-	void update_simultaneous_sampling_heatmap(const SimSampMap simultaneous_sampling_per_grid_cell);
+	void update_simultaneous_sampling_heatmap(const SimSampMap& simultaneous_sampling_per_grid_cell);
 };
 
 struct Range {
@@ -163,9 +190,6 @@ protected:
 	glm::vec3 position_;
 	long long timeout_;
 	long long last_timeout_;
-	std::mt19937 rng_;
-	std::uniform_real_distribution<float> velocity_generator_;
-	std::uniform_int_distribution<int> position_generator_;
 
 	std::list<glm::vec3> last_resultant_directions_;
 	// goal position
@@ -228,6 +252,8 @@ protected:
 	std::vector<VisibleCell> adjacent_cells_;
 	std::vector<glm::vec3> interior_cells_;
 	bool interior_updated_;
+	// filled by the PROFILE_* macros
+	SimProfile profile_;
 	//int grid_cube_length_;
 	//int grid_resolution_per_side_;
 	//std::vector<glm::ivec3> get_adjacent_cells(const glm::ivec3& position) const;
@@ -250,7 +276,7 @@ protected:
 	QMutex explored_mutex_;
 
 	int discovery_range_;
-	std::unordered_map<glm::ivec3, int, IVec3Hasher, IVec3Equals> coverage_map_;
+	DenseGridMap<int> coverage_map_;
 
 	int pool_size_;
 	int current_pool_count_;
@@ -318,6 +344,7 @@ public:
 	//void handle_input();
 	virtual void update(glm::mat4 global_model);
 	virtual void update(int timestamp);
+	const SimProfile& get_profile() const;
 
 	Robot& operator=(const Robot& other);
 	virtual ~Robot();
@@ -332,6 +359,9 @@ public:
 	void calculate_sampling_factor();
 	double calculate_coverage();
 	void reallocate_pools();
+	// back to the state the constructor leaves a robot in, on the same grids and keeping its buffers
+	void reset(glm::vec3 position, double separation_constant, double alignment_constant, double cluster_constant,
+		double explore_constant, int discovery_range, double separation_distance);
 	// calculate forces, 3 types of forces for now
 	// calculate acceleration and integrate for velocity and position
 
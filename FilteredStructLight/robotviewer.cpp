@@ -18,7 +18,8 @@ const std::string RobotViewer::FLOOR_GRID = "floor_grid";
 RobotViewer::RobotViewer(const QGLFormat& format, QWidget* parent)
 	:  QGLWidget(format, parent),
 	m_vertexBuffer(QGLBuffer::VertexBuffer), no_of_pts_(0), angle_(0), is_draw_triangles_(true), is_texture_on_(false),
-	m_xRot(0), m_yRot(0), m_zRot(0), mouse_down_(false), scale_(1.f) 
+	m_xRot(0), m_yRot(0), m_zRot(0), mouse_down_(false), scale_(1.f),
+	frame_planes_(GL_TRIANGLE_STRIP, &m_shader), frame_points_(GL_POINTS, &m_shader), frame_lines_(GL_LINES, &m_shader)
 {
 
 	setFocusPolicy(Qt::StrongFocus);
@@ -40,6 +41,10 @@ RobotViewer::RobotViewer(const QGLFormat& format, QWidget* parent)
 }
 
 RobotViewer::~RobotViewer() {
+	makeCurrent();
+	frame_planes_.clear_gpu_structs();
+	frame_points_.clear_gpu_structs();
+	frame_lines_.clear_gpu_structs();
 	//if (tex) {
 	//	delete[] tex;
 	//}
@@ -304,11 +309,13 @@ void RobotViewer::custom_draw_code() {
 				&& (current_frame_to_draw_ <= (frames_.size() - 1))) {
 				Scene scene = frames_[current_frame_to_draw_];
 				draw_scene(scene);
+				draw_frame_geometry(current_frame_to_draw_);
 			}
 		} else {
 			for (auto& scene : frames_) {
 				draw_scene(scene);
 			}
+			draw_frame_geometry(-1);
 		}
 	} else {
 		// always draw the default scene, if nothing is there
@@ -642,6 +649,34 @@ void RobotViewer::set_scale(int value) {
 void RobotViewer::start_reconstruction_sequence() {
 	frames_.clear();
 	points_.clear();
+	// the buffers stay allocated for the next sequence
+	frame_planes_.batch_.clear();
+	frame_points_.batch_.clear();
+	frame_lines_.batch_.clear();
+}
+
+void RobotViewer::append_frame_geometry(const std::vector<cv::Vec3f>& plane_points,
+	const std::vector<cv::Vec3f>& points_3d, const std::vector<cv::Vec3f>& line_points, cv::Vec4f color) {
+	frame_planes_.batch_.append_frame(plane_points, color);
+	frame_points_.batch_.append_frame(points_3d, color);
+	frame_lines_.batch_.append_frame(line_points, color);
+}
+
+void RobotViewer::draw_frame_geometry(int frame) {
+	// all in world coordinates, the entities get_plane_entity and the rest made had identity models too
+	GLuint model_loc = m_shader.uniformLocation("model");
+	glUniformMatrix4fv(model_loc, 1, GL_FALSE, glm::value_ptr(model_));
+
+	if (draw_points_) {
+		frame_points_.draw(frame);
+	}
+	if (draw_lines_) {
+		frame_lines_.draw(frame);
+	}
+	// translucent, so after everything else
+	if (draw_planes_) {
+		frame_planes_.draw(frame);
+	}
 }
 
 void RobotViewer::end_reconstruction_sequence() {
@@ -664,19 +699,16 @@ void RobotViewer::create_calibration_frame(std::vector<cv::Vec3f> points_3d,
 
 	cv::Vec4f common_color(dist(e2), dist(e2), dist(e2), 0.2f);
 
-	RenderEntity checkerboard_plane = get_plane_entity(normal, d, common_color);
+	std::vector<cv::Vec3f> checkerboard_plane;
+	get_plane_points(normal, d, checkerboard_plane);
 
 	float elongation_length = 200.f;
-	cv::Vec3f elongated_line_b = line_a + elongation_length * (line_b - line_a);
-	cv::Vec3f elongated_line_a = line_a - elongation_length * (line_b - line_a);
-	RenderEntity fitted_line = get_line_entity(elongated_line_a, elongated_line_b, common_color);
+	std::vector<cv::Vec3f> fitted_line;
+	fitted_line.push_back(line_a - elongation_length * (line_b - line_a));
+	fitted_line.push_back(line_a + elongation_length * (line_b - line_a));
 
-	RenderEntity line_3d_points = get_points_entity(points_3d, common_color);
+	append_frame_geometry(checkerboard_plane, points_3d, fitted_line, common_color);
 
-	RenderMesh calibration;
-	calibration.push_back(checkerboard_plane);
-	calibration.push_back(line_3d_points);
-	calibration.push_back(fitted_line);
 	// make copies not references
 	RenderMesh camera = assets_[CAMERA];
 
@@ -686,7 +718,6 @@ void RobotViewer::create_calibration_frame(std::vector<cv::Vec3f> points_3d,
 	//update_model(floor_grid, RT);
 
 	std::vector<RenderMesh> scene;
-	scene.push_back(calibration);
 	scene.push_back(camera);
 	scene.push_back(robot);
 	scene.push_back(floor_grid);
@@ -705,10 +736,10 @@ void RobotViewer::create_final_calibration_frame(cv::Vec3f normal, double d) {
 
 	cv::Vec4f common_color(dist(e2), dist(e2), dist(e2), 0.2f);
 
-	RenderEntity scanline_plane = get_plane_entity(normal, d, common_color);
+	std::vector<cv::Vec3f> scanline_plane;
+	get_plane_points(normal, d, scanline_plane);
 
-	RenderMesh calibration;
-	calibration.push_back(scanline_plane);
+	append_frame_geometry(scanline_plane, std::vector<cv::Vec3f>(), std::vector<cv::Vec3f>(), common_color);
 
 	// make copies not references
 	RenderMesh camera = assets_[CAMERA];
@@ -719,7 +750,6 @@ void RobotViewer::create_final_calibration_frame(cv::Vec3f normal, double d) {
 	//update_model(floor_grid, RT);
 
 	std::vector<RenderMesh> scene;
-	scene.push_back(calibration);
 	scene.push_back(camera);
 	scene.push_back(robot);
 	scene.push_back(floor_grid);
@@ -736,19 +766,16 @@ void RobotViewer::create_reconstruction_frame(std::vector<cv::Vec3f> points_3d,
 
 	cv::Vec4f common_color(dist(e2), dist(e2), dist(e2), 0.2f);
 
-	RenderEntity laser_line_plane = get_plane_entity(normal, d, common_color);
+	std::vector<cv::Vec3f> laser_line_plane;
+	get_plane_points(normal, d, laser_line_plane);
 
 	float elongation_length = 200.f;
-	cv::Vec3f elongated_line_b = line_a + elongation_length * (line_b - line_a);
-	cv::Vec3f elongated_line_a = line_a - elongation_length * (line_b - line_a);
-	RenderEntity camera_ray = get_line_entity(elongated_line_a, elongated_line_b, common_color);
+	std::vector<cv::Vec3f> camera_ray;
+	camera_ray.push_back(line_a - elongation_length * (line_b - line_a));
+	camera_ray.push_back(line_a + elongation_length * (line_b - line_a));
 
-	RenderEntity line_3d_points = get_points_entity(points_3d, common_color);
-
-	RenderMesh reconstruction;
-	reconstruction.push_back(laser_line_plane);
-	reconstruction.push_back(line_3d_points);
-	reconstruction.push_back(camera_ray);
+	// no gl objects per frame, the points go on the end of the shared buffers
+	append_frame_geometry(laser_line_plane, points_3d, camera_ray, common_color);
 
 	// make copies not references
 	RenderMesh camera = assets_[CAMERA];
@@ -761,7 +788,6 @@ void RobotViewer::create_reconstruction_frame(std::vector<cv::Vec3f> points_3d,
 	//update_model(floor_grid, RT);
 
 	std::vector<RenderMesh> scene;
-	scene.push_back(reconstruction);
 	scene.push_back(camera);
 	scene.push_back(robot);
 	scene.push_back(floor_grid);
@@ -927,12 +953,9 @@ RenderEntity RobotViewer::get_line_entity(cv::Vec3f a, cv::Vec3f b, cv::Vec4f li
 	return line_entity;
 }
 
-RenderEntity RobotViewer::get_plane_entity(cv::Vec3f normal, double d, cv::Vec4f plane_color) {
-	makeCurrent();
+void RobotViewer::get_plane_points(cv::Vec3f normal, double d, std::vector<cv::Vec3f>& plane_points) {
 	int dist_x = 200, dist_y = 200;
 
-	std::vector<cv::Vec3f> plane_points;
-	std::vector<cv::Vec4f> plane_colors;
 	for (int x = 0; x < 2; ++x)  {
 		for (int y = 0; y < 2; ++y) {
 			float x_mul = (x % 2 == 0) ? 1.f : -1.f;
@@ -950,9 +973,16 @@ RenderEntity RobotViewer::get_plane_entity(cv::Vec3f normal, double d, cv::Vec4f
 
 			cv::Vec3f plane_point(plane_x, plane_y, z);
 			plane_points.push_back(plane_point);
-			plane_colors.push_back(plane_color);
 		}
 	}
+}
+
+RenderEntity RobotViewer::get_plane_entity(cv::Vec3f normal, double d, cv::Vec4f plane_color) {
+	makeCurrent();
+
+	std::vector<cv::Vec3f> plane_points;
+	get_plane_points(normal, d, plane_points);
+	std::vector<cv::Vec4f> plane_colors(plane_points.size(), plane_color);
 
 	RenderEntity plane(GL_TRIANGLE_STRIP, &m_shader);
 	plane.set_type(RenderEntity::Plane);
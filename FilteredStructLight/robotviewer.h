@@ -106,8 +106,19 @@ private:
 	std::vector<RenderEntity> entities_;
 
 	bool draw_frame_by_frame_;
+	// the camera, robot and floor of every frame. these share the assets' vaos, only the models differ
 	std::vector<std::vector<RenderMesh>> frames_;
 	int current_frame_to_draw_;
+	// planes, points and lines of every frame, appended to as frames come in. frame i of each is frames_[i]
+	StreamedEntity frame_planes_;
+	StreamedEntity frame_points_;
+	StreamedEntity frame_lines_;
+
+	void get_plane_points(cv::Vec3f normal, double d, std::vector<cv::Vec3f>& plane_points);
+	// the laser line or checkerboard plane of a frame, its points and its fitted line. any can be empty
+	void append_frame_geometry(const std::vector<cv::Vec3f>& plane_points, const std::vector<cv::Vec3f>& points_3d,
+		const std::vector<cv::Vec3f>& line_points, cv::Vec4f color);
+	void draw_frame_geometry(int frame);
 
 public:
 	RobotViewer(const QGLFormat& format, QWidget* parent = 0);
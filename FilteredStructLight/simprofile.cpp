@@ -0,0 +1,171 @@
+#include "simprofile.h"
+#include <QMutex>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <sstream>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+const char* SimProfile::PHASE_NAMES[NO_OF_PHASES] = {
+	"neighbours", "interior_stats", "velocity", "explore", "sensor_window", "path", "grid_marking"
+};
+
+const char* SimProfile::COUNTER_NAMES[NO_OF_COUNTERS] = {
+	"astar_searches", "visibility_tests", "frontier_queries", "allocations"
+};
+
+static QMutex summary_lock;
+static std::vector<std::string> summary_rows;
+
+#ifdef SWARM_PROFILE
+// every heap allocation goes through here in a profiling build
+static thread_local std::uint64_t allocation_count = 0;
+
+void* operator new(std::size_t size) {
+	allocation_count++;
+	void* memory = std::malloc(size ? size : 1);
+	if (!memory) {
+		throw std::bad_alloc();
+	}
+	return memory;
+}
+
+void* operator new[](std::size_t size) {
+	return operator new(size);
+}
+
+void operator delete(void* memory) noexcept {
+	std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept {
+	std::free(memory);
+}
+#endif
+
+SimProfile::SimProfile() {
+	reset();
+}
+
+std::uint64_t SimProfile::cycles() {
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+std::uint64_t SimProfile::thread_allocations() {
+#ifdef SWARM_PROFILE
+	return allocation_count;
+#else
+	return 0;
+#endif
+}
+
+void SimProfile::begin_tick() {
+	tick_allocations_start_ = thread_allocations();
+	tick_start_ = cycles();
+}
+
+void SimProfile::end_tick() {
+	std::uint64_t tick_cycles = cycles() - tick_start_;
+	tick_cycles_ += tick_cycles;
+	if (tick_cycles > max_tick_cycles_) {
+		max_tick_cycles_ = tick_cycles;
+	}
+	counters_[ALLOCATIONS] += thread_allocations() - tick_allocations_start_;
+	ticks_++;
+}
+
+void SimProfile::merge(const SimProfile& other) {
+	ticks_ += other.ticks_;
+	tick_cycles_ += other.tick_cycles_;
+	if (other.max_tick_cycles_ > max_tick_cycles_) {
+		max_tick_cycles_ = other.max_tick_cycles_;
+	}
+	for (int i = 0; i < NO_OF_PHASES; ++i) {
+		phase_cycles_[i] += other.phase_cycles_[i];
+	}
+	for (int i = 0; i < NO_OF_COUNTERS; ++i) {
+		counters_[i] += other.counters_[i];
+	}
+}
+
+void SimProfile::reset() {
+	ticks_ = 0;
+	tick_cycles_ = 0;
+	max_tick_cycles_ = 0;
+	tick_start_ = 0;
+	tick_allocations_start_ = 0;
+	for (int i = 0; i < NO_OF_PHASES; ++i) {
+		phase_cycles_[i] = 0;
+		phase_start_[i] = 0;
+	}
+	for (int i = 0; i < NO_OF_COUNTERS; ++i) {
+		counters_[i] = 0;
+	}
+}
+
+std::uint64_t SimProfile::get_ticks() const {
+	return ticks_;
+}
+
+std::uint64_t SimProfile::get_tick_cycles() const {
+	return tick_cycles_;
+}
+
+void SimProfile::print_header(std::ostream& stream) {
+	stream << "group_id,thread_id,iteration,robot_id,wall_time_s,ticks,tick_cycles,max_tick_cycles";
+	for (int i = 0; i < NO_OF_PHASES; ++i) {
+		stream << "," << PHASE_NAMES[i] << "_cycles";
+	}
+	for (int i = 0; i < NO_OF_COUNTERS; ++i) {
+		stream << "," << COUNTER_NAMES[i];
+	}
+	stream << "\n";
+}
+
+void SimProfile::print(int group_id, int thread_id, int iteration, int robot_id, double wall_time, std::ostream& stream) const {
+	stream << group_id << "," << thread_id << "," << iteration << "," << robot_id << "," << wall_time << ","
+		<< ticks_ << "," << tick_cycles_ << "," << max_tick_cycles_;
+	for (int i = 0; i < NO_OF_PHASES; ++i) {
+		stream << "," << phase_cycles_[i];
+	}
+	for (int i = 0; i < NO_OF_COUNTERS; ++i) {
+		stream << "," << counters_[i];
+	}
+	stream << "\n";
+}
+
+void SimProfile::record_simulation(int group_id, int thread_id, int iteration, double wall_time,
+	const std::vector<const SimProfile*>& robot_profiles) {
+	std::stringstream rows;
+	SimProfile total;
+	for (int robot_id = 0; robot_id < robot_profiles.size(); ++robot_id) {
+		robot_profiles[robot_id]->print(group_id, thread_id, iteration, robot_id, wall_time, rows);
+		total.merge(*robot_profiles[robot_id]);
+	}
+	total.print(group_id, thread_id, iteration, -1, wall_time, rows);
+
+	summary_lock.lock();
+	summary_rows.push_back(rows.str());
+	summary_lock.unlock();
+}
+
+void SimProfile::write_summary(const std::string& filename) {
+	summary_lock.lock();
+	std::ofstream file(filename);
+	print_header(file);
+	for (auto& rows : summary_rows) {
+		file << rows;
+	}
+	summary_rows.clear();
+	summary_lock.unlock();
+}
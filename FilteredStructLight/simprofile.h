@@ -0,0 +1,90 @@
+#pragma once
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// per phase cycle counts and event counters for the simulator. the PROFILE_* macros only do something
+// when SWARM_PROFILE is defined, so a normal build pays nothing for them
+#ifdef SWARM_PROFILE
+#define PROFILE_TICK_BEGIN(profile) (profile).begin_tick()
+#define PROFILE_TICK_END(profile) (profile).end_tick()
+#define PROFILE_BEGIN(profile, phase) (profile).begin(SimProfile::phase)
+#define PROFILE_END(profile, phase) (profile).end(SimProfile::phase)
+#define PROFILE_COUNT(profile, counter) (profile).count(SimProfile::counter)
+#else
+#define PROFILE_TICK_BEGIN(profile) ((void)0)
+#define PROFILE_TICK_END(profile) ((void)0)
+#define PROFILE_BEGIN(profile, phase) ((void)0)
+#define PROFILE_END(profile, phase) ((void)0)
+#define PROFILE_COUNT(profile, counter) ((void)0)
+#endif
+
+class SimProfile {
+public:
+	// phases of a robot tick, in the order ExperimentalRobot::update runs them
+	enum Phase {
+		NEIGHBOURS = 0,
+		INTERIOR_STATS,
+		VELOCITY,
+		EXPLORE,
+		SENSOR_WINDOW,
+		PATH,
+		GRID_MARKING,
+		NO_OF_PHASES
+	};
+
+	enum Counter {
+		ASTAR_SEARCHES = 0,
+		VISIBILITY_TESTS,
+		FRONTIER_QUERIES,
+		ALLOCATIONS,
+		NO_OF_COUNTERS
+	};
+
+	static const char* PHASE_NAMES[NO_OF_PHASES];
+	static const char* COUNTER_NAMES[NO_OF_COUNTERS];
+
+	SimProfile();
+
+	// rdtsc where there is one, otherwise nanoseconds
+	static std::uint64_t cycles();
+	// heap allocations made by the calling thread, always 0 without SWARM_PROFILE
+	static std::uint64_t thread_allocations();
+
+	void begin_tick();
+	void end_tick();
+	void begin(Phase phase) {
+		phase_start_[phase] = cycles();
+	}
+	void end(Phase phase) {
+		phase_cycles_[phase] += cycles() - phase_start_[phase];
+	}
+	void count(Counter counter, std::uint64_t n = 1) {
+		counters_[counter] += n;
+	}
+
+	void merge(const SimProfile& other);
+	void reset();
+	std::uint64_t get_ticks() const;
+	std::uint64_t get_tick_cycles() const;
+
+	// csv, one row per robot plus one total row (robot -1) per simulation
+	static void print_header(std::ostream& stream);
+	void print(int group_id, int thread_id, int iteration, int robot_id, double wall_time, std::ostream& stream) const;
+
+	// finished simulations are collected here and written out once by the optimizer
+	static void record_simulation(int group_id, int thread_id, int iteration, double wall_time,
+		const std::vector<const SimProfile*>& robot_profiles);
+	static void write_summary(const std::string& filename);
+
+private:
+	std::uint64_t ticks_;
+	std::uint64_t tick_cycles_;
+	std::uint64_t max_tick_cycles_;
+	std::uint64_t tick_start_;
+	std::uint64_t tick_allocations_start_;
+	std::uint64_t phase_cycles_[NO_OF_PHASES];
+	std::uint64_t phase_start_[NO_OF_PHASES];
+	std::uint64_t counters_[NO_OF_COUNTERS];
+};
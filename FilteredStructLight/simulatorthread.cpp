@@ -1,5 +1,9 @@
 #include "simulatorthread.h"
 #include "swarmutils.h"
+#include "swarmtrace.h"
+#include "swarmframe.h"
+#include <chrono>
+#include <QThread>
 
 #define PI 3.14159265
 
@@ -9,6 +13,72 @@ const int SimulatorThread::DEFAULT_NO_OF_ROBOTS = 3;
 const std::string SimulatorThread::OCCUPANCY_GRID_NAME = "occupancy_grid";
 const std::string SimulatorThread::OCCUPANCY_GRID_OVERLAY_NAME = "occupancy_grid_overlay";
 const int SimulatorThread::OCCUPANCY_GRID_HEIGHT = 2;
+const int SimulatorThread::SIMULATOR_VERSION = 1;
+
+QMutex SimulationStatePool::lock_;
+std::vector<SimulationState> SimulationStatePool::states_;
+int SimulationStatePool::max_no_of_states_ = 2 * QThread::idealThreadCount();
+
+bool SimulationStatePool::is_compatible(const SwarmParams& swarm_params, const SwarmParams& other) {
+	return swarm_params.model_matrix_filename_ == other.model_matrix_filename_
+		&& swarm_params.grid_resolution_ == other.grid_resolution_
+		&& swarm_params.grid_length_ == other.grid_length_
+		&& swarm_params.no_of_robots_ == other.no_of_robots_
+		&& swarm_params.sensor_range_ == other.sensor_range_;
+}
+
+bool SimulationStatePool::acquire(const SwarmParams& swarm_params, SimulationState& state) {
+	QMutexLocker locker(&lock_);
+	// newest first, its buffers are the most likely to still be in cache
+	for (int i = states_.size() - 1; i >= 0; --i) {
+		if (is_compatible(swarm_params, states_[i].swarm_params)) {
+			state = states_[i];
+			states_.erase(states_.begin() + i);
+			return true;
+		}
+	}
+	return false;
+}
+
+void SimulationStatePool::release(SimulationState& state) {
+	QMutexLocker locker(&lock_);
+	states_.push_back(state);
+	while (states_.size() > max_no_of_states_) {
+		destroy(states_.front());
+		states_.erase(states_.begin());
+	}
+}
+
+void SimulationStatePool::set_max_no_of_states(int max_no_of_states) {
+	QMutexLocker locker(&lock_);
+	max_no_of_states_ = max_no_of_states;
+	while (states_.size() > max_no_of_states_) {
+		destroy(states_.front());
+		states_.erase(states_.begin());
+	}
+}
+
+void SimulationStatePool::clear() {
+	QMutexLocker locker(&lock_);
+	for (auto& state : states_) {
+		destroy(state);
+	}
+	states_.clear();
+}
+
+void SimulationStatePool::destroy(SimulationState& state) {
+	for (auto& robot : state.robots) {
+		robot->clear_gpu_structs();
+		delete robot;
+	}
+	state.robots.clear();
+	delete state.occupancy_grid;
+	delete state.collision_grid;
+	delete state.recon_grid;
+	state.occupancy_grid = nullptr;
+	state.collision_grid = nullptr;
+	state.recon_grid = nullptr;
+}
 
 
 void BridgeObject::update_sim_results(int group_id, int thread_id, int iteration, 
@@ -52,6 +122,8 @@ void BridgeObject::update_sim_results(int group_id, int thread_id, int iteration
 SimulatorThread::~SimulatorThread()
 {
 	cleanup();
+	delete trace_recorder_;
+	delete frame_writer_;
 }
 
 
@@ -65,20 +137,38 @@ void SimulatorThread::reset_sim(SwarmParams& swarm_params) {
 	cleanup();
 
 	aborted_ = false;
+	exception_thrown_ = false;
 	time_step_count_ = 0;
 
-
-	VertexBufferData* vertex_buffer_data;
-	SwarmUtils::load_interior_model_from_matrix(swarm_params, &occupancy_grid_, &recon_grid_, &collision_grid_);
-
-	occupancy_grid_->create_perimeter_list();
-	occupancy_grid_->create_empty_space_list();
-	occupancy_grid_->create_interior_list();
-
-	bool render_ = false;
-	QGLShaderProgram* m_shader = nullptr;
-
-	SwarmUtils::create_robots(swarm_params, death_map_, occupancy_grid_, collision_grid_, recon_grid_, uniform_locations_, m_shader, render_, robots_);
+	SimulationState state;
+	if (SimulationStatePool::acquire(swarm_params, state)) {
+		occupancy_grid_ = state.occupancy_grid;
+		collision_grid_ = state.collision_grid;
+		recon_grid_ = state.recon_grid;
+		robots_.swap(state.robots);
+
+		swarm_params.grid_width_ = occupancy_grid_->get_grid_width();
+		swarm_params.grid_height_ = occupancy_grid_->get_grid_height();
+		occupancy_grid_->restore_floor_plan();
+		recon_grid_->restore_floor_plan();
+		collision_grid_->clear();
+
+		SwarmUtils::reset_robots(swarm_params, death_map_, occupancy_grid_, robots_);
+	} else {
+		VertexBufferData* vertex_buffer_data;
+		SwarmUtils::load_interior_model_from_matrix(swarm_params, &occupancy_grid_, &recon_grid_, &collision_grid_);
+
+		occupancy_grid_->create_perimeter_list();
+		occupancy_grid_->create_empty_space_list();
+		occupancy_grid_->create_interior_list();
+		occupancy_grid_->snapshot_floor_plan();
+		recon_grid_->snapshot_floor_plan();
+
+		bool render_ = false;
+		QGLShaderProgram* m_shader = nullptr;
+
+		SwarmUtils::create_robots(swarm_params, death_map_, occupancy_grid_, collision_grid_, recon_grid_, uniform_locations_, m_shader, render_, robots_);
+	}
 
 	VisibilityQuadrant::visbility_quadrant(swarm_params_.sensor_range_);
 
@@ -89,14 +179,22 @@ void SimulatorThread::reset_sim(SwarmParams& swarm_params) {
 		//	robot->set_show_forces(show_forces_);
 		//}
 	}
+
+	if (!trace_filename_.empty()) {
+		if (!trace_recorder_) {
+			trace_recorder_ = new SwarmTraceRecorder();
+		}
+		trace_recorder_->open(trace_filename_, swarm_params, occupancy_grid_, robots_);
+	}
+
+	if (!video_directory_.empty()) {
+		delete frame_writer_;
+		frame_writer_ = new SwarmFrameWriter(video_directory_);
+		robot_colors_ = SwarmUtils::get_robot_colors(swarm_params);
+	}
 }
 
 void SimulatorThread::finish_work() {
-	std::random_device rd;
-	std::mt19937 mt(rd());
-	//std::normal_distribution<> normal_distribution(0.0, 1.0);
-	std::uniform_real_distribution<> uniform_real_distribution(0, 1);
-
 	OptimizationResults results;
 	SwarmUtils::calculate_sim_results(occupancy_grid_, recon_grid_, robots_, time_step_count_, swarm_params_, results);
 	if (exception_thrown_) {
@@ -119,30 +217,105 @@ void SimulatorThread::finish_work() {
 void SimulatorThread::run() {
 	//finish_work();
 	exception_thrown_ = false;
+#ifdef SWARM_PROFILE
+	auto begin_time = std::chrono::steady_clock::now();
+#endif
 
-	while (!aborted_) {
-		if (time_step_count_ > swarm_params_.max_time_taken_) {
-			finish_work();
-		}
+	while (step()) {
+	}
 
-		if ((occupancy_grid_->no_of_unexplored_cells() - (1.0 - swarm_params_.coverage_needed_) * occupancy_grid_->no_of_interior_cells()) > 0) {
+#ifdef SWARM_PROFILE
+	end_run(std::chrono::duration<double>(std::chrono::steady_clock::now() - begin_time).count());
+#else
+	end_run(0.0);
+#endif
+}
 
-		} else {
-			finish_work();
-		}
-		try {
-			for (auto& robot : robots_) {
-				robot->update(time_step_count_);
-			}
-		} catch (OutOfGridBoundsException& ex) {
-			exception_thrown_ = true;
-			//time_step_count_ = swarm_params_.max_time_taken_;
-			finish_work();
+bool SimulatorThread::step() {
+	if (aborted_) {
+		return false;
+	}
+
+	if (time_step_count_ > swarm_params_.max_time_taken_) {
+		finish_work();
+	}
+
+	if ((occupancy_grid_->no_of_unexplored_cells() - (1.0 - swarm_params_.coverage_needed_) * occupancy_grid_->no_of_interior_cells()) > 0) {
+
+	} else {
+		finish_work();
+	}
+	try {
+		for (auto& robot : robots_) {
+			robot->update(time_step_count_);
 		}
-		time_step_count_++;
-		//QCoreApplication::processEvents();
+	} catch (OutOfGridBoundsException& ex) {
+		exception_thrown_ = true;
+		//time_step_count_ = swarm_params_.max_time_taken_;
+		finish_work();
+	}
+	time_step_count_++;
+	if (trace_recorder_) {
+		trace_recorder_->record_tick(robots_);
 	}
+	if (frame_writer_) {
+		frame_writer_->write(SwarmFrameRenderer::render(occupancy_grid_, robots_, robot_colors_, nullptr, swarm_params_.desired_sampling));
+	}
+	//QCoreApplication::processEvents();
+	return true;
+}
+
+void SimulatorThread::end_run(double wall_time) {
 	std::cout << "Ending : " << group_id_ << " " << thread_id_ << " " << iteration_ << "\n";
+	if (trace_recorder_) {
+		trace_recorder_->close();
+	}
+	if (frame_writer_) {
+		std::cout << "Wrote " << frame_writer_->get_frame_count() << " frames to " << frame_writer_->get_directory() << "\n";
+		delete frame_writer_;
+		frame_writer_ = nullptr;
+	}
+
+#ifdef SWARM_PROFILE
+	std::vector<const SimProfile*> robot_profiles;
+	for (auto& robot : robots_) {
+		robot_profiles.push_back(&robot->get_profile());
+	}
+	SimProfile::record_simulation(group_id_, thread_id_, iteration_, wall_time, robot_profiles);
+	std::cout << "Ticks/s : " << time_step_count_ / wall_time << "\n";
+#endif
+}
+
+int SimulatorThread::get_time_step_count() const {
+	return time_step_count_;
+}
+
+bool SimulatorThread::is_exception_thrown() const {
+	return exception_thrown_;
+}
+
+int SimulatorThread::get_group_id() const {
+	return group_id_;
+}
+
+int SimulatorThread::get_thread_id() const {
+	return thread_id_;
+}
+
+int SimulatorThread::get_iteration() const {
+	return iteration_;
+}
+
+const SwarmParams& SimulatorThread::get_swarm_params() const {
+	return swarm_params_;
+}
+
+void SimulatorThread::set_trace_filename(const std::string& filename) {
+	trace_filename_ = filename;
+}
+
+void SimulatorThread::set_video_directory(const std::string& directory) {
+	video_directory_ = directory;
 }
 
 void SimulatorThread::abort() {
@@ -150,7 +323,7 @@ void SimulatorThread::abort() {
 }
 
 SimulatorThread::SimulatorThread(int group_id, int thread_id, int iteration, SwarmParams& swarm_params) :
-occupancy_grid_(nullptr), collision_grid_(nullptr), time_step_count_(0), group_id_(group_id), thread_id_(thread_id), recon_grid_(nullptr), aborted_(false), iteration_(iteration), swarm_params_(swarm_params)
+occupancy_grid_(nullptr), collision_grid_(nullptr), time_step_count_(0), group_id_(group_id), thread_id_(thread_id), recon_grid_(nullptr), aborted_(false), iteration_(iteration), swarm_params_(swarm_params), trace_recorder_(nullptr), frame_writer_(nullptr)
 {
 }
 
@@ -170,11 +343,6 @@ void SimulatorThread::cleanup() {
 	//	delete vis_object;
 	//}
 
-	for (auto& vis_object : robots_) {
-		vis_object->clear_gpu_structs();
-		delete vis_object;
-	}
-
 	//for (auto& vis_object : lights_) {
 	//	vis_object->clear_gpu_structs();
 	//	delete vis_object;
@@ -183,19 +351,28 @@ void SimulatorThread::cleanup() {
 	//default_vis_objects_.clear();
 	//robot_color_map_.clear();
 	//reset_vis_objects_.clear();
-	robots_.clear();
 	//lights_.clear();
 
-	if (occupancy_grid_) {
-		delete occupancy_grid_;
+	if (!occupancy_grid_) {
+		return;
 	}
-	if (collision_grid_) {
-		delete collision_grid_;
-	}
-	if (recon_grid_) {
-		delete recon_grid_;
+
+	// the grid stops journalling before another simulation gets it
+	if (trace_recorder_) {
+		trace_recorder_->close();
 	}
-	
+
+	SimulationState state;
+	state.swarm_params = swarm_params_;
+	state.occupancy_grid = occupancy_grid_;
+	state.collision_grid = collision_grid_;
+	state.recon_grid = recon_grid_;
+	state.robots.swap(robots_);
+	SimulationStatePool::release(state);
+
+	occupancy_grid_ = nullptr;
+	collision_grid_ = nullptr;
+	recon_grid_ = nullptr;
 }
 
 //void SimulatorThread::set_no_of_robots(int no_of_robots) {
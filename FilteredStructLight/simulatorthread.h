@@ -4,9 +4,42 @@
 #include "swarmutils.h"
 #include <qrunnable.h>
 #include <qthreadpool.h>
+#include <QMutex>
 
 
+// grids and robots of a finished simulation
+struct SimulationState {
+	// what they were built for
+	SwarmParams swarm_params;
+	SwarmOccupancyTree* occupancy_grid;
+	SwarmCollisionTree* collision_grid;
+	Swarm3DReconTree* recon_grid;
+	std::vector<Robot*> robots;
+};
+
+// finished simulations hand their grids and robots back here, and the next simulation on the same floor plan with
+// the same no of robots resets them in place instead of allocating everything again. the optimizer runs
+// thousands of short simulations on a handful of floor plans, so nearly every reset after the first few is a hit
+class SimulationStatePool {
+public:
+	// true if swarm_params can run on a state built for other, i.e. the buffers come out the same size
+	static bool is_compatible(const SwarmParams& swarm_params, const SwarmParams& other);
+	static bool acquire(const SwarmParams& swarm_params, SimulationState& state);
+	// the oldest idle state is freed once there are more than max_no_of_states
+	static void release(SimulationState& state);
+	static void set_max_no_of_states(int max_no_of_states);
+	static void clear();
+	static void destroy(SimulationState& state);
+
+private:
+	static QMutex lock_;
+	static std::vector<SimulationState> states_;
+	static int max_no_of_states_;
+};
+
 class SimulatorThread;
+class SwarmTraceRecorder;
+class SwarmFrameWriter;
 class BridgeObject : public QObject {
 	Q_OBJECT
 
@@ -84,8 +117,19 @@ private:
 
 	std::unordered_map<int, int> death_map_;
 
+	// empty unless the run should be recorded
+	std::string trace_filename_;
+	SwarmTraceRecorder* trace_recorder_;
+	// same for a frame per tick
+	std::string video_directory_;
+	SwarmFrameWriter* frame_writer_;
+	std::vector<cv::Vec4f> robot_colors_;
+
 	//BridgeObject* bridge_;
 public:
+	// bump whenever a change to the simulation changes what a run returns for the same SwarmParams. it's part of
+	// the SwarmResultCache key, so results of an older simulator aren't reused
+	static const int SIMULATOR_VERSION;
 
 
 
@@ -106,9 +150,23 @@ public:
 	//void load_interior_model();
 	//std::vector<glm::vec3> create_starting_formation(Formation type);
 
+	// hands the grids and robots to SimulationStatePool
 	void cleanup();
 	void finish_work();
+	int get_time_step_count() const;
+	bool is_exception_thrown() const;
+	int get_group_id() const;
+	int get_thread_id() const;
+	int get_iteration() const;
+	const SwarmParams& get_swarm_params() const;
+	// records the next run to filename, set before reset_sim
+	void set_trace_filename(const std::string& filename);
+	// writes a top down frame of every tick of the next run to directory
+	void set_video_directory(const std::string& directory);
 	void run() override;
+	// one tick of every robot, false once the simulation has finished. run() is just this in a loop
+	bool step();
+	void end_run(double wall_time);
 	void abort();
 	//void do_work();
 
@@ -168,4 +226,3 @@ signals:
 
 void send_sim_results(int group_id, int thread_id, int iteration, SwarmParams params, OptimizationResults results);
 };
-
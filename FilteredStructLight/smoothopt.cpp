@@ -1,10 +1,10 @@
 #include "smoothopt.h"
 #include <assert.h>
 #include <iomanip>
+#include <cmath>
 
 
-// for use by lsqr_eval_for_opt
-static std::vector<double> lambdas_g;
+// lsqr_eval_for_opt gets the lambdas through lsqr's userdata, so each call has its own
 
 
 
@@ -16,6 +16,7 @@ static void
 lsqr_eval_for_opt(long mode, dvec *x, dvec *y, void *userdata)
 {
 //	int i, j, nparms = x->length;
+	const std::vector<double>& lambdas_g = *static_cast<const std::vector<double>*>(userdata);
 
 	if (mode == 0) {
       // compute y = y + A*x
@@ -89,21 +90,12 @@ lsqr_eval_for_opt(long mode, dvec *x, dvec *y, void *userdata)
 
 
 /*****************************************************************************
+   lambda of every inner point, lambdas[i - 1] is point i's
 *****************************************************************************/
-float
-optimize_smoothness(WPt& worlds_pts, const IntensityPerImage& left_intensities, const IntensityPerImage& right_intensities)
+static void
+calculate_lambdas(const WPt& worlds_pts, const IntensityPerImage& left_intensities, const IntensityPerImage& right_intensities,
+	std::vector<double>& lambdas)
 {
-	// copy to globals
-	//assert(fromVector.size() == toVector.size());
-	//assert(fromVector.size() >= 3);
-	//_fromVector = fromVector;
-//	worlds_pts.resize(3);
-
-	if (worlds_pts.size() < 3) {
-		// too little points to opitimize
-		return -1;
-	}
-
 	double max_z = -DBL_MAX;
 	for (auto w = 0; w < worlds_pts.size();++w) {
 		max_z = std::max(max_z, worlds_pts[w][2]);
@@ -112,7 +104,6 @@ optimize_smoothness(WPt& worlds_pts, const IntensityPerImage& left_intensities,
 
 	double adjustment_rate = 1;
 
-	std::vector<double> lambdas;
 	lambdas.resize(worlds_pts.size() - 2);
 	for (auto w = 0; w < worlds_pts.size();++w) {
 		if (((w - 1) >= 0) && ((w) < (worlds_pts.size() - 1))) {
@@ -149,9 +140,85 @@ optimize_smoothness(WPt& worlds_pts, const IntensityPerImage& left_intensities,
 		std::cout << std::setprecision(15) << lambdas[i] << std::endl;
 	}
 #endif
-	
-	// allocate to globals
-	lambdas_g = lambdas;
+}
+
+
+/*****************************************************************************
+*****************************************************************************/
+float
+optimize_smoothness(WPt& worlds_pts, const IntensityPerImage& left_intensities, const IntensityPerImage& right_intensities)
+{
+	if (worlds_pts.size() < 3) {
+		// too little points to opitimize
+		return -1;
+	}
+
+	std::vector<double> lambdas;
+	calculate_lambdas(worlds_pts, left_intensities, right_intensities, lambdas);
+
+	// thomas algorithm over the inner points, row j is point j + 1. the diagonal is 1 and the off diagonals
+	// -lambda_j / 2, so the pivots stay positive as long as every lambda is below 1
+	int n = lambdas.size();
+	std::vector<double> upper(n);
+	std::vector<double> rhs(n);
+	for (auto j = 0; j < n; ++j) {
+		double off_diagonal = -0.5 * lambdas[j];
+		rhs[j] = (1.0 - lambdas[j]) * worlds_pts[j + 1][2];
+		if (j == 0) {
+			rhs[j] -= off_diagonal * worlds_pts[0][2];
+		}
+		if (j == n - 1) {
+			rhs[j] -= off_diagonal * worlds_pts[n + 1][2];
+		}
+
+		double pivot = 1.0;
+		if (j > 0) {
+			pivot -= off_diagonal * upper[j - 1];
+			rhs[j] -= off_diagonal * rhs[j - 1];
+		}
+		if (pivot < 1e-6) {
+			return optimize_smoothness_lsqr(worlds_pts, left_intensities, right_intensities);
+		}
+		upper[j] = off_diagonal / pivot;
+		rhs[j] /= pivot;
+	}
+	for (auto j = n - 2; j >= 0; --j) {
+		rhs[j] -= upper[j] * rhs[j + 1];
+	}
+
+	double error = 0.0;
+	for (auto j = 0; j < n; ++j) {
+		double previous_z = (j == 0) ? worlds_pts[0][2] : rhs[j - 1];
+		double next_z = (j == n - 1) ? worlds_pts[n + 1][2] : rhs[j + 1];
+		double residual = rhs[j] - 0.5 * lambdas[j] * (previous_z + next_z) - (1.0 - lambdas[j]) * worlds_pts[j + 1][2];
+		error += residual * residual;
+	}
+	for (auto j = 0; j < n; ++j) {
+		worlds_pts[j + 1][2] = rhs[j];
+	}
+
+	return std::sqrt(error);
+}
+
+
+/*****************************************************************************
+*****************************************************************************/
+float
+optimize_smoothness_lsqr(WPt& worlds_pts, const IntensityPerImage& left_intensities, const IntensityPerImage& right_intensities)
+{
+	// copy to globals
+	//assert(fromVector.size() == toVector.size());
+	//assert(fromVector.size() >= 3);
+	//_fromVector = fromVector;
+//	worlds_pts.resize(3);
+
+	if (worlds_pts.size() < 3) {
+		// too little points to opitimize
+		return -1;
+	}
+
+	std::vector<double> lambdas;
+	calculate_lambdas(worlds_pts, left_intensities, right_intensities, lambdas);
 
 	// allocate structures for sparse linear least squares
 	//printf("\tallocating for sparse linear least squares "
@@ -188,7 +255,7 @@ optimize_smoothness(WPt& worlds_pts, const IntensityPerImage& left_intensities,
 
 	// call sparse linear least squares!
 	printf("\t\tstarting (rows=%i, cols=%i)...\n", num_rows, num_cols);
-	lsqr(input, output, work, func, NULL);
+	lsqr(input, output, work, func, &lambdas);
 	double error = output->resid_norm;
 	printf("\t\ttermination reason = %i\n", output->term_flag);
 	printf("\t\tnum function calls = %i\n", output->num_iters);
@@ -6,5 +6,13 @@ extern "C" {
 #include "lsqr.h"
 }
 
+// smooths the z of one stripe. every inner point i is pulled to its neighbours by lambda_i,
+// -lambda_i / 2 * z_(i - 1) + z_i - lambda_i / 2 * z_(i + 1) = (1 - lambda_i) * z0_i, with the end points held.
+// that's tridiagonal, so it's solved directly in O(n), and falls back to lsqr if the system isn't diagonally
+// dominant. reentrant, stripes can be smoothed in parallel. returns the residual norm, -1 for less than 3 points
 float
 optimize_smoothness(WPt& worlds_pts, const IntensityPerImage& left_intensities, const IntensityPerImage& right_intensities);
+
+// the same system by lsqr
+float
+optimize_smoothness_lsqr(WPt& worlds_pts, const IntensityPerImage& left_intensities, const IntensityPerImage& right_intensities);
@@ -0,0 +1,537 @@
+#include "swarmbenchmark.h"
+#include "simulatorthread.h"
+#include "experimentalrobot.h"
+#include "swarmutils.h"
+#include "astar.h"
+#include "gaussfit.h"
+#include "reconstruct.h"
+#include "robotreconstruction.h"
+#include "counterrng.h"
+#include "renderentity.h"
+#include "swarmvoxels.h"
+#include <QDir>
+#include <QFileInfo>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+const char* SwarmBenchmark::MICRO_CONFIG = "to-optimize/medium_complexity_house.ini";
+const char* SwarmBenchmark::DEFAULT_CONFIG_DIR = "to-optimize";
+const unsigned int SwarmBenchmark::BENCHMARK_SEED = 1;
+const int SwarmBenchmark::REPEATS = 7;
+
+// keeps the compiler from dropping the measured work
+static volatile long long benchmark_sink = 0;
+
+int SwarmBenchmark::run(const std::string& output_filename, QStringList configs) {
+	if (configs.empty()) {
+		QDir config_dir(DEFAULT_CONFIG_DIR);
+		for (auto& filename : config_dir.entryList(QStringList() << "*.ini", QDir::Files, QDir::Name)) {
+			configs.push_back(config_dir.filePath(filename));
+		}
+	}
+
+	bool checks_passed = true;
+	auto micro_results = run_micro_benchmarks(checks_passed);
+	auto macro_results = run_macro_benchmarks(configs);
+
+	std::ofstream file(output_filename);
+	if (!file.is_open()) {
+		std::cout << "Unable to write benchmark results to " << output_filename << "\n";
+		return 1;
+	}
+	write_json(micro_results, macro_results, file);
+	std::cout << "Benchmark results written to " << output_filename << "\n";
+	if (!checks_passed) {
+		std::cout << "A benchmark check failed, see above\n";
+		return 1;
+	}
+	return 0;
+}
+
+MicroBenchmarkResult SwarmBenchmark::measure(const std::string& name, std::function<long long()> operation) {
+	// warm up caches and any lazily created state
+	long long operations = operation();
+
+	std::vector<double> ns_per_op;
+	for (int i = 0; i < REPEATS; ++i) {
+		auto begin = std::chrono::steady_clock::now();
+		operations = operation();
+		auto end = std::chrono::steady_clock::now();
+		double ns = std::chrono::duration<double, std::nano>(end - begin).count();
+		ns_per_op.push_back(ns / std::max(operations, 1LL));
+	}
+	std::sort(ns_per_op.begin(), ns_per_op.end());
+
+	MicroBenchmarkResult result;
+	result.name = name;
+	result.operations = operations;
+	result.min_ns = ns_per_op.front();
+	result.median_ns = ns_per_op[ns_per_op.size() / 2];
+	std::cout << name << " : " << result.median_ns << " ns/op\n";
+	return result;
+}
+
+std::vector<MicroBenchmarkResult> SwarmBenchmark::run_micro_benchmarks(bool& checks_passed) {
+	checks_passed = true;
+	std::vector<MicroBenchmarkResult> results;
+
+	// quadtree access, the grids are walked both ways in the simulator
+	{
+		const int side = 1024;
+		mm::Quadtree<int> grid(side, side, 1.f, 0);
+		results.push_back(measure("quadtree_at_row_major", [&]() {
+			long long sum = 0;
+			for (int y = 0; y < side; ++y) {
+				for (int x = 0; x < side; ++x) {
+					sum += grid.at(x, y);
+				}
+			}
+			benchmark_sink += sum;
+			return (long long)side * side;
+		}));
+		results.push_back(measure("quadtree_at_column_major", [&]() {
+			long long sum = 0;
+			for (int x = 0; x < side; ++x) {
+				for (int y = 0; y < side; ++y) {
+					sum += grid.at(x, y);
+				}
+			}
+			benchmark_sink += sum;
+			return (long long)side * side;
+		}));
+		results.push_back(measure("quadtree_set_random", [&]() {
+			CounterRng rng(BENCHMARK_SEED, 0, 0, 0);
+			const int no_of_sets = 1 << 20;
+			for (int i = 0; i < no_of_sets; ++i) {
+				int value = i;
+				grid.set(rng.uniform_int(0, side - 1), rng.uniform_int(0, side - 1), value);
+			}
+			return (long long)no_of_sets;
+		}));
+	}
+
+	// stripe processing
+	{
+		cv::Mat img(1, 640, CV_8U);
+		for (int x = 0; x < img.cols; ++x) {
+			img.at<unsigned char>(0, x) = cv::saturate_cast<unsigned char>(200.0 * std::exp(-0.5 * std::pow((x - 320.3) / 4.0, 2)));
+		}
+		cv::Mat non_zero_vals;
+		cv::findNonZero(img > 20, non_zero_vals);
+		results.push_back(measure("fit_gauss", [&]() {
+			const int no_of_fits = 200;
+			double mid_point = 0.0;
+			for (int i = 0; i < no_of_fits; ++i) {
+				fit_gauss(img, 0, non_zero_vals, 318.0, mid_point);
+			}
+			benchmark_sink += (long long)mid_point;
+			return (long long)no_of_fits;
+		}));
+
+		cv::Mat camera_matrix = (cv::Mat_<double>(3, 3) << 800, 0, 320, 0, 800, 240, 0, 0, 1);
+		cv::Mat left_extrinsics = (cv::Mat_<double>(3, 4) << 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0);
+		cv::Mat right_extrinsics = (cv::Mat_<double>(3, 4) << 1, 0, 0, -100, 0, 1, 0, 0, 0, 0, 1, 0);
+		cv::Mat left_projection = camera_matrix * left_extrinsics;
+		cv::Mat right_projection = camera_matrix * right_extrinsics;
+		cv::Mat world_point = (cv::Mat_<double>(4, 1) << 20, -15, 900, 1);
+		cv::Mat left_h = left_projection * world_point;
+		cv::Mat right_h = right_projection * world_point;
+		cv::Vec2d left_point(left_h.at<double>(0) / left_h.at<double>(2), left_h.at<double>(1) / left_h.at<double>(2));
+		cv::Vec2d right_point(right_h.at<double>(0) / right_h.at<double>(2), right_h.at<double>(1) / right_h.at<double>(2));
+		Reconstruct3D reconstructor(2, nullptr);
+		results.push_back(measure("calculate_3D_point", [&]() {
+			const int no_of_points = 10000;
+			double sum = 0.0;
+			for (int i = 0; i < no_of_points; ++i) {
+				sum += reconstructor.calculate_3D_point(left_point, right_point, left_projection, right_projection)[2];
+			}
+			benchmark_sink += (long long)sum;
+			return (long long)no_of_points;
+		}));
+
+		cv::Mat frame = cv::Mat::zeros(480, 640, CV_8UC3);
+		cv::line(frame, cv::Point(300, 0), cv::Point(340, 479), cv::Scalar(255, 255, 255), 3);
+		RobotReconstruction robot_reconstruction;
+		results.push_back(measure("find_line", [&]() {
+			const int no_of_frames = 10;
+			for (int i = 0; i < no_of_frames; ++i) {
+				benchmark_sink += robot_reconstruction.find_line(frame).size();
+			}
+			return (long long)no_of_frames;
+		}));
+	}
+
+	// simulator queries on a bundled floor plan
+	SwarmParams swarm_params = SwarmUtils::load_swarm_params(MICRO_CONFIG);
+	swarm_params.seed_ = BENCHMARK_SEED;
+
+	// the whole house as sparse voxels, every storey and not just the floor plan slice
+	if (QFileInfo(swarm_params.model_filename_).exists()) {
+		VertexBufferData vertex_buffer_data;
+		SwarmUtils::load_obj(swarm_params.model_filename_.toStdString(), vertex_buffer_data);
+		glm::vec3 model_offset(swarm_params.x_spin_box_, swarm_params.y_spin_box_, swarm_params.z_spin_box_);
+		SwarmVoxelTree voxel_tree(swarm_params.grid_length_);
+		results.push_back(measure("voxelize_model", [&]() {
+			voxel_tree.clear();
+			SwarmUtils::derive_voxels(vertex_buffer_data, swarm_params.scale_spinbox_, model_offset, &voxel_tree);
+			return voxel_tree.get_no_of_surface_voxels();
+		}));
+		std::cout << swarm_params.model_filename_.toStdString() << " : " << voxel_tree.get_no_of_surface_voxels()
+			<< " surface voxels in " << voxel_tree.get_no_of_blocks() << " blocks, "
+			<< voxel_tree.get_memory_usage() / (1024 * 1024) << " MB\n";
+
+		glm::ivec3 source_voxel = (voxel_tree.get_min_voxel() + voxel_tree.get_max_voxel()) / 2;
+		int sensor_range = swarm_params.sensor_range_;
+		std::vector<glm::ivec3> surface_voxels;
+		results.push_back(measure("voxel_sensor_window", [&]() {
+			const int no_of_windows = 100;
+			for (int i = 0; i < no_of_windows; ++i) {
+				voxel_tree.get_surface_in_range(source_voxel, sensor_range, surface_voxels);
+				benchmark_sink += surface_voxels.size();
+			}
+			return (long long)no_of_windows;
+		}));
+
+		results.push_back(measure("voxel_nearest_frontier", [&]() {
+			const int no_of_lookups = 100;
+			for (int i = 0; i < no_of_lookups; ++i) {
+				glm::ivec3 frontier;
+				benchmark_sink += voxel_tree.nearest_frontier(source_voxel, frontier);
+			}
+			return (long long)no_of_lookups;
+		}));
+	}
+	SwarmOccupancyTree* occupancy_grid = nullptr;
+	Swarm3DReconTree* recon_grid = nullptr;
+	SwarmCollisionTree* collision_grid = nullptr;
+	if (!SwarmUtils::load_interior_model_from_matrix(swarm_params, &occupancy_grid, &recon_grid, &collision_grid)) {
+		std::cout << "Skipping grid benchmarks, unable to load " << MICRO_CONFIG << "\n";
+		return results;
+	}
+	occupancy_grid->create_perimeter_list();
+	occupancy_grid->create_empty_space_list();
+	occupancy_grid->create_interior_list();
+
+	std::unordered_map<int, int> death_map;
+	UniformLocations uniform_locations;
+	std::vector<Robot*> robots;
+	SwarmUtils::create_robots(swarm_params, death_map, occupancy_grid, collision_grid, recon_grid, uniform_locations, nullptr, false, robots);
+	for (auto& robot : robots) {
+		robot->update_robots(robots);
+	}
+
+	if (!robots.empty()) {
+		ExperimentalRobot* robot = dynamic_cast<ExperimentalRobot*>(robots[0]);
+		glm::vec3 source = robot->get_position();
+		glm::ivec3 source_cell = occupancy_grid->map_to_grid(source);
+
+		// the free cell furthest from the robot, the same one every run
+		glm::ivec3 target_cell = source_cell;
+		float max_distance = 0.f;
+		for (int x = 0; x < occupancy_grid->get_grid_width(); ++x) {
+			for (int z = 0; z < occupancy_grid->get_grid_height(); ++z) {
+				glm::ivec3 cell(x, 0, z);
+				float distance = glm::distance(glm::vec3(cell), glm::vec3(source_cell));
+				if (!occupancy_grid->is_interior(cell) && distance > max_distance) {
+					max_distance = distance;
+					target_cell = cell;
+				}
+			}
+		}
+		glm::vec3 target = occupancy_grid->map_to_position(target_cell);
+
+		AStar astar(occupancy_grid);
+		std::vector<glm::ivec3> path(occupancy_grid->get_grid_width() * occupancy_grid->get_grid_height());
+		std::vector<int> adjacent_robots;
+		results.push_back(measure("astar_search", [&]() {
+			const int no_of_searches = 5;
+			for (int i = 0; i < no_of_searches; ++i) {
+				int no_of_steps = 0;
+				astar.search(source, target, &robots, &adjacent_robots, 0, robot, path, no_of_steps);
+				benchmark_sink += no_of_steps;
+			}
+			return (long long)no_of_searches;
+		}));
+
+		results.push_back(measure("frontier_bread_first_search", [&]() {
+			const int no_of_searches = 20;
+			for (int i = 0; i < no_of_searches; ++i) {
+				glm::ivec3 result_cell;
+				benchmark_sink += occupancy_grid->frontier_bread_first_search(source_cell, result_cell, occupancy_grid->get_grid_width());
+			}
+			return (long long)no_of_searches;
+		}));
+
+		// the first lookup builds the field, the rest are what every robot pays per tick
+		results.push_back(measure("nearest_frontier", [&]() {
+			const int no_of_lookups = 1000;
+			for (int i = 0; i < no_of_lookups; ++i) {
+				glm::ivec3 result_cell;
+				benchmark_sink += occupancy_grid->nearest_frontier(source_cell, result_cell);
+			}
+			return (long long)no_of_lookups;
+		}));
+
+		int sensor_range = swarm_params.sensor_range_;
+		auto visibility_quadrant = VisibilityQuadrant::visbility_quadrant(sensor_range);
+		results.push_back(measure("visibility_quadrant_lookup", [&]() {
+			long long no_of_tests = 0;
+			for (int ix = -sensor_range; ix <= sensor_range; ++ix) {
+				for (int iz = -sensor_range; iz <= sensor_range; ++iz) {
+					glm::ivec3 interior_cell = source_cell + glm::ivec3(ix, 0, iz);
+					if (occupancy_grid->is_out_of_bounds(interior_cell)) {
+						continue;
+					}
+					for (int x = -sensor_range; x <= sensor_range; ++x) {
+						for (int z = -sensor_range; z <= sensor_range; ++z) {
+							glm::ivec3 test_cell = source_cell + glm::ivec3(x, 0, z);
+							benchmark_sink += visibility_quadrant->is_sensor_cell_visible(source_cell, interior_cell, test_cell);
+							no_of_tests++;
+						}
+					}
+				}
+			}
+			return no_of_tests;
+		}));
+
+		// a tick's sensing explores a few perimeter cells, then the robots look their frontiers up again. these
+		// explore the grid, so they come last
+		occupancy_grid->snapshot_floor_plan();
+		std::set<glm::ivec3, IVec3Comparator> perimeter_list = occupancy_grid->get_static_perimeter_list();
+		std::vector<glm::ivec3> perimeter_cells(perimeter_list.begin(), perimeter_list.end());
+		const int no_of_marks_per_lookup = 8;
+		int no_of_rounds = perimeter_cells.size() / no_of_marks_per_lookup;
+		auto explore_round = [&](CounterRng& rng) {
+			for (int i = 0; i < no_of_marks_per_lookup; ++i) {
+				occupancy_grid->mark_explored_in_perimeter_list(perimeter_cells[rng.uniform_int(0, (int)perimeter_cells.size() - 1)]);
+			}
+		};
+		if (!perimeter_cells.empty()) {
+			results.push_back(measure("frontier_field_update", [&]() {
+				occupancy_grid->restore_floor_plan();
+				CounterRng rng(BENCHMARK_SEED, 0, 0, 0);
+				for (int i = 0; i < no_of_rounds; ++i) {
+					explore_round(rng);
+					glm::ivec3 result_cell;
+					benchmark_sink += occupancy_grid->nearest_frontier(source_cell, result_cell);
+				}
+				return (long long)no_of_rounds;
+			}));
+
+			// the same run, compared against a rebuild every few rounds so the updates pile up in between
+			const int rounds_per_check = 16;
+			occupancy_grid->restore_floor_plan();
+			CounterRng rng(BENCHMARK_SEED, 1, 0, 0);
+			for (int i = 0; i < no_of_rounds; ++i) {
+				explore_round(rng);
+				glm::ivec3 result_cell;
+				occupancy_grid->nearest_frontier(source_cell, result_cell);
+				if ((i + 1) % rounds_per_check == 0 || i + 1 == no_of_rounds) {
+					if (!occupancy_grid->is_frontier_field_consistent()) {
+						std::cout << "frontier field differs from a rebuild after " << i + 1 << " rounds\n";
+						checks_passed = false;
+						break;
+					}
+				}
+			}
+
+			// half the perimeter explored, from cells spread over the floor plan. the scan is what
+			// next_cell_to_explore falls back to when no frontier around the robot is in sight
+			occupancy_grid->restore_floor_plan();
+			for (int i = 0; i < no_of_rounds / 2; ++i) {
+				explore_round(rng);
+			}
+			std::set<glm::ivec3, IVec3Comparator> unexplored_list = occupancy_grid->get_unexplored_perimeter_list();
+			std::vector<glm::ivec3> query_cells;
+			CounterRng query_rng(BENCHMARK_SEED, 2, 0, 0);
+			for (int tries = 0; tries < 10000 && query_cells.size() < 100; ++tries) {
+				glm::ivec3 cell(query_rng.uniform_int(0, occupancy_grid->get_grid_width() - 1), 0,
+					query_rng.uniform_int(0, occupancy_grid->get_grid_height() - 1));
+				if (!occupancy_grid->is_interior(cell)) {
+					query_cells.push_back(cell);
+				}
+			}
+			float range_max = std::sqrt(std::pow(occupancy_grid->get_grid_height(), 2.f) + std::pow(occupancy_grid->get_grid_width(), 2.f));
+			results.push_back(measure("next_cell_to_explore", [&]() {
+				for (auto& cell : query_cells) {
+					glm::ivec3 explore_cell;
+					benchmark_sink += occupancy_grid->next_cell_to_explore(cell, explore_cell, 0.f, range_max);
+				}
+				return (long long)query_cells.size();
+			}));
+			results.push_back(measure("closest_frontier_scan", [&]() {
+				for (auto& cell : query_cells) {
+					glm::ivec3 explore_cell;
+					benchmark_sink += occupancy_grid->find_closest_position_from_list(unexplored_list, cell, explore_cell, 0.f, range_max);
+				}
+				return (long long)query_cells.size();
+			}));
+		}
+	}
+
+	for (auto& robot : robots) {
+		robot->clear_gpu_structs();
+		delete robot;
+	}
+	delete occupancy_grid;
+	delete recon_grid;
+	delete collision_grid;
+
+	return results;
+}
+
+std::vector<MacroBenchmarkResult> SwarmBenchmark::run_macro_benchmarks(const QStringList& configs) {
+	std::vector<MacroBenchmarkResult> results;
+	for (auto& config : configs) {
+		if (!QFileInfo(config).exists()) {
+			std::cout << "Skipping missing config : " << config.toStdString() << "\n";
+			continue;
+		}
+		SwarmParams swarm_params = SwarmUtils::load_swarm_params(config);
+		if (!QFileInfo(swarm_params.model_matrix_filename_).exists()) {
+			std::cout << "Skipping " << config.toStdString() << ", missing floor plan : " << swarm_params.model_matrix_filename_.toStdString() << "\n";
+			continue;
+		}
+		swarm_params.seed_ = BENCHMARK_SEED;
+
+		SimulatorThread simulator_thread(0, 0, 0, swarm_params);
+		simulator_thread.setAutoDelete(false);
+
+		MacroBenchmarkResult result;
+		result.is_peak_per_run = reset_peak_rss();
+		result.rss_before_bytes = current_rss_bytes();
+
+		auto begin = std::chrono::steady_clock::now();
+		simulator_thread.reset_sim();
+		simulator_thread.run();
+		auto end = std::chrono::steady_clock::now();
+
+		result.config = config.toStdString();
+		result.seed = swarm_params.seed_;
+		result.ticks = simulator_thread.get_time_step_count();
+		result.wall_time_s = std::chrono::duration<double>(end - begin).count();
+		result.ticks_per_s = result.wall_time_s > 0.0 ? result.ticks / result.wall_time_s : 0.0;
+		result.peak_rss_bytes = peak_rss_bytes();
+		result.out_of_bounds = simulator_thread.is_exception_thrown();
+		std::cout << result.config << " : " << result.ticks << " ticks, " << result.ticks_per_s << " ticks/s, "
+			<< (result.peak_rss_bytes - result.rss_before_bytes) / (1024 * 1024) << " MB above the start"
+			<< (result.is_peak_per_run ? "" : " (process peak)") << "\n";
+		results.push_back(result);
+	}
+	return results;
+}
+
+// the high water mark starts again from the current resident size. only linux has a way to do that
+bool SwarmBenchmark::reset_peak_rss() {
+#ifdef __linux__
+	std::ofstream clear_refs("/proc/self/clear_refs");
+	clear_refs << "5";
+	clear_refs.close();
+	return !clear_refs.fail();
+#else
+	return false;
+#endif
+}
+
+long long SwarmBenchmark::current_rss_bytes() {
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+		return counters.WorkingSetSize;
+	}
+	return 0;
+#elif defined(__linux__)
+	// in pages, the second field is what's resident
+	std::ifstream statm("/proc/self/statm");
+	long long no_of_pages, no_of_resident_pages;
+	if (statm >> no_of_pages >> no_of_resident_pages) {
+		return no_of_resident_pages * sysconf(_SC_PAGESIZE);
+	}
+	return 0;
+#else
+	return 0;
+#endif
+}
+
+long long SwarmBenchmark::peak_rss_bytes() {
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+		return counters.PeakWorkingSetSize;
+	}
+	return 0;
+#else
+#ifdef __linux__
+	// getrusage isn't reset by clear_refs, VmHWM is
+	std::ifstream status("/proc/self/status");
+	std::string line;
+	while (std::getline(status, line)) {
+		if (line.compare(0, 6, "VmHWM:") == 0) {
+			return std::stoll(line.substr(6)) * 1024LL;
+		}
+	}
+#endif
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss * 1024LL;
+#endif
+}
+
+static std::string json_string(const std::string& value) {
+	std::string escaped = "\"";
+	for (char c : value) {
+		if (c == '"' || c == '\\') {
+			escaped += '\\';
+		}
+		escaped += c;
+	}
+	return escaped + "\"";
+}
+
+void SwarmBenchmark::write_json(const std::vector<MicroBenchmarkResult>& micro_results,
+	const std::vector<MacroBenchmarkResult>& macro_results, std::ostream& stream) {
+	stream << std::fixed << std::setprecision(3);
+	stream << "{\n";
+	stream << "  \"version\": 2,\n";
+	stream << "  \"seed\": " << BENCHMARK_SEED << ",\n";
+	stream << "  \"repeats\": " << REPEATS << ",\n";
+	stream << "  \"micro\": [";
+	for (int i = 0; i < micro_results.size(); ++i) {
+		auto& result = micro_results[i];
+		stream << (i > 0 ? ",\n" : "\n");
+		stream << "    {\"name\": " << json_string(result.name)
+			<< ", \"operations\": " << result.operations
+			<< ", \"min_ns\": " << result.min_ns
+			<< ", \"median_ns\": " << result.median_ns << "}";
+	}
+	stream << "\n  ],\n";
+	stream << "  \"macro\": [";
+	for (int i = 0; i < macro_results.size(); ++i) {
+		auto& result = macro_results[i];
+		stream << (i > 0 ? ",\n" : "\n");
+		stream << "    {\"config\": " << json_string(result.config)
+			<< ", \"seed\": " << result.seed
+			<< ", \"ticks\": " << result.ticks
+			<< ", \"wall_time_s\": " << result.wall_time_s
+			<< ", \"ticks_per_s\": " << result.ticks_per_s
+			<< ", \"rss_before_bytes\": " << result.rss_before_bytes
+			<< ", \"peak_rss_bytes\": " << result.peak_rss_bytes
+			<< ", \"peak_rss_increase_bytes\": " << std::max(0LL, result.peak_rss_bytes - result.rss_before_bytes)
+			<< ", \"peak_rss_scope\": " << (result.is_peak_per_run ? "\"run\"" : "\"process\"")
+			<< ", \"out_of_bounds\": " << (result.out_of_bounds ? "true" : "false") << "}";
+	}
+	stream << "\n  ]\n";
+	stream << "}\n";
+}
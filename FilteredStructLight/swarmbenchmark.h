@@ -0,0 +1,56 @@
+#pragma once
+#include "fsl_common.h"
+#include <QStringList>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+struct MicroBenchmarkResult {
+	std::string name;
+	long long operations;
+	// per operation, over the repeats
+	double min_ns;
+	double median_ns;
+};
+
+struct MacroBenchmarkResult {
+	std::string config;
+	unsigned int seed;
+	int ticks;
+	double wall_time_s;
+	double ticks_per_s;
+	// resident memory when the run started, and the most it reached. the peak is the run's own where the high
+	// water mark can be reset (linux), elsewhere it's the process's and includes the configs run before
+	long long rss_before_bytes;
+	long long peak_rss_bytes;
+	bool is_peak_per_run;
+	bool out_of_bounds;
+};
+
+// micro benchmarks of the hot paths and fixed seed full simulations of the bundled configs.
+// run with FilteredStructLight --benchmark [output.json] [config.ini ...]. the json keys and their
+// order only change along with its version, so results of the same version can be diffed
+class SwarmBenchmark {
+public:
+	static const char* MICRO_CONFIG;
+	static const char* DEFAULT_CONFIG_DIR;
+	static const unsigned int BENCHMARK_SEED;
+	static const int REPEATS;
+
+	// configs empty means every .ini in DEFAULT_CONFIG_DIR
+	static int run(const std::string& output_filename, QStringList configs);
+
+	// checks_passed is false if an optimized path disagreed with the plain one it replaces
+	static std::vector<MicroBenchmarkResult> run_micro_benchmarks(bool& checks_passed);
+	static std::vector<MacroBenchmarkResult> run_macro_benchmarks(const QStringList& configs);
+	static void write_json(const std::vector<MicroBenchmarkResult>& micro_results,
+		const std::vector<MacroBenchmarkResult>& macro_results, std::ostream& stream);
+
+private:
+	// operation runs once per call and returns how many operations it did
+	static MicroBenchmarkResult measure(const std::string& name, std::function<long long()> operation);
+	static bool reset_peak_rss();
+	static long long current_rss_bytes();
+	static long long peak_rss_bytes();
+};
@@ -0,0 +1,442 @@
+#include "swarmdistributed.h"
+#include "simulatorthread.h"
+#include <QCoreApplication>
+#include <QHostInfo>
+#include <QThread>
+#include <iostream>
+
+const quint32 SwarmProtocol::PROTOCOL_VERSION = 1;
+const int SwarmProtocol::HEARTBEAT_INTERVAL_MS = 1000;
+const int SwarmProtocol::HEARTBEAT_TIMEOUT_MS = 10000;
+const int SwarmWorker::RECONNECT_INTERVAL_MS = 2000;
+
+QDataStream& operator<<(QDataStream& stream, const SwarmParams& params) {
+	stream << params.no_of_robots_ << params.explore_constant_ << params.separation_constant_ << params.alignment_constant_
+		<< params.cluster_constant_ << params.perimeter_constant_ << params.goto_work_constant_
+		<< params.separation_range_min_ << params.separation_range_max_ << params.alignment_range_min_ << params.alignment_range_max_
+		<< params.cluster_range_min_ << params.cluster_range_max_ << params.perimeter_range_min_ << params.perimeter_range_max_
+		<< params.explore_range_min_ << params.explore_range_max_
+		<< params.obstacle_avoidance_near_range_min_ << params.obstacle_avoidance_near_range_max_
+		<< params.obstacle_avoidance_far_range_min_ << params.obstacle_avoidance_far_range_max_
+		<< params.formation << params.magic_k_spin_box_ << params.neighborhood_count_ << params.grid_resolution_ << params.grid_length_
+		<< params.scale_spinbox_ << params.x_spin_box_ << params.y_spin_box_ << params.z_spin_box_ << params.show_interior_
+		<< params.model_filename_ << params.show_forces_ << params.collide_with_other_robots_ << params.square_radius_
+		<< params.bounce_function_power_ << params.bounce_function_multiplier_ << params.sensor_range_ << params.discovery_range_
+		<< params.grid_width_ << params.grid_height_ << params.no_of_clusters_ << params.max_time_taken_
+		<< params.death_percentage_ << params.death_time_taken_ << params.config_name_ << params.model_matrix_filename_
+		<< params.robots_in_a_cluster_ << params.coverage_needed_ << params.display_local_map_ << params.local_map_robot_id_
+		<< params.display_astar_path_ << params.desired_sampling << params.video_mode_ << quint32(params.seed_);
+	return stream;
+}
+
+QDataStream& operator>>(QDataStream& stream, SwarmParams& params) {
+	quint32 seed;
+	stream >> params.no_of_robots_ >> params.explore_constant_ >> params.separation_constant_ >> params.alignment_constant_
+		>> params.cluster_constant_ >> params.perimeter_constant_ >> params.goto_work_constant_
+		>> params.separation_range_min_ >> params.separation_range_max_ >> params.alignment_range_min_ >> params.alignment_range_max_
+		>> params.cluster_range_min_ >> params.cluster_range_max_ >> params.perimeter_range_min_ >> params.perimeter_range_max_
+		>> params.explore_range_min_ >> params.explore_range_max_
+		>> params.obstacle_avoidance_near_range_min_ >> params.obstacle_avoidance_near_range_max_
+		>> params.obstacle_avoidance_far_range_min_ >> params.obstacle_avoidance_far_range_max_
+		>> params.formation >> params.magic_k_spin_box_ >> params.neighborhood_count_ >> params.grid_resolution_ >> params.grid_length_
+		>> params.scale_spinbox_ >> params.x_spin_box_ >> params.y_spin_box_ >> params.z_spin_box_ >> params.show_interior_
+		>> params.model_filename_ >> params.show_forces_ >> params.collide_with_other_robots_ >> params.square_radius_
+		>> params.bounce_function_power_ >> params.bounce_function_multiplier_ >> params.sensor_range_ >> params.discovery_range_
+		>> params.grid_width_ >> params.grid_height_ >> params.no_of_clusters_ >> params.max_time_taken_
+		>> params.death_percentage_ >> params.death_time_taken_ >> params.config_name_ >> params.model_matrix_filename_
+		>> params.robots_in_a_cluster_ >> params.coverage_needed_ >> params.display_local_map_ >> params.local_map_robot_id_
+		>> params.display_astar_path_ >> params.desired_sampling >> params.video_mode_ >> seed;
+	params.seed_ = seed;
+	return stream;
+}
+
+QDataStream& operator<<(QDataStream& stream, const OptimizationResults& results) {
+	stream << results.occlusion << results.multi_samping << results.density << results.time_taken
+		<< results.simul_sampling << results.clustering;
+	return stream;
+}
+
+QDataStream& operator>>(QDataStream& stream, OptimizationResults& results) {
+	stream >> results.occlusion >> results.multi_samping >> results.density >> results.time_taken
+		>> results.simul_sampling >> results.clustering;
+	return stream;
+}
+
+void SwarmProtocol::init_stream(QDataStream& stream) {
+	// workers and coordinator can be built against different qt versions
+	stream.setVersion(QDataStream::Qt_5_0);
+	stream.setFloatingPointPrecision(QDataStream::DoublePrecision);
+}
+
+void SwarmProtocol::send(QTcpSocket* socket, MessageType type, const QByteArray& body) {
+	QByteArray message;
+	QDataStream stream(&message, QIODevice::WriteOnly);
+	init_stream(stream);
+	stream << quint32(sizeof(qint32) + body.size()) << qint32(type);
+	message.append(body);
+	socket->write(message);
+}
+
+std::vector<std::pair<SwarmProtocol::MessageType, QByteArray>> SwarmProtocol::receive(QTcpSocket* socket, QByteArray& buffer) {
+	buffer.append(socket->readAll());
+
+	std::vector<std::pair<MessageType, QByteArray>> messages;
+	int offset = 0;
+	while (buffer.size() - offset >= int(sizeof(quint32) + sizeof(qint32))) {
+		QDataStream stream(buffer.mid(offset, sizeof(quint32) + sizeof(qint32)));
+		init_stream(stream);
+		quint32 length;
+		qint32 type;
+		stream >> length >> type;
+		if (buffer.size() - offset - int(sizeof(quint32)) < int(length)) {
+			break;
+		}
+		messages.push_back(std::make_pair(static_cast<MessageType>(type),
+			buffer.mid(offset + sizeof(quint32) + sizeof(qint32), length - sizeof(qint32))));
+		offset += sizeof(quint32) + length;
+	}
+	buffer.remove(0, offset);
+	return messages;
+}
+
+SwarmCoordinator::SwarmCoordinator(QObject* parent) : QObject(parent), next_job_id_(0) {
+	clock_.start();
+	connect(&server_, SIGNAL(newConnection()), this, SLOT(accept_workers()));
+	connect(&heartbeat_timer_, SIGNAL(timeout()), this, SLOT(check_heartbeats()));
+}
+
+SwarmCoordinator::~SwarmCoordinator() {
+	for (auto& worker : workers_) {
+		worker.first->disconnect(this);
+		worker.first->abort();
+		delete worker.first;
+	}
+	workers_.clear();
+
+	for (auto& process : local_workers_) {
+		process->kill();
+		process->waitForFinished(1000);
+		delete process;
+	}
+	local_workers_.clear();
+}
+
+bool SwarmCoordinator::listen(quint16 port) {
+	if (!server_.listen(QHostAddress::Any, port)) {
+		std::cout << "Coordinator couldn't listen on port " << port << " : " << server_.errorString().toStdString() << "\n";
+		return false;
+	}
+	heartbeat_timer_.start(SwarmProtocol::HEARTBEAT_INTERVAL_MS);
+	std::cout << "Coordinator listening on port " << server_.serverPort() << "\n";
+	return true;
+}
+
+void SwarmCoordinator::start_local_workers(int no_of_workers) {
+	int no_of_threads = std::max(1, QThread::idealThreadCount() / std::max(1, no_of_workers));
+	for (int i = 0; i < no_of_workers; ++i) {
+		QProcess* process = new QProcess();
+		process->setProcessChannelMode(QProcess::ForwardedChannels);
+		QStringList arguments;
+		arguments << "--worker" << "127.0.0.1" << QString::number(server_.serverPort()) << QString::number(no_of_threads);
+		process->start(QCoreApplication::applicationFilePath(), arguments);
+		local_workers_.push_back(process);
+	}
+}
+
+void SwarmCoordinator::submit(int group_id, int thread_id, int iteration, const SwarmParams& swarm_params) {
+	SwarmJob job;
+	job.job_id = next_job_id_++;
+	job.group_id = group_id;
+	job.thread_id = thread_id;
+	job.iteration = iteration;
+	job.swarm_params = swarm_params;
+
+	outstanding_jobs_[job.job_id] = job;
+	pending_jobs_.push_back(job.job_id);
+	dispatch();
+}
+
+int SwarmCoordinator::get_no_of_workers() const {
+	return workers_.size();
+}
+
+int SwarmCoordinator::get_no_of_outstanding_jobs() const {
+	return outstanding_jobs_.size();
+}
+
+void SwarmCoordinator::accept_workers() {
+	while (server_.hasPendingConnections()) {
+		QTcpSocket* socket = server_.nextPendingConnection();
+		socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+
+		SwarmWorkerConnection worker;
+		worker.name = socket->peerAddress().toString() + ":" + QString::number(socket->peerPort());
+		worker.no_of_slots = 0;
+		worker.last_message_ms = clock_.elapsed();
+		workers_[socket] = worker;
+
+		connect(socket, SIGNAL(readyRead()), this, SLOT(read_worker()));
+		connect(socket, SIGNAL(disconnected()), this, SLOT(worker_disconnected()));
+	}
+}
+
+void SwarmCoordinator::read_worker() {
+	QTcpSocket* socket = qobject_cast<QTcpSocket*>(sender());
+	auto worker = workers_.find(socket);
+	if (worker == workers_.end()) {
+		return;
+	}
+	worker->second.last_message_ms = clock_.elapsed();
+
+	auto messages = SwarmProtocol::receive(socket, worker->second.buffer);
+	for (auto& message : messages) {
+		// a result can end the optimization, which doesn't touch the sockets but can drop this worker
+		if (workers_.find(socket) == workers_.end()) {
+			return;
+		}
+		handle_message(socket, message.first, message.second);
+	}
+}
+
+void SwarmCoordinator::handle_message(QTcpSocket* socket, SwarmProtocol::MessageType type, const QByteArray& body) {
+	SwarmWorkerConnection& worker = workers_[socket];
+	QDataStream stream(body);
+	SwarmProtocol::init_stream(stream);
+
+	if (type == SwarmProtocol::HELLO) {
+		quint32 version;
+		qint32 no_of_slots;
+		QString host_name;
+		stream >> version >> no_of_slots >> host_name;
+		if (version != SwarmProtocol::PROTOCOL_VERSION) {
+			remove_worker(socket, "protocol version " + std::to_string(version));
+			return;
+		}
+		worker.name = host_name + " (" + worker.name + ")";
+		worker.no_of_slots = std::max(1, int(no_of_slots));
+		std::cout << "Worker joined : " << worker.name.toStdString() << " with " << worker.no_of_slots << " slots\n";
+		dispatch();
+	} else if (type == SwarmProtocol::RESULT) {
+		quint64 job_id;
+		OptimizationResults results;
+		stream >> job_id >> results;
+		worker.job_ids.erase(job_id);
+
+		// a job re-sent after a missed heartbeat can come back twice, the first one wins
+		auto job_itr = outstanding_jobs_.find(job_id);
+		if (job_itr != outstanding_jobs_.end()) {
+			SwarmJob job = job_itr->second;
+			outstanding_jobs_.erase(job_itr);
+			emit send_sim_results(job.group_id, job.thread_id, job.iteration, job.swarm_params, results);
+		}
+		dispatch();
+	}
+	// heartbeats only need last_message_ms updated
+}
+
+void SwarmCoordinator::worker_disconnected() {
+	remove_worker(qobject_cast<QTcpSocket*>(sender()), "disconnected");
+}
+
+void SwarmCoordinator::check_heartbeats() {
+	std::vector<QTcpSocket*> lost_workers;
+	for (auto& worker : workers_) {
+		if (clock_.elapsed() - worker.second.last_message_ms > SwarmProtocol::HEARTBEAT_TIMEOUT_MS) {
+			lost_workers.push_back(worker.first);
+		} else {
+			SwarmProtocol::send(worker.first, SwarmProtocol::HEARTBEAT);
+		}
+	}
+	for (auto& socket : lost_workers) {
+		remove_worker(socket, "missed heartbeats");
+	}
+}
+
+void SwarmCoordinator::remove_worker(QTcpSocket* socket, const std::string& reason) {
+	auto worker = workers_.find(socket);
+	if (worker == workers_.end()) {
+		return;
+	}
+
+	// put its jobs back at the front so they don't wait behind the rest of the iteration
+	int no_of_requeued_jobs = 0;
+	for (auto job_id = worker->second.job_ids.rbegin(); job_id != worker->second.job_ids.rend(); ++job_id) {
+		if (outstanding_jobs_.find(*job_id) != outstanding_jobs_.end()) {
+			pending_jobs_.push_front(*job_id);
+			no_of_requeued_jobs++;
+		}
+	}
+	std::cout << "Worker lost : " << worker->second.name.toStdString() << " (" << reason << "), re-queued "
+		<< no_of_requeued_jobs << " jobs\n";
+
+	workers_.erase(worker);
+	socket->disconnect(this);
+	socket->abort();
+	socket->deleteLater();
+
+	dispatch();
+}
+
+void SwarmCoordinator::dispatch() {
+	for (auto& worker : workers_) {
+		while (int(worker.second.job_ids.size()) < worker.second.no_of_slots && pending_jobs_.size() > 0) {
+			quint64 job_id = pending_jobs_.front();
+			pending_jobs_.pop_front();
+
+			auto job_itr = outstanding_jobs_.find(job_id);
+			if (job_itr == outstanding_jobs_.end()) {
+				continue;
+			}
+			const SwarmJob& job = job_itr->second;
+
+			QByteArray body;
+			QDataStream stream(&body, QIODevice::WriteOnly);
+			SwarmProtocol::init_stream(stream);
+			stream << job.job_id << qint32(job.group_id) << qint32(job.thread_id) << qint32(job.iteration) << job.swarm_params;
+			SwarmProtocol::send(worker.first, SwarmProtocol::JOB, body);
+
+			worker.second.job_ids.insert(job_id);
+		}
+	}
+
+	if (workers_.empty() && pending_jobs_.size() > 0) {
+		std::cout << "Waiting for workers, " << pending_jobs_.size() << " jobs queued\n";
+	}
+}
+
+SwarmJobRunnable::SwarmJobRunnable(SimulatorThread* sim_thread, QMutex* lock, std::set<SimulatorThread*>* running_sims) :
+	sim_thread_(sim_thread), lock_(lock), running_sims_(running_sims) {
+	sim_thread_->setAutoDelete(false);
+}
+
+// after run, or when the pool is cleared before it started
+SwarmJobRunnable::~SwarmJobRunnable() {
+	{
+		QMutexLocker locker(lock_);
+		running_sims_->erase(sim_thread_);
+	}
+	delete sim_thread_;
+}
+
+void SwarmJobRunnable::run() {
+	sim_thread_->run();
+}
+
+SwarmWorker::SwarmWorker(const QString& host, quint16 port, int no_of_threads, QObject* parent) :
+	QObject(parent), host_(host), port_(port), no_of_threads_(no_of_threads), last_message_ms_(0), connection_id_(0) {
+	if (no_of_threads_ <= 0) {
+		no_of_threads_ = QThread::idealThreadCount();
+	}
+	thread_pool_.setMaxThreadCount(no_of_threads_);
+	clock_.start();
+
+	reconnect_timer_.setSingleShot(true);
+	connect(&reconnect_timer_, SIGNAL(timeout()), this, SLOT(connect_to_coordinator()));
+	connect(&heartbeat_timer_, SIGNAL(timeout()), this, SLOT(send_heartbeat()));
+	connect(&socket_, SIGNAL(connected()), this, SLOT(send_hello()));
+	connect(&socket_, SIGNAL(readyRead()), this, SLOT(read_coordinator()));
+	connect(&socket_, SIGNAL(disconnected()), this, SLOT(coordinator_lost()));
+	connect(&socket_, SIGNAL(error(QAbstractSocket::SocketError)), this, SLOT(coordinator_lost()));
+}
+
+void SwarmWorker::start() {
+	connect_to_coordinator();
+}
+
+void SwarmWorker::connect_to_coordinator() {
+	if (socket_.state() != QAbstractSocket::UnconnectedState) {
+		return;
+	}
+	buffer_.clear();
+	socket_.connectToHost(host_, port_);
+}
+
+void SwarmWorker::send_hello() {
+	connection_id_++;
+	last_message_ms_ = clock_.elapsed();
+	socket_.setSocketOption(QAbstractSocket::LowDelayOption, 1);
+
+	QByteArray body;
+	QDataStream stream(&body, QIODevice::WriteOnly);
+	SwarmProtocol::init_stream(stream);
+	stream << SwarmProtocol::PROTOCOL_VERSION << qint32(no_of_threads_) << QHostInfo::localHostName();
+	SwarmProtocol::send(&socket_, SwarmProtocol::HELLO, body);
+
+	heartbeat_timer_.start(SwarmProtocol::HEARTBEAT_INTERVAL_MS);
+	std::cout << "Connected to coordinator " << host_.toStdString() << ":" << port_ << " with " << no_of_threads_ << " threads\n";
+}
+
+void SwarmWorker::read_coordinator() {
+	last_message_ms_ = clock_.elapsed();
+	auto messages = SwarmProtocol::receive(&socket_, buffer_);
+	for (auto& message : messages) {
+		if (message.first == SwarmProtocol::JOB) {
+			run_job(message.second);
+		}
+	}
+}
+
+void SwarmWorker::coordinator_lost() {
+	// error and disconnected both land here
+	if (reconnect_timer_.isActive()) {
+		return;
+	}
+	reconnect_timer_.start(RECONNECT_INTERVAL_MS);
+	heartbeat_timer_.stop();
+	connection_id_++;
+	socket_.abort();
+
+	// the coordinator re-queues them anyway, don't hold the cores up with results nobody takes
+	int no_of_aborted_sims = 0;
+	{
+		QMutexLocker locker(&running_sims_lock_);
+		for (auto sim_thread : running_sims_) {
+			sim_thread->abort();
+		}
+		no_of_aborted_sims = running_sims_.size();
+		running_sims_.clear();
+	}
+	// outside the lock, the jobs that never started take themselves out of running_sims_ as they're deleted
+	thread_pool_.clear();
+	std::cout << "Lost coordinator " << host_.toStdString() << ":" << port_ << ", aborted " << no_of_aborted_sims
+		<< " simulations, retrying\n";
+}
+
+void SwarmWorker::send_heartbeat() {
+	if (clock_.elapsed() - last_message_ms_ > SwarmProtocol::HEARTBEAT_TIMEOUT_MS) {
+		coordinator_lost();
+		return;
+	}
+	SwarmProtocol::send(&socket_, SwarmProtocol::HEARTBEAT);
+}
+
+void SwarmWorker::run_job(const QByteArray& body) {
+	QDataStream stream(body);
+	SwarmProtocol::init_stream(stream);
+	quint64 job_id;
+	qint32 group_id, thread_id, iteration;
+	SwarmParams swarm_params;
+	stream >> job_id >> group_id >> thread_id >> iteration >> swarm_params;
+
+	// same as ParallelMCMCOptimizer::start_thread, the result signal is queued back to this thread
+	auto sim_thread = new SimulatorThread(group_id, thread_id, iteration, swarm_params);
+	int connection_id = connection_id_;
+	connect(sim_thread, &SimulatorThread::send_sim_results, this,
+		[this, job_id, connection_id](int, int, int, SwarmParams, OptimizationResults results) {
+		if (connection_id != connection_id_ || socket_.state() != QAbstractSocket::ConnectedState) {
+			return;
+		}
+		QByteArray result_body;
+		QDataStream result_stream(&result_body, QIODevice::WriteOnly);
+		SwarmProtocol::init_stream(result_stream);
+		result_stream << job_id << results;
+		SwarmProtocol::send(&socket_, SwarmProtocol::RESULT, result_body);
+	});
+
+	sim_thread->reset_sim();
+	{
+		QMutexLocker locker(&running_sims_lock_);
+		running_sims_.insert(sim_thread);
+	}
+	thread_pool_.start(new SwarmJobRunnable(sim_thread, &running_sims_lock_, &running_sims_));
+}
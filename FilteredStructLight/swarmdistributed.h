@@ -0,0 +1,156 @@
+#pragma once
+#include "fsl_common.h"
+#include "swarmutils.h"
+#include <QByteArray>
+#include <QDataStream>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QProcess>
+#include <QRunnable>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QThreadPool>
+#include <QTimer>
+#include <deque>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+QDataStream& operator<<(QDataStream& stream, const SwarmParams& params);
+QDataStream& operator>>(QDataStream& stream, SwarmParams& params);
+QDataStream& operator<<(QDataStream& stream, const OptimizationResults& results);
+QDataStream& operator>>(QDataStream& stream, OptimizationResults& results);
+
+// messages between the coordinator and the workers. every message is a quint32 length followed by
+// a QDataStream body starting with the message type
+class SwarmProtocol {
+public:
+	enum MessageType {
+		HELLO = 0,
+		JOB,
+		RESULT,
+		HEARTBEAT
+	};
+
+	static const quint32 PROTOCOL_VERSION;
+	static const int HEARTBEAT_INTERVAL_MS;
+	static const int HEARTBEAT_TIMEOUT_MS;
+
+	static void init_stream(QDataStream& stream);
+	static void send(QTcpSocket* socket, MessageType type, const QByteArray& body = QByteArray());
+	// appends whatever the socket has to buffer and pops every complete message off its front
+	static std::vector<std::pair<MessageType, QByteArray>> receive(QTcpSocket* socket, QByteArray& buffer);
+};
+
+struct SwarmJob {
+	quint64 job_id;
+	int group_id;
+	int thread_id;
+	int iteration;
+	SwarmParams swarm_params;
+};
+
+struct SwarmWorkerConnection {
+	QString name;
+	// 0 until the worker has said hello
+	int no_of_slots;
+	qint64 last_message_ms;
+	QByteArray buffer;
+	std::set<quint64> job_ids;
+};
+
+// hands simulator jobs to worker processes (FilteredStructLight --worker <host> <port>) instead of the local
+// thread pool. results come back through send_sim_results with the same arguments as SimulatorThread's, so the
+// optimizer doesn't care where a simulation ran. a worker that disconnects or misses heartbeats has its jobs
+// put back at the front of the queue. workers load floor plans themselves, so they need the same working directory
+class SwarmCoordinator : public QObject {
+	Q_OBJECT
+
+	QTcpServer server_;
+	QTimer heartbeat_timer_;
+	QElapsedTimer clock_;
+	quint64 next_job_id_;
+	// submitted and not answered yet
+	std::unordered_map<quint64, SwarmJob> outstanding_jobs_;
+	std::deque<quint64> pending_jobs_;
+	std::unordered_map<QTcpSocket*, SwarmWorkerConnection> workers_;
+	std::vector<QProcess*> local_workers_;
+
+public:
+	explicit SwarmCoordinator(QObject* parent = nullptr);
+	virtual ~SwarmCoordinator();
+
+	bool listen(quint16 port);
+	// spawns worker processes on this machine, splitting the cores between them
+	void start_local_workers(int no_of_workers);
+	void submit(int group_id, int thread_id, int iteration, const SwarmParams& swarm_params);
+	int get_no_of_workers() const;
+	int get_no_of_outstanding_jobs() const;
+
+public slots:
+	void accept_workers();
+	void read_worker();
+	void worker_disconnected();
+	void check_heartbeats();
+
+signals:
+	void send_sim_results(int group_id, int thread_id, int iteration, SwarmParams params, OptimizationResults results);
+
+private:
+	void handle_message(QTcpSocket* socket, SwarmProtocol::MessageType type, const QByteArray& body);
+	void remove_worker(QTcpSocket* socket, const std::string& reason);
+	void dispatch();
+};
+
+class SimulatorThread;
+
+// runs a worker's simulator on its pool. the simulator is taken out of running_sims before it's deleted, so
+// anything in there can be aborted while holding lock
+class SwarmJobRunnable : public QRunnable {
+	SimulatorThread* sim_thread_;
+	QMutex* lock_;
+	std::set<SimulatorThread*>* running_sims_;
+
+public:
+	SwarmJobRunnable(SimulatorThread* sim_thread, QMutex* lock, std::set<SimulatorThread*>* running_sims);
+	virtual ~SwarmJobRunnable();
+	void run() override;
+};
+
+// runs jobs from a coordinator on a local thread pool. keeps trying to reconnect when the coordinator goes away
+class SwarmWorker : public QObject {
+	Q_OBJECT
+
+	QString host_;
+	quint16 port_;
+	int no_of_threads_;
+	QTcpSocket socket_;
+	QByteArray buffer_;
+	QTimer heartbeat_timer_;
+	QTimer reconnect_timer_;
+	QElapsedTimer clock_;
+	qint64 last_message_ms_;
+	// results from simulations started on an earlier connection are dropped, the coordinator has re-queued them
+	int connection_id_;
+	// simulations of the current connection that haven't finished, aborted when it drops
+	QMutex running_sims_lock_;
+	std::set<SimulatorThread*> running_sims_;
+	// after the two above, so it's destroyed first and waits for the simulations
+	QThreadPool thread_pool_;
+
+	static const int RECONNECT_INTERVAL_MS;
+
+public:
+	SwarmWorker(const QString& host, quint16 port, int no_of_threads, QObject* parent = nullptr);
+	void start();
+
+public slots:
+	void connect_to_coordinator();
+	void send_hello();
+	void read_coordinator();
+	void coordinator_lost();
+	void send_heartbeat();
+
+private:
+	void run_job(const QByteArray& body);
+};
@@ -0,0 +1,127 @@
+#include "swarmframe.h"
+#include <QDir>
+#include <QRunnable>
+#include <QThread>
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+const int SwarmFrameRenderer::DEFAULT_CELL_SIZE = 4;
+const int SwarmFrameWriter::DEFAULT_MAX_QUEUED_FRAMES = 64;
+
+static cv::Vec3b to_bgr(const cv::Vec4f& color) {
+	return cv::Vec3b(cv::saturate_cast<uchar>(color[2] * 255.f), cv::saturate_cast<uchar>(color[1] * 255.f),
+		cv::saturate_cast<uchar>(color[0] * 255.f));
+}
+
+cv::Mat SwarmFrameRenderer::render(const SwarmOccupancyTree* occupancy_grid, const std::vector<Robot*>& robots,
+	const std::vector<cv::Vec4f>& robot_colors, const SimSampMap* heatmap, double desired_sampling, int cell_size) {
+	int grid_width = occupancy_grid->get_grid_width();
+	int grid_height = occupancy_grid->get_grid_height();
+	auto& explored_mask = occupancy_grid->get_explored_mask();
+
+	// the overlay colors of a live run, except that walls are grey so the floor plan shows before it's explored
+	cv::Vec4f cyan = cv::Vec4f(0.f, 255.f, 204.f, 255.f) / 255.f;
+	cv::Vec3b unexplored_color(255, 255, 255);
+	cv::Vec3b interior_color(200, 200, 200);
+	cv::Vec3b explored_color = to_bgr(cyan / 1.3f);
+	cv::Vec3b explored_interior_color = to_bgr(cyan / 2.f);
+
+	// one pixel per cell, scaled up once at the end
+	cv::Mat cells(grid_height, grid_width, CV_8UC3);
+	for (int z = 0; z < grid_height; ++z) {
+		auto row = cells.ptr<cv::Vec3b>(z);
+		for (int x = 0; x < grid_width; ++x) {
+			bool explored = explored_mask[z * grid_width + x] != 0;
+			if (occupancy_grid->at(x, z) == SwarmOccupancyTree::INTERIOR_MARK) {
+				row[x] = explored ? explored_interior_color : interior_color;
+			} else {
+				row[x] = explored ? explored_color : unexplored_color;
+			}
+		}
+	}
+
+	if (heatmap) {
+		for (auto index : heatmap->cells()) {
+			auto cell = heatmap->cell(index);
+			cells.at<cv::Vec3b>(cell.z, cell.x) = to_bgr(heatmap_color(0.0, desired_sampling, heatmap->value(index)));
+		}
+	}
+
+	cv::Mat frame;
+	cv::resize(cells, frame, cv::Size(), cell_size, cell_size, cv::INTER_NEAREST);
+
+	float pixels_per_unit = cell_size / occupancy_grid->get_grid_square_length();
+	int radius = std::max(2, cell_size * 3 / 2);
+	for (int i = 0; i < robots.size(); ++i) {
+		auto position = robots[i]->get_position();
+		cv::Point center(static_cast<int>(position.x * pixels_per_unit), static_cast<int>(position.z * pixels_per_unit));
+		cv::Vec3b color(0, 0, 0);
+		if (!robots[i]->is_dead() && i < robot_colors.size()) {
+			color = to_bgr(robot_colors[i]);
+		}
+		cv::circle(frame, center, radius, cv::Scalar(color[0], color[1], color[2]), -1);
+		// outline, the dark grey cluster and white would vanish against the floor otherwise
+		cv::circle(frame, center, radius, cv::Scalar(0, 0, 0), 1);
+	}
+
+	return frame;
+}
+
+cv::Vec4f SwarmFrameRenderer::heatmap_color(double minimum, double maximum, double unclamped_value) {
+	double value = std::max(std::min(unclamped_value, maximum), minimum);
+	double ratio = 2 * (value - minimum) / (maximum - minimum);
+	int b = int(std::max(0.0, 255 * (1 - ratio)));
+	int r = int(std::max(0.0, 255 * (ratio - 1)));
+	int g = 255 - b - r;
+	cv::Vec4f color(r, g, b, 255.f);
+	color /= 255.f;
+	return color;
+}
+
+class FrameEncodeJob : public QRunnable {
+	cv::Mat frame_;
+	std::string filename_;
+	QSemaphore* free_slots_;
+
+public:
+	FrameEncodeJob(const cv::Mat& frame, const std::string& filename, QSemaphore* free_slots)
+		: frame_(frame), filename_(filename), free_slots_(free_slots) {
+	}
+
+	void run() override {
+		cv::imwrite(filename_, frame_);
+		free_slots_->release();
+	}
+};
+
+SwarmFrameWriter::SwarmFrameWriter(const std::string& directory, int max_queued_frames) :
+	free_slots_(max_queued_frames), directory_(directory), frame_count_(0) {
+	QDir().mkpath(directory_.c_str());
+	// the simulation keeps a core, the rest encode
+	thread_pool_.setMaxThreadCount(std::max(1, QThread::idealThreadCount() - 1));
+}
+
+SwarmFrameWriter::~SwarmFrameWriter() {
+	wait();
+}
+
+void SwarmFrameWriter::write(const cv::Mat& frame) {
+	std::stringstream ss;
+	ss << directory_ << "/" << std::setfill('0') << std::setw(5) << frame_count_++ << ".png";
+
+	free_slots_.acquire();
+	thread_pool_.start(new FrameEncodeJob(frame, ss.str(), &free_slots_));
+}
+
+void SwarmFrameWriter::wait() {
+	thread_pool_.waitForDone();
+}
+
+int SwarmFrameWriter::get_frame_count() const {
+	return frame_count_;
+}
+
+const std::string& SwarmFrameWriter::get_directory() const {
+	return directory_;
+}
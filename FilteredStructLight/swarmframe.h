@@ -0,0 +1,42 @@
+#pragma once
+#include "swarmutils.h"
+#include <QSemaphore>
+#include <QThreadPool>
+#include <string>
+#include <vector>
+
+// draws the top down view straight from the grids, no gl context needed, so frames can come from the thread
+// running the simulation or from a headless run. a cell is cell_size x cell_size pixels, x to the right, z down
+class SwarmFrameRenderer {
+public:
+	static const int DEFAULT_CELL_SIZE;
+
+	// heatmap is null unless the simultaneous sampling layer should replace the explored colors of its cells
+	static cv::Mat render(const SwarmOccupancyTree* occupancy_grid, const std::vector<Robot*>& robots,
+		const std::vector<cv::Vec4f>& robot_colors, const SimSampMap* heatmap, double desired_sampling,
+		int cell_size = DEFAULT_CELL_SIZE);
+	// blue through green to red as value goes from minimum to maximum
+	static cv::Vec4f heatmap_color(double minimum, double maximum, double unclamped_value);
+};
+
+// numbered pngs written to a directory by a pool of its own, so whoever renders frames doesn't wait for png
+// compression. at most max_queued_frames are held, write blocks past that instead of a fast simulation
+// piling up frames in memory
+class SwarmFrameWriter {
+	QThreadPool thread_pool_;
+	QSemaphore free_slots_;
+	std::string directory_;
+	int frame_count_;
+
+public:
+	static const int DEFAULT_MAX_QUEUED_FRAMES;
+
+	explicit SwarmFrameWriter(const std::string& directory, int max_queued_frames = DEFAULT_MAX_QUEUED_FRAMES);
+	// waits for the queued frames
+	~SwarmFrameWriter();
+	// frame mustn't be written to afterwards, it's encoded later
+	void write(const cv::Mat& frame);
+	void wait();
+	int get_frame_count() const;
+	const std::string& get_directory() const;
+};
@@ -4,10 +4,12 @@
 #include <QtCore/qeventloop.h>
 #include <chrono>
 #include <fstream>
+#include <limits>
 #include <QtCore/qcoreapplication.h>
 #include <qthreadpool.h>
 #include "simulatorthread.h"
 #include "swarmutils.h"
+#include <QDir>
 #include <iomanip>
 
 
@@ -32,6 +34,10 @@ double SwarmOptimizer::separation_constant_;
 //double ParallelMCMCOptimizer::MAX_EXPLORE_VALUE = 10.0;
 //double ParallelMCMCOptimizer::MAX_BOUNCE_MULTIPLIER_VALUE = 50.0;
 
+// proposals are ranked by mean - kappa * deviation of the predicted score
+double ParallelMCMCOptimizer::SURROGATE_KAPPA = 1.0;
+int ParallelMCMCOptimizer::MIN_SURROGATE_POINTS = 16;
+
 double ParallelMCMCOptimizer::MIN_SEPARATION_VALUE = 1.0;
 double ParallelMCMCOptimizer::MIN_ALIGNMENT_VALUE = 0.0;
 double ParallelMCMCOptimizer::MIN_CLUSTER_VALUE = 0.0;
@@ -559,32 +565,30 @@ double ParallelMCMCOptimizer::MAX_BOUNCE_MULTIPLIER_VALUE = 0.2;
 
 ParallelMCMCOptimizer::ParallelMCMCOptimizer(const SwarmParams& swarm_params, const OptimizationParams& optimization_params, std::string& optimizer_filename) 
 	: swarm_params_(swarm_params), optimization_params_(optimization_params), optimizer_filename_(optimizer_filename), 
-	current_working_threads_(0), cull_threshold_(0.2f) {
+	current_working_threads_(0), cull_threshold_(0.2f), coordinator_(nullptr), surrogate_no_of_points_(0) {
 	VisibilityQuadrant::visbility_quadrant(swarm_params_.sensor_range_ * 2);
 }
 
-double ParallelMCMCOptimizer::init_value(double min, double max) {
-	std::random_device rd;
-	std::mt19937 mt(rd());
-	std::uniform_real_distribution<> uniform_real_distribution(min, max);
-
-	return uniform_real_distribution(mt);
+double ParallelMCMCOptimizer::init_value(CounterRng& rng, double min, double max) {
+	return rng.uniform(min, max);
 }
 
-double ParallelMCMCOptimizer::perturb_value(double current_value, double temperature, double min, double max) {
-
-	std::random_device rd;
-	std::mt19937 mt(rd());
-	std::normal_distribution<> normal_distribution(current_value, temperature);
+double ParallelMCMCOptimizer::perturb_value(CounterRng& rng, double current_value, double temperature, double min, double max) {
 
 	double perterbed_val;
-	perterbed_val = normal_distribution(mt);
+	perterbed_val = rng.normal(current_value, temperature);
 
 	perterbed_val = std::max(min, std::min(max, perterbed_val));
 
 	return perterbed_val;
 }
 
+// draws for a chain step only depend on the seed and (temperature, thread, iteration), not on the order results come back in
+CounterRng ParallelMCMCOptimizer::create_rng(int temperature, int thread_id, int iteration, CounterRng::Domain domain) const {
+	int stream = temperature * optimization_params_.no_of_threads + thread_id;
+	return CounterRng(swarm_params_.seed_, stream, iteration, domain);
+}
+
 SimulatorThread* ParallelMCMCOptimizer::init_mcmc_thread(int temperature, int thread_id, int iteration, const MCMCParams& mcmc_params) {
 
 	//seperation_constant = perturb_value(current_params.separation_constant, temperature, 0.0, 10.0);
@@ -631,12 +635,13 @@ SimulatorThread* ParallelMCMCOptimizer::init_mcmc_thread(int temperature, int th
 	// let's randomly keep 20%, and re-initialize the rest
 
 	if (!keep_original) {
+		auto rng = create_rng(temperature, thread_id, iteration, CounterRng::MCMC_INIT);
 
 		//next_params.swarm_params.coverage_needed_ = swarm_params_.coverage_needed_;
-		next_params.swarm_params.separation_constant_ = init_value(MIN_SEPARATION_VALUE, MAX_SEPARATION_VALUE);
-		next_params.swarm_params.alignment_constant_ = init_value(MIN_ALIGNMENT_VALUE, MAX_ALIGNMENT_VALUE);
-		next_params.swarm_params.cluster_constant_ = init_value(MIN_CLUSTER_VALUE, MAX_CLUSTER_VALUE);
-		next_params.swarm_params.explore_constant_ = init_value(MIN_EXPLORE_VALUE, MAX_EXPLORE_VALUE);
+		next_params.swarm_params.separation_constant_ = init_value(rng, MIN_SEPARATION_VALUE, MAX_SEPARATION_VALUE);
+		next_params.swarm_params.alignment_constant_ = init_value(rng, MIN_ALIGNMENT_VALUE, MAX_ALIGNMENT_VALUE);
+		next_params.swarm_params.cluster_constant_ = init_value(rng, MIN_CLUSTER_VALUE, MAX_CLUSTER_VALUE);
+		next_params.swarm_params.explore_constant_ = init_value(rng, MIN_EXPLORE_VALUE, MAX_EXPLORE_VALUE);
 		//next_params.swarm_params.bounce_function_multiplier_ = init_value(0.0, 100.0);
 		//next_params.swarm_params.separation_range_max_ = init_value(0.0, 5.0);
 
@@ -647,39 +652,8 @@ SimulatorThread* ParallelMCMCOptimizer::init_mcmc_thread(int temperature, int th
 	return simulator_thread;
 }
 
-SimulatorThread* ParallelMCMCOptimizer::get_next_mcmc(int temperature, int thread_id, int iteration) {
-
-	double next_score = next_results_map_[temperature][thread_id].score;
-	double best_score = best_results_map_[temperature][thread_id].score;
-	double current_score = current_results_map_[temperature][thread_id].score;
-
-
-	if (next_score < best_score) {
-		best_results_map_[temperature][thread_id] = next_results_map_[temperature][thread_id];
-		result_progression_map_[temperature][thread_id].push_back(next_results_map_[temperature][thread_id]);
-	}
-
-	double uniform_random_value = init_value(0.0, 1.0);
-
-	if ((next_score <= current_score)
-		|| ((next_score / current_score) >= uniform_random_value)) {
-		current_results_map_[temperature][thread_id] = next_results_map_[temperature][thread_id];
-	}
-
-	double seperation_constant, alignment_constant, cluster_constant, explore_constant;
-
-	MCMCParams current_mcmc_params = current_results_map_[temperature][thread_id];
-
-
-	// randomly pick a parameter
-	int no_of_params_to_perturb;
-	std::random_device rd;
-	std::mt19937 mt(rd());
-	//std::uniform_int_distribution<> uniform_int_distribution(0, 5);
-	//std::uniform_int_distribution<> uniform_int_distribution(0, 3);
-	std::uniform_int_distribution<> uniform_int_distribution(0, 3);
-	
-	int param_index = uniform_int_distribution(mt);
+MCMCParams ParallelMCMCOptimizer::perturb_params(CounterRng& rng, const MCMCParams& current_mcmc_params, int temperature) {
+	int param_index = rng.uniform_int(0, 3);
 
 	//auto& current_params = current_mcmc_params.swarm_params;
 	//seperation_constant = current_params.separation_constant_;
@@ -694,27 +668,27 @@ SimulatorThread* ParallelMCMCOptimizer::get_next_mcmc(int temperature, int threa
 
 	switch (param_index) {
 	case 0: {
-		next_mcmc_params.swarm_params.explore_constant_ = perturb_value(next_mcmc_params.swarm_params.explore_constant_,
+		next_mcmc_params.swarm_params.explore_constant_ = perturb_value(rng, next_mcmc_params.swarm_params.explore_constant_,
 			temperatures_[temperature], MIN_EXPLORE_VALUE, MAX_EXPLORE_VALUE);
 		break;
 	}
 	case 1: {
-		next_mcmc_params.swarm_params.alignment_constant_ = perturb_value(next_mcmc_params.swarm_params.alignment_constant_, 
+		next_mcmc_params.swarm_params.alignment_constant_ = perturb_value(rng, next_mcmc_params.swarm_params.alignment_constant_, 
 			temperatures_[temperature], MIN_ALIGNMENT_VALUE, MAX_ALIGNMENT_VALUE);
 		break;
 	}
 	case 2: {
-		next_mcmc_params.swarm_params.cluster_constant_ = perturb_value(next_mcmc_params.swarm_params.cluster_constant_, 
+		next_mcmc_params.swarm_params.cluster_constant_ = perturb_value(rng, next_mcmc_params.swarm_params.cluster_constant_, 
 			temperatures_[temperature], MIN_CLUSTER_VALUE, MAX_CLUSTER_VALUE);
 		break;
 	}
 	case 3: {
-		next_mcmc_params.swarm_params.separation_constant_ = perturb_value(next_mcmc_params.swarm_params.separation_constant_, 
+		next_mcmc_params.swarm_params.separation_constant_ = perturb_value(rng, next_mcmc_params.swarm_params.separation_constant_, 
 			temperatures_[temperature], MIN_SEPARATION_VALUE, MAX_SEPARATION_VALUE);
 		break;
 	}
 	case 4: {
-		next_mcmc_params.swarm_params.bounce_function_multiplier_ = perturb_value(next_mcmc_params.swarm_params.bounce_function_multiplier_,
+		next_mcmc_params.swarm_params.bounce_function_multiplier_ = perturb_value(rng, next_mcmc_params.swarm_params.bounce_function_multiplier_,
 			temperatures_[temperature], MIN_BOUNCE_MULTIPLIER_VALUE, MAX_BOUNCE_MULTIPLIER_VALUE);
 		break;
 	}
@@ -726,6 +700,127 @@ SimulatorThread* ParallelMCMCOptimizer::get_next_mcmc(int temperature, int threa
 
 	}
 
+	return next_mcmc_params;
+}
+
+std::vector<double> ParallelMCMCOptimizer::get_surrogate_point(const SwarmParams& swarm_params) const {
+	double values[SwarmResultCache::NO_OF_OPTIMIZED_VALUES];
+	SwarmResultCache::get_optimized_values(swarm_params, values);
+	double min_values[] = { MIN_EXPLORE_VALUE, MIN_ALIGNMENT_VALUE, MIN_CLUSTER_VALUE, MIN_SEPARATION_VALUE, MIN_BOUNCE_MULTIPLIER_VALUE };
+	double max_values[] = { MAX_EXPLORE_VALUE, MAX_ALIGNMENT_VALUE, MAX_CLUSTER_VALUE, MAX_SEPARATION_VALUE, MAX_BOUNCE_MULTIPLIER_VALUE };
+
+	std::vector<double> point(SwarmResultCache::NO_OF_OPTIMIZED_VALUES);
+	for (int i = 0; i < point.size(); ++i) {
+		point[i] = (values[i] - min_values[i]) / (max_values[i] - min_values[i]);
+	}
+	return point;
+}
+
+void ParallelMCMCOptimizer::fit_surrogate() {
+	auto evaluations = SwarmResultCache::get_evaluations(swarm_params_);
+	if (evaluations.size() == surrogate_no_of_points_ || evaluations.size() < MIN_SURROGATE_POINTS) {
+		return;
+	}
+	surrogate_no_of_points_ = evaluations.size();
+
+	// scored with this run's coefficients, the cache only keeps the raw results
+	std::vector<std::vector<double>> points;
+	std::vector<double> scores;
+	for (auto& evaluation : evaluations) {
+		SwarmParams params = swarm_params_;
+		params.explore_constant_ = evaluation.values[0];
+		params.alignment_constant_ = evaluation.values[1];
+		params.cluster_constant_ = evaluation.values[2];
+		params.separation_constant_ = evaluation.values[3];
+		params.bounce_function_multiplier_ = evaluation.values[4];
+
+		OptimizationResults scores_per_term;
+		scores.push_back(SwarmUtils::calculate_score(params, evaluation.results, optimization_params_.coefficients,
+			TIME_AND_SIMUL_SAMPLING_AND_MULTI_SAMPLING_COVERAGE, scores_per_term));
+		points.push_back(get_surrogate_point(params));
+	}
+	surrogate_.fit(points, scores);
+}
+
+bool ParallelMCMCOptimizer::answer_from_cache(SimulatorThread* sim_thread) {
+	OptimizationResults results;
+	if (!optimization_params_.use_result_cache || !SwarmResultCache::lookup(sim_thread->get_swarm_params(), results)) {
+		return false;
+	}
+
+	// queued so it arrives like any other result, restart_work is usually what called us
+	current_working_threads_++;
+	QMetaObject::invokeMethod(this, "restart_work", Qt::QueuedConnection,
+		Q_ARG(int, sim_thread->get_group_id()), Q_ARG(int, sim_thread->get_thread_id()), Q_ARG(int, sim_thread->get_iteration()),
+		Q_ARG(SwarmParams, sim_thread->get_swarm_params()), Q_ARG(OptimizationResults, results));
+	delete sim_thread;
+	return true;
+}
+
+// simulations handed to workers aren't recorded, only the ones on this machine
+void ParallelMCMCOptimizer::set_trace_filename(SimulatorThread* sim_thread) {
+	if (!optimization_params_.record_traces) {
+		return;
+	}
+
+	auto swarm_config_filename = sim_thread->get_swarm_params().config_name_.toStdString();
+	auto trace_dir = swarm_config_filename.substr(0, swarm_config_filename.rfind(".")) + "_traces";
+	QDir().mkpath(trace_dir.c_str());
+	sim_thread->set_trace_filename(trace_dir + "/" + std::to_string(sim_thread->get_group_id()) + "_"
+		+ std::to_string(sim_thread->get_thread_id()) + "_" + std::to_string(sim_thread->get_iteration()) + ".swtr");
+}
+
+SimulatorThread* ParallelMCMCOptimizer::get_next_mcmc(int temperature, int thread_id, int iteration) {
+
+	double next_score = next_results_map_[temperature][thread_id].score;
+	double best_score = best_results_map_[temperature][thread_id].score;
+	double current_score = current_results_map_[temperature][thread_id].score;
+
+
+	if (next_score < best_score) {
+		best_results_map_[temperature][thread_id] = next_results_map_[temperature][thread_id];
+		result_progression_map_[temperature][thread_id].push_back(next_results_map_[temperature][thread_id]);
+	}
+
+	auto accept_rng = create_rng(temperature, thread_id, iteration, CounterRng::MCMC_ACCEPT);
+	double uniform_random_value = init_value(accept_rng, 0.0, 1.0);
+
+	if ((next_score <= current_score)
+		|| ((next_score / current_score) >= uniform_random_value)) {
+		current_results_map_[temperature][thread_id] = next_results_map_[temperature][thread_id];
+	}
+
+	double seperation_constant, alignment_constant, cluster_constant, explore_constant;
+
+	MCMCParams current_mcmc_params = current_results_map_[temperature][thread_id];
+
+
+	// randomly pick a parameter
+	int no_of_params_to_perturb;
+	auto rng = create_rng(temperature, thread_id, iteration, CounterRng::MCMC_PERTURB);
+	//std::uniform_int_distribution<> uniform_int_distribution(0, 5);
+	//std::uniform_int_distribution<> uniform_int_distribution(0, 3);
+	
+	auto next_mcmc_params = perturb_params(rng, current_mcmc_params, temperature);
+
+	// more proposals from the same stream, only the one the surrogate rates best gets simulated
+	if (optimization_params_.surrogate_candidates > 1) {
+		fit_surrogate();
+		if (surrogate_.is_fitted()) {
+			double mean, deviation;
+			surrogate_.predict(get_surrogate_point(next_mcmc_params.swarm_params), mean, deviation);
+			double best_bound = mean - SURROGATE_KAPPA * deviation;
+			for (int i = 1; i < optimization_params_.surrogate_candidates; ++i) {
+				auto candidate_params = perturb_params(rng, current_mcmc_params, temperature);
+				surrogate_.predict(get_surrogate_point(candidate_params.swarm_params), mean, deviation);
+				if (mean - SURROGATE_KAPPA * deviation < best_bound) {
+					best_bound = mean - SURROGATE_KAPPA * deviation;
+					next_mcmc_params = candidate_params;
+				}
+			}
+		}
+	}
+
 
 
 	//SwarmParams& next_params = next_mcmc_params.swarm_params;
@@ -900,10 +995,36 @@ void ParallelMCMCOptimizer::refill_queue(int temperature, int thread_id, int ite
 //}
 
 ParallelMCMCOptimizer::~ParallelMCMCOptimizer() {
+	if (coordinator_) {
+		delete coordinator_;
+	}
+}
+
+int ParallelMCMCOptimizer::get_no_of_concurrent_sims() const {
+	// the coordinator queues jobs itself and hands them out as worker slots free up
+	if (coordinator_) {
+		return std::numeric_limits<int>::max();
+	}
+	return 2 * QThread::idealThreadCount();
 }
 
 void ParallelMCMCOptimizer::start_thread() {
 		auto sim_thread = simulator_threads_work_queue_.front();
+
+		if (answer_from_cache(sim_thread)) {
+			simulator_threads_work_queue_.pop_front();
+			return;
+		}
+
+		if (coordinator_) {
+			current_working_threads_++;
+			coordinator_->submit(sim_thread->get_group_id(), sim_thread->get_thread_id(), sim_thread->get_iteration(),
+				sim_thread->get_swarm_params());
+			simulator_threads_work_queue_.pop_front();
+			delete sim_thread;
+			return;
+		}
+
 		//connect(sim_thread,
 		//	SIGNAL(send_sim_results(int, int, int, double, double, double, double, double, double, double, double, double)),
 		//	this,
@@ -916,6 +1037,7 @@ void ParallelMCMCOptimizer::start_thread() {
 
 
 		current_working_threads_++;
+		set_trace_filename(sim_thread);
 		sim_thread->reset_sim();
 		thread_pool_.start(sim_thread);
 
@@ -949,15 +1071,13 @@ void ParallelMCMCOptimizer::run_optimizer() {
 	//cull_threshold_ = 0.2;
 
 
-	std::random_device rd;
-	std::mt19937 eng(rd());
-	std::uniform_real_distribution<float> dist(0.f, 1.f);
 	float percentage_to_seed_with_original = 0.2f;
 
 	// init threads, data structs
 	for (int temperature = 0; temperature < temperatures_.size(); ++temperature) {
 		for (int thread_id = 0; thread_id < optimization_params_.no_of_threads; ++thread_id) {
-			bool keep_original = (dist(eng) < percentage_to_seed_with_original);
+			auto rng = create_rng(temperature, thread_id, 0, CounterRng::MCMC_SEED_ORIGINAL);
+			bool keep_original = (rng.uniform() < percentage_to_seed_with_original);
 			auto simulator_thread = init_mcmc_thread(temperature, thread_id, 1, keep_original);
 
 			simulator_threads_work_queue_.push_back(simulator_thread);
@@ -983,6 +1103,24 @@ void ParallelMCMCOptimizer::run_optimizer() {
 	//	this,
 	//	&ParallelMCMCOptimizer::restart_work);
 
+	if (optimization_params_.distributed_port > 0) {
+		coordinator_ = new SwarmCoordinator();
+		if (coordinator_->listen(optimization_params_.distributed_port)) {
+			connect(coordinator_,
+				SIGNAL(send_sim_results(int, int, int, SwarmParams, OptimizationResults)),
+				this,
+				SLOT(restart_work(int, int, int, SwarmParams, OptimizationResults)));
+			coordinator_->start_local_workers(optimization_params_.no_of_local_workers);
+		} else {
+			std::cout << "Running the optimizer on the local thread pool instead\n";
+			delete coordinator_;
+			coordinator_ = nullptr;
+		}
+	}
+
+	// enough idle grids and robots for every simulation that can finish before the next batch is reset
+	SimulationStatePool::set_max_no_of_states(2 * QThread::idealThreadCount());
+
 	begin_time_ = std::chrono::steady_clock::now();
 
 	std::cout << "ideal thread count : " << QThread::idealThreadCount() << "\n";
@@ -991,7 +1129,7 @@ void ParallelMCMCOptimizer::run_optimizer() {
 
 	current_working_threads_ = 0;
 
-	for (int i = 0; i < 2 * QThread::idealThreadCount() && simulator_threads_work_queue_.size() > 0; ++i) {
+	for (int i = 0; i < get_no_of_concurrent_sims() && simulator_threads_work_queue_.size() > 0; ++i) {
 		start_thread();
 	}
 
@@ -1092,6 +1230,10 @@ void ParallelMCMCOptimizer::restart_work(int group_id, int thread_id, int iterat
 	next_params.scores = scores;
 	//next_params.score = calculate_score(next_params, MULTI_SAMPLING_ONLY);
 
+	if (optimization_params_.use_result_cache) {
+		SwarmResultCache::insert(params, results);
+	}
+
 	//std::cout << "score : " << next_params.score << "\n";
 	next_results_map_[group_id][thread_id] = next_params;
 
@@ -1124,7 +1266,7 @@ void ParallelMCMCOptimizer::restart_work(int group_id, int thread_id, int iterat
 	} else if (iteration % optimization_params_.culling_nth_iteration == 0) {
 		if (current_working_threads_ == 0) {
 			cull_and_refill_queue(iteration);
-			for (int i = 0; i < 2 * QThread::idealThreadCount() && simulator_threads_work_queue_.size() > 0; ++i) {
+			for (int i = 0; i < get_no_of_concurrent_sims() && simulator_threads_work_queue_.size() > 0; ++i) {
 				start_thread();
 			}
 		}
@@ -1167,8 +1309,12 @@ void ParallelMCMCOptimizer::restart_work(int group_id, int thread_id, int iterat
 		print_progression_results_2(swarm_params_.config_name_.toStdString());
 		print_best_results_progression(swarm_params_.config_name_.toStdString());
 		write_out_best_results();
+#ifdef SWARM_PROFILE
+		SimProfile::write_summary(SwarmUtils::get_optimizer_results_filename(swarm_params_.config_name_.toStdString(), "profile"));
+#endif
 		//std::cout << "Work done!\n No. of active threads : " << thread_pool_.activeThreadCount() << "\n";
 		thread_pool_.waitForDone();
+		SimulationStatePool::clear();
 		emit finished();
 	}	
 
@@ -3,6 +3,9 @@
 #include <qthreadpool.h>
 #include "simulatorthread.h"
 #include <chrono>
+#include "counterrng.h"
+#include "swarmdistributed.h"
+#include "swarmresultcache.h"
 
 class SwarmOptimizer : public QObject {
 	Q_OBJECT
@@ -80,6 +83,13 @@ class ParallelMCMCOptimizer : public QObject {
 	std::vector<float> temperatures_;
 	//BridgeObject* bridge_;
 	int current_working_threads_;
+	// null unless optimization_params_.distributed_port is set, simulations then run on worker processes
+	SwarmCoordinator* coordinator_;
+	// refit whenever the result cache has more points for this config
+	SwarmSurrogate surrogate_;
+	int surrogate_no_of_points_;
+	static double SURROGATE_KAPPA;
+	static int MIN_SURROGATE_POINTS;
 	std::chrono::high_resolution_clock::time_point begin_time_;
 	std::chrono::high_resolution_clock::time_point end_time_;
 	SwarmParams swarm_params_;
@@ -98,11 +108,17 @@ class ParallelMCMCOptimizer : public QObject {
 public:
 	ParallelMCMCOptimizer(const SwarmParams& swarm_params, const OptimizationParams& optimization_params, std::string& optimizer_filename);
 
-	double init_value(double min, double max);
-	double perturb_value(double current_value, double temperature, double min, double max);
+	double init_value(CounterRng& rng, double min, double max);
+	double perturb_value(CounterRng& rng, double current_value, double temperature, double min, double max);
+	CounterRng create_rng(int temperature, int thread_id, int iteration, CounterRng::Domain domain) const;
 	SimulatorThread* init_mcmc_thread(int temperature, int thread_id, int iteration, const MCMCParams& next_params);
 	SimulatorThread* init_mcmc_thread(int temperature, int thread_id, int iteration, bool keep_original);
 	SimulatorThread* get_next_mcmc(int temperature, int thread_id, int iteration);
+	MCMCParams perturb_params(CounterRng& rng, const MCMCParams& current_mcmc_params, int temperature);
+	std::vector<double> get_surrogate_point(const SwarmParams& swarm_params) const;
+	void fit_surrogate();
+	bool answer_from_cache(SimulatorThread* sim_thread);
+	void set_trace_filename(SimulatorThread* sim_thread);
 	void refill_queue_with_single_next_mcmc_thread(int temperature, int thread_id, int iteration);
 	void print_results(std::string swarm_config_filename);
 	MCMCParams get_best_results();
@@ -114,6 +130,7 @@ public:
 	//void set_viewer(SwarmViewer* swarm_viewer);
 	virtual ~ParallelMCMCOptimizer();
 	void start_thread();
+	int get_no_of_concurrent_sims() const;
 
 public slots:
 	void run_optimizer();
@@ -0,0 +1,260 @@
+#include "swarmresultcache.h"
+#include "floorplancache.h"
+#include "swarmdistributed.h"
+#include "simulatorthread.h"
+#include <QByteArray>
+#include <QDataStream>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <sstream>
+
+const char* SwarmResultCache::DEFAULT_FILENAME = "swarm_result_cache.csv";
+const double SwarmResultCache::QUANTUM = 1e-6;
+
+QMutex SwarmResultCache::lock_;
+bool SwarmResultCache::loaded_ = false;
+std::unordered_map<std::uint64_t, CachedEvaluation> SwarmResultCache::evaluations_;
+std::unordered_map<std::string, std::uint64_t> SwarmResultCache::floor_plan_hashes_;
+
+const int SwarmSurrogate::MAX_NO_OF_POINTS = 256;
+const double SwarmSurrogate::LENGTH_SCALE = 0.2;
+const double SwarmSurrogate::NOISE = 1e-2;
+
+static std::uint64_t hash_bytes(std::uint64_t hash, const char* data, int size) {
+	for (int i = 0; i < size; ++i) {
+		hash = (hash ^ static_cast<unsigned char>(data[i])) * 1099511628211ULL;
+	}
+	return hash;
+}
+
+void SwarmResultCache::get_optimized_values(const SwarmParams& swarm_params, double* values) {
+	values[0] = swarm_params.explore_constant_;
+	values[1] = swarm_params.alignment_constant_;
+	values[2] = swarm_params.cluster_constant_;
+	values[3] = swarm_params.separation_constant_;
+	values[4] = swarm_params.bounce_function_multiplier_;
+}
+
+// called with lock_ held
+std::uint64_t SwarmResultCache::get_config_key(const SwarmParams& swarm_params) {
+	SwarmParams config = swarm_params;
+	config.explore_constant_ = 0.0;
+	config.alignment_constant_ = 0.0;
+	config.cluster_constant_ = 0.0;
+	config.separation_constant_ = 0.0;
+	config.bounce_function_multiplier_ = 0.0;
+	// the same config loaded from a different path is still the same config
+	config.config_name_ = "";
+	// filled in when the grids and robots are created, so they differ before and after a reset
+	config.grid_width_ = 0;
+	config.grid_height_ = 0;
+	config.robots_in_a_cluster_ = 0;
+	// display only, they don't change the results
+	config.show_interior_ = false;
+	config.show_forces_ = false;
+	config.display_local_map_ = false;
+	config.local_map_robot_id_ = 0;
+	config.display_astar_path_ = false;
+	config.video_mode_ = false;
+	config.model_filename_ = "";
+
+	QByteArray bytes;
+	QDataStream stream(&bytes, QIODevice::WriteOnly);
+	SwarmProtocol::init_stream(stream);
+	stream << config;
+	std::uint64_t hash = hash_bytes(14695981039346656037ULL, reinterpret_cast<const char*>(&SimulatorThread::SIMULATOR_VERSION),
+		sizeof(SimulatorThread::SIMULATOR_VERSION));
+	hash = hash_bytes(hash, bytes.constData(), bytes.size());
+
+	std::string model_filename = swarm_params.model_matrix_filename_.toStdString();
+	auto floor_plan_hash = floor_plan_hashes_.find(model_filename);
+	if (floor_plan_hash == floor_plan_hashes_.end()) {
+		bool ok;
+		std::uint64_t content_hash = FloorPlanCache::hash_file(model_filename, ok);
+		floor_plan_hash = floor_plan_hashes_.insert(std::make_pair(model_filename, content_hash)).first;
+	}
+	return hash_bytes(hash, reinterpret_cast<const char*>(&floor_plan_hash->second), sizeof(std::uint64_t));
+}
+
+std::uint64_t SwarmResultCache::get_key(std::uint64_t config_key, const double* values) {
+	std::uint64_t hash = config_key;
+	for (int i = 0; i < NO_OF_OPTIMIZED_VALUES; ++i) {
+		std::int64_t quantized_value = std::llround(values[i] / QUANTUM);
+		hash = hash_bytes(hash, reinterpret_cast<const char*>(&quantized_value), sizeof(std::int64_t));
+	}
+	return hash;
+}
+
+void SwarmResultCache::load() {
+	if (loaded_) {
+		return;
+	}
+	loaded_ = true;
+
+	std::ifstream file(DEFAULT_FILENAME);
+	std::string line;
+	// header
+	std::getline(file, line);
+	while (std::getline(file, line)) {
+		std::replace(line.begin(), line.end(), ',', ' ');
+		std::stringstream line_stream(line);
+		CachedEvaluation evaluation;
+		line_stream >> std::hex >> evaluation.config_key >> evaluation.key >> std::dec;
+		for (int i = 0; i < NO_OF_OPTIMIZED_VALUES; ++i) {
+			line_stream >> evaluation.values[i];
+		}
+		line_stream >> evaluation.results.occlusion >> evaluation.results.multi_samping >> evaluation.results.density
+			>> evaluation.results.time_taken >> evaluation.results.simul_sampling >> evaluation.results.clustering;
+		if (line_stream) {
+			evaluations_[evaluation.key] = evaluation;
+		}
+	}
+	if (evaluations_.size() > 0) {
+		std::cout << "Loaded " << evaluations_.size() << " cached simulation results\n";
+	}
+}
+
+bool SwarmResultCache::lookup(const SwarmParams& swarm_params, OptimizationResults& results) {
+	QMutexLocker locker(&lock_);
+	load();
+
+	double values[NO_OF_OPTIMIZED_VALUES];
+	get_optimized_values(swarm_params, values);
+	auto evaluation = evaluations_.find(get_key(get_config_key(swarm_params), values));
+	if (evaluation == evaluations_.end()) {
+		return false;
+	}
+	results = evaluation->second.results;
+	return true;
+}
+
+void SwarmResultCache::insert(const SwarmParams& swarm_params, const OptimizationResults& results) {
+	QMutexLocker locker(&lock_);
+	load();
+
+	CachedEvaluation evaluation;
+	evaluation.config_key = get_config_key(swarm_params);
+	get_optimized_values(swarm_params, evaluation.values);
+	evaluation.key = get_key(evaluation.config_key, evaluation.values);
+	evaluation.results = results;
+	if (evaluations_.find(evaluation.key) != evaluations_.end()) {
+		return;
+	}
+	evaluations_[evaluation.key] = evaluation;
+
+	bool write_header = !std::ifstream(DEFAULT_FILENAME).good();
+	std::ofstream file(DEFAULT_FILENAME, std::ios::app);
+	if (write_header) {
+		file << "config_key,key,explore,alignment,cluster,separation,bounce_multiplier,"
+			<< "occlusion,multi_sampling,density,time_taken,simul_sampling,clustering\n";
+	}
+	file << std::hex << evaluation.config_key << "," << evaluation.key << std::dec << std::setprecision(17);
+	for (int i = 0; i < NO_OF_OPTIMIZED_VALUES; ++i) {
+		file << "," << evaluation.values[i];
+	}
+	file << "," << results.occlusion << "," << results.multi_samping << "," << results.density
+		<< "," << results.time_taken << "," << results.simul_sampling << "," << results.clustering << "\n";
+}
+
+std::vector<CachedEvaluation> SwarmResultCache::get_evaluations(const SwarmParams& swarm_params) {
+	QMutexLocker locker(&lock_);
+	load();
+
+	std::uint64_t config_key = get_config_key(swarm_params);
+	std::vector<CachedEvaluation> config_evaluations;
+	for (auto& evaluation : evaluations_) {
+		if (evaluation.second.config_key == config_key) {
+			config_evaluations.push_back(evaluation.second);
+		}
+	}
+	// unordered_map order isn't stable, the surrogate should fit the same points every run
+	std::sort(config_evaluations.begin(), config_evaluations.end(), [](const CachedEvaluation& a, const CachedEvaluation& b) {
+		return a.key < b.key;
+	});
+	return config_evaluations;
+}
+
+SwarmSurrogate::SwarmSurrogate() : score_mean_(0.0), score_variance_(1.0) {
+}
+
+double SwarmSurrogate::kernel(const std::vector<double>& a, const std::vector<double>& b) const {
+	double distance_squared = 0.0;
+	for (int i = 0; i < a.size(); ++i) {
+		distance_squared += (a[i] - b[i]) * (a[i] - b[i]);
+	}
+	return std::exp(-distance_squared / (2.0 * LENGTH_SCALE * LENGTH_SCALE));
+}
+
+void SwarmSurrogate::fit(const std::vector<std::vector<double>>& points, const std::vector<double>& scores) {
+	points_.clear();
+	if (points.empty()) {
+		return;
+	}
+
+	// the region around the best scores is the one proposals are made in
+	std::vector<int> order(points.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+		return scores[a] < scores[b];
+	});
+	if (order.size() > MAX_NO_OF_POINTS) {
+		order.resize(MAX_NO_OF_POINTS);
+	}
+
+	std::vector<double> fit_scores;
+	for (auto& index : order) {
+		points_.push_back(points[index]);
+		fit_scores.push_back(scores[index]);
+	}
+
+	int no_of_points = points_.size();
+	score_mean_ = std::accumulate(fit_scores.begin(), fit_scores.end(), 0.0) / no_of_points;
+	score_variance_ = 0.0;
+	for (auto& score : fit_scores) {
+		score_variance_ += (score - score_mean_) * (score - score_mean_);
+	}
+	score_variance_ = std::max(score_variance_ / no_of_points, 1e-12);
+	double score_deviation = std::sqrt(score_variance_);
+
+	cv::Mat covariance(no_of_points, no_of_points, CV_64F);
+	cv::Mat normalized_scores(no_of_points, 1, CV_64F);
+	for (int i = 0; i < no_of_points; ++i) {
+		for (int j = i; j < no_of_points; ++j) {
+			double value = kernel(points_[i], points_[j]);
+			covariance.at<double>(i, j) = value;
+			covariance.at<double>(j, i) = value;
+		}
+		covariance.at<double>(i, i) += NOISE;
+		normalized_scores.at<double>(i, 0) = (fit_scores[i] - score_mean_) / score_deviation;
+	}
+
+	inverse_covariance_ = covariance.inv(cv::DECOMP_CHOLESKY);
+	weights_ = inverse_covariance_ * normalized_scores;
+}
+
+bool SwarmSurrogate::is_fitted() const {
+	return points_.size() > 0;
+}
+
+void SwarmSurrogate::predict(const std::vector<double>& point, double& mean, double& deviation) const {
+	if (!is_fitted()) {
+		mean = 0.0;
+		deviation = 0.0;
+		return;
+	}
+
+	cv::Mat point_covariance(points_.size(), 1, CV_64F);
+	for (int i = 0; i < points_.size(); ++i) {
+		point_covariance.at<double>(i, 0) = kernel(point, points_[i]);
+	}
+
+	double score_deviation = std::sqrt(score_variance_);
+	mean = score_mean_ + point_covariance.dot(weights_) * score_deviation;
+	cv::Mat explained = point_covariance.t() * inverse_covariance_ * point_covariance;
+	double variance = 1.0 + NOISE - explained.at<double>(0, 0);
+	deviation = std::sqrt(std::max(variance, 0.0)) * score_deviation;
+}
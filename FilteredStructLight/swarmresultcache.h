@@ -0,0 +1,69 @@
+#pragma once
+#include "swarmutils.h"
+#include <QMutex>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct CachedEvaluation {
+	// hash of everything but the optimized constants
+	std::uint64_t config_key;
+	std::uint64_t key;
+	double values[5];
+	OptimizationResults results;
+};
+
+// results of every simulation the optimizer has run, appended to one csv so later runs and repeated sweeps
+// over the same configs don't simulate a parameter set twice. a run only depends on its SwarmParams (seed
+// included), the floor plan and the simulator, so the key hashes all three, SimulatorThread::SIMULATOR_VERSION
+// for the last, with the optimized constants rounded to QUANTUM
+class SwarmResultCache {
+public:
+	static const char* DEFAULT_FILENAME;
+	static const double QUANTUM;
+	static const int NO_OF_OPTIMIZED_VALUES = 5;
+
+	// explore, alignment, cluster, separation and bounce multiplier, the constants ParallelMCMCOptimizer moves
+	static void get_optimized_values(const SwarmParams& swarm_params, double* values);
+
+	static bool lookup(const SwarmParams& swarm_params, OptimizationResults& results);
+	static void insert(const SwarmParams& swarm_params, const OptimizationResults& results);
+	// every cached evaluation of the same config, for fitting a surrogate
+	static std::vector<CachedEvaluation> get_evaluations(const SwarmParams& swarm_params);
+
+private:
+	static std::uint64_t get_config_key(const SwarmParams& swarm_params);
+	static std::uint64_t get_key(std::uint64_t config_key, const double* values);
+	static void load();
+
+	static QMutex lock_;
+	static bool loaded_;
+	static std::unordered_map<std::uint64_t, CachedEvaluation> evaluations_;
+	// floor plan content hashes by filename, hashing the file on every lookup would cost more than the lookup saves
+	static std::unordered_map<std::string, std::uint64_t> floor_plan_hashes_;
+};
+
+// gaussian process over the normalized optimized values with a fixed rbf kernel. cheap enough to refit
+// every iteration on a few hundred points, and only used to rank candidate proposals
+class SwarmSurrogate {
+public:
+	static const int MAX_NO_OF_POINTS;
+	static const double LENGTH_SCALE;
+	static const double NOISE;
+
+	SwarmSurrogate();
+	// points are normalized to [0, 1]. keeps the best MAX_NO_OF_POINTS if there are more
+	void fit(const std::vector<std::vector<double>>& points, const std::vector<double>& scores);
+	bool is_fitted() const;
+	void predict(const std::vector<double>& point, double& mean, double& deviation) const;
+
+private:
+	double kernel(const std::vector<double>& a, const std::vector<double>& b) const;
+
+	std::vector<std::vector<double>> points_;
+	cv::Mat inverse_covariance_;
+	cv::Mat weights_;
+	double score_mean_;
+	double score_variance_;
+};
@@ -0,0 +1,351 @@
+#include "swarmtrace.h"
+#include "swarmdistributed.h"
+#include <QByteArray>
+#include <QDataStream>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <iterator>
+
+const char SwarmTrace::MAGIC[4] = { 'S', 'W', 'T', 'R' };
+const int SwarmTrace::VERSION = 1;
+const float SwarmTrace::POSITION_SCALE = 16.f;
+
+void SwarmTrace::put_varint(std::vector<unsigned char>& buffer, unsigned long long value) {
+	while (value >= 0x80) {
+		buffer.push_back(static_cast<unsigned char>(value | 0x80));
+		value >>= 7;
+	}
+	buffer.push_back(static_cast<unsigned char>(value));
+}
+
+void SwarmTrace::put_signed_varint(std::vector<unsigned char>& buffer, long long value) {
+	// zigzag, small negative deltas stay small
+	put_varint(buffer, (static_cast<unsigned long long>(value) << 1) ^ static_cast<unsigned long long>(value >> 63));
+}
+
+bool SwarmTrace::get_varint(const unsigned char*& current, const unsigned char* end, unsigned long long& value) {
+	value = 0;
+	for (int shift = 0; shift < 64; shift += 7) {
+		if (current == end) {
+			return false;
+		}
+		unsigned char byte = *current++;
+		value |= static_cast<unsigned long long>(byte & 0x7f) << shift;
+		if (!(byte & 0x80)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool SwarmTrace::get_signed_varint(const unsigned char*& current, const unsigned char* end, long long& value) {
+	unsigned long long zigzag;
+	if (!get_varint(current, end, zigzag)) {
+		return false;
+	}
+	value = static_cast<long long>(zigzag >> 1) ^ -static_cast<long long>(zigzag & 1);
+	return true;
+}
+
+int SwarmTrace::quantize(float value) {
+	return static_cast<int>(std::lround(value * POSITION_SCALE));
+}
+
+SwarmTraceRecorder::SwarmTraceRecorder() : occupancy_grid_(nullptr) {
+}
+
+SwarmTraceRecorder::~SwarmTraceRecorder() {
+	close();
+}
+
+bool SwarmTraceRecorder::open(const std::string& filename, const SwarmParams& swarm_params, SwarmOccupancyTree* occupancy_grid,
+	const std::vector<Robot*>& robots) {
+	close();
+	file_.open(filename, std::ios::binary | std::ios::trunc);
+	if (!file_.is_open()) {
+		std::cout << "Couldn't open trace " << filename << "\n";
+		return false;
+	}
+
+	QByteArray params_bytes;
+	QDataStream stream(&params_bytes, QIODevice::WriteOnly);
+	SwarmProtocol::init_stream(stream);
+	stream << swarm_params;
+
+	record_.clear();
+	record_.insert(record_.end(), SwarmTrace::MAGIC, SwarmTrace::MAGIC + 4);
+	SwarmTrace::put_varint(record_, SwarmTrace::VERSION);
+	SwarmTrace::put_varint(record_, params_bytes.size());
+	record_.insert(record_.end(), params_bytes.constData(), params_bytes.constData() + params_bytes.size());
+	SwarmTrace::put_varint(record_, robots.size());
+	SwarmTrace::put_signed_varint(record_, robots.size() > 0 ? SwarmTrace::quantize(robots[0]->get_position().y) : 0);
+	file_.write(reinterpret_cast<const char*>(&record_[0]), record_.size());
+
+	previous_x_.assign(robots.size(), 0);
+	previous_z_.assign(robots.size(), 0);
+	dead_.assign(robots.size(), 0);
+	cell_changes_.clear();
+	interior_changes_.clear();
+
+	occupancy_grid_ = occupancy_grid;
+	occupancy_grid_->set_journal(&cell_changes_, &interior_changes_);
+
+	write_record(robots);
+	return true;
+}
+
+void SwarmTraceRecorder::record_tick(const std::vector<Robot*>& robots) {
+	if (!is_open()) {
+		return;
+	}
+	write_record(robots);
+}
+
+void SwarmTraceRecorder::write_record(const std::vector<Robot*>& robots) {
+	record_.clear();
+	for (int i = 0; i < robots.size(); ++i) {
+		auto position = robots[i]->get_position();
+		int x = SwarmTrace::quantize(position.x);
+		int z = SwarmTrace::quantize(position.z);
+		SwarmTrace::put_signed_varint(record_, x - previous_x_[i]);
+		SwarmTrace::put_signed_varint(record_, z - previous_z_[i]);
+		previous_x_[i] = x;
+		previous_z_[i] = z;
+	}
+
+	// sorted so the index deltas are small and unsigned, stable so a cell changed twice in a tick keeps its last value
+	std::stable_sort(cell_changes_.begin(), cell_changes_.end(), [](const CellChange& a, const CellChange& b) {
+		return a.index < b.index;
+	});
+	SwarmTrace::put_varint(record_, cell_changes_.size());
+	int previous_index = 0;
+	for (auto& change : cell_changes_) {
+		SwarmTrace::put_varint(record_, change.index - previous_index);
+		SwarmTrace::put_signed_varint(record_, change.value);
+		previous_index = change.index;
+	}
+
+	std::sort(interior_changes_.begin(), interior_changes_.end());
+	SwarmTrace::put_varint(record_, interior_changes_.size());
+	previous_index = 0;
+	for (auto& index : interior_changes_) {
+		SwarmTrace::put_varint(record_, index - previous_index);
+		previous_index = index;
+	}
+
+	int no_of_deaths = 0;
+	for (int i = 0; i < robots.size(); ++i) {
+		if (!dead_[i] && robots[i]->is_dead()) {
+			no_of_deaths++;
+		}
+	}
+	SwarmTrace::put_varint(record_, no_of_deaths);
+	for (int i = 0; i < robots.size(); ++i) {
+		if (!dead_[i] && robots[i]->is_dead()) {
+			SwarmTrace::put_varint(record_, i);
+			dead_[i] = 1;
+		}
+	}
+
+	std::vector<unsigned char> record_size;
+	SwarmTrace::put_varint(record_size, record_.size());
+	file_.write(reinterpret_cast<const char*>(&record_size[0]), record_size.size());
+	file_.write(reinterpret_cast<const char*>(&record_[0]), record_.size());
+
+	cell_changes_.clear();
+	interior_changes_.clear();
+}
+
+void SwarmTraceRecorder::close() {
+	if (occupancy_grid_) {
+		occupancy_grid_->set_journal(nullptr, nullptr);
+		occupancy_grid_ = nullptr;
+	}
+	if (file_.is_open()) {
+		file_.close();
+	}
+}
+
+bool SwarmTraceRecorder::is_open() const {
+	return file_.is_open();
+}
+
+SwarmTraceReader::SwarmTraceReader() : no_of_robots_(0), no_of_ticks_(0), robot_height_(0.f) {
+}
+
+bool SwarmTraceReader::load(const std::string& filename) {
+	std::ifstream file(filename, std::ios::binary);
+	if (!file.is_open()) {
+		std::cout << "Couldn't open trace " << filename << "\n";
+		return false;
+	}
+	std::vector<unsigned char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+	const unsigned char* current = bytes.data();
+	const unsigned char* end = bytes.data() + bytes.size();
+	unsigned long long version, params_size, no_of_robots;
+	long long robot_height;
+	if (bytes.size() < 4 || !std::equal(SwarmTrace::MAGIC, SwarmTrace::MAGIC + 4, current)) {
+		std::cout << filename << " isn't a swarm trace\n";
+		return false;
+	}
+	current += 4;
+	if (!SwarmTrace::get_varint(current, end, version) || version != SwarmTrace::VERSION) {
+		std::cout << filename << " is a trace version this build can't read\n";
+		return false;
+	}
+	if (!SwarmTrace::get_varint(current, end, params_size) || params_size > static_cast<unsigned long long>(end - current)) {
+		std::cout << filename << " is truncated\n";
+		return false;
+	}
+	QByteArray params_bytes(reinterpret_cast<const char*>(current), params_size);
+	QDataStream stream(params_bytes);
+	SwarmProtocol::init_stream(stream);
+	stream >> swarm_params_;
+	current += params_size;
+	if (!SwarmTrace::get_varint(current, end, no_of_robots) || !SwarmTrace::get_signed_varint(current, end, robot_height)) {
+		std::cout << filename << " is truncated\n";
+		return false;
+	}
+	no_of_robots_ = no_of_robots;
+	robot_height_ = robot_height / SwarmTrace::POSITION_SCALE;
+
+	int grid_width = swarm_params_.grid_width_;
+	int grid_size = swarm_params_.grid_width_ * swarm_params_.grid_height_;
+	std::vector<char> explored(grid_size, 0);
+	std::vector<long long> x(no_of_robots_, 0);
+	std::vector<long long> z(no_of_robots_, 0);
+
+	positions_.clear();
+	cell_changes_.clear();
+	interior_changes_.clear();
+	cell_change_offsets_.assign(1, 0);
+	interior_change_offsets_.assign(1, 0);
+	death_ticks_.clear();
+	no_of_ticks_ = 0;
+	std::vector<int> deaths;
+
+	// a record that doesn't decode is where the run stopped writing, everything before it is kept
+	while (current != end) {
+		unsigned long long record_size;
+		if (!SwarmTrace::get_varint(current, end, record_size) || record_size > static_cast<unsigned long long>(end - current)) {
+			break;
+		}
+		const unsigned char* record_end = current + record_size;
+		bool complete = true;
+
+		auto no_of_positions = positions_.size();
+		auto no_of_cell_changes = cell_changes_.size();
+		auto no_of_interior_changes = interior_changes_.size();
+
+		for (int i = 0; i < no_of_robots_ && complete; ++i) {
+			long long dx, dz;
+			complete = SwarmTrace::get_signed_varint(current, record_end, dx) && SwarmTrace::get_signed_varint(current, record_end, dz);
+			x[i] += dx;
+			z[i] += dz;
+			positions_.push_back(glm::vec3(x[i] / SwarmTrace::POSITION_SCALE, robot_height_, z[i] / SwarmTrace::POSITION_SCALE));
+		}
+
+		unsigned long long count, delta;
+		long long value;
+		long long index = 0;
+		complete = complete && SwarmTrace::get_varint(current, record_end, count);
+		for (unsigned long long i = 0; i < count && complete; ++i) {
+			complete = SwarmTrace::get_varint(current, record_end, delta) && SwarmTrace::get_signed_varint(current, record_end, value);
+			index += delta;
+			complete = complete && index < grid_size;
+			if (complete) {
+				TraceCellChange change;
+				change.grid_position = glm::ivec3(index % grid_width, 0, index / grid_width);
+				change.value = value;
+				change.first_change = !explored[index];
+				cell_changes_.push_back(change);
+			}
+		}
+
+		index = 0;
+		complete = complete && SwarmTrace::get_varint(current, record_end, count);
+		for (unsigned long long i = 0; i < count && complete; ++i) {
+			complete = SwarmTrace::get_varint(current, record_end, delta);
+			index += delta;
+			complete = complete && index < grid_size;
+			if (complete) {
+				interior_changes_.push_back(glm::ivec3(index % grid_width, 0, index / grid_width));
+			}
+		}
+
+		std::vector<int> tick_deaths;
+		complete = complete && SwarmTrace::get_varint(current, record_end, count);
+		for (unsigned long long i = 0; i < count && complete; ++i) {
+			complete = SwarmTrace::get_varint(current, record_end, delta) && delta < static_cast<unsigned long long>(no_of_robots_);
+			if (complete) {
+				tick_deaths.push_back(delta);
+			}
+		}
+
+		if (!complete) {
+			positions_.resize(no_of_positions);
+			cell_changes_.resize(no_of_cell_changes);
+			interior_changes_.resize(no_of_interior_changes);
+			break;
+		}
+
+		for (auto change = cell_changes_.begin() + no_of_cell_changes; change != cell_changes_.end(); ++change) {
+			auto& position = change->grid_position;
+			explored[position.z * grid_width + position.x] = 1;
+		}
+		for (auto& robot_id : tick_deaths) {
+			deaths.push_back(robot_id);
+			deaths.push_back(no_of_ticks_);
+		}
+		cell_change_offsets_.push_back(cell_changes_.size());
+		interior_change_offsets_.push_back(interior_changes_.size());
+		no_of_ticks_++;
+		current = record_end;
+	}
+
+	death_ticks_.assign(no_of_robots_, no_of_ticks_);
+	for (int i = 0; i < deaths.size(); i += 2) {
+		death_ticks_[deaths[i]] = std::min(death_ticks_[deaths[i]], deaths[i + 1]);
+	}
+
+	std::cout << "Loaded trace " << filename << " : " << no_of_ticks_ << " ticks, " << no_of_robots_ << " robots\n";
+	return no_of_ticks_ > 0;
+}
+
+const SwarmParams& SwarmTraceReader::get_swarm_params() const {
+	return swarm_params_;
+}
+
+int SwarmTraceReader::get_no_of_robots() const {
+	return no_of_robots_;
+}
+
+int SwarmTraceReader::get_no_of_ticks() const {
+	return no_of_ticks_;
+}
+
+glm::vec3 SwarmTraceReader::get_position(int tick, int robot_id) const {
+	return positions_[tick * no_of_robots_ + robot_id];
+}
+
+bool SwarmTraceReader::is_dead(int tick, int robot_id) const {
+	return death_ticks_[robot_id] <= tick;
+}
+
+const TraceCellChange* SwarmTraceReader::cell_changes_begin(int tick) const {
+	return cell_changes_.data() + cell_change_offsets_[tick];
+}
+
+const TraceCellChange* SwarmTraceReader::cell_changes_end(int tick) const {
+	return cell_changes_.data() + cell_change_offsets_[tick + 1];
+}
+
+const glm::ivec3* SwarmTraceReader::interior_changes_begin(int tick) const {
+	return interior_changes_.data() + interior_change_offsets_[tick];
+}
+
+const glm::ivec3* SwarmTraceReader::interior_changes_end(int tick) const {
+	return interior_changes_.data() + interior_change_offsets_[tick + 1];
+}
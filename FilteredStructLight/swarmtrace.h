@@ -0,0 +1,86 @@
+#pragma once
+#include "swarmutils.h"
+#include <fstream>
+#include <string>
+#include <vector>
+
+// compact binary record of a simulation, one record per tick, so a run can be watched again, seeked and scrubbed
+// in SwarmViewer without simulating it again. the header holds the SwarmParams the run was started with, a record
+// holds the robot positions as deltas from the previous tick quantized to 1 / POSITION_SCALE, the cells explored
+// that tick, the interior cells marked explored that tick and the robots that died. every integer is a varint and
+// there's no footer, so the trace of a run that crashed is still readable up to its last complete record
+class SwarmTrace {
+public:
+	static const char MAGIC[4];
+	static const int VERSION;
+	static const float POSITION_SCALE;
+
+	static void put_varint(std::vector<unsigned char>& buffer, unsigned long long value);
+	static void put_signed_varint(std::vector<unsigned char>& buffer, long long value);
+	// false once past end
+	static bool get_varint(const unsigned char*& current, const unsigned char* end, unsigned long long& value);
+	static bool get_signed_varint(const unsigned char*& current, const unsigned char* end, long long& value);
+	static int quantize(float value);
+};
+
+class SwarmTraceRecorder {
+	std::ofstream file_;
+	SwarmOccupancyTree* occupancy_grid_;
+	// filled by the occupancy grid between records
+	std::vector<CellChange> cell_changes_;
+	std::vector<int> interior_changes_;
+	std::vector<int> previous_x_;
+	std::vector<int> previous_z_;
+	std::vector<char> dead_;
+	std::vector<unsigned char> record_;
+
+	void write_record(const std::vector<Robot*>& robots);
+
+public:
+	SwarmTraceRecorder();
+	~SwarmTraceRecorder();
+	// writes the header and a first record with the starting positions, and starts journalling the grid
+	bool open(const std::string& filename, const SwarmParams& swarm_params, SwarmOccupancyTree* occupancy_grid,
+		const std::vector<Robot*>& robots);
+	// everything that changed since the last record
+	void record_tick(const std::vector<Robot*>& robots);
+	// stops journalling, the grid goes back to the pool after this
+	void close();
+	bool is_open() const;
+};
+
+struct TraceCellChange {
+	glm::ivec3 grid_position;
+	int value;
+	// nothing explored the cell before, undoing this change makes it unexplored again
+	bool first_change;
+};
+
+// a whole trace decoded into flat arrays. the changes of tick t are [offsets[t], offsets[t + 1]) of their array,
+// so seeking is walking records forwards or backwards and never decoding anything again
+class SwarmTraceReader {
+	SwarmParams swarm_params_;
+	int no_of_robots_;
+	int no_of_ticks_;
+	float robot_height_;
+	std::vector<glm::vec3> positions_;
+	std::vector<TraceCellChange> cell_changes_;
+	std::vector<int> cell_change_offsets_;
+	std::vector<glm::ivec3> interior_changes_;
+	std::vector<int> interior_change_offsets_;
+	// first tick each robot is dead on, no_of_ticks_ if it never died
+	std::vector<int> death_ticks_;
+
+public:
+	SwarmTraceReader();
+	bool load(const std::string& filename);
+	const SwarmParams& get_swarm_params() const;
+	int get_no_of_robots() const;
+	int get_no_of_ticks() const;
+	glm::vec3 get_position(int tick, int robot_id) const;
+	bool is_dead(int tick, int robot_id) const;
+	const TraceCellChange* cell_changes_begin(int tick) const;
+	const TraceCellChange* cell_changes_end(int tick) const;
+	const glm::ivec3* interior_changes_begin(int tick) const;
+	const glm::ivec3* interior_changes_end(int tick) const;
+};
@@ -8,6 +8,7 @@
 #include <functional>
 #include <chrono>
 #include <random>
+#include <limits>
 #include <glm/detail/type_mat.hpp>
 #include <glm/detail/type_mat.hpp>
 #include <glm/detail/type_mat.hpp>
@@ -139,13 +140,16 @@ void Swarm3DReconTree::mark_floor_plan() {
 //	//leak_ = new float();
 //}
 
+const int SwarmOccupancyTree::FRONTIER_NEIGHBOURHOOD = 2;
+
 SwarmOccupancyTree::SwarmOccupancyTree(int grid_cube_length, int grid_width, int grid_height, char empty_value) : 
 	Quadtree<int>(grid_width, grid_height, grid_cube_length, empty_value) {
 
 	offset_ = glm::ivec3(0, 0, 0);
 	mark_floor_plan();
-	sampling_tracker_ = new std::vector<Sampling>();
 	update_multisampling_ = false;
+	cell_journal_ = nullptr;
+	interior_journal_ = nullptr;
 
 	// create pool
 	pool_size_ = 100000;
@@ -155,6 +159,60 @@ SwarmOccupancyTree::SwarmOccupancyTree(int grid_cube_length, int grid_width, int
 	perimeter_vector_.resize(grid_width * grid_height);
 
 	grid_stats_.resize(grid_width * grid_height);
+	no_of_simul_samples_per_timestep_per_gridcell.resize(grid_width * grid_height, 0);
+	no_of_sampled_timesteps_per_gridcell.resize(grid_width * grid_height, 0);
+	interior_list_mask_.resize(grid_width * grid_height, 0);
+	explored_mask_.resize(grid_width * grid_height, 0);
+	interior_list_ready_ = false;
+
+	frontier_distance_.resize(grid_width * grid_height);
+	frontier_owner_.resize(grid_width * grid_height);
+	frontier_queue_.reserve(grid_width * grid_height);
+	frontier_field_valid_ = false;
+}
+
+void SwarmOccupancyTree::snapshot_floor_plan() {
+	floor_plan_grid_.assign(grid_, grid_ + grid_width_ * grid_height_);
+	static_empty_space_list_ = empty_space_list_;
+}
+
+void SwarmOccupancyTree::restore_floor_plan() {
+	std::copy(floor_plan_grid_.begin(), floor_plan_grid_.end(), grid_);
+	explore_perimeter_list_ = static_perimeter_list_;
+	explore_interior_list_ = interior_list_;
+	empty_space_list_ = static_empty_space_list_;
+
+	std::fill(grid_stats_.begin(), grid_stats_.end(), GridStats());
+	std::fill(no_of_simul_samples_per_timestep_per_gridcell.begin(), no_of_simul_samples_per_timestep_per_gridcell.end(), 0);
+	std::fill(no_of_sampled_timesteps_per_gridcell.begin(), no_of_sampled_timesteps_per_gridcell.end(), 0);
+	std::fill(explored_mask_.begin(), explored_mask_.end(), 0);
+	frontier_field_valid_ = false;
+	explored_frontiers_.clear();
+	update_multisampling_ = false;
+	// a full pool is cleared on its next use, same as after construction
+	current_pool_count_ = pool_size_;
+}
+
+void SwarmOccupancyTree::set_journal(std::vector<CellChange>* cell_journal, std::vector<int>* interior_journal) {
+	cell_journal_ = cell_journal;
+	interior_journal_ = interior_journal;
+}
+
+void SwarmOccupancyTree::mark_explored(const glm::ivec3& grid_position, int explored) {
+	int index = grid_position.z * grid_width_ + grid_position.x;
+	// robot 0 marks with 0, the same value as an unexplored cell, so the mask decides as well
+	if (cell_journal_ && (!explored_mask_[index] || grid_[index] != explored)) {
+		CellChange change;
+		change.index = index;
+		change.value = explored;
+		cell_journal_->push_back(change);
+	}
+	grid_[index] = explored;
+	explored_mask_[index] = 1;
+}
+
+const std::vector<char>& SwarmOccupancyTree::get_explored_mask() const {
+	return explored_mask_;
 }
 
  std::set<glm::ivec3, IVec3Comparator> SwarmOccupancyTree::get_unexplored_perimeter_list() {
@@ -299,46 +357,108 @@ SwarmCollisionTree::SwarmCollisionTree(unsigned width, unsigned height): Quadtre
 	}
 }
 
+void SwarmCollisionTree::clear() {
+	for (int i = 0; i < grid_width_ * grid_height_; ++i) {
+		grid_[i]->clear();
+	}
+}
+
 void SwarmCollisionTree::insert(int robot_id, const glm::ivec3& position) {
 	auto robot_positions = at(position.x, position.z);
 	robot_positions->insert(robot_id);
 }
 
 Swarm3DReconTree::Swarm3DReconTree(float grid_cube_length, int grid_width, int grid_height): 
-Quadtree<std::vector<glm::vec3>*>(grid_width, grid_height, grid_cube_length, nullptr) {
+Quadtree<int>(grid_width, grid_height, grid_cube_length, 0) {
+
+	multi_sampling_map_.resize(grid_width_ * grid_height_, -1);
+	offsets_.resize(grid_width_ * grid_height_ + 1, 0);
+	reserve(grid_width_ * grid_height_);
+	mark_floor_plan();
+}
 
+void Swarm3DReconTree::reserve(int no_of_points) {
+	staged_points_.reserve(staged_points_.size() + no_of_points);
+}
+
+void Swarm3DReconTree::snapshot_floor_plan() {
+	pack_points();
+	floor_plan_counts_.assign(grid_, grid_ + grid_width_ * grid_height_);
+	floor_plan_points_ = points_;
+	floor_plan_offsets_ = offsets_;
+	floor_plan_multi_sampling_map_ = multi_sampling_map_;
+}
+
+// the floor plan points are packed, so this leaves the tree as a fresh load followed by a read would
+void Swarm3DReconTree::restore_floor_plan() {
+	std::copy(floor_plan_counts_.begin(), floor_plan_counts_.end(), grid_);
+	points_.assign(floor_plan_points_.begin(), floor_plan_points_.end());
+	offsets_ = floor_plan_offsets_;
+	multi_sampling_map_ = floor_plan_multi_sampling_map_;
+	staged_points_.clear();
+}
+
+void Swarm3DReconTree::insert(const glm::vec3& points, const glm::ivec3& position) {
+	int index = position.x * grid_height_ + position.z;
+	staged_points_.push_back(std::make_pair(index, points));
+	grid_[position.z * grid_width_ + position.x]++;
+	multi_sampling_map_[index] = 0;
+}
+
+// the counts are already in the grid, so the new offsets are a prefix sum. the packed points are
+// then moved and the staged ones scattered behind them
+void Swarm3DReconTree::pack_points() {
+	if (staged_points_.empty()) {
+		return;
+	}
+
+	std::vector<int> offsets(offsets_.size(), 0);
 	for (int x = 0; x < grid_width_; ++x) {
 		for (int z = 0; z < grid_height_; ++z) {
-			auto new_vector = new std::vector<glm::vec3>();
-			set(x, z, new_vector);
+			int index = x * grid_height_ + z;
+			offsets[index + 1] = offsets[index] + at(x, z);
 		}
 	}
-	mark_floor_plan();
+
+	std::vector<glm::vec3> points(offsets.back());
+	std::vector<int> next(offsets.begin(), offsets.end() - 1);
+	for (int index = 0; index + 1 < offsets_.size(); ++index) {
+		for (int i = offsets_[index]; i < offsets_[index + 1]; ++i) {
+			points[next[index]++] = points_[i];
+		}
+	}
+	for (auto& staged_point : staged_points_) {
+		points[next[staged_point.first]++] = staged_point.second;
+	}
+
+	points_.swap(points);
+	offsets_.swap(offsets);
+	std::vector<std::pair<int, glm::vec3>>().swap(staged_points_);
 }
 
-void Swarm3DReconTree::insert(glm::vec3& points, const glm::ivec3& position) {
-	auto points_3d = at(position.x, position.z);
-	points_3d->push_back(points);
-	multi_sampling_map_[position] = 0;
+PointSpan Swarm3DReconTree::get_3d_points(const glm::ivec3& position) {
+	pack_points();
+	int index = position.x * grid_height_ + position.z;
+	const glm::vec3* first = points_.data();
+	return PointSpan(first + offsets_[index], first + offsets_[index + 1]);
 }
 
-std::vector<glm::vec3>* Swarm3DReconTree::get_3d_points(const glm::ivec3& position) {
-	auto points_3d = at(position.x, position.z);
-	return points_3d;
+const std::vector<glm::vec3>& Swarm3DReconTree::get_points() {
+	pack_points();
+	return points_;
+}
+
+const std::vector<int>& Swarm3DReconTree::get_offsets() {
+	pack_points();
+	return offsets_;
 }
 
 void Swarm3DReconTree::update_multi_sampling_map(const glm::ivec3& position) {
-	multi_sampling_map_[position]++;
+	auto& no_of_samples = multi_sampling_map_[position.x * grid_height_ + position.z];
+	no_of_samples = std::max(no_of_samples, 0) + 1;
 }
 
 Swarm3DReconTree::~Swarm3DReconTree() {
-	for (int x = 0; x < grid_width_; ++x) {
-		for (int z = 0; z < grid_height_; ++z) {
-			auto container = at(x, z);
-			delete container;
-			unset(x, z);
-		}
-	}
 }
 
 std::vector<int> SwarmCollisionTree::find_adjacent_robots(int robot_id, const glm::ivec3& position) const {
@@ -622,7 +742,7 @@ void Swarm3DReconTree::mark_interior_line(glm::vec3 a, glm::vec3 b) {
 		glm::vec3 position = a + direction * (division_factor) * static_cast<float>(i);
 		try {
 			glm::ivec3 grid_position;
-			map_to_grid(position.x, position.z, grid_position.x, grid_position.y);
+			map_to_grid(position.x, position.z, grid_position.x, grid_position.z);
 			insert(position, grid_position);
 			//SwarmUtils::print_vector("mark interior A", a);
 			//SwarmUtils::print_vector("mark interior B", b);
@@ -636,10 +756,14 @@ void Swarm3DReconTree::mark_interior_line(glm::vec3 a, glm::vec3 b) {
 
 double Swarm3DReconTree::calculate_multi_sampling_factor() {
 	int total_no_of_samples = 0;
-	for (auto& map_entry : multi_sampling_map_) {
-		total_no_of_samples += map_entry.second;
+	int no_of_sampled_cells = 0;
+	for (auto no_of_samples : multi_sampling_map_) {
+		if (no_of_samples >= 0) {
+			total_no_of_samples += no_of_samples;
+			no_of_sampled_cells++;
+		}
 	}
-	return (multi_sampling_map_.size() > 0)  ? (total_no_of_samples / double(multi_sampling_map_.size())) : 0.0;
+	return (no_of_sampled_cells > 0)  ? (total_no_of_samples / double(no_of_sampled_cells)) : 0.0;
 }
 
 double Swarm3DReconTree::calculate_density() {
@@ -649,12 +773,9 @@ double Swarm3DReconTree::calculate_density() {
 
 	for (int x = 0; x < grid_width_; ++x) {
 		for (int z = 0; z < grid_height_; ++z) {
-			auto grid_position = glm::ivec3(x, 0, z);
-			auto points_3d = get_3d_points(grid_position);
-			if (points_3d->size() > 0) {
+			if (at(x, z) > 0) {
 				total_no_of_points++;
-				int no_of_samples = multi_sampling_map_[grid_position];
-				if (no_of_samples > 0) {
+				if (multi_sampling_map_[x * grid_height_ + z] > 0) {
 					sampled_no_of_points++;
 				}
 			}
@@ -712,7 +833,7 @@ void Swarm3DReconTree::mark_random_points_in_triangle(glm::vec3 a, glm::vec3 b,
 				xz_position.y = 0.f;
 
 				glm::ivec3 grid_position;
-				map_to_grid(xz_position.x, xz_position.z, grid_position.x, grid_position.y);
+				map_to_grid(xz_position.x, xz_position.z, grid_position.x, grid_position.z);
 
 				//auto grid_position = map_to_grid(xz_position);
 
@@ -754,50 +875,27 @@ void SwarmOccupancyTree::remove_inner_interiors() {
 
 
 void SwarmOccupancyTree::update_interior_stats(glm::ivec3 grid_cell, int timestep, int robot_id, int cluster_id) {
-	//auto entry = sampling_tracker_->find(grid_cell);
-	//if (entry != sampling_tracker_->end()) {
-		//entry->second[timestep][robot_id] = 1;
-	//}
-	//(*sampling_tracker_)[grid_cell][timestep][robot_id] = 1;
-	auto& stat = grid_stats_[grid_cell.x * grid_height_ + grid_cell.z];
+	int index = grid_cell.x * grid_height_ + grid_cell.z;
+	auto& stat = grid_stats_[index];
 	if (stat.last_timestamp != timestep) {
-		// new timestamp
+		// new timestamp, fold the samples of the last one into the running totals
+		if (stat.last_timestamp >= 0 && interior_list_mask_[index]) {
+			no_of_simul_samples_per_timestep_per_gridcell[index] += stat.current_simul_samples;
+			no_of_sampled_timesteps_per_gridcell[index]++;
+		}
 		stat.last_timestamp = timestep;
 		stat.current_simul_samples = 0;
 	}
 
 	stat.current_simul_samples++;
 	stat.max_simul_samples = std::max(stat.max_simul_samples, stat.current_simul_samples);
-
-	/*
-	Sampling sample;
-	sample.grid_cell = grid_cell;
-	sample.timestamp = timestep;
-	sample.robot_id = robot_id;
-	sample.cluster_id = cluster_id;
-	sampling_tracker_->push_back(sample);
-
-	if (sampling_tracker_->size() % 100000 == 0) {
-		//std::cout << "tracker memory : " << sampling_tracker_->size() * sizeof(Sampling) / (1024 * 1024) << "\n";
-		last_multisample_timestep_ = timestep;
-		update_multisampling_ = true;
-	}
-
-	if (update_multisampling_) {
-		if (timestep != last_multisample_timestep_) {
-			calculate_simultaneous_sampling_per_cluster();
-			sampling_tracker_->clear();
-			update_multisampling_ = false;
-		}
-	}
-	*/
 }
 
 SimSampMap SwarmOccupancyTree::calculate_simultaneous_sampling_per_grid_cell() {
 
 	//calculate_simultaneous_sampling_per_cluster();
 
-	SimSampMap simultaneous_sampling_map;
+	SimSampMap simultaneous_sampling_map(grid_width_, grid_height_);
 
 	//for (auto& sample_per_timestep : no_of_simul_samples_per_timestep_per_gridcell) {
 	//	auto grid_cell = sample_per_timestep.first;
@@ -806,13 +904,9 @@ SimSampMap SwarmOccupancyTree::calculate_simultaneous_sampling_per_grid_cell() {
 	//	auto no_of_timesteps_grid_cell_was_sampled =  no_of_sampled_timesteps_per_gridcell[grid_cell];
 	//	simultaneous_sampling_map[grid_cell] = (double) no_of_total_samples_per_grid_cell / no_of_timesteps_grid_cell_was_sampled;
 	//}
-	for (int x = 0; x < grid_width_; ++x) {
-		for (int z = 0; z < grid_height_; ++z) {
-			glm::ivec3 grid_cell(x, 0, z);
-			if (is_interior(grid_cell) && !is_interior_interior(grid_cell)) {
-				auto& stat = grid_stats_[grid_cell.x * grid_height_ + grid_cell.z];
-				simultaneous_sampling_map[grid_cell] = (double)stat.max_simul_samples;
-			}
+	for (int index = 0; index < grid_stats_.size(); ++index) {
+		if (interior_list_mask_[index]) {
+			simultaneous_sampling_map.at_index(index) = (double)grid_stats_[index].max_simul_samples;
 		}
 	}
 
@@ -821,16 +915,23 @@ SimSampMap SwarmOccupancyTree::calculate_simultaneous_sampling_per_grid_cell() {
 
 SimSampMap SwarmOccupancyTree::calculate_multi_sampling_per_grid_cell() {
 
-	calculate_simultaneous_sampling_per_cluster();
-
-	SimSampMap simultaneous_sampling_map;
+	SimSampMap simultaneous_sampling_map(grid_width_, grid_height_);
 
-	for (auto& sample_per_timestep : no_of_simul_samples_per_timestep_per_gridcell) {
-		auto grid_cell = sample_per_timestep.first;
-		auto no_of_total_samples_per_grid_cell = sample_per_timestep.second;
+	for (int index = 0; index < no_of_sampled_timesteps_per_gridcell.size(); ++index) {
 		// we have to know the actual timesteps this was sampled
-		auto no_of_timesteps_grid_cell_was_sampled =  no_of_sampled_timesteps_per_gridcell[grid_cell];
-		simultaneous_sampling_map[grid_cell] = (double) no_of_total_samples_per_grid_cell / no_of_timesteps_grid_cell_was_sampled;
+		auto no_of_timesteps_grid_cell_was_sampled = no_of_sampled_timesteps_per_gridcell[index];
+		auto no_of_total_samples_per_grid_cell = no_of_simul_samples_per_timestep_per_gridcell[index];
+
+		// the latest timestep of a cell is still open in grid_stats_
+		auto& stat = grid_stats_[index];
+		if (stat.last_timestamp >= 0 && interior_list_mask_[index]) {
+			no_of_total_samples_per_grid_cell += stat.current_simul_samples;
+			no_of_timesteps_grid_cell_was_sampled++;
+		}
+
+		if (no_of_timesteps_grid_cell_was_sampled > 0) {
+			simultaneous_sampling_map.at_index(index) = (double) no_of_total_samples_per_grid_cell / no_of_timesteps_grid_cell_was_sampled;
+		}
 	}
 
 	return simultaneous_sampling_map;
@@ -871,11 +972,12 @@ double SwarmOccupancyTree::calculate_simultaneous_sampling_factor() {
 	return sampling_factor;
 	*/
 
-	SimSampMap map = calculate_simultaneous_sampling_per_grid_cell();
 	double avg_sim_sampling = 0.0;
 
-	for (auto& entry : map) {
-		avg_sim_sampling += entry.second;
+	for (int index = 0; index < grid_stats_.size(); ++index) {
+		if (interior_list_mask_[index]) {
+			avg_sim_sampling += grid_stats_[index].max_simul_samples;
+		}
 	}
 	
 	if (interior_list_.size() > 0) {
@@ -907,9 +1009,8 @@ double SwarmOccupancyTree::calculate_multi_sampling_factor() {
 
 	auto simultaneous_sampling_map = calculate_multi_sampling_per_grid_cell();
 
-	for (auto& cell_entry : simultaneous_sampling_map) {
-		auto simultaneous_sampling_per_grid_cell = cell_entry.second;
-		sampling_factor += simultaneous_sampling_per_grid_cell;
+	for (auto index : simultaneous_sampling_map.cells()) {
+		sampling_factor += simultaneous_sampling_map.value(index);
 	}
 
 	if (simultaneous_sampling_map.size() > 0) {
@@ -920,93 +1021,17 @@ double SwarmOccupancyTree::calculate_multi_sampling_factor() {
 }
 
 bool SwarmOccupancyTree::is_interior_interior(const glm::ivec3& position) {
-	std::vector<glm::ivec3> cells;
-	get_adjacent_cells(position, cells, 1);
-	bool is_interior_of_interior = true;
-	for (auto& cell : cells) {
-		if (!is_interior(cell)) {
-			is_interior_of_interior = false;
-			break;
-		}
-	}
-	return is_interior_of_interior;
-}
-
-void SwarmOccupancyTree::calculate_simultaneous_sampling_per_cluster() {
-
-
-	double sampling_factor = 0.0;
-
-	long long last_timestamp = -1;
-	std::unordered_map<glm::ivec3, int, IVec3Hasher, IVec3Equals> simultaneous_samples_per_timestamp;
-
-	int no_of_timesteps = 0;
-
-	for (auto& sampling_tracker_entry : *sampling_tracker_) {
-
-		// the tracker will be ordered by timestamp
-		if (sampling_tracker_entry.timestamp != last_timestamp) {
-			for (auto& simultaneous_samples : simultaneous_samples_per_timestamp) {
-				glm::ivec3 grid_cell = simultaneous_samples.first;
-				if (no_of_simul_samples_per_timestep_per_gridcell.find(grid_cell) != no_of_simul_samples_per_timestep_per_gridcell.end()) {
-					no_of_simul_samples_per_timestep_per_gridcell[grid_cell] += simultaneous_samples.second;
-					no_of_sampled_timesteps_per_gridcell[grid_cell]++;
-				} else {
-					no_of_simul_samples_per_timestep_per_gridcell[grid_cell] = simultaneous_samples.second;
-					no_of_sampled_timesteps_per_gridcell[grid_cell] = 1;
-				}
-			}
-			last_timestamp = sampling_tracker_entry.timestamp;
-			simultaneous_samples_per_timestamp.clear();
-			no_of_timesteps++;
-		}
-		if (interior_list_.find(sampling_tracker_entry.grid_cell) != interior_list_.end()) {
-			if (!is_interior_interior(sampling_tracker_entry.grid_cell)) {
-				if (simultaneous_samples_per_timestamp.find(sampling_tracker_entry.grid_cell) == simultaneous_samples_per_timestamp.end()) {
-					simultaneous_samples_per_timestamp[sampling_tracker_entry.grid_cell] = 1;
-				}
-				else {
-					simultaneous_samples_per_timestamp[sampling_tracker_entry.grid_cell] += 1;
-				}
+	// the cells get_adjacent_cells(position, cells, 1) would list, without building the list.
+	// every robot runs this over the whole grid when it's created or reset
+	for (int x = -1; x < 2; ++x) {
+		for (int z = -1; z < 2; ++z) {
+			glm::ivec3 cell = position + glm::ivec3(x, 0, z);
+			if (!mm::Quadtree<int>::is_out_of_bounds(cell.x, cell.z) && !is_interior(cell)) {
+				return false;
 			}
 		}
 	}
-
-	//// no of samples per gridcell per cluster per timestamp
-	//double sampling_factor = 0.0;
-
-	//long long last_timestamp = -1;
-	//std::unordered_map<glm::ivec3, std::unordered_map<int, int>, IVec3Hasher, IVec3Equals> simultaneous_samples_per_timestamp;
-
-	//int no_of_timesteps = 0;
-
-	//for (auto& sampling_tracker_entry : *sampling_tracker_) {
-
-	//	// the tracker will be ordered by timestamp
-	//	if (sampling_tracker_entry.timestamp != last_timestamp) {
-	//		for (auto& simultaneous_samples : simultaneous_samples_per_timestamp) {
-	//			glm::ivec3 grid_cell = simultaneous_samples.first;
-	//			if (no_of_simul_samples_per_timestep_per_gridcell.find(grid_cell) != no_of_simul_samples_per_timestep_per_gridcell.end()) {
-	//				no_of_simul_samples_per_timestep_per_gridcell[grid_cell] += simultaneous_samples.second;
-	//				no_of_sampled_timesteps_per_gridcell[grid_cell]++;
-	//			} else {
-	//				no_of_simul_samples_per_timestep_per_gridcell[grid_cell] = simultaneous_samples.second;
-	//				no_of_sampled_timesteps_per_gridcell[grid_cell] = 1;
-	//			}
-	//		}
-	//		last_timestamp = sampling_tracker_entry.timestamp;
-	//		simultaneous_samples_per_timestamp.clear();
-	//		no_of_timesteps++;
-	//	}
-	//	if (interior_list_.find(sampling_tracker_entry.grid_cell) != interior_list_.end()) {
-	//		if (simultaneous_samples_per_timestamp.find(sampling_tracker_entry.grid_cell) == simultaneous_samples_per_timestamp.end()) {
-	//			simultaneous_samples_per_timestamp[sampling_tracker_entry.grid_cell] = 1;
-	//		} else {
-	//			simultaneous_samples_per_timestamp[sampling_tracker_entry.grid_cell] += 1;
-	//		}
-	//	}
-	//}
-
+	return true;
 }
 
 double SwarmOccupancyTree::calculate_coverage() {
@@ -1051,9 +1076,25 @@ void SwarmOccupancyTree::create_perimeter_list() {
 		}
 	}
 	static_perimeter_list_ = explore_perimeter_list_;
+	frontier_field_valid_ = false;
+}
+
+// cells are x, z pairs in x then z order, which is the set order so every insert is at the end
+void SwarmOccupancyTree::set_interior_list(const std::int32_t* cells, int no_of_cells) {
+	for (int i = 0; i < no_of_cells; ++i) {
+		int x = cells[2 * i];
+		int z = cells[2 * i + 1];
+		interior_list_.insert(interior_list_.end(), glm::ivec3(x, 0, z));
+		interior_list_mask_[x * grid_height_ + z] = 1;
+	}
+	explore_interior_list_ = interior_list_;
+	interior_list_ready_ = true;
 }
 
 void SwarmOccupancyTree::create_interior_list() {
+	if (interior_list_ready_) {
+		return;
+	}
 	for (int x = 0; x < grid_width_; ++x) {
 		for (int z = 0; z < grid_height_; ++z) {
 			glm::ivec3 grid_position(x, 0, z);
@@ -1071,6 +1112,7 @@ void SwarmOccupancyTree::create_interior_list() {
 
 				if (perimeter_found) {
 					interior_list_.insert(grid_position);
+					interior_list_mask_[x * grid_height_ + z] = 1;
 					//std::unordered_map<int, std::unordered_map<int, int>> timestamp_robots;
 					std::map<int, std::map<int, int>> timestamp_robots;
 					//timestamp_robots.rereserve(100);
@@ -1102,8 +1144,9 @@ void SwarmOccupancyTree::create_empty_space_list() {
 	}
 }
 
-void SwarmOccupancyTree::init_coverage_map(std::unordered_map<glm::ivec3, int, IVec3Hasher, IVec3Equals>& coverage_map) const
+void SwarmOccupancyTree::init_coverage_map(DenseGridMap<int>& coverage_map) const
 {
+	coverage_map.resize(grid_width_, grid_height_);
 	for (int x = 0; x < grid_width_; ++x) {
 		for (int z = 0; z < grid_height_; ++z) {
 			glm::ivec3 grid_position(x, 0, z);
@@ -1125,16 +1168,168 @@ bool SwarmOccupancyTree::mark_explored_in_list(std::set<glm::ivec3, IVec3Compara
 }
 
 SwarmOccupancyTree::~SwarmOccupancyTree() {
-	//sampling_tracker_->clear();
-	delete sampling_tracker_;
 }
 
 bool SwarmOccupancyTree::mark_explored_in_interior_list(const glm::ivec3& grid_position) {
-	return mark_explored_in_list(explore_interior_list_, grid_position);
+	bool marked = mark_explored_in_list(explore_interior_list_, grid_position);
+	if (marked) {
+		explored_mask_[grid_position.z * grid_width_ + grid_position.x] = 1;
+		if (interior_journal_) {
+			interior_journal_->push_back(grid_position.z * grid_width_ + grid_position.x);
+		}
+	}
+	return marked;
 }
 
 void SwarmOccupancyTree::mark_explored_in_perimeter_list(const glm::ivec3& grid_position) {
-	mark_explored_in_list(explore_perimeter_list_, grid_position);
+	if (mark_explored_in_list(explore_perimeter_list_, grid_position) && frontier_field_valid_) {
+		explored_frontiers_.push_back(grid_position.z * grid_width_ + grid_position.x);
+	}
+}
+
+void SwarmOccupancyTree::rebuild_frontier_field() {
+	int width = grid_width_;
+	int height = grid_height_;
+	std::fill(frontier_distance_.begin(), frontier_distance_.end(), std::numeric_limits<int>::max());
+	std::fill(frontier_owner_.begin(), frontier_owner_.end(), -1);
+	frontier_queue_.clear();
+	for (auto& frontier : explore_perimeter_list_) {
+		int index = frontier.z * width + frontier.x;
+		frontier_distance_[index] = 0;
+		frontier_owner_[index] = index;
+		frontier_queue_.push_back(index);
+	}
+
+	// every source starts at 0, so a fifo visits cells in distance order
+	for (int head = 0; head < frontier_queue_.size(); ++head) {
+		int index = frontier_queue_[head];
+		int x = index % width;
+		int z = index / width;
+		int next_distance = frontier_distance_[index] + 1;
+		for (int nz = std::max(z - 1, 0); nz <= std::min(z + 1, height - 1); ++nz) {
+			for (int nx = std::max(x - 1, 0); nx <= std::min(x + 1, width - 1); ++nx) {
+				int next_index = nz * width + nx;
+				if (frontier_distance_[next_index] == std::numeric_limits<int>::max() && grid_[next_index] != INTERIOR_MARK) {
+					frontier_distance_[next_index] = next_distance;
+					frontier_owner_[next_index] = frontier_owner_[index];
+					frontier_queue_.push_back(next_index);
+				}
+			}
+		}
+	}
+
+	explored_frontiers_.clear();
+	frontier_field_valid_ = true;
+}
+
+void SwarmOccupancyTree::update_frontier_field() {
+	if (!frontier_field_valid_) {
+		rebuild_frontier_field();
+		return;
+	}
+	if (explored_frontiers_.empty()) {
+		return;
+	}
+	int width = grid_width_;
+	int height = grid_height_;
+
+	// clear the cells that led to an explored perimeter cell. every cell got its owner from a neighbour with the
+	// same owner, so flooding from the explored cell through its owner finds all of them
+	frontier_queue_.clear();
+	for (auto explored : explored_frontiers_) {
+		if (frontier_owner_[explored] != explored) {
+			continue;
+		}
+		int begin = frontier_queue_.size();
+		frontier_owner_[explored] = -1;
+		frontier_distance_[explored] = std::numeric_limits<int>::max();
+		frontier_queue_.push_back(explored);
+		for (int head = begin; head < frontier_queue_.size(); ++head) {
+			int index = frontier_queue_[head];
+			int x = index % width;
+			int z = index / width;
+			for (int nz = std::max(z - 1, 0); nz <= std::min(z + 1, height - 1); ++nz) {
+				for (int nx = std::max(x - 1, 0); nx <= std::min(x + 1, width - 1); ++nx) {
+					int next_index = nz * width + nx;
+					if (frontier_owner_[next_index] == explored) {
+						frontier_owner_[next_index] = -1;
+						frontier_distance_[next_index] = std::numeric_limits<int>::max();
+						frontier_queue_.push_back(next_index);
+					}
+				}
+			}
+		}
+	}
+	explored_frontiers_.clear();
+
+	// the rest of the field is still right, fill the cleared cells in from their borders. the borders are at
+	// different distances, so they're expanded in distance order
+	typedef std::pair<int, int> DistanceIndex;
+	std::priority_queue<DistanceIndex, std::vector<DistanceIndex>, std::greater<DistanceIndex>> border;
+	for (auto index : frontier_queue_) {
+		int x = index % width;
+		int z = index / width;
+		for (int nz = std::max(z - 1, 0); nz <= std::min(z + 1, height - 1); ++nz) {
+			for (int nx = std::max(x - 1, 0); nx <= std::min(x + 1, width - 1); ++nx) {
+				int next_index = nz * width + nx;
+				if (frontier_owner_[next_index] >= 0) {
+					border.push(DistanceIndex(frontier_distance_[next_index], next_index));
+				}
+			}
+		}
+	}
+
+	while (!border.empty()) {
+		auto current = border.top();
+		border.pop();
+		int index = current.second;
+		if (current.first != frontier_distance_[index]) {
+			continue;
+		}
+		int x = index % width;
+		int z = index / width;
+		int next_distance = current.first + 1;
+		for (int nz = std::max(z - 1, 0); nz <= std::min(z + 1, height - 1); ++nz) {
+			for (int nx = std::max(x - 1, 0); nx <= std::min(x + 1, width - 1); ++nx) {
+				int next_index = nz * width + nx;
+				if (next_distance < frontier_distance_[next_index] && grid_[next_index] != INTERIOR_MARK) {
+					frontier_distance_[next_index] = next_distance;
+					frontier_owner_[next_index] = frontier_owner_[index];
+					border.push(DistanceIndex(next_distance, next_index));
+				}
+			}
+		}
+	}
+}
+
+bool SwarmOccupancyTree::is_frontier_field_consistent() {
+	update_frontier_field();
+	std::vector<int> frontier_distance = frontier_distance_;
+	std::vector<int> frontier_owner = frontier_owner_;
+	rebuild_frontier_field();
+	// owners can differ where two frontiers are the same distance away
+	for (int i = 0; i < frontier_distance.size(); ++i) {
+		if (frontier_distance[i] != frontier_distance_[i] || (frontier_owner[i] < 0) != (frontier_owner_[i] < 0)) {
+			return false;
+		}
+		if (frontier_owner[i] >= 0 && frontier_distance_[frontier_owner[i]] != 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool SwarmOccupancyTree::nearest_frontier(const glm::ivec3& robot_grid_position, glm::ivec3& frontier_position) {
+	if (is_out_of_bounds(robot_grid_position)) {
+		return false;
+	}
+	update_frontier_field();
+	int owner = frontier_owner_[robot_grid_position.z * grid_width_ + robot_grid_position.x];
+	if (owner < 0) {
+		return false;
+	}
+	frontier_position = glm::ivec3(owner % grid_width_, 0, owner / grid_width_);
+	return true;
 }
 
 void SwarmOccupancyTree::mark_explored_in_empty_space_list(const glm::ivec3& grid_position) {
@@ -1391,9 +1586,59 @@ bool SwarmOccupancyTree::next_cell_to_explore(const glm::ivec3& robot_grid_posit
 
 bool SwarmOccupancyTree::next_cell_to_explore(const glm::ivec3& robot_grid_position,
 	glm::ivec3& explore_position, float range_min, float range_max) {
+	// the nearest frontier by walking distance is the answer whenever the robot can see it. when it can't, the
+	// frontiers the cells around the robot lead to usually include one it can, the whole list is only scanned
+	// (and sorted) when none of them is in sight. --benchmark has both next_cell_to_explore and the scan
+	glm::ivec3 frontier_position;
+	if (nearest_frontier(robot_grid_position, frontier_position)) {
+		float grid_distance = glm::length(glm::vec3(frontier_position - robot_grid_position));
+		if (range_min <= grid_distance && grid_distance < range_max
+			&& !going_through_interior_test(robot_grid_position, frontier_position)) {
+			explore_position = frontier_position;
+			return true;
+		}
+		if (find_closest_neighbourhood_frontier(robot_grid_position, explore_position, range_min, range_max)) {
+			return true;
+		}
+	}
 	return find_closest_position_from_list(explore_perimeter_list_, robot_grid_position, explore_position, range_min, range_max);
 }
 
+bool SwarmOccupancyTree::find_closest_neighbourhood_frontier(const glm::ivec3& robot_grid_position,
+	glm::ivec3& explore_position, float range_min, float range_max) {
+	int width = grid_width_;
+	int height = grid_height_;
+	std::vector<PerimeterPos> frontiers;
+	for (int z = std::max(robot_grid_position.z - FRONTIER_NEIGHBOURHOOD, 0);
+		z <= std::min(robot_grid_position.z + FRONTIER_NEIGHBOURHOOD, height - 1); ++z) {
+		for (int x = std::max(robot_grid_position.x - FRONTIER_NEIGHBOURHOOD, 0);
+			x <= std::min(robot_grid_position.x + FRONTIER_NEIGHBOURHOOD, width - 1); ++x) {
+			int owner = frontier_owner_[z * width + x];
+			if (owner < 0) {
+				continue;
+			}
+			glm::ivec3 frontier(owner % width, 0, owner / width);
+			float grid_distance = glm::length(glm::vec3(frontier - robot_grid_position));
+			if (range_min <= grid_distance && grid_distance < range_max) {
+				frontiers.push_back(PerimeterPos(grid_distance, frontier));
+			}
+		}
+	}
+
+	std::sort(frontiers.begin(), frontiers.end());
+	for (int i = 0; i < frontiers.size(); ++i) {
+		// neighbouring cells mostly share an owner
+		if (i > 0 && frontiers[i].grid_position_ == frontiers[i - 1].grid_position_) {
+			continue;
+		}
+		if (!going_through_interior_test(robot_grid_position, frontiers[i].grid_position_)) {
+			explore_position = frontiers[i].grid_position_;
+			return true;
+		}
+	}
+	return false;
+}
+
 bool SwarmOccupancyTree::next_cell_to_explore_visibility_non_aware(const glm::ivec3& robot_grid_position,
 	glm::ivec3& explore_position, float range_min, float range_max) {
 	return find_closest_position_from_list_visibility_non_aware(explore_perimeter_list_, robot_grid_position, explore_position, range_min, range_max);
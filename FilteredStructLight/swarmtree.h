@@ -22,7 +22,7 @@ struct VisibleCell {
 
 struct IVec3Hasher {
 	std::size_t operator()(const glm::ivec3& k) const {
-		return k.x + GRID_MAX * k.x + GRID_MAX * GRID_MAX * k.z;
+		return std::size_t(k.x) + GRID_MAX * (std::size_t(k.y) + GRID_MAX * std::size_t(k.z));
 	}
 };
 
@@ -94,7 +94,111 @@ struct GridStats {
 		}
 };
 
-typedef std::unordered_map<glm::ivec3, double, IVec3Hasher, IVec3Equals> SimSampMap;
+// running mean and variance (welford), so per timestep measurements don't have to be kept around
+struct RunningStats {
+	long count;
+	double mean;
+	double m2;
+	RunningStats() : count(0), mean(0.0), m2(0.0) {
+	}
+
+	void add(double value) {
+		count++;
+		double delta = value - mean;
+		mean += delta / count;
+		m2 += delta * (value - mean);
+	}
+
+	double variance() const {
+		return (count > 1) ? m2 / (count - 1) : 0.0;
+	}
+};
+
+// per grid cell statistics stored densely in the same (x * grid_height + z) order as the overlay vbo.
+// the indices of the cells that hold a value are kept alongside, so sparse maps can be walked
+// and cleared without touching the whole grid
+template <class T>
+class DenseGridMap {
+	int grid_width_;
+	int grid_height_;
+	std::vector<T> values_;
+	std::vector<char> occupied_;
+	std::vector<int> cells_;
+
+public:
+	DenseGridMap() : grid_width_(0), grid_height_(0) {
+	}
+
+	DenseGridMap(int grid_width, int grid_height) {
+		resize(grid_width, grid_height);
+	}
+
+	void resize(int grid_width, int grid_height) {
+		grid_width_ = grid_width;
+		grid_height_ = grid_height;
+		values_.assign(grid_width * grid_height, T());
+		occupied_.assign(grid_width * grid_height, 0);
+		cells_.clear();
+	}
+
+	void clear() {
+		for (auto index : cells_) {
+			values_[index] = T();
+			occupied_[index] = 0;
+		}
+		cells_.clear();
+	}
+
+	int index(const glm::ivec3& grid_cell) const {
+		return grid_cell.x * grid_height_ + grid_cell.z;
+	}
+
+	glm::ivec3 cell(int index) const {
+		return glm::ivec3(index / grid_height_, 0, index % grid_height_);
+	}
+
+	bool contains(const glm::ivec3& grid_cell) const {
+		return occupied_[index(grid_cell)] != 0;
+	}
+
+	T& at_index(int index) {
+		if (!occupied_[index]) {
+			occupied_[index] = 1;
+			cells_.push_back(index);
+		}
+		return values_[index];
+	}
+
+	T& operator[](const glm::ivec3& grid_cell) {
+		return at_index(index(grid_cell));
+	}
+
+	T value(int index) const {
+		return values_[index];
+	}
+
+	T at(const glm::ivec3& grid_cell) const {
+		return values_[index(grid_cell)];
+	}
+
+	const std::vector<int>& cells() const {
+		return cells_;
+	}
+
+	std::size_t size() const {
+		return cells_.size();
+	}
+
+	int get_grid_width() const {
+		return grid_width_;
+	}
+
+	int get_grid_height() const {
+		return grid_height_;
+	}
+};
+
+typedef DenseGridMap<double> SimSampMap;
 
 class ThreadSafeSimSampMap {
 	
@@ -102,7 +206,7 @@ class ThreadSafeSimSampMap {
 	SimSampMap map_;
 
 public:
-	void set_map(SimSampMap& map) {
+	void set_map(const SimSampMap& map) {
 		lock_.lock();
 		map_ = map;
 		lock_.unlock();
@@ -141,6 +245,12 @@ struct PerimeterPos {
 	}
 };
 
+// a cell value written by a robot, index is z * grid_width + x like the grid itself
+struct CellChange {
+	int index;
+	int value;
+};
+
 class SwarmOccupancyTree : public mm::Quadtree<int> {
 
 private:
@@ -191,23 +301,47 @@ private:
 	long last_multisample_timestep_;
 	std::vector<GridStats> grid_stats_;
 
-	struct Sampling {
-		glm::ivec3 grid_cell;
-		int robot_id;
-		long timestamp;
-		int cluster_id;
-	};
+	std::vector<std::pair<double, int>> sampling_avg_storage_;
 
+	// running totals over the closed timesteps of each cell, dense and indexed like grid_stats_.
+	// the open timestep of a cell is still held in its GridStats
+	std::vector<int> no_of_simul_samples_per_timestep_per_gridcell;
+	std::vector<int> no_of_sampled_timesteps_per_gridcell;
+	// 1 for the cells in interior_list_, i.e. interior cells which are not interior-interior
+	std::vector<char> interior_list_mask_;
+	// set when the interior list came from a compiled floor plan, create_interior_list is then a no op
+	bool interior_list_ready_;
 
-	std::vector<Sampling>* sampling_tracker_;
+	// the grid and empty space list as they were after loading the floor plan, see snapshot_floor_plan
+	std::vector<int> floor_plan_grid_;
+	std::set<glm::ivec3, IVec3Comparator> static_empty_space_list_;
 
-	std::vector<std::pair<double, int>> sampling_avg_storage_;
+	// 1 for every cell a robot has explored, interior ones included. laid out like the grid. the grid values can't
+	// tell robot 0's cells from empty ones
+	std::vector<char> explored_mask_;
 
-	std::unordered_map<glm::ivec3, int, IVec3Hasher, IVec3Equals>  no_of_simul_samples_per_timestep_per_gridcell;
-	std::unordered_map<glm::ivec3, int, IVec3Hasher, IVec3Equals>  no_of_sampled_timesteps_per_gridcell;
+	// null unless something is recording the simulation, see set_journal
+	std::vector<CellChange>* cell_journal_;
+	std::vector<int>* interior_journal_;
 
 	std::vector<PerimeterPos> perimeter_vector_;
+
+	// distance to and index of the nearest unexplored perimeter cell of every cell, walking 8 connected through
+	// non interior cells, laid out like the grid. one multi source bfs from the whole perimeter list builds it,
+	// after that only the cells that belonged to perimeter cells explored since the last query are searched again
+	std::vector<int> frontier_distance_;
+	std::vector<int> frontier_owner_;
+	std::vector<int> frontier_queue_;
+	std::vector<int> explored_frontiers_;
+	bool frontier_field_valid_;
+	void rebuild_frontier_field();
+	void update_frontier_field();
+	// the closest in range and in sight of the frontier cells that own the cells around the robot
+	bool find_closest_neighbourhood_frontier(const glm::ivec3& robot_grid_position,
+		glm::ivec3& explore_position, float range_min, float range_max);
 public:
+	// cells either side of the robot whose frontiers next_cell_to_explore tries before scanning the whole list
+	static const int FRONTIER_NEIGHBOURHOOD;
 
 	bool is_interior_interior(const glm::ivec3& position);
 	bool is_perimeter(const glm::ivec3& grid_position) const;
@@ -239,8 +373,17 @@ public:
 	std::set<glm::ivec3, IVec3Comparator> get_interior_list();
 
 	void create_interior_list();
+	void set_interior_list(const std::int32_t* cells, int no_of_cells);
 	int get_interior_mark();
 	void mark_floor_plan();
+	// taken once the floor plan and the lists are in place. restore_floor_plan then puts the tree back
+	// in that state with bulk copies, so the next simulation on the same floor plan can reuse it
+	void snapshot_floor_plan();
+	void restore_floor_plan();
+	// every explored cell and interior cell marked explored from now on is appended to these, null stops it
+	void set_journal(std::vector<CellChange>* cell_journal, std::vector<int>* interior_journal);
+	void mark_explored(const glm::ivec3& grid_position, int explored);
+	const std::vector<char>& get_explored_mask() const;
 	//SwarmOccupancyTree(int grid_cube_length, int grid_resolution);
 	//SwarmOccupancyTree::SwarmOccupancyTree(float grid_square_length, int grid_height, int grid_width);
 	SwarmOccupancyTree(int grid_cube_length, int grid_width, int grid_height, char empty_value);
@@ -250,7 +393,7 @@ public:
 	//bool visited(std::set<glm::ivec3>* visited_nodes, const glm::ivec3& bfs_node) const;
 	//bool is_unexplored_perimeter(const glm::ivec3& grid_position) const;
 
-	void init_coverage_map(std::unordered_map<glm::ivec3, int, IVec3Hasher, IVec3Equals>& coverage_map_) const;
+	void init_coverage_map(DenseGridMap<int>& coverage_map_) const;
 
 	void mark_visited(SwarmOccupancyTree& swarm_oct_tree, const BFSNode& bfs_node) const;
 	bool frontier_bread_first_search(const glm::ivec3& current_cell, glm::ivec3& result_cell, 
@@ -260,7 +403,6 @@ public:
 	void update_interior_stats(glm::ivec3 grid_cell, int timestep, int robot_id, int cluster_id);
 	double calculate_simultaneous_sampling_factor();
 	double calculate_multi_sampling_factor();
-	void calculate_simultaneous_sampling_per_cluster();
 	double calculate_coverage();
 	static int INTERIOR_MARK;
 	static int PERIMETER;
@@ -284,6 +426,11 @@ public:
 
 	bool next_cell_to_explore(const glm::ivec3& robot_grid_position,
 		glm::ivec3& explore_position, float range_min, float range_max);
+	// nearest reachable unexplored perimeter cell, false if there's none or the robot is in an interior cell
+	bool nearest_frontier(const glm::ivec3& robot_grid_position, glm::ivec3& frontier_position);
+	// true if the incrementally updated field has the distances of one rebuilt from scratch, and every owner is an
+	// unexplored perimeter cell. leaves the rebuilt one in place
+	bool is_frontier_field_consistent();
 
 	bool next_cell_to_explore_visibility_non_aware(const glm::ivec3& robot_grid_position,
 		glm::ivec3& explore_position, float range_min, float range_max);
@@ -311,17 +458,48 @@ public:
 	void find_adjacent_robots_memory_save(int robot_id, const std::vector<VisibleCell>& adjacent_cells, const int current_adjacent_cells,
 		std::vector<int>& adjacent_robots, int& current_no_of_robots) const;
 	SwarmCollisionTree(unsigned width, unsigned height);
+	// removes every robot, the per cell sets stay allocated
+	void clear();
 	void insert(int robot_id, const glm::ivec3& position);
 	void update(int robot_id, const glm::ivec3& previous_position, const glm::ivec3& current_position);
 	virtual ~SwarmCollisionTree() override;
 };
 
-class Swarm3DReconTree : public mm::Quadtree<std::vector<glm::vec3>*> {
+// view over the points of one recon cell, valid until the next insert
+struct PointSpan {
+	const glm::vec3* first;
+	const glm::vec3* last;
+
+	PointSpan(const glm::vec3* first, const glm::vec3* last) : first(first), last(last) {}
+	const glm::vec3* begin() const { return first; }
+	const glm::vec3* end() const { return last; }
+	std::size_t size() const { return last - first; }
+	bool empty() const { return first == last; }
+	const glm::vec3& operator[](std::size_t i) const { return first[i]; }
+};
+
+// the grid value of a cell is its no of points
+class Swarm3DReconTree : public mm::Quadtree<int> {
 private:
 	int grid_cube_length_;
 	int grid_resolution_;
-	std::unordered_map<glm::ivec3, int, IVec3Hasher> multi_sampling_map_;
+	// no of samples per grid cell, -1 where nothing was inserted
+	std::vector<int> multi_sampling_map_;
 	int total_no_of_3d_points;
+
+	// compressed rows, the points of cell i = x * grid_height_ + z are points_[offsets_[i], offsets_[i + 1]).
+	// inserts are staged and packed in one pass when the points are next read
+	std::vector<glm::vec3> points_;
+	std::vector<int> offsets_;
+	std::vector<std::pair<int, glm::vec3>> staged_points_;
+
+	// counts, points and multi sampling map of the floor plan alone, see snapshot_floor_plan
+	std::vector<int> floor_plan_counts_;
+	std::vector<glm::vec3> floor_plan_points_;
+	std::vector<int> floor_plan_offsets_;
+	std::vector<int> floor_plan_multi_sampling_map_;
+
+	void pack_points();
 public:
 	double calculate_multi_sampling_factor();
 	double calculate_density();
@@ -333,8 +511,14 @@ public:
 	void mark_floor_plan();
 	//glm::ivec3 map_to_grid(const glm::vec3& position) const;
 	Swarm3DReconTree(float grid_cube_length, int grid_width, int grid_height);
-	void insert(glm::vec3& points, const glm::ivec3& position);
-	std::vector<glm::vec3>* get_3d_points(const glm::ivec3& position);
+	void reserve(int no_of_points);
+	void snapshot_floor_plan();
+	void restore_floor_plan();
+	void insert(const glm::vec3& points, const glm::ivec3& position);
+	PointSpan get_3d_points(const glm::ivec3& position);
+	// all points, cell after cell, with the offsets of each cell (grid width * height + 1 entries)
+	const std::vector<glm::vec3>& get_points();
+	const std::vector<int>& get_offsets();
 	virtual ~Swarm3DReconTree() override;
 };
 
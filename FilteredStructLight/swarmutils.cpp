@@ -5,6 +5,9 @@
 #include "swarmtree.h"
 #include <random>
 #include "experimentalrobot.h"
+#include "counterrng.h"
+#include "floorplancache.h"
+#include "swarmvoxels.h"
 #include <chrono>
 
 #define PI 3.14159265
@@ -13,6 +16,11 @@ const char* SwarmUtils::OPT_SWARM_CONFIGS_LIST = "OPT_SWARM_CONFIGS_LIST";
 const char* SwarmUtils::OPT_NO_OF_THREADS = "OPT_NO_OF_THREADS";
 const char* SwarmUtils::OPT_NO_OF_ITERATIONS = "OPT_NO_OF_ITERATIONS";
 const char* SwarmUtils::OPT_CULLING_NTH_ITERATION = "OPT_CULLING_NTH_ITERATION";
+const char* SwarmUtils::OPT_DISTRIBUTED_PORT = "OPT_DISTRIBUTED_PORT";
+const char* SwarmUtils::OPT_NO_OF_LOCAL_WORKERS = "OPT_NO_OF_LOCAL_WORKERS";
+const char* SwarmUtils::OPT_USE_RESULT_CACHE = "OPT_USE_RESULT_CACHE";
+const char* SwarmUtils::OPT_SURROGATE_CANDIDATES = "OPT_SURROGATE_CANDIDATES";
+const char* SwarmUtils::OPT_RECORD_TRACES = "OPT_RECORD_TRACES";
 
 const char* SwarmUtils::OPT_COEFF_TIME_TAKEN = "OPT_COEFF_TIME_TAKEN";
 const char* SwarmUtils::OPT_COEFF_COVERAGE = "OPT_COEFF_COVERAGE";
@@ -76,6 +84,7 @@ const char* SwarmUtils::DEATH_PERCENTAGE = "death_percentage_";
 const char* SwarmUtils::DEATH_TIME_TAKEN = "death_time_taken";
 const char* SwarmUtils::COVERAGE_FACTOR = "coverage_factor";
 const char* SwarmUtils::DESIRED_SAMPLING = "desired_sampling";
+const char* SwarmUtils::SEED = "seed";
 
 
 const std::string SwarmUtils::DEFAULT_INTERIOR_MODEL_FILENAME = "interior/l-shape-floor-plan.obj";
@@ -99,6 +108,11 @@ OptimizationParams SwarmUtils::load_optimization_params(const QString& filename)
 	optimization_params.no_of_iterations = settings.value(OPT_NO_OF_ITERATIONS, "10").toInt();
 	optimization_params.no_of_threads = settings.value(OPT_NO_OF_THREADS, "10").toInt();
 	optimization_params.culling_nth_iteration = settings.value(OPT_CULLING_NTH_ITERATION, "5").toInt();
+	optimization_params.distributed_port = settings.value(OPT_DISTRIBUTED_PORT, "0").toInt();
+	optimization_params.no_of_local_workers = settings.value(OPT_NO_OF_LOCAL_WORKERS, "0").toInt();
+	optimization_params.use_result_cache = settings.value(OPT_USE_RESULT_CACHE, "1").toBool();
+	optimization_params.surrogate_candidates = settings.value(OPT_SURROGATE_CANDIDATES, "1").toInt();
+	optimization_params.record_traces = settings.value(OPT_RECORD_TRACES, "0").toBool();
 	
 	//scores.time_taken = 4.0 * std::pow((double)(results.time_taken) / (double)(swarm_params_.max_time_taken_ + 100), 2);
 	//scores.simul_sampling =  6.0 * std::pow((results.simul_sampling - robots_in_a_cluster) / (double)(swarm_params_.no_of_robots_), 2.0);
@@ -125,6 +139,11 @@ void SwarmUtils::save_optimization_params(const OptimizationParams& params, cons
 	settings.setValue(OPT_NO_OF_THREADS, params.no_of_threads);
 	settings.setValue(OPT_NO_OF_ITERATIONS, params.no_of_iterations);
 	settings.setValue(OPT_CULLING_NTH_ITERATION, params.culling_nth_iteration);
+	settings.setValue(OPT_DISTRIBUTED_PORT, params.distributed_port);
+	settings.setValue(OPT_NO_OF_LOCAL_WORKERS, params.no_of_local_workers);
+	settings.setValue(OPT_USE_RESULT_CACHE, params.use_result_cache);
+	settings.setValue(OPT_SURROGATE_CANDIDATES, params.surrogate_candidates);
+	settings.setValue(OPT_RECORD_TRACES, params.record_traces);
 
 	settings.setValue(OPT_COEFF_TIME_TAKEN, params.coefficients.time_taken);
 	settings.setValue(OPT_COEFF_COVERAGE, params.coefficients.density);
@@ -210,6 +229,7 @@ SwarmParams SwarmUtils::load_swarm_params(const QString& filename) {
 
 	swarm_params.coverage_needed_ = settings.value(COVERAGE_FACTOR, "1.0").toDouble();
 	swarm_params.desired_sampling = settings.value(DESIRED_SAMPLING, "1.0").toDouble();
+	swarm_params.seed_ = settings.value(SEED, "1").toUInt();
 	return swarm_params;
 }
 
@@ -286,6 +306,7 @@ void SwarmUtils::save_swarm_params(const SwarmParams& params, const QString& fil
 	settings.setValue(COVERAGE_FACTOR, params.coverage_needed_);
 
 	settings.setValue(DESIRED_SAMPLING, params.desired_sampling);
+	settings.setValue(SEED, params.seed_);
 }
 
 void SwarmUtils::print_vector(const std::string& name, const glm::vec3& vector) {
@@ -581,15 +602,13 @@ std::vector<glm::vec3> SwarmUtils::create_starting_formation(Formation type, Swa
 
 	}
 	case RANDOM: {
-		std::random_device rd;
-		std::mt19937 rng;
-		rng.seed(rd());
-		std::uniform_int_distribution<int> position_generator_x(0, swarm_params.grid_width_- 1);
-		std::uniform_int_distribution<int> position_generator_z(0, swarm_params.grid_height_ - 1);
+		CounterRng rng(swarm_params.seed_, 0, 0, CounterRng::STARTING_FORMATION);
 		int robot_count = 0;
 		int iterations = 0;
 		while ((swarm_params.no_of_robots_ != robot_count) && ((swarm_params.no_of_robots_ + 100) > iterations)) {
-			glm::ivec3 robot_grid_position(position_generator_x(rng), 0, position_generator_z(rng));
+			int x = rng.uniform_int(0, swarm_params.grid_width_ - 1);
+			int z = rng.uniform_int(0, swarm_params.grid_height_ - 1);
+			glm::ivec3 robot_grid_position(x, 0, z);
 			if (!occupancy_grid_->is_out_of_bounds(robot_grid_position)
 				&& !occupancy_grid_->is_interior(robot_grid_position)) {
 				robot_positions.push_back(occupancy_grid_->map_to_position(robot_grid_position));
@@ -740,26 +759,64 @@ void SwarmUtils::derive_floor_plan(const VertexBufferData& bufferdata, float sca
 	//occupancy_grid_->remove_inner_interiors();
 }
 
+void SwarmUtils::derive_voxels(const VertexBufferData& bufferdata, float scale, const glm::vec3& offset,
+	SwarmVoxelTree* voxel_tree) {
+	for (size_t i = 0; i < bufferdata.count.size(); ++i) {
+		int index_offset = bufferdata.base_index[i];
+		int base_vertex = bufferdata.offset[i];
+		for (int j = 0; j + 2 < bufferdata.count[i]; j += 3) {
+			glm::vec3 triangle[3];
+			for (int k = 0; k < 3; ++k) {
+				auto& position = bufferdata.positions[base_vertex + bufferdata.indices[index_offset + j + k]];
+				triangle[k] = scale * (glm::vec3(position[0], position[1], position[2]) + offset);
+			}
+			voxel_tree->mark_surface_triangle(triangle[0], triangle[1], triangle[2]);
+		}
+	}
+}
+
 bool SwarmUtils::load_interior_model_from_matrix(SwarmParams& swarm_params, SwarmOccupancyTree** occupancy_grid,
                                                  Swarm3DReconTree** recon_grid, SwarmCollisionTree** collision_grid) {
 
-
-
-	cv::Mat model_matrix;
 	std::string model_filename = swarm_params.model_matrix_filename_.toStdString();
-	int last_period_pos = model_filename.find_last_of('.');
-	std::string file_ext = model_filename.substr(last_period_pos, model_filename.length() - last_period_pos);
-
-	if (file_ext == ".yml") {
-		cv::FileStorage fs2(model_filename, cv::FileStorage::READ);
-		fs2["model"] >> model_matrix;
-	} else if (file_ext == ".bmp" || file_ext == ".jpg") {
-		model_matrix = cv::imread(model_filename, CV_LOAD_IMAGE_GRAYSCALE);
-	} else {
-		std::cout << "Unknown file type :  " << file_ext << "\n";
+
+	// compiled pyramid, only misses when the resolution is outside the cached levels
+	auto floor_plan = FloorPlanCache::get(model_filename);
+	if (!floor_plan) {
+		return false;
+	}
+	const FloorPlanLevel* level = floor_plan->level(swarm_params.grid_resolution_);
+	if (level) {
+		swarm_params.grid_width_ = level->grid_width;
+		swarm_params.grid_height_ = level->grid_height;
+
+		*occupancy_grid = new SwarmOccupancyTree(swarm_params.grid_length_, swarm_params.grid_width_, swarm_params.grid_height_, 0);
+		*collision_grid = new SwarmCollisionTree(swarm_params.grid_width_, swarm_params.grid_height_);
+		*recon_grid = new Swarm3DReconTree(swarm_params.grid_length_, swarm_params.grid_width_, swarm_params.grid_height_);
+
+		int grid_cube_length = swarm_params.grid_length_;
+		int mark = (*occupancy_grid)->get_interior_mark();
+
+		int y = 0;
+		for (int z = 0; z < level->grid_height; ++z) {
+			const std::uint64_t* row = level->interior_mask + z * level->words_per_row;
+			for (int word_index = 0; word_index < level->words_per_row; ++word_index) {
+				std::uint64_t word = row[word_index];
+				while (word) {
+					int x = word_index * 64 + FloorPlanLevel::lowest_bit(word);
+					word &= word - 1;
+					glm::vec3 points((x + 0.5) * grid_cube_length, y, (x + 0.5) * grid_cube_length);
+					(*recon_grid)->insert(points, glm::ivec3(x, y, z));
+					(*occupancy_grid)->set(x, z, mark);
+				}
+			}
+		}
+		(*occupancy_grid)->set_interior_list(level->perimeter_cells, level->no_of_perimeter_cells);
+		return true;
 	}
 
-	if (model_matrix.empty()) {
+	cv::Mat model_matrix;
+	if (!FloorPlanCache::read_model_matrix(model_filename, model_matrix)) {
 		return false;
 	}
 
@@ -789,7 +846,7 @@ bool SwarmUtils::load_interior_model_from_matrix(SwarmParams& swarm_params, Swar
 	for (int x = 0; x < model_matrix.cols; ++x) {
 		for (int z = 0; z < model_matrix.rows; ++z) {
 			int value = model_matrix.at<unsigned char>(z, x);
-			if (value < 220) {
+			if (value < FloorPlanCache::INTERIOR_THRESHOLD) {
 				glm::vec3 points((x + 0.5) * grid_cube_length, y, (x + 0.5) * grid_cube_length);
 				(*recon_grid)->insert(points, glm::ivec3(x, y, z));
 				(*occupancy_grid)->set(x, z, mark);
@@ -985,9 +1042,6 @@ void SwarmUtils::create_robots(SwarmParams& swarm_params, std::unordered_map<int
 		
 	//std::cout << "Debug : " << robots_in_a_cluster << "," << no_of_clusters << ", " << robot_positions.size() << ", " << swarm_params.no_of_robots_ << "\n";
 	for (int i = 0; i < swarm_params.no_of_robots_; ++i) {
-		std::random_device rd;
-		std::mt19937 rng;
-		rng.seed(rd());
 		auto separation_distance = swarm_params.separation_range_max_ * swarm_params.grid_length_;
 		int cluster_id = (i / robots_in_a_cluster) > (no_of_clusters - 1) ? 0 : i / robots_in_a_cluster;
 		ExperimentalRobot* robot = new ExperimentalRobot(uniform_locations, 
@@ -1005,6 +1059,34 @@ void SwarmUtils::create_robots(SwarmParams& swarm_params, std::unordered_map<int
 	}
 }
 
+void SwarmUtils::reset_robots(SwarmParams& swarm_params, std::unordered_map<int, int>& death_map_,
+	SwarmOccupancyTree* occupancy_grid_, std::vector<Robot*>& robots) {
+
+	std::vector<glm::vec3> robot_positions = create_starting_formation(static_cast<Formation>(swarm_params.formation), swarm_params,
+		occupancy_grid_);
+
+	assert(swarm_params.no_of_robots_ == robot_positions.size());
+	assert(swarm_params.no_of_robots_ == robots.size());
+
+	populate_death_map(swarm_params, death_map_);
+
+	int no_of_clusters = (swarm_params.no_of_clusters_ > swarm_params.no_of_robots_) ? swarm_params.no_of_robots_ : swarm_params.no_of_clusters_;
+	int robots_in_a_cluster = swarm_params.no_of_robots_ / no_of_clusters;
+	swarm_params.robots_in_a_cluster_ = robots_in_a_cluster;
+
+	for (int i = 0; i < swarm_params.no_of_robots_; ++i) {
+		auto separation_distance = swarm_params.separation_range_max_ * swarm_params.grid_length_;
+		int cluster_id = (i / robots_in_a_cluster) > (no_of_clusters - 1) ? 0 : i / robots_in_a_cluster;
+		ExperimentalRobot* robot = static_cast<ExperimentalRobot*>(robots[i]);
+		robot->reset(cluster_id,
+			swarm_params.separation_constant_, swarm_params.alignment_constant_, swarm_params.cluster_constant_, swarm_params.explore_constant_,
+			swarm_params.discovery_range_, separation_distance, robot_positions[i], swarm_params.square_radius_, swarm_params.bounce_function_power_,
+			swarm_params.bounce_function_multiplier_, swarm_params.max_time_taken_, swarm_params);
+
+		robot->set_death_time(death_map_[i]);
+	}
+}
+
 void SwarmUtils::populate_death_map(SwarmParams& swarm_params, std::unordered_map<int, int>& death_map_) {
 
 	std::set<int> dying_robots;
@@ -1017,18 +1099,15 @@ void SwarmUtils::populate_death_map(SwarmParams& swarm_params, std::unordered_ma
 
 	int dead_robots_count = 0;
 
-	std::random_device rd;
-	std::mt19937 eng(rd());
-	std::uniform_int_distribution<int> robot_distribution(0, swarm_params.no_of_robots_ - 1);
-	std::uniform_int_distribution<int> death_time_distribution(0, swarm_params.death_time_taken_- 1);
+	CounterRng rng(swarm_params.seed_, 0, 0, CounterRng::DEATH_MAP);
 
 	while (no_of_dead_robots > dead_robots_count) {
-		int robot_id = robot_distribution(eng);
+		int robot_id = rng.uniform_int(0, swarm_params.no_of_robots_ - 1);
 		if (dying_robots.find(robot_id) == dying_robots.end()) {
 			if (death_map_.find(robot_id) == death_map_.end()) {
 				std::cout << "Unknown robot_id : " << robot_id << "\n";
 			} else {
-				int death_time = death_time_distribution(eng);
+				int death_time = rng.uniform_int(0, swarm_params.death_time_taken_ - 1);
 
 				// init sampling grid
 				death_map_[robot_id] = death_time;
@@ -1063,12 +1142,73 @@ std::string SwarmUtils::get_swarm_config_results_filename(std::string swarm_conf
 
 }
 
+std::string SwarmUtils::get_video_directory(std::string swarm_config_filename) {
+	std::string filename_prefix = "";
+	auto period_pos = swarm_config_filename.rfind(".");
+	if (period_pos != std::string::npos) {
+		filename_prefix = swarm_config_filename.substr(0, period_pos) + std::string("_");
+	}
+	auto timestamp = std::chrono::steady_clock::now().time_since_epoch().count();
+	return filename_prefix + "video_" + std::to_string(timestamp);
+}
+
+std::vector<cv::Vec4f> SwarmUtils::get_robot_colors(const SwarmParams& swarm_params) {
+	int no_of_clusters = (swarm_params.no_of_clusters_ > swarm_params.no_of_robots_) ? swarm_params.no_of_robots_ : swarm_params.no_of_clusters_;
+
+	std::vector<cv::Vec4f> cluster_colors;
+
+	cv::Vec4f green(0.f, 1.f, 0.f, 1.f);
+	cv::Vec4f red(1.f, 0.f, 0.f, 1.f);
+	cv::Vec4f yellow(1.f, 1.f, 0.f, 1.f);
+	cv::Vec4f blue(0.f, 0.f, 1.f, 1.f);
+	//cv::Vec4f black(0.f, 0.f, 0.f, 1.f); -- dead color
+	cv::Vec4f orange = (cv::Vec4f(255.f, 131.f, 0.f, 255.f)) / 255.f;
+	cv::Vec4f white(1.f, 1.f, 1.f, 1.f);
+	cv::Vec4f magenta(1.f, 0.f, 1.f, 1.f);
+	cv::Vec4f purple(.5f, 0.f, .5f, 1.f);
+
+	cv::Vec4f dark_gray = cv::Vec4f(126, 140, 141, 255) / 255.f;
+	dark_gray /= 3.f;
+	dark_gray[3] = 1.f;
+
+	cluster_colors.push_back(dark_gray);
+	cluster_colors.push_back(green);
+	cluster_colors.push_back(red);
+	cluster_colors.push_back(yellow);
+	cluster_colors.push_back(blue);
+	cluster_colors.push_back(orange);
+	cluster_colors.push_back(white);
+	cluster_colors.push_back(magenta);
+	cluster_colors.push_back(purple);
+
+	std::random_device rd;
+	std::mt19937 rng;
+	rng.seed(rd());
+	std::uniform_real_distribution<float> color_generator(0.f, 1.f);
+
+	while (cluster_colors.size() < no_of_clusters) {
+		cv::Vec4f color(color_generator(rng), color_generator(rng), color_generator(rng), 1.f);
+		cluster_colors.push_back(color);
+	}
+
+	std::vector<cv::Vec4f> robot_colors(swarm_params.no_of_robots_, cluster_colors[0]);
+	if (no_of_clusters > 0) {
+		int robots_in_a_cluster = swarm_params.no_of_robots_ / no_of_clusters;
+		for (int i = 0; i < swarm_params.no_of_robots_; ++i) {
+			int cluster_id = (i / robots_in_a_cluster) > (no_of_clusters - 1) ? 0 : i / robots_in_a_cluster;
+			robot_colors[i] = cluster_colors[cluster_id];
+		}
+	}
+	return robot_colors;
+}
+
 void SwarmUtils::print_result_header(std::ostream& stream) {
 	stream << "temperature,thread_id,iteration,model_filename,no_of_robots,"
 		<< "no_of_clusters,separation,alignment,cluster,explore,obstacle_avoidance,separation_distance,"
 		<< "time_taken,simul_sampling,multi_sampling,coverage,occlusion,clustering,score,"
 		<< "time_taken_score,simul_sampling_score,multi_sampling_score,coverage_score,occlusion_score,clustering_score,"
-		<< "time_taken_coeff,simul_sampling_coeff,multi_sampling_coeff,coverage_coeff,occlusion_coeff,clustering_coeff"
+		<< "time_taken_coeff,simul_sampling_coeff,multi_sampling_coeff,coverage_coeff,occlusion_coeff,clustering_coeff,"
+		<< "seed"
 		<< "\n";
 }
 
@@ -1104,7 +1244,8 @@ void SwarmUtils::print_result(const MCMCParams& params, std::ostream& stream) {
 		<< params.coeffs.multi_samping << ","
 		<< params.coeffs.density << ","
 		<< params.coeffs.occlusion << ","
-		<< params.coeffs.clustering
+		<< params.coeffs.clustering << ","
+		<< params.swarm_params.seed_
 		<< "\n";
 }
 
@@ -34,6 +34,16 @@ struct OptimizationParams {
 	int no_of_threads;
 	int no_of_iterations;
 	int culling_nth_iteration;
+	// 0 runs simulations on the local thread pool, otherwise workers connect to this port
+	int distributed_port;
+	// worker processes started on this machine when distributed_port is set
+	int no_of_local_workers;
+	// reuse results of parameter sets already simulated, in this run or an earlier one
+	bool use_result_cache;
+	// proposals per mcmc step ranked by the surrogate, 1 simulates every proposal
+	int surrogate_candidates;
+	// a SwarmTrace of every simulation run on this machine, in <swarm config>_traces
+	bool record_traces;
 	QStringList swarm_configs;
 	OptimizationResults coefficients;
 	
@@ -52,6 +62,7 @@ struct MCMCParams {
 };
 
 struct VertexBufferData;
+class SwarmVoxelTree;
 
 enum Formation {
 	GRID = 0,
@@ -75,6 +86,11 @@ class SwarmUtils
 	static const char* OPT_NO_OF_THREADS;
 	static const char* OPT_NO_OF_ITERATIONS;
 	static const char* OPT_CULLING_NTH_ITERATION;
+	static const char* OPT_DISTRIBUTED_PORT;
+	static const char* OPT_NO_OF_LOCAL_WORKERS;
+	static const char* OPT_USE_RESULT_CACHE;
+	static const char* OPT_SURROGATE_CANDIDATES;
+	static const char* OPT_RECORD_TRACES;
 	static const char* OPT_COEFF_TIME_TAKEN;
 	static const char* OPT_COEFF_COVERAGE;
 	static const char* OPT_COEFF_SIMUL_SAMPLING;
@@ -130,6 +146,7 @@ class SwarmUtils
 	static const char* DEATH_TIME_TAKEN;
 	static const char* COVERAGE_FACTOR;
 	static const char* DESIRED_SAMPLING;
+	static const char* SEED;
 	// delete later
 	static const std::string DEFAULT_INTERIOR_MODEL_FILENAME;
 	static const int DEFAULT_NO_OF_ROBOTS;
@@ -151,9 +168,15 @@ public:
 	static void write_matrix_to_file();
 	//static void load_interior_model(SwarmParams& swarm_params, VertexBufferData*& vertex_buffer_data, SwarmOccupancyTree* occupancy_grid_, Swarm3DReconTree* recon_grid_);
 	static void create_robots(SwarmParams& swarm_params, std::unordered_map<int, int>& death_map_, SwarmOccupancyTree* occupancy_grid_, SwarmCollisionTree* collision_grid_, Swarm3DReconTree* recon_grid_, UniformLocations& uniform_locations, QGLShaderProgram* shader, bool render, std::vector<Robot*>& robots);
+	// same as create_robots, on robots create_robots made earlier for the same grids and no of robots
+	static void reset_robots(SwarmParams& swarm_params, std::unordered_map<int, int>& death_map_, SwarmOccupancyTree* occupancy_grid_, std::vector<Robot*>& robots);
 	static void populate_death_map(SwarmParams& swarm_params, std::unordered_map<int, int>& death_map_);
 	static std::string get_optimizer_results_filename(std::string swarm_config_filename, std::string mid_part);
 	static std::string get_swarm_config_results_filename(std::string swarm_config_filename, std::string mid_part);
+	// a new directory name for the frames of a run of swarm_config_filename
+	static std::string get_video_directory(std::string swarm_config_filename);
+	// the color of each robot, by cluster
+	static std::vector<cv::Vec4f> get_robot_colors(const SwarmParams& swarm_params);
 	static void print_result_header(std::ostream& stream);
 	static void print_result(const MCMCParams& params, std::ostream& stream);
 	static double calculate_coverage(std::vector<Robot*> robots_);
@@ -164,6 +187,9 @@ public:
 	static bool intersect(const cv::Vec3f& n, float d, const cv::Vec3f& a, const cv::Vec3f& b, cv::Vec3f& intersection_pt);
 	static void derive_floor_plan(const VertexBufferData& bufferdata, float scale, const glm::vec3& offset,
 		SwarmOccupancyTree* occupancy_grid_, Swarm3DReconTree* recon_grid_);
+	// every storey of the model, where derive_floor_plan keeps one slice
+	static void derive_voxels(const VertexBufferData& bufferdata, float scale, const glm::vec3& offset,
+		SwarmVoxelTree* voxel_tree);
 	static bool load_interior_model_from_matrix(SwarmParams& swarm_params,
 	                                            SwarmOccupancyTree** occupancy_grid,
 	                                            Swarm3DReconTree** recon_grid, SwarmCollisionTree** collision_grid);
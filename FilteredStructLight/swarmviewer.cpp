@@ -16,6 +16,8 @@
 #include <unordered_map>
 #include <qdir.h>
 #include <iomanip>
+#include "swarmtrace.h"
+#include "swarmframe.h"
 
 
 //const std::string SwarmViewer::DEFAULT_INTERIOR_MODEL_FILENAME = "interior/house interior.obj";
@@ -31,6 +33,8 @@ const int SwarmViewer::DEFAULT_NO_OF_ROBOTS = 3;
 
 const std::string SwarmViewer::OCCUPANCY_GRID_NAME = "occupancy_grid";
 const std::string SwarmViewer::OCCUPANCY_GRID_OVERLAY_NAME = "occupancy_grid_overlay";
+// clean cells between two dirty ones that are uploaded anyway rather than starting another span
+const int GridOverlay::MAX_SPAN_GAP = 16;
 const int SwarmViewer::OCCUPANCY_GRID_HEIGHT = 2;
 
 
@@ -45,7 +49,7 @@ void SwarmViewer::Light::update(glm::mat4 global_model) {
 	glUniform3fv(light_position_location_, 1, glm::value_ptr(world_position));
 }
 
-RobotWorker::RobotWorker() : aborted_(false), paused_(false), sampling_updated_(false), figure_mode_(false) {
+RobotWorker::RobotWorker() : aborted_(false), paused_(false), sampling_updated_(false), figure_mode_(false), frame_writer_(nullptr) {
 	//refresh_rate_ = 1.f / 30.f;
 	//accumulator_ = 0.f;
 	
@@ -89,6 +93,11 @@ void RobotWorker::set_simlutaneous_sampling_per_gridcell_map(ThreadSafeSimSampMa
 	simultaneous_sampling_per_grid_cell_ = simultaneous_sampling_per_grid_cell;
 }
 
+void RobotWorker::set_frame_writer(SwarmFrameWriter* frame_writer, const std::vector<cv::Vec4f>& robot_colors) {
+	frame_writer_ = frame_writer;
+	robot_colors_ = robot_colors;
+}
+
 //void RobotWorker::set_overlay_lock(QMutex* overlay_lock) {
 //	overlay_lock_ = overlay_lock;
 //}
@@ -101,6 +110,9 @@ void RobotWorker::finish_work() {
 				auto map = occupancy_grid_->calculate_simultaneous_sampling_per_grid_cell();
 				simultaneous_sampling_per_grid_cell_->set_map(map);
 		//}
+		if (frame_writer_ && figure_mode_) {
+			frame_writer_->write(SwarmFrameRenderer::render(occupancy_grid_, robots_, robot_colors_, &map, swarm_params_.desired_sampling));
+		}
 		OptimizationResults results;
 
 		SwarmUtils::calculate_sim_results(occupancy_grid_, recon_grid_, robots_, time_step_count_, swarm_params_, results);
@@ -129,10 +141,6 @@ void RobotWorker::do_work() {
 			//if (time_step_count_ == 384) {
 			//	paused_ = true;
 			//}
-			if (swarm_params_.video_mode_ && frame_ready_) {
-				continue;
-			}
-
 			if (slow_down_) {
 				//each time step, call again
 				auto current_time = std::chrono::steady_clock::now();
@@ -162,10 +170,6 @@ void RobotWorker::do_work() {
 				finish_work();
 			}
 
-			if (swarm_params_.video_mode_) {
-				frame_ready_ = true;
-			}
-
 		}
 		if (!paused_) {
 			//std::chrono::milliseconds current_timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(
@@ -193,6 +197,9 @@ void RobotWorker::do_work() {
 				//	}
 				//}
 				time_step_count_++;
+				if (frame_writer_) {
+					frame_writer_->write(SwarmFrameRenderer::render(occupancy_grid_, robots_, robot_colors_, nullptr, swarm_params_.desired_sampling));
+				}
 			} catch (OutOfGridBoundsException& ex) {
 				std::cout << "Out of bounds...\n";
 				finish_work();
@@ -203,14 +210,6 @@ void RobotWorker::do_work() {
 	}
 }
 
-bool RobotWorker::is_frame_ready() const {
-	return frame_ready_;
-}
-
-void RobotWorker::reset_frame() {
-	frame_ready_ = false;
-}
-
 void RobotWorker::init() {
 	sampling_updated_ = false;
 	aborted_ = false;
@@ -253,32 +252,36 @@ void Recon3DPoints::create_points() {
 	int total_offset = 0;
 	int total_indices = 0;
 
-	for (int x = 0; x < grid_resolution_per_side_; ++x) {
-		for (int z = 0; z < grid_resolution_per_side_; ++z) {
-			glm::ivec3 grid_position(x, 0, z);
-			auto points_3d_vector = recon_grid_->get_3d_points(grid_position);
-
-			int i = 0;
-			for (auto& point_3d : *points_3d_vector) {
-				auto& vertices = bufferdata->positions;
-				vertices.push_back(cv::Vec3f(point_3d.x, point_3d.y, point_3d.z));
-				cv::Vec4f color = unexplored_color;
-				bufferdata->colors.push_back(color);
-				bufferdata->normals.push_back(normal);
-				bufferdata->indices.push_back(i);
-				i++;
-			}
+	// the recon points are already one array, cell after cell
+	auto& points_3d = recon_grid_->get_points();
+	auto& cell_offsets = recon_grid_->get_offsets();
 
-			auto indices_count = points_3d_vector->size();
-			auto no_of_vertices = indices_count;
+	static_assert(sizeof(glm::vec3) == sizeof(cv::Vec3f), "recon points are copied as is");
+	auto& vertices = bufferdata->positions;
+	vertices.resize(points_3d.size());
+	if (!points_3d.empty()) {
+		std::memcpy(&vertices[0], points_3d.data(), points_3d.size() * sizeof(glm::vec3));
+	}
+	bufferdata->colors.assign(points_3d.size(), unexplored_color);
+	bufferdata->normals.assign(points_3d.size(), normal);
+	bufferdata->indices.reserve(points_3d.size());
+
+	int no_of_cells = cell_offsets.size() - 1;
+	bufferdata->count.reserve(no_of_cells);
+	bufferdata->offset.reserve(no_of_cells);
+	bufferdata->base_index.reserve(no_of_cells);
+	for (int index = 0; index < no_of_cells; ++index) {
+		int indices_count = cell_offsets[index + 1] - cell_offsets[index];
+		for (int i = 0; i < indices_count; ++i) {
+			bufferdata->indices.push_back(i);
+		}
 
-			bufferdata->count.push_back(indices_count);
-			bufferdata->offset.push_back(total_offset);
-			bufferdata->base_index.push_back(total_indices);
+		bufferdata->count.push_back(indices_count);
+		bufferdata->offset.push_back(total_offset);
+		bufferdata->base_index.push_back(total_indices);
 
-			total_offset += (no_of_vertices);
-			total_indices += indices_count;
-		}
+		total_offset += indices_count;
+		total_indices += indices_count;
 	}
 
 	base_vertex_ = bufferdata->offset;
@@ -327,7 +330,7 @@ GridOverlay::GridOverlay(UniformLocations& locations, SwarmOccupancyTree* octree
 	int no_of_robots_in_a_cluster, bool display_local_map) :
 	VisObject(locations), occupany_grid_(octree), grid_width_(grid_width), grid_height_(grid_height), grid_length_(grid_length), 
 	robot_color_map_(robot_color_map), shader_(shader), simult_sampling_grid_(mm::Quadtree<SamplingTime>(grid_width_, grid_height_, 1, SamplingTime())),
-	desired_sampling_(no_of_robots_in_a_cluster), display_local_map_(display_local_map)  {
+	desired_sampling_(no_of_robots_in_a_cluster), display_local_map_(display_local_map), dirty_begin_(0), dirty_end_(0)  {
 	
 	cv::Vec4f dark_green(60.f, 179.f, 113.f, 255.f);
 
@@ -407,6 +410,7 @@ void GridOverlay::create_mesh(bool initialize) {
 						color = interior_color;
 					}
 				}
+				cell_colors_.push_back(color);
 				//int explored_robot = occupany_grid_->explored_by(current_position);
 
 				//if (explored_robot >= 0) {
@@ -423,6 +427,7 @@ void GridOverlay::create_mesh(bool initialize) {
 		bufferdata.count.push_back(bufferdata.positions.size());
 		bufferdata.base_index.push_back(0);
 		bufferdata.offset.push_back(0);
+		dirty_cells_.assign(cell_colors_.size(), 0);
 
 		if (initialize) {
 			RenderMesh grid_overlay_mesh;
@@ -442,6 +447,67 @@ void GridOverlay::create_mesh(bool initialize) {
 
 void GridOverlay::update(glm::mat4 global_model) {
 	//create_mesh(false);
+	flush();
+}
+
+void GridOverlay::set_cell_color(int index, const cv::Vec4f& color) {
+	cell_colors_[index] = color;
+	if (!dirty_cells_[index]) {
+		dirty_cells_[index] = 1;
+		if (dirty_begin_ == dirty_end_) {
+			dirty_begin_ = index;
+			dirty_end_ = index + 1;
+		} else {
+			dirty_begin_ = std::min(dirty_begin_, index);
+			dirty_end_ = std::max(dirty_end_, index + 1);
+		}
+	}
+}
+
+void GridOverlay::flush() {
+	upload_colors_.clear();
+	upload_spans_.clear();
+
+	// copy out under the lock, upload without it so the simulation isn't held up by the driver
+	cell_lock_.lock();
+	int index = dirty_begin_;
+	while (index < dirty_end_) {
+		if (!dirty_cells_[index]) {
+			++index;
+			continue;
+		}
+		int span_begin = index;
+		int span_end = index + 1;
+		for (int next = span_end; next < dirty_end_ && next - span_end <= MAX_SPAN_GAP; ++next) {
+			if (dirty_cells_[next]) {
+				span_end = next + 1;
+			}
+		}
+		for (int i = span_begin; i < span_end; ++i) {
+			dirty_cells_[i] = 0;
+			upload_colors_.insert(upload_colors_.end(), 6, cell_colors_[i]);
+		}
+		upload_spans_.push_back(std::make_pair(span_begin, span_end));
+		index = span_end;
+	}
+	dirty_begin_ = dirty_end_ = 0;
+	cell_lock_.unlock();
+
+	if (upload_spans_.empty()) {
+		return;
+	}
+
+	RenderEntity& entity = mesh_[0];
+	glBindVertexArray(entity.vao_);
+	glBindBuffer(GL_ARRAY_BUFFER, entity.vbo_[RenderEntity::COLOR]);
+	int offset = 0;
+	for (auto& span : upload_spans_) {
+		int no_of_vertices = 6 * (span.second - span.first);
+		glBufferSubData(GL_ARRAY_BUFFER, 6 * span.first * sizeof(cv::Vec4f), no_of_vertices * sizeof(cv::Vec4f),
+			&upload_colors_[offset]);
+		offset += no_of_vertices;
+	}
+	glBindVertexArray(0);
 }
 
 void GridOverlay::update_poo_position(const glm::vec3& position, const cv::Vec4f& color) {
@@ -470,69 +536,29 @@ void GridOverlay::update_grid_position(const glm::ivec3& position, const cv::Vec
 
 	//auto& sampling_time = simult_sampling_grid_.at(position.x, position.z);
 
-	RenderEntity& entity = mesh_[0];
-
-
-	std::vector<cv::Vec4f> fill_color(6);
-	std::fill(fill_color.begin(), fill_color.end(), color);
-
-	glBindVertexArray(entity.vao_);
-	glBindBuffer(GL_ARRAY_BUFFER, entity.vbo_[RenderEntity::COLOR]);
-	glBufferSubData(GL_ARRAY_BUFFER, 6 * ( (position.x * grid_height_) + position.z) * sizeof(cv::Vec4f), 
-		6 * sizeof(cv::Vec4f), &fill_color[0]);
-
-	glBindVertexArray(0);
+	QMutexLocker locker(&cell_lock_);
+	set_cell_color((position.x * grid_height_) + position.z, color);
 }
 
 cv::Vec4f GridOverlay::calculate_heatmap_color_grid_cell(double minimum, double maximum, double unclamped_value) {
-	double value = std::max(std::min(unclamped_value, maximum), minimum);
-	double ratio = 2 * (value-minimum) / (maximum - minimum);
-    int b = int(std::max(0.0, 255*(1 - ratio)));
-    int r = int(std::max(0.0, 255*(ratio - 1)));
-    int g = 255 - b - r;
-	cv::Vec4f color(r, g, b, 255.f);
-	color /= 255.f;
-    return color;
+	return SwarmFrameRenderer::heatmap_color(minimum, maximum, unclamped_value);
 }
 
-void GridOverlay::update_simultaneous_sampling_heatmap(const SimSampMap simultaneous_sampling_per_grid_cell) {
+void GridOverlay::update_simultaneous_sampling_heatmap(const SimSampMap& simultaneous_sampling_per_grid_cell) {
 
-	RenderEntity& entity = mesh_[0];
-
-	glBindVertexArray(entity.vao_);
-	glBindBuffer(GL_ARRAY_BUFFER, entity.vbo_[RenderEntity::COLOR]);
-
-	for (auto& sampling_per_grid_cell : simultaneous_sampling_per_grid_cell) {
-		auto& grid_cell = sampling_per_grid_cell.first;
-		auto& sampling = sampling_per_grid_cell.second;
+	QMutexLocker locker(&cell_lock_);
+	// the map uses the same x * grid_height + z layout as the color buffer
+	for (auto index : simultaneous_sampling_per_grid_cell.cells()) {
+		auto sampling = simultaneous_sampling_per_grid_cell.value(index);
 
 		//int expected_cluster_value = std::max(no_of_robots_in_a_cluster_, 2);
-		auto color = calculate_heatmap_color_grid_cell(0.0, desired_sampling_, sampling); 
-		std::vector<cv::Vec4f> fill_color(6);
-		std::fill(fill_color.begin(), fill_color.end(), color);
-
-		glBufferSubData(GL_ARRAY_BUFFER, 6 * ( (grid_cell.x * grid_height_) + grid_cell.z) * sizeof(cv::Vec4f), 
-			6 * sizeof(cv::Vec4f), &fill_color[0]);
+		set_cell_color(index, calculate_heatmap_color_grid_cell(0.0, desired_sampling_, sampling));
 	}
-
-	glBindVertexArray(0);
 }
 
 void GridOverlay::update_grid_position(const glm::ivec3& position) {
 
-	RenderEntity& entity = mesh_[0];
-
-
-	//std::vector<cv::Vec4f> fill_color(6);
-	//std::fill(fill_color.begin(), fill_color.end(), color);
-
-	glBindVertexArray(entity.vao_);
-	glBindBuffer(GL_ARRAY_BUFFER, entity.vbo_[RenderEntity::COLOR]);
-	glBufferSubData(GL_ARRAY_BUFFER, 6 * ( (position.x * grid_height_) + position.z) * sizeof(cv::Vec4f), 
-		6 * sizeof(cv::Vec4f), &fill_color_[0]);
-
-	glBindVertexArray(0);
-	//update_grid_position(position, fill_color_[0]);
+	update_grid_position(position, fill_color_[0]);
 	//RenderEntity& entity = mesh_[0];
 
 
@@ -831,6 +857,10 @@ void SwarmViewer::custom_draw_code() {
 	if (render_) {
 		glm::mat4 mvp;
 
+		if (trace_) {
+			update_replay();
+		}
+
 		glUniform3fv(view_position_loc_, 1, glm::value_ptr(eye_));
 
 		draw_scene(default_scene_);
@@ -860,17 +890,6 @@ void SwarmViewer::custom_draw_code() {
 		for (auto& light : lights_) {
 			light->update(model_);
 		}
-		if (swarm_params_.video_mode_) {
-			if (robot_worker_ && !update_finished_) {
-				if (robot_worker_->is_frame_ready()) {
-					write_frame();
-					if (figure_mode_) {
-						update_finished_ = true;
-					}
-					robot_worker_->reset_frame();
-				}
-			}
-		}
 	}
 
 }
@@ -904,12 +923,18 @@ void SwarmViewer::shutdown_worker() {
 		delete robot_worker_;
 		robot_worker_ = nullptr;
 	}
-	
+	// waits for the frames still being encoded
+	if (frame_writer_) {
+		delete frame_writer_;
+		frame_writer_ = nullptr;
+	}
+
 }
 
 SwarmViewer::~SwarmViewer() {
 	VisibilityQuadrant::cleanup();
 	shutdown_worker();
+	stop_replay();
 	cleanup();
 	timer_->stop();
 }
@@ -956,45 +981,10 @@ void SwarmViewer::cleanup() {
 	
 }
 
-std::string SwarmViewer::generate_next_frame_filename() {
-
-	std::stringstream ss;
-
-	ss << video_dir << "/" << std::setfill('0') << std::setw(5) << video_sequence_++ << ".png";
-
-	std::string filename = ss.str();
-
-	return filename;
-	
-}
-
-
-void SwarmViewer::write_frame() {
-	//if (!robot_worker_) {
-	//	return;
-	//}
-
-	//if (!robot_worker_->is_frame_ready()) {
-	//	return;
-	//}
-		
-
-	auto filename = generate_next_frame_filename();
-
-	int _width = width();
-	int _height = height();
-	glReadPixels(0, 0, _width, _height, GL_BGRA, GL_UNSIGNED_BYTE, &video_buffer_[0]);
-
-	cv::Mat mat(_height, _width, CV_8UC4, &video_buffer_[0]);
-	cv::imwrite(filename, mat);
-
-	
-}
-
-
-void SwarmViewer::reset_sim(SwarmParams& swarm_params) {
+bool SwarmViewer::setup_scene(SwarmParams& swarm_params, bool render) {
 	makeCurrent();
 	shutdown_worker();
+	stop_replay();
 	cleanup();
 
 
@@ -1003,13 +993,13 @@ void SwarmViewer::reset_sim(SwarmParams& swarm_params) {
 	step_count_ = -1;
 	time_step_count_ = 0;
 
-	render_ = gui_render_;
+	render_ = render;
 
 	VertexBufferData* vertex_buffer_data = nullptr;
 	bool file_exists = SwarmUtils::load_interior_model_from_matrix(swarm_params, &occupancy_grid_, &recon_grid_, &collision_grid_);
 	if (!file_exists) {
 		std::cout << "Floor plan doesn't exist.\n";
-		return;
+		return false;
 	}
 
 	//SwarmUtils::create_grids(&occupancy_grid_, &recon_grid_, &collision_grid_);
@@ -1038,25 +1028,6 @@ void SwarmViewer::reset_sim(SwarmParams& swarm_params) {
 	change_to_top_down_view();
 	if (render_) {
 		//upload_interior_model_data_to_gpu(vertex_buffer_data);
-		if (swarm_params_.video_mode_) {
-			video_sequence_ = 0;
-			update_finished_ = false;
-
-			auto timestamp = std::chrono::steady_clock::now().time_since_epoch().count();
-			std::string filename_prefix = "";
-			auto swarm_config_filename = swarm_params_.config_name_.toStdString();
-			auto period_pos = swarm_config_filename.rfind(".");
-			if (period_pos != std::string::npos) {
-				filename_prefix = swarm_config_filename.substr(0, period_pos) + std::string("_");
-			}
-			video_dir = filename_prefix + "_video_" + std::to_string(timestamp);
-			QDir dir(video_dir.c_str());
-			dir.mkpath(".");
-			video_buffer_.resize(width() * height() * 4);
-			glReadBuffer(GL_COLOR_ATTACHMENT0);
-			glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-		}
-
 		upload_robots_to_gpu();
 		create_occupancy_grid(swarm_params.grid_width_, swarm_params.grid_height_, swarm_params.grid_length_);
 		robot_color_map_[occupancy_grid_->get_interior_mark()] = cv::Vec4f(1.f, 1.f, 1.f, 1.f);
@@ -1082,6 +1053,13 @@ void SwarmViewer::reset_sim(SwarmParams& swarm_params) {
 	if (vertex_buffer_data) {
 		delete vertex_buffer_data;
 	}
+	return true;
+}
+
+void SwarmViewer::reset_sim(SwarmParams& swarm_params) {
+	if (!setup_scene(swarm_params, gui_render_)) {
+		return;
+	}
 
 	robot_worker_ = new RobotWorker();
 	robot_worker_->moveToThread(&robot_update_thread_);
@@ -1095,8 +1073,10 @@ void SwarmViewer::reset_sim(SwarmParams& swarm_params) {
 	connect(&robot_update_thread_, &QThread::started, robot_worker_, &RobotWorker::do_work);
 	connect(robot_worker_, &RobotWorker::aborted, this, &SwarmViewer::update_finished);
 
+	// frames are drawn from the grids on the worker thread, so video mode works with rendering off too
 	if (swarm_params_.video_mode_) {
-		connect(this, &SwarmViewer::frame_reset, robot_worker_, &RobotWorker::reset_frame);
+		frame_writer_ = new SwarmFrameWriter(SwarmUtils::get_video_directory(swarm_params_.config_name_.toStdString()));
+		robot_worker_->set_frame_writer(frame_writer_, SwarmUtils::get_robot_colors(swarm_params_));
 	}
 
 	simultaneous_sampling_per_grid_cell_map_.clear();
@@ -1111,6 +1091,92 @@ void SwarmViewer::reset_sim(SwarmParams& swarm_params) {
 	robot_update_thread_.start();
 }
 
+void SwarmViewer::load_trace(QString filename) {
+	auto trace = new SwarmTraceReader();
+	if (!trace->load(filename.toStdString())) {
+		delete trace;
+		return;
+	}
+
+	// the floor plan is loaded again from the trace's model matrix file, it has to be where it was when recording
+	SwarmParams swarm_params = trace->get_swarm_params();
+	swarm_params.video_mode_ = false;
+	if (!setup_scene(swarm_params, true)) {
+		delete trace;
+		return;
+	}
+	if (robots_.size() != trace->get_no_of_robots()) {
+		std::cout << "Trace has " << trace->get_no_of_robots() << " robots, its config makes " << robots_.size() << "\n";
+		delete trace;
+		return;
+	}
+
+	trace_ = trace;
+	replay_tick_ = 0.0;
+	replayed_tick_ = -1;
+	replay_clock_.start();
+	emit replay_loaded(trace_->get_no_of_ticks());
+}
+
+void SwarmViewer::set_replay_speed(double ticks_per_second) {
+	replay_speed_ = ticks_per_second;
+}
+
+void SwarmViewer::seek_replay(int tick) {
+	replay_tick_ = tick;
+}
+
+void SwarmViewer::stop_replay() {
+	if (trace_) {
+		delete trace_;
+		trace_ = nullptr;
+	}
+}
+
+void SwarmViewer::update_replay() {
+	double elapsed = replay_clock_.restart() / 1000.0;
+	replay_tick_ = std::min(std::max(replay_tick_ + elapsed * replay_speed_, 0.0), trace_->get_no_of_ticks() - 1.0);
+	int tick = static_cast<int>(replay_tick_);
+	if (tick == replayed_tick_) {
+		return;
+	}
+
+	// scrubbing walks the records in between, each one only touches the cells it changed
+	while (replayed_tick_ < tick) {
+		replayed_tick_++;
+		apply_trace_tick(replayed_tick_, true);
+	}
+	while (replayed_tick_ > tick) {
+		apply_trace_tick(replayed_tick_, false);
+		replayed_tick_--;
+	}
+
+	for (int i = 0; i < robots_.size(); ++i) {
+		dynamic_cast<ExperimentalRobot*>(robots_[i])->set_replay_state(trace_->get_position(tick, i), trace_->is_dead(tick, i),
+			robot_color_map_[i]);
+	}
+
+	emit replay_tick_changed(tick);
+	update_time_step_count(tick);
+}
+
+void SwarmViewer::apply_trace_tick(int tick, bool forward) {
+	// same colors as a live run
+	cv::Vec4f cyan = cv::Vec4f(0.f, 255.f, 204.f, 255.f) / 255.f;
+	cv::Vec4f unexplored_color(1.f, 1.f, 1.f, 1.f);
+
+	for (auto change = trace_->cell_changes_begin(tick); change != trace_->cell_changes_end(tick); ++change) {
+		if (forward || !change->first_change) {
+			overlay_->update_grid_position(change->grid_position, cyan / 1.3f);
+		} else {
+			overlay_->update_grid_position(change->grid_position, unexplored_color);
+		}
+	}
+	for (auto cell = trace_->interior_changes_begin(tick); cell != trace_->interior_changes_end(tick); ++cell) {
+		overlay_->update_grid_position(*cell, forward ? cyan / 2.f : unexplored_color);
+	}
+}
+
 void SwarmViewer::set_figure_mode(bool figure_mode) {
 	figure_mode_ = figure_mode;
 }
@@ -1362,7 +1428,12 @@ SwarmViewer::SwarmViewer(const QGLFormat& format, QWidget* parent) : RobotViewer
 
 	figure_mode_ = false;
 
-	update_finished_ = false;
+	frame_writer_ = nullptr;
+
+	trace_ = nullptr;
+	replay_tick_ = 0.0;
+	replayed_tick_ = -1;
+	replay_speed_ = 30.0;
 
 	//max_time_taken_ = 20010.0;
 	//no_of_clusters_ = 4;
@@ -1723,58 +1794,9 @@ void SwarmViewer::create_lights() {
 //}
 
 void SwarmViewer::populate_color_map() {
-	int no_of_clusters = (swarm_params_.no_of_clusters_ > swarm_params_.no_of_robots_) ? swarm_params_.no_of_robots_ : swarm_params_.no_of_clusters_;
-
-	std::vector<cv::Vec4f> robot_colors;
-
-	cv::Vec4f green(0.f, 1.f, 0.f, 1.f);
-	cv::Vec4f red(1.f, 0.f, 0.f, 1.f);
-	cv::Vec4f yellow(1.f, 1.f, 0.f, 1.f);
-	cv::Vec4f blue(0.f, 0.f, 1.f, 1.f);
-	//cv::Vec4f black(0.f, 0.f, 0.f, 1.f); -- dead color
-	cv::Vec4f orange = (cv::Vec4f(255.f, 131.f, 0.f, 255.f)) / 255.f;
-	cv::Vec4f cyan = cv::Vec4f(0.f, 255.f, 204.f, 255.f) / 255.f;
-	//cv::Vec4f cyan = cv::Vec4f(45.f, 204.f, 112.f, 255.f) / 255.f;
-	cv::Vec4f white(1.f, 1.f, 1.f, 1.f);
-	cv::Vec4f magenta(1.f, 0.f, 1.f, 1.f);
-	cv::Vec4f purple(.5f, 0.f, .5f, 1.f);
-
-	cv::Vec4f dark_green= cv::Vec4f(39.f, 174.f, 97.f, 255.f) / 255.f;
-
-	cv::Vec4f dark_gray = cv::Vec4f(126, 140, 141, 255) / 255.f;
-	dark_gray /= 3.f;
-	dark_gray[3] = 1.f;
-
-	//robot_colors.push_back(cyan/2.f);
-	robot_colors.push_back(dark_gray);
-	robot_colors.push_back(green);
-	robot_colors.push_back(red);
-	robot_colors.push_back(yellow);
-	robot_colors.push_back(blue);
-	robot_colors.push_back(orange);
-	robot_colors.push_back(white);
-	robot_colors.push_back(magenta);
-	robot_colors.push_back(purple);
-
-	std::random_device rd;
-	std::mt19937 rng;
-	rng.seed(rd());
-	std::uniform_real_distribution<float> color_generator(0.f, 1.f);
-
-	while (robot_colors.size() < no_of_clusters) {
-		cv::Vec4f color(color_generator(rng), color_generator(rng), color_generator(rng), 1.f);
-		robot_colors.push_back(color);
-	}
-
-	int robots_in_a_cluster = swarm_params_.no_of_robots_ / no_of_clusters;
-
-	for (int i = 0; i < swarm_params_.no_of_robots_; ++i) {
-		if (no_of_clusters > 0) {
-			int cluster_id = (i / robots_in_a_cluster) > (no_of_clusters - 1) ? 0 : i / robots_in_a_cluster;
-			robot_color_map_[i] = robot_colors[cluster_id];
-		} else {
-			robot_color_map_[i] = robot_colors[0];
-		}
+	auto robot_colors = SwarmUtils::get_robot_colors(swarm_params_);
+	for (int i = 0; i < robot_colors.size(); ++i) {
+		robot_color_map_[i] = robot_colors[i];
 	}
 }
 
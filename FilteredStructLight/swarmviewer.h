@@ -6,11 +6,14 @@
 #include <memory>
 #include "swarmtree.h"
 #include <QtCore/QThread>
+#include <QElapsedTimer>
 #include "swarmutils.h"
 #include "experimentalrobot.h"
 
 
 class ParallelMCMCOptimizer;
+class SwarmTraceReader;
+class SwarmFrameWriter;
 class RobotWorker : public QObject {
 	Q_OBJECT
 	std::vector<Robot*> robots_;
@@ -28,7 +31,9 @@ class RobotWorker : public QObject {
 	Swarm3DReconTree* recon_grid_;
 	SwarmParams swarm_params_;
 	ThreadSafeSimSampMap* simultaneous_sampling_per_grid_cell_;
-	bool frame_ready_;
+	// null unless in video mode, owned by SwarmViewer
+	SwarmFrameWriter* frame_writer_;
+	std::vector<cv::Vec4f> robot_colors_;
 	//QMutex* overlay_lock_;
 
 public:
@@ -42,6 +47,8 @@ public:
 	void set_max_time_taken(int max_time_taken);
 	void set_swarm_params(SwarmParams swarm_params);
 	void set_simlutaneous_sampling_per_gridcell_map(ThreadSafeSimSampMap* simultaneous_sampling_per_grid_cell);
+	// a frame of every tick is rendered on this thread and handed to frame_writer
+	void set_frame_writer(SwarmFrameWriter* frame_writer, const std::vector<cv::Vec4f>& robot_colors);
 
 	//void set_overlay_lock(QMutex* overlay_lock);
 
@@ -58,8 +65,6 @@ public slots:
 	void resume();
 	void step();
 	void do_work();
-	bool is_frame_ready() const;
-	void reset_frame();
 
 	signals:
 	void update_time_step_count(int count);
@@ -172,10 +177,17 @@ private:
 	bool figure_mode_;
 
 	// video write out
-	std::string video_dir;
-	int video_sequence_;
-	bool update_finished_;
-	std::vector<unsigned char> video_buffer_;
+	SwarmFrameWriter* frame_writer_;
+
+	// trace replay, null while simulating
+	SwarmTraceReader* trace_;
+	// where the replay is, fractional so slow speeds still advance
+	double replay_tick_;
+	// the tick the overlay and robots show
+	int replayed_tick_;
+	// ticks per second, negative plays backwards
+	double replay_speed_;
+	QElapsedTimer replay_clock_;
 protected:
 
 	void load_inital_models() override;
@@ -189,6 +201,12 @@ protected:
 	virtual void custom_draw_code() override;
 	virtual void draw_mesh(RenderMesh& mesh) override;
 	void shutdown_worker();
+	// grids, robots, overlay and lights for swarm_params, everything reset_sim does but starting the simulation
+	bool setup_scene(SwarmParams& swarm_params, bool render);
+	void stop_replay();
+	void update_replay();
+	// applies the overlay changes of tick, or undoes them
+	void apply_trace_tick(int tick, bool forward);
 	//bool intersect(const cv::Vec3f& n, float d,
 	//	const cv::Vec3f& a, const cv::Vec3f& b, cv::Vec3f& intersection_pt) const;
 	void quad_tree_test();
@@ -203,8 +221,6 @@ public:
 	SwarmViewer(const QGLFormat& format, QWidget* parent = 0);
 	virtual ~SwarmViewer();
 	void cleanup();
-	std::string generate_next_frame_filename();
-	void write_frame();
 	void create_light_model(RenderMesh& light_mesh);
 	void create_robot_model(RenderMesh& light_mesh, cv::Vec4f color, VertexBufferData& bufferdata);
 	void upload_robot_model(RenderMesh& robot_mesh, VertexBufferData& bufferdata);
@@ -256,7 +272,8 @@ signals:
 	//void update_sim_results_ui(double timesteps, double simul_sampling, double multi_sampling, double density, double occlusion);
 	void update_sim_results_ui(OptimizationResults results);
 
-	void frame_reset();
+	void replay_loaded(int no_of_ticks);
+	void replay_tick_changed(int tick);
 	
 
 public slots:
@@ -321,6 +338,10 @@ void run_mcmc_optimization(OptimizationParams opt_params, SwarmParams swarm_para
 void set_should_render(int render);
 void set_slow_down(int slow_down);
 void reset_sim(SwarmParams& swarm_params);
+// shows a SwarmTrace instead of simulating, at replay_speed_
+void load_trace(QString filename);
+void set_replay_speed(double ticks_per_second);
+void seek_replay(int tick);
 void set_figure_mode(bool figure_mode);
 	void set_show_forces(int show);
 	//void set_magic_k(double magic_k);
@@ -0,0 +1,392 @@
+#include "swarmvoxels.h"
+#include "floorplancache.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+VoxelBlock::VoxelBlock(const glm::ivec3& origin) : origin(origin), no_of_unexplored(0), frontier_index(-1) {
+	std::fill(surface, surface + VOXEL_BLOCK_SIZE, 0);
+	std::fill(explored, explored + VOXEL_BLOCK_SIZE, 0);
+}
+
+SwarmVoxelTree::SwarmVoxelTree(float voxel_length) : voxel_length_(voxel_length) {
+	clear();
+}
+
+void SwarmVoxelTree::clear() {
+	std::vector<VoxelBlock>().swap(blocks_);
+	block_map_.clear();
+	frontier_blocks_.clear();
+	no_of_surface_voxels_ = 0;
+	no_of_explored_voxels_ = 0;
+	no_of_points_ = 0;
+	min_voxel_ = glm::ivec3(GRID_MAX);
+	max_voxel_ = glm::ivec3(-GRID_MAX);
+}
+
+float SwarmVoxelTree::get_voxel_length() const {
+	return voxel_length_;
+}
+
+glm::ivec3 SwarmVoxelTree::map_to_voxel(const glm::vec3& position) const {
+	return glm::ivec3(std::floor(position.x / voxel_length_), std::floor(position.y / voxel_length_),
+		std::floor(position.z / voxel_length_));
+}
+
+glm::vec3 SwarmVoxelTree::map_to_position(const glm::ivec3& voxel) const {
+	return (glm::vec3(voxel) + glm::vec3(0.5f)) * voxel_length_;
+}
+
+glm::ivec3 SwarmVoxelTree::get_min_voxel() const {
+	return min_voxel_;
+}
+
+glm::ivec3 SwarmVoxelTree::get_max_voxel() const {
+	return max_voxel_;
+}
+
+glm::ivec3 SwarmVoxelTree::map_to_block(const glm::ivec3& voxel) {
+	return glm::ivec3(voxel.x >> VOXEL_BLOCK_SHIFT, voxel.y >> VOXEL_BLOCK_SHIFT, voxel.z >> VOXEL_BLOCK_SHIFT);
+}
+
+int SwarmVoxelTree::map_to_index(const glm::ivec3& voxel) {
+	int mask = VOXEL_BLOCK_SIZE - 1;
+	return ((voxel.z & mask) << 6) | ((voxel.y & mask) << 3) | (voxel.x & mask);
+}
+
+const VoxelBlock* SwarmVoxelTree::find_block(const glm::ivec3& block_position) const {
+	auto block = block_map_.find(block_position);
+	return (block == block_map_.end()) ? nullptr : &blocks_[block->second];
+}
+
+int SwarmVoxelTree::find_or_create_block(const glm::ivec3& block_position) {
+	auto inserted = block_map_.insert(std::make_pair(block_position, int(blocks_.size())));
+	if (inserted.second) {
+		blocks_.push_back(VoxelBlock(block_position * VOXEL_BLOCK_SIZE));
+	}
+	return inserted.first->second;
+}
+
+void SwarmVoxelTree::mark_surface(const glm::vec3& position) {
+	glm::ivec3 voxel = map_to_voxel(position);
+	int block_index = find_or_create_block(map_to_block(voxel));
+	auto& block = blocks_[block_index];
+	int index = map_to_index(voxel);
+	block.staged_points.push_back(std::make_pair(index, position));
+	no_of_points_++;
+	if (block.is_surface(index)) {
+		return;
+	}
+
+	block.surface[index >> 6] |= std::uint64_t(1) << (index & 63);
+	block.no_of_unexplored++;
+	if (block.frontier_index < 0) {
+		block.frontier_index = frontier_blocks_.size();
+		frontier_blocks_.push_back(block_index);
+	}
+	no_of_surface_voxels_++;
+	min_voxel_ = glm::min(min_voxel_, voxel);
+	max_voxel_ = glm::max(max_voxel_, voxel);
+}
+
+void SwarmVoxelTree::mark_surface_triangle(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c) {
+	glm::vec3 ab = b - a;
+	glm::vec3 ac = c - a;
+	float max_length = std::max(std::max(glm::length(ab), glm::length(ac)), glm::length(c - b));
+	int no_of_steps = std::max(1, int(std::ceil(max_length / (0.5f * voxel_length_))));
+
+	for (int i = 0; i <= no_of_steps; ++i) {
+		for (int j = 0; i + j <= no_of_steps; ++j) {
+			mark_surface(a + ab * (float(i) / no_of_steps) + ac * (float(j) / no_of_steps));
+		}
+	}
+}
+
+bool SwarmVoxelTree::is_surface(const glm::ivec3& voxel) const {
+	auto block = find_block(map_to_block(voxel));
+	return block && block->is_surface(map_to_index(voxel));
+}
+
+bool SwarmVoxelTree::has_explored(const glm::ivec3& voxel) const {
+	auto block = find_block(map_to_block(voxel));
+	return block && block->has_explored(map_to_index(voxel));
+}
+
+// amanatides woo, walks the voxels the line crosses one face at a time. the block of the last step is kept,
+// consecutive voxels are mostly in the same one
+bool SwarmVoxelTree::is_line_of_sight(const glm::ivec3& from, const glm::ivec3& to) const {
+	glm::ivec3 direction = to - from;
+	glm::ivec3 step;
+	glm::dvec3 t_max;
+	glm::dvec3 t_delta;
+	for (int i = 0; i < 3; ++i) {
+		step[i] = (direction[i] > 0) ? 1 : ((direction[i] < 0) ? -1 : 0);
+		t_delta[i] = (direction[i] != 0) ? 1.0 / std::abs(direction[i]) : std::numeric_limits<double>::max();
+		// starting from the center, the first face is half a voxel away
+		t_max[i] = (direction[i] != 0) ? 0.5 * t_delta[i] : std::numeric_limits<double>::max();
+	}
+
+	int no_of_steps = std::abs(direction.x) + std::abs(direction.y) + std::abs(direction.z);
+	glm::ivec3 voxel = from;
+	glm::ivec3 block_position = map_to_block(from);
+	const VoxelBlock* block = find_block(block_position);
+	for (int i = 0; i + 1 < no_of_steps; ++i) {
+		int axis = (t_max.x < t_max.y) ? ((t_max.x < t_max.z) ? 0 : 2) : ((t_max.y < t_max.z) ? 1 : 2);
+		voxel[axis] += step[axis];
+		t_max[axis] += t_delta[axis];
+
+		glm::ivec3 voxel_block_position = map_to_block(voxel);
+		if (voxel_block_position != block_position) {
+			block_position = voxel_block_position;
+			block = find_block(block_position);
+		}
+		if (voxel != to && block && block->is_surface(map_to_index(voxel))) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void SwarmVoxelTree::get_surface_in_range(const glm::ivec3& voxel, int sensor_range,
+	std::vector<glm::ivec3>& surface_voxels, bool line_of_sight) const {
+	surface_voxels.clear();
+	glm::ivec3 low = voxel - glm::ivec3(sensor_range);
+	glm::ivec3 high = voxel + glm::ivec3(sensor_range);
+	glm::ivec3 low_block = map_to_block(low);
+	glm::ivec3 high_block = map_to_block(high);
+
+	auto add_surface = [&](const VoxelBlock& block) {
+		glm::ivec3 block_low = glm::max(low, block.origin) - block.origin;
+		glm::ivec3 block_high = glm::min(high, block.origin + glm::ivec3(VOXEL_BLOCK_SIZE - 1)) - block.origin;
+		if (block_low.x > block_high.x || block_low.y > block_high.y || block_low.z > block_high.z) {
+			return;
+		}
+		// the x, y part of the window, the same for every z
+		std::uint64_t row = (0xFFu >> (VOXEL_BLOCK_SIZE - 1 - (block_high.x - block_low.x))) << block_low.x;
+		std::uint64_t mask = 0;
+		for (int y = block_low.y; y <= block_high.y; ++y) {
+			mask |= row << (y * VOXEL_BLOCK_SIZE);
+		}
+		for (int z = block_low.z; z <= block_high.z; ++z) {
+			std::uint64_t word = block.surface[z] & mask;
+			while (word) {
+				int bit = FloorPlanLevel::lowest_bit(word);
+				word &= word - 1;
+				glm::ivec3 surface_voxel = block.origin + glm::ivec3(bit & (VOXEL_BLOCK_SIZE - 1), bit >> VOXEL_BLOCK_SHIFT, z);
+				if (!line_of_sight || is_line_of_sight(voxel, surface_voxel)) {
+					surface_voxels.push_back(surface_voxel);
+				}
+			}
+		}
+	};
+
+	// a long range window over a small model has fewer blocks than the window has block positions
+	glm::ivec3 window_blocks = high_block - low_block + glm::ivec3(1);
+	long long no_of_window_blocks = (long long)window_blocks.x * window_blocks.y * window_blocks.z;
+	if (no_of_window_blocks > (long long)blocks_.size()) {
+		for (auto& block : blocks_) {
+			add_surface(block);
+		}
+		return;
+	}
+
+	for (int z = low_block.z; z <= high_block.z; ++z) {
+		for (int y = low_block.y; y <= high_block.y; ++y) {
+			for (int x = low_block.x; x <= high_block.x; ++x) {
+				auto block = find_block(glm::ivec3(x, y, z));
+				if (block) {
+					add_surface(*block);
+				}
+			}
+		}
+	}
+}
+
+int SwarmVoxelTree::explore(const glm::ivec3& voxel, int sensor_range) {
+	get_surface_in_range(voxel, sensor_range, sensor_window_);
+
+	int no_of_explored = 0;
+	for (auto& surface_voxel : sensor_window_) {
+		int block_index = block_map_[map_to_block(surface_voxel)];
+		auto& block = blocks_[block_index];
+		int index = map_to_index(surface_voxel);
+		if (block.has_explored(index)) {
+			continue;
+		}
+		block.explored[index >> 6] |= std::uint64_t(1) << (index & 63);
+		block.no_of_unexplored--;
+		no_of_explored++;
+
+		if (block.no_of_unexplored == 0) {
+			// swap with the last frontier block
+			int last_block_index = frontier_blocks_.back();
+			frontier_blocks_[block.frontier_index] = last_block_index;
+			blocks_[last_block_index].frontier_index = block.frontier_index;
+			frontier_blocks_.pop_back();
+			block.frontier_index = -1;
+		}
+	}
+	no_of_explored_voxels_ += no_of_explored;
+	return no_of_explored;
+}
+
+const std::vector<glm::ivec3>& SwarmVoxelTree::get_sensor_window() const {
+	return sensor_window_;
+}
+
+// a block no closer than the best so far is skipped without looking at its voxels
+bool SwarmVoxelTree::nearest_frontier(const glm::ivec3& voxel, glm::ivec3& frontier, int max_range,
+	bool line_of_sight) const {
+	long long best_distance = (long long)max_range * max_range;
+	bool found = false;
+
+	for (auto block_index : frontier_blocks_) {
+		auto& block = blocks_[block_index];
+		glm::ivec3 block_high = block.origin + glm::ivec3(VOXEL_BLOCK_SIZE - 1);
+		glm::ivec3 gap = glm::max(glm::max(block.origin - voxel, voxel - block_high), glm::ivec3(0));
+		long long block_distance = (long long)gap.x * gap.x + (long long)gap.y * gap.y + (long long)gap.z * gap.z;
+		if (block_distance > best_distance || (found && block_distance == best_distance)) {
+			continue;
+		}
+
+		for (int z = 0; z < VOXEL_BLOCK_SIZE; ++z) {
+			std::uint64_t word = block.surface[z] & ~block.explored[z];
+			while (word) {
+				int bit = FloorPlanLevel::lowest_bit(word);
+				word &= word - 1;
+				glm::ivec3 candidate = block.origin + glm::ivec3(bit & (VOXEL_BLOCK_SIZE - 1), bit >> VOXEL_BLOCK_SHIFT, z);
+				glm::ivec3 difference = candidate - voxel;
+				long long distance = (long long)difference.x * difference.x + (long long)difference.y * difference.y
+					+ (long long)difference.z * difference.z;
+				if (distance > best_distance || (found && distance == best_distance)) {
+					continue;
+				}
+				if (line_of_sight && !is_line_of_sight(voxel, candidate)) {
+					continue;
+				}
+				best_distance = distance;
+				frontier = candidate;
+				found = true;
+			}
+		}
+	}
+	return found;
+}
+
+void SwarmVoxelTree::pack_points(VoxelBlock& block) {
+	if (block.staged_points.empty()) {
+		return;
+	}
+
+	const int no_of_voxels = VOXEL_BLOCK_SIZE * VOXEL_BLOCK_SIZE * VOXEL_BLOCK_SIZE;
+	std::vector<int> counts(no_of_voxels, 0);
+	for (int index = 0; index + 1 < block.offsets.size(); ++index) {
+		counts[index] = block.offsets[index + 1] - block.offsets[index];
+	}
+	for (auto& staged_point : block.staged_points) {
+		counts[staged_point.first]++;
+	}
+
+	std::vector<int> offsets(no_of_voxels + 1, 0);
+	for (int index = 0; index < no_of_voxels; ++index) {
+		offsets[index + 1] = offsets[index] + counts[index];
+	}
+
+	std::vector<glm::vec3> points(offsets.back());
+	std::vector<int> next(offsets.begin(), offsets.end() - 1);
+	for (int index = 0; index + 1 < block.offsets.size(); ++index) {
+		for (int i = block.offsets[index]; i < block.offsets[index + 1]; ++i) {
+			points[next[index]++] = block.points[i];
+		}
+	}
+	for (auto& staged_point : block.staged_points) {
+		points[next[staged_point.first]++] = staged_point.second;
+	}
+
+	block.points.swap(points);
+	block.offsets.swap(offsets);
+	std::vector<std::pair<int, glm::vec3>>().swap(block.staged_points);
+}
+
+PointSpan SwarmVoxelTree::get_3d_points(const glm::ivec3& voxel) {
+	auto block = block_map_.find(map_to_block(voxel));
+	if (block == block_map_.end()) {
+		return PointSpan(nullptr, nullptr);
+	}
+	auto& voxel_block = blocks_[block->second];
+	pack_points(voxel_block);
+	int index = map_to_index(voxel);
+	const glm::vec3* first = voxel_block.points.data();
+	return PointSpan(first + voxel_block.offsets[index], first + voxel_block.offsets[index + 1]);
+}
+
+void SwarmVoxelTree::update_multi_sampling_map(const glm::ivec3& voxel) {
+	auto block = block_map_.find(map_to_block(voxel));
+	if (block == block_map_.end()) {
+		return;
+	}
+	auto& voxel_block = blocks_[block->second];
+	int index = map_to_index(voxel);
+	if (!voxel_block.is_surface(index)) {
+		return;
+	}
+	if (voxel_block.multi_sampling_map.empty()) {
+		voxel_block.multi_sampling_map.resize(VOXEL_BLOCK_SIZE * VOXEL_BLOCK_SIZE * VOXEL_BLOCK_SIZE, 0);
+	}
+	voxel_block.multi_sampling_map[index]++;
+}
+
+double SwarmVoxelTree::calculate_multi_sampling_factor() const {
+	long long total_no_of_samples = 0;
+	for (auto& block : blocks_) {
+		for (auto no_of_samples : block.multi_sampling_map) {
+			total_no_of_samples += no_of_samples;
+		}
+	}
+	return (no_of_surface_voxels_ > 0) ? (total_no_of_samples / double(no_of_surface_voxels_)) : 0.0;
+}
+
+double SwarmVoxelTree::calculate_density() const {
+	long long no_of_sampled_voxels = 0;
+	for (auto& block : blocks_) {
+		for (auto no_of_samples : block.multi_sampling_map) {
+			if (no_of_samples > 0) {
+				no_of_sampled_voxels++;
+			}
+		}
+	}
+	return (no_of_surface_voxels_ > 0) ? (no_of_sampled_voxels / double(no_of_surface_voxels_)) : 0.0;
+}
+
+double SwarmVoxelTree::calculate_coverage() const {
+	return (no_of_surface_voxels_ > 0) ? (no_of_explored_voxels_ / double(no_of_surface_voxels_)) : 0.0;
+}
+
+long long SwarmVoxelTree::get_no_of_surface_voxels() const {
+	return no_of_surface_voxels_;
+}
+
+long long SwarmVoxelTree::get_no_of_explored_voxels() const {
+	return no_of_explored_voxels_;
+}
+
+long long SwarmVoxelTree::get_no_of_points() const {
+	return no_of_points_;
+}
+
+int SwarmVoxelTree::get_no_of_blocks() const {
+	return blocks_.size();
+}
+
+long long SwarmVoxelTree::get_memory_usage() const {
+	long long memory_usage = sizeof(*this) + blocks_.capacity() * sizeof(VoxelBlock)
+		+ frontier_blocks_.capacity() * sizeof(int) + sensor_window_.capacity() * sizeof(glm::ivec3);
+	for (auto& block : blocks_) {
+		memory_usage += block.multi_sampling_map.capacity() * sizeof(int) + block.points.capacity() * sizeof(glm::vec3)
+			+ block.offsets.capacity() * sizeof(int) + block.staged_points.capacity() * sizeof(std::pair<int, glm::vec3>);
+	}
+	// buckets and one node per block
+	memory_usage += block_map_.bucket_count() * sizeof(void*)
+		+ block_map_.size() * (sizeof(std::pair<const glm::ivec3, int>) + 2 * sizeof(void*));
+	return memory_usage;
+}
@@ -0,0 +1,107 @@
+#pragma once
+#include "fsl_common.h"
+#include "swarmtree.h"
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#define VOXEL_BLOCK_SIZE 8
+#define VOXEL_BLOCK_SHIFT 3
+
+struct VoxelBlockHasher {
+	std::size_t operator()(const glm::ivec3& k) const {
+		return (std::size_t(k.x) * 73856093u) ^ (std::size_t(k.y) * 19349663u) ^ (std::size_t(k.z) * 83492791u);
+	}
+};
+
+// VOXEL_BLOCK_SIZE^3 voxels. bit y * 8 + x of word z is the voxel origin + (x, y, z)
+struct VoxelBlock {
+	glm::ivec3 origin;
+	std::uint64_t surface[VOXEL_BLOCK_SIZE];
+	std::uint64_t explored[VOXEL_BLOCK_SIZE];
+	int no_of_unexplored;
+	// into frontier_blocks_, -1 once every surface voxel of the block is explored
+	int frontier_index;
+	// no of samples per voxel, empty until one of them is sampled
+	std::vector<int> multi_sampling_map;
+	// points of voxel i are points[offsets[i], offsets[i + 1]), staged and packed as in Swarm3DReconTree
+	std::vector<glm::vec3> points;
+	std::vector<int> offsets;
+	std::vector<std::pair<int, glm::vec3>> staged_points;
+
+	explicit VoxelBlock(const glm::ivec3& origin);
+	bool is_surface(int index) const { return (surface[index >> 6] >> (index & 63)) & 1; }
+	bool has_explored(int index) const { return (explored[index >> 6] >> (index & 63)) & 1; }
+};
+
+// a 3D counterpart of the occupancy and recon grids for interiors with more than one storey. only the voxels
+// a model's triangles pass through are stored, in blocks found through a hash map, so memory goes with the
+// surface of the building rather than its volume. a voxel is explored once a sensor has seen it, the frontier
+// is the surface that hasn't been
+class SwarmVoxelTree {
+	float voxel_length_;
+	std::vector<VoxelBlock> blocks_;
+	std::unordered_map<glm::ivec3, int, VoxelBlockHasher, IVec3Equals> block_map_;
+	// blocks with unexplored surface, what the frontier search goes over
+	std::vector<int> frontier_blocks_;
+	long long no_of_surface_voxels_;
+	long long no_of_explored_voxels_;
+	long long no_of_points_;
+	glm::ivec3 min_voxel_;
+	glm::ivec3 max_voxel_;
+	std::vector<glm::ivec3> sensor_window_;
+
+	const VoxelBlock* find_block(const glm::ivec3& block_position) const;
+	int find_or_create_block(const glm::ivec3& block_position);
+	void pack_points(VoxelBlock& block);
+	static glm::ivec3 map_to_block(const glm::ivec3& voxel);
+	static int map_to_index(const glm::ivec3& voxel);
+
+public:
+	explicit SwarmVoxelTree(float voxel_length);
+	void clear();
+
+	float get_voxel_length() const;
+	glm::ivec3 map_to_voxel(const glm::vec3& position) const;
+	// the center of the voxel
+	glm::vec3 map_to_position(const glm::ivec3& voxel) const;
+	glm::ivec3 get_min_voxel() const;
+	glm::ivec3 get_max_voxel() const;
+
+	// marks the voxel of position as surface and keeps position as a 3d point of it
+	void mark_surface(const glm::vec3& position);
+	// samples the triangle every half voxel, so every voxel it passes through is marked
+	void mark_surface_triangle(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c);
+	bool is_surface(const glm::ivec3& voxel) const;
+	bool has_explored(const glm::ivec3& voxel) const;
+	// false if a surface voxel other than the two ends is on the line between their centers
+	bool is_line_of_sight(const glm::ivec3& from, const glm::ivec3& to) const;
+
+	// the surface voxels within sensor_range voxels of voxel on every axis
+	void get_surface_in_range(const glm::ivec3& voxel, int sensor_range, std::vector<glm::ivec3>& surface_voxels,
+		bool line_of_sight = true) const;
+	// marks what the sensor sees from voxel as explored, returns the no of newly explored voxels
+	int explore(const glm::ivec3& voxel, int sensor_range);
+	// the surface voxels the last explore saw, explored before or not
+	const std::vector<glm::ivec3>& get_sensor_window() const;
+	// the closest unexplored surface voxel no further than max_range voxels. with line_of_sight, the closest
+	// that can be seen from voxel
+	bool nearest_frontier(const glm::ivec3& voxel, glm::ivec3& frontier, int max_range = GRID_MAX,
+		bool line_of_sight = false) const;
+
+	PointSpan get_3d_points(const glm::ivec3& voxel);
+	void update_multi_sampling_map(const glm::ivec3& voxel);
+	// average no of samples over the surface voxels
+	double calculate_multi_sampling_factor() const;
+	// fraction of the surface voxels sampled at least once
+	double calculate_density() const;
+	// fraction of the surface voxels explored
+	double calculate_coverage() const;
+
+	long long get_no_of_surface_voxels() const;
+	long long get_no_of_explored_voxels() const;
+	long long get_no_of_points() const;
+	int get_no_of_blocks() const;
+	// blocks, point lists and the hash map, in bytes
+	long long get_memory_usage() const;
+};
@@ -0,0 +1,219 @@
+#include "swarmvoxelsim.h"
+#include "swarmutils.h"
+#include "renderentity.h"
+#include "counterrng.h"
+#include <QFileInfo>
+#include <iostream>
+#include <limits>
+#include <queue>
+#include <unordered_map>
+
+const int SwarmVoxelSimulator::REPORT_INTERVAL = 100;
+const int SwarmVoxelSimulator::FORMATION_RANGE = 3;
+const int SwarmVoxelSimulator::MAX_PATH_SEARCH = 1 << 20;
+
+SwarmVoxelSimulator::SwarmVoxelSimulator(const SwarmParams& swarm_params) : swarm_params_(swarm_params),
+	voxel_tree_(swarm_params.grid_length_), time_step_count_(0), no_of_sampled_points_(0) {
+}
+
+bool SwarmVoxelSimulator::load_model() {
+	voxel_tree_.clear();
+	if (!QFileInfo(swarm_params_.model_filename_).exists()) {
+		std::cout << "Unable to load the model : " << swarm_params_.model_filename_.toStdString() << std::endl;
+		return false;
+	}
+	VertexBufferData vertex_buffer_data;
+	SwarmUtils::load_obj(swarm_params_.model_filename_.toStdString(), vertex_buffer_data);
+	glm::vec3 model_offset(swarm_params_.x_spin_box_, swarm_params_.y_spin_box_, swarm_params_.z_spin_box_);
+	SwarmUtils::derive_voxels(vertex_buffer_data, swarm_params_.scale_spinbox_, model_offset, &voxel_tree_);
+
+	std::cout << swarm_params_.model_filename_.toStdString() << " : " << voxel_tree_.get_no_of_surface_voxels()
+		<< " surface voxels in " << voxel_tree_.get_no_of_blocks() << " blocks, "
+		<< voxel_tree_.get_memory_usage() / (1024 * 1024) << " MB" << std::endl;
+	return voxel_tree_.get_no_of_surface_voxels() > 0;
+}
+
+// anywhere that isn't surface, up to a voxel outside the model
+bool SwarmVoxelSimulator::is_free(const glm::ivec3& voxel) const {
+	glm::ivec3 low = voxel_tree_.get_min_voxel() - glm::ivec3(1);
+	glm::ivec3 high = voxel_tree_.get_max_voxel() + glm::ivec3(1);
+	if (voxel.x < low.x || voxel.y < low.y || voxel.z < low.z || voxel.x > high.x || voxel.y > high.y || voxel.z > high.z) {
+		return false;
+	}
+	return !voxel_tree_.is_surface(voxel);
+}
+
+void SwarmVoxelSimulator::create_robots() {
+	robot_voxels_.clear();
+	glm::ivec3 center = (voxel_tree_.get_min_voxel() + voxel_tree_.get_max_voxel()) / 2;
+	// a floor through the middle, the first free voxel above it
+	while (!is_free(center) && center.y <= voxel_tree_.get_max_voxel().y) {
+		center.y++;
+	}
+
+	for (int robot = 0; robot < swarm_params_.no_of_robots_; ++robot) {
+		CounterRng rng(swarm_params_.seed_, robot, 0, CounterRng::STARTING_FORMATION);
+		glm::ivec3 voxel = center;
+		for (int tries = 0; tries < 100; ++tries) {
+			glm::ivec3 candidate = center + glm::ivec3(rng.uniform_int(-FORMATION_RANGE, FORMATION_RANGE),
+				rng.uniform_int(-FORMATION_RANGE, FORMATION_RANGE), rng.uniform_int(-FORMATION_RANGE, FORMATION_RANGE));
+			if (is_free(candidate)) {
+				voxel = candidate;
+				break;
+			}
+		}
+		robot_voxels_.push_back(voxel);
+	}
+	previous_voxels_ = robot_voxels_;
+	paths_.assign(robot_voxels_.size(), std::vector<glm::ivec3>());
+	path_targets_.assign(robot_voxels_.size(), glm::ivec3(0));
+	time_step_count_ = 0;
+	no_of_sampled_points_ = 0;
+}
+
+static const glm::ivec3 directions[6] = { glm::ivec3(1, 0, 0), glm::ivec3(-1, 0, 0), glm::ivec3(0, 1, 0),
+	glm::ivec3(0, -1, 0), glm::ivec3(0, 0, 1), glm::ivec3(0, 0, -1) };
+
+// standing next to an unexplored surface voxel is enough, the sensor sees it from there
+int SwarmVoxelSimulator::find_path(int robot) {
+	auto& path = paths_[robot];
+	path.clear();
+	glm::ivec3 start = robot_voxels_[robot];
+	std::unordered_map<glm::ivec3, glm::ivec3, VoxelBlockHasher, IVec3Equals> parents;
+	std::queue<glm::ivec3> queue;
+	parents[start] = start;
+	queue.push(start);
+
+	while (!queue.empty()) {
+		if (parents.size() > MAX_PATH_SEARCH) {
+			return -1;
+		}
+		glm::ivec3 voxel = queue.front();
+		queue.pop();
+		for (auto& direction : directions) {
+			glm::ivec3 neighbour = voxel + direction;
+			if (voxel_tree_.is_surface(neighbour) && !voxel_tree_.has_explored(neighbour)) {
+				path_targets_[robot] = neighbour;
+				for (; voxel != start; voxel = parents[voxel]) {
+					path.push_back(voxel);
+				}
+				return 1;
+			}
+		}
+		for (auto& direction : directions) {
+			glm::ivec3 neighbour = voxel + direction;
+			if (is_free(neighbour) && parents.find(neighbour) == parents.end()) {
+				parents[neighbour] = voxel;
+				queue.push(neighbour);
+			}
+		}
+	}
+	return 0;
+}
+
+// greedy, the free neighbour closest to goal, for when the path search gives up on a big model. a robot can
+// follow a wall for a while before it finds a way round
+void SwarmVoxelSimulator::step_towards(int robot, const glm::ivec3& goal) {
+	glm::ivec3 voxel = robot_voxels_[robot];
+	glm::ivec3 next_voxel = previous_voxels_[robot];
+	long long best_distance = std::numeric_limits<long long>::max();
+	for (auto& direction : directions) {
+		glm::ivec3 candidate = voxel + direction;
+		if (candidate == previous_voxels_[robot] || !is_free(candidate)) {
+			continue;
+		}
+		glm::ivec3 difference = goal - candidate;
+		long long distance = (long long)difference.x * difference.x + (long long)difference.y * difference.y
+			+ (long long)difference.z * difference.z;
+		if (distance < best_distance) {
+			best_distance = distance;
+			next_voxel = candidate;
+		}
+	}
+
+	previous_voxels_[robot] = voxel;
+	robot_voxels_[robot] = next_voxel;
+}
+
+bool SwarmVoxelSimulator::step() {
+	int sensor_range = static_cast<int>(swarm_params_.sensor_range_);
+	for (auto& voxel : robot_voxels_) {
+		voxel_tree_.explore(voxel, sensor_range);
+		for (auto& surface_voxel : voxel_tree_.get_sensor_window()) {
+			voxel_tree_.update_multi_sampling_map(surface_voxel);
+			no_of_sampled_points_ += voxel_tree_.get_3d_points(surface_voxel).size();
+		}
+	}
+
+	// after everyone has sensed, so no one heads for what another robot saw this tick
+	bool has_frontier = false;
+	glm::ivec3 frontier;
+	if (!voxel_tree_.nearest_frontier(robot_voxels_.empty() ? glm::ivec3(0) : robot_voxels_[0], frontier)) {
+		time_step_count_++;
+		return false;
+	}
+	for (int robot = 0; robot < robot_voxels_.size(); ++robot) {
+		// the path is kept until what it leads to has been seen, by this robot or another
+		int found = 1;
+		if (paths_[robot].empty() || voxel_tree_.has_explored(path_targets_[robot])) {
+			found = find_path(robot);
+		}
+		if (found == 1) {
+			has_frontier = true;
+			if (!paths_[robot].empty()) {
+				previous_voxels_[robot] = robot_voxels_[robot];
+				robot_voxels_[robot] = paths_[robot].back();
+				paths_[robot].pop_back();
+			}
+		} else if (found < 0 && voxel_tree_.nearest_frontier(robot_voxels_[robot], frontier)) {
+			has_frontier = true;
+			step_towards(robot, frontier);
+		}
+	}
+	time_step_count_++;
+	return has_frontier;
+}
+
+void SwarmVoxelSimulator::run(std::ostream* results) {
+	auto write_row = [&]() {
+		if (results) {
+			*results << time_step_count_ << "," << voxel_tree_.calculate_coverage() << "," << voxel_tree_.calculate_density()
+				<< "," << voxel_tree_.calculate_multi_sampling_factor() << "," << no_of_sampled_points_ << "\n";
+		}
+	};
+	if (results) {
+		*results << "time_step,coverage,density,multi_sampling_factor,no_of_sampled_points\n";
+	}
+
+	bool has_frontier = true;
+	while (has_frontier && time_step_count_ < swarm_params_.max_time_taken_
+		&& voxel_tree_.calculate_coverage() < swarm_params_.coverage_needed_) {
+		has_frontier = step();
+		if (time_step_count_ % REPORT_INTERVAL == 0) {
+			write_row();
+		}
+	}
+	if (time_step_count_ % REPORT_INTERVAL != 0) {
+		write_row();
+	}
+
+	std::cout << robot_voxels_.size() << " robots, " << time_step_count_ << " ticks, coverage "
+		<< voxel_tree_.calculate_coverage() << ", density " << voxel_tree_.calculate_density()
+		<< ", multi sampling " << voxel_tree_.calculate_multi_sampling_factor() << std::endl;
+}
+
+int SwarmVoxelSimulator::get_time_step_count() const {
+	return time_step_count_;
+}
+
+long long SwarmVoxelSimulator::get_no_of_sampled_points() const {
+	return no_of_sampled_points_;
+}
+
+const std::vector<glm::ivec3>& SwarmVoxelSimulator::get_robot_voxels() const {
+	return robot_voxels_;
+}
+
+const SwarmVoxelTree& SwarmVoxelSimulator::get_voxel_tree() const {
+	return voxel_tree_;
+}
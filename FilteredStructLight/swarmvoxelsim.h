@@ -0,0 +1,48 @@
+#pragma once
+#include "robot.h"
+#include "swarmvoxels.h"
+#include <ostream>
+#include <vector>
+
+// the swarm in 3d over a SwarmVoxelTree of the config's model, for interiors with more than one storey. there's no
+// floor plan and no flocking, each robot samples everything its sensor sees and flies a voxel per tick along the
+// shortest free path to the closest unexplored surface it can reach. run with
+// FilteredStructLight --voxel-explore <swarm config.ini> [output.csv]
+class SwarmVoxelSimulator {
+	SwarmParams swarm_params_;
+	SwarmVoxelTree voxel_tree_;
+	std::vector<glm::ivec3> robot_voxels_;
+	// where each robot was the tick before, the greedy step doesn't go straight back there
+	std::vector<glm::ivec3> previous_voxels_;
+	// next voxel last, and the unexplored surface voxel the path leads to
+	std::vector<std::vector<glm::ivec3>> paths_;
+	std::vector<glm::ivec3> path_targets_;
+	int time_step_count_;
+	long long no_of_sampled_points_;
+
+	bool is_free(const glm::ivec3& voxel) const;
+	// breadth first over free voxels. 1 when a path was found, 0 when nothing unexplored can be reached and -1
+	// when the search gave up after MAX_PATH_SEARCH voxels
+	int find_path(int robot);
+	void step_towards(int robot, const glm::ivec3& goal);
+
+public:
+	static const int REPORT_INTERVAL;
+	static const int FORMATION_RANGE;
+	static const int MAX_PATH_SEARCH;
+
+	explicit SwarmVoxelSimulator(const SwarmParams& swarm_params);
+	// voxelizes model_filename_ with grid_length_ voxels
+	bool load_model();
+	// no_of_robots_ around the middle of the model
+	void create_robots();
+	// every robot senses, then moves. false once no robot can get to unexplored surface
+	bool step();
+	// until coverage_needed_, max_time_taken_ or the surface is explored. a row every REPORT_INTERVAL ticks
+	void run(std::ostream* results = nullptr);
+
+	int get_time_step_count() const;
+	long long get_no_of_sampled_points() const;
+	const std::vector<glm::ivec3>& get_robot_voxels() const;
+	const SwarmVoxelTree& get_voxel_tree() const;
+};